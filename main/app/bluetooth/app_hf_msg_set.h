@@ -21,6 +21,8 @@ typedef struct {
 
 /**
  * @brief Store information about a paired Bluetooth device
+ *
+ * Adds it to the paired device registry as the most recent entry.
  * 
  * @param bd_addr Bluetooth address of the paired device
  * @param device_name Name of the paired device (optional)
@@ -29,7 +31,7 @@ typedef struct {
 esp_err_t app_hf_store_paired_device(const esp_bd_addr_t bd_addr, const char* device_name);
 
 /**
- * @brief Retrieve information about the last paired Bluetooth device
+ * @brief Retrieve information about the most recently connected paired device
  * 
  * @param bd_addr Buffer to store the Bluetooth address
  * @param device_name Buffer to store the device name (optional)
@@ -39,7 +41,7 @@ esp_err_t app_hf_store_paired_device(const esp_bd_addr_t bd_addr, const char* de
 esp_err_t app_hf_get_paired_device(esp_bd_addr_t bd_addr, char* device_name, size_t name_len);
 
 /**
- * @brief Clear stored information about the paired Bluetooth device
+ * @brief Clear all paired devices from the registry
  * 
  * @return ESP_OK on success, ESP_FAIL on failure
  */
@@ -0,0 +1,265 @@
+#include "announce.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "audio/announce_image.h"
+#include "audio/audio_output.h"
+#include "config/audio_config.h"
+#include "config/call_config.h"
+#include "network/clock/clock.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "announce";
+
+// Two samples a byte at 8 kHz
+#define ANNOUNCE_BYTES_TO_MS(b) ((uint32_t)(b) * 2 * 1000 / AUDIO_SAMPLE_RATE)
+#define ANNOUNCE_MS_TO_BYTES(ms) ((uint32_t)(ms) * AUDIO_SAMPLE_RATE / 2 / 1000)
+
+_Static_assert(2 * ANNOUNCE_REPEATS - 1 <= AUDIO_CLIPS_MAX, "Repeats and gaps must fit one announcement");
+
+// Time of day, run from the timer: a pause after dialing, then the clips
+typedef enum {
+    TIME_IDLE,
+    TIME_PENDING,       // Waiting out ANNOUNCE_LEAD_MS
+    TIME_PLAYING,       // Clips playing, timer set for their length
+} time_state_t;
+
+// The image stays mapped for the life of the firmware
+static bool mounted = false;
+static announce_image_t image;
+static esp_partition_mmap_handle_t map_handle;
+
+static esp_timer_handle_t time_timer = NULL;
+static time_state_t time_state = TIME_IDLE;
+static portMUX_TYPE time_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Append a clip by name; a missing one is left out
+static void add_clip(audio_clip_t *list, size_t *n, const char *name)
+{
+    const announce_image_entry_t *entry = announce_image_find(&image, name);
+
+    if (entry != NULL && *n < AUDIO_CLIPS_MAX) {
+        list[*n].adpcm = announce_image_data(&image, entry);
+        list[*n].len = entry->length;
+        (*n)++;
+    }
+}
+
+static void add_number(audio_clip_t *list, size_t *n, int value)
+{
+    char name[ANNOUNCE_NAME_LEN];
+    snprintf(name, sizeof(name), "n_%d", value);
+    add_clip(list, n, name);
+}
+
+static uint32_t play_list(const audio_clip_t *list, size_t n)
+{
+    uint32_t bytes = 0;
+
+    if (n == 0 || audio_output_play_clips(list, n) != ESP_OK) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        bytes += list[i].len;
+    }
+    return ANNOUNCE_BYTES_TO_MS(bytes);
+}
+
+uint32_t announce_play(const char *name)
+{
+    audio_clip_t list[AUDIO_CLIPS_MAX];
+    size_t n = 0;
+
+    if (!mounted || announce_image_find(&image, name) == NULL) {
+        return 0;
+    }
+
+    for (int i = 0; i < ANNOUNCE_REPEATS; i++) {
+        if (i > 0) {
+            list[n].adpcm = NULL;
+            list[n].len = ANNOUNCE_MS_TO_BYTES(ANNOUNCE_GAP_MS);
+            n++;
+        }
+        add_clip(list, &n, name);
+    }
+
+    uint32_t ms = play_list(list, n);
+    ESP_LOGI(TAG, "Playing \"%s\", %" PRIu32 " ms", name, ms);
+    return ms;
+}
+
+void announce_stop(void)
+{
+    if (mounted) {
+        audio_output_stop_clips();
+    }
+}
+
+// "The time is" ten forty-five PM; minutes read as "oh five", "oclock", etc.
+static uint32_t play_time(void)
+{
+    audio_clip_t list[AUDIO_CLIPS_MAX];
+    size_t n = 0;
+    struct tm local;
+
+    if (!clock_localtime(&local)) {
+        ESP_LOGW(TAG, "Clock not set, no time to read out");
+        return 0;
+    }
+
+    int hour = local.tm_hour % 12;
+    int min = local.tm_min;
+
+    add_clip(list, &n, "time");
+    add_number(list, &n, (hour == 0) ? 12 : hour);
+    if (min == 0) {
+        add_clip(list, &n, "oclock");
+    } else if (min < 10) {
+        add_clip(list, &n, "oh");
+        add_number(list, &n, min);
+    } else if (min < 20 || min % 10 == 0) {
+        add_number(list, &n, min);
+    } else {
+        add_number(list, &n, min - min % 10);
+        add_number(list, &n, min % 10);
+    }
+    add_clip(list, &n, (local.tm_hour < 12) ? "am" : "pm");
+
+    uint32_t ms = play_list(list, n);
+    ESP_LOGI(TAG, "Time %02d:%02d, %" PRIu32 " ms", local.tm_hour, min, ms);
+    return ms;
+}
+
+static void time_timer_cb(void *arg)
+{
+    portENTER_CRITICAL(&time_lock);
+    time_state_t was = time_state;
+    time_state = (was == TIME_PENDING) ? TIME_PLAYING : TIME_IDLE;
+    portEXIT_CRITICAL(&time_lock);
+
+    if (was == TIME_PENDING) {
+        // Call progress goes quiet, and drops any announcement, before ours starts
+        event_publish(PHONE_EVENT_ANNOUNCE_START, NULL);
+        uint32_t ms = ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK) ? play_time() : 0;
+        if (ms > 0) {
+            esp_timer_start_once(time_timer, (uint64_t)ms * 1000);
+            return;
+        }
+        // Nothing to read out, straight back to dial tone
+        portENTER_CRITICAL(&time_lock);
+        time_state = TIME_IDLE;
+        portEXIT_CRITICAL(&time_lock);
+    }
+    if (was != TIME_IDLE) {
+        event_publish(PHONE_EVENT_ANNOUNCE_END, NULL);
+    }
+}
+
+static void announce_event_handler(event_type_t event, void *user_data)
+{
+    // Hung up: the handset is idle again, whatever the time read-out was doing
+    portENTER_CRITICAL(&time_lock);
+    time_state = TIME_IDLE;
+    portEXIT_CRITICAL(&time_lock);
+    esp_timer_stop(time_timer);
+}
+
+bool announce_handset_code(const char *digits)
+{
+    if (strcmp(digits, ANNOUNCE_TIME_CODE) != 0) {
+        return false;
+    }
+
+    if (!mounted) {
+        ESP_LOGW(TAG, "Time code ignored, no announcements");
+        return true;
+    }
+
+    portENTER_CRITICAL(&time_lock);
+    bool idle = (time_state == TIME_IDLE);
+    if (idle) {
+        time_state = TIME_PENDING;
+    }
+    portEXIT_CRITICAL(&time_lock);
+
+    if (idle) {
+        esp_timer_start_once(time_timer, (uint64_t)ANNOUNCE_LEAD_MS * 1000);
+    }
+    return true;
+}
+
+static void mount_image(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           ESP_PARTITION_SUBTYPE_ANY,
+                                                           ANNOUNCE_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, tones only", ANNOUNCE_PARTITION_LABEL);
+        return;
+    }
+
+    // Map only as much as the image needs; the MMU pages are shared with the app
+    announce_image_header_t hdr;
+    if (esp_partition_read(part, 0, &hdr, sizeof(hdr)) != ESP_OK ||
+        hdr.magic != ANNOUNCE_IMAGE_MAGIC || hdr.size > part->size) {
+        ESP_LOGW(TAG, "No announcement image in \"%s\", tones only", ANNOUNCE_PARTITION_LABEL);
+        return;
+    }
+
+    const void *base = NULL;
+    esp_err_t ret = esp_partition_mmap(part, 0, hdr.size, ESP_PARTITION_MMAP_DATA, &base, &map_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map announcements: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    bool valid = (announce_image_open(&image, base, hdr.size) == 0);
+    for (uint16_t i = 0; valid && i < image.count; i++) {
+        valid = announce_image_check_clip(&image, &image.entries[i]);
+    }
+    if (!valid) {
+        ESP_LOGE(TAG, "Announcement image is corrupt, tones only");
+        esp_partition_munmap(map_handle);
+        return;
+    }
+    mounted = true;
+
+    ESP_LOGI(TAG, "Announcements: %u clips, %" PRIu32 " KB, checked in %lld ms",
+             image.count, image.size / 1024,
+             (long long)((esp_timer_get_time() - start) / 1000));
+    if (announce_image_find(&image, ANNOUNCE_INTERCEPT) == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" clip, failed calls get reorder only", ANNOUNCE_INTERCEPT);
+    }
+}
+
+esp_err_t announce_init(void)
+{
+    ESP_LOGI(TAG, "Initializing announcements");
+
+    mount_image();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = time_timer_cb,
+        .name = "announce",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &time_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = event_subscribe(PHONE_EVENT_ON_HOOK, announce_event_handler, NULL);
+    if (ret != ESP_OK) {
+        esp_timer_delete(time_timer);
+        time_timer = NULL;
+        return ret;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,60 @@
+#ifndef __ANNOUNCE_H__
+#define __ANNOUNCE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @file announce.h
+ * @brief Recorded announcements
+ *
+ * The "announce" partition holds an image of IMA ADPCM clips built by
+ * tools/pack_announcements.py. It is memory-mapped once at boot and never
+ * copied: audio_output decodes each clip from the mapping straight into the
+ * output frame.
+ *
+ * Call progress plays ANNOUNCE_INTERCEPT ahead of reorder after a failed
+ * call and ANNOUNCE_PERMANENT ahead of it after an off-hook timeout. Dialing
+ * ANNOUNCE_TIME_CODE reads out the time of day from the "time", "n_<n>",
+ * "oh", "oclock", "am" and "pm" clips.
+ */
+
+/**
+ * @brief Map the announcement partition, check the image and subscribe to
+ *        hook events
+ *
+ * Must be called after event_system_init() and audio_output_init(). A
+ * missing partition or image is logged and leaves the plain tones; it is
+ * not an error.
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t announce_init(void);
+
+/**
+ * @brief Play a clip ANNOUNCE_REPEATS times, ANNOUNCE_GAP_MS apart
+ *
+ * Replaces any announcement in progress; a tone already started waits
+ * until the clips have played.
+ *
+ * @param name Clip name in the image
+ * @return Milliseconds the announcement lasts, 0 if the clip is missing
+ */
+uint32_t announce_play(const char *name);
+
+/**
+ * @brief Stop any announcement
+ */
+void announce_stop(void);
+
+/**
+ * @brief Start the time of day if the digits are its code
+ *
+ * Called by call control with the number about to be dialed.
+ *
+ * @return True if the digits were an announcement code and must not be dialed
+ */
+bool announce_handset_code(const char *digits);
+
+#endif /* __ANNOUNCE_H__ */
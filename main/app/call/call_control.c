@@ -0,0 +1,632 @@
+#include "call_control.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "audio/audio_bridge.h"
+#include "bluetooth/bt_app_hf.h"
+#include "dialer.h"
+#include "phonebook.h"
+#include "voicemail.h"
+#include "announce.h"
+#include "config/call_config.h"
+#include "config/audio_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_hf_client_api.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "call_control";
+
+// Actions run on a transition. Each returns the event to publish once the
+// state machine lock has been released, or 0 for none.
+typedef enum {
+    A_NONE,
+    A_RING_START,
+    A_RING_STOP,
+    A_ANSWER,
+    A_HANGUP,
+    A_CALL_UP,
+    A_CALL_DOWN,
+    A_PICKUP,
+    A_DIALING,
+    A_ALERTING,
+    A_SETUP_FAILED,
+    A_BUSY,
+    A_WAITING_START,
+    A_WAITING_STOP,
+    A_LINK_LOST,
+    A_DIGIT,
+    A_RELEASE,
+    A_HOLD,
+    A_RECALL,
+    A_FLASH_CODE,
+    A_SWAP,
+    A_RECALL_CANCEL,
+    A_DIAL,
+    A_HANGUP_ALL,
+    A_MACHINE_ANSWER,
+    A_CALL_CLEAR,
+    A_COUNT
+} cc_action_t;
+
+typedef struct {
+    uint8_t valid;   // 0 = event ignored in this state
+    uint8_t next;    // cc_state_t
+    uint8_t action;  // cc_action_t
+} cc_transition_t;
+
+#define T(next_state, act) { 1, (next_state), (act) }
+
+// The whole call lifecycle. Cells left empty are ignored.
+static const cc_transition_t cc_table[CC_STATE_COUNT][CC_EVENT_COUNT] = {
+    [CC_STATE_IDLE] = {
+        [CC_EVENT_OFF_HOOK]       = T(CC_STATE_OFF_HOOK,  A_NONE),
+        [CC_EVENT_RING]           = T(CC_STATE_RINGING,   A_RING_START),
+        [CC_EVENT_SETUP_INCOMING] = T(CC_STATE_RINGING,   A_RING_START),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_ELSEWHERE, A_CALL_UP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_IDLE,      A_CALL_CLEAR),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_IDLE,      A_LINK_LOST),
+    },
+    [CC_STATE_RINGING] = {
+        [CC_EVENT_OFF_HOOK]       = T(CC_STATE_ANSWERING, A_ANSWER),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_IDLE,      A_RING_STOP),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_ELSEWHERE, A_CALL_UP),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_IDLE,      A_LINK_LOST),
+        [CC_EVENT_MACHINE_ANSWER] = T(CC_STATE_MACHINE,   A_MACHINE_ANSWER),
+    },
+    [CC_STATE_OFF_HOOK] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_RELEASE),
+        [CC_EVENT_DIGIT]          = T(CC_STATE_OFF_HOOK,  A_DIGIT),
+        [CC_EVENT_SETUP_DIALING]  = T(CC_STATE_OUTGOING,  A_DIALING),
+        [CC_EVENT_SETUP_ALERTING] = T(CC_STATE_OUTGOING,  A_ALERTING),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_ACTIVE,    A_CALL_UP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_OFF_HOOK,  A_CALL_DOWN),
+        [CC_EVENT_AT_BUSY]        = T(CC_STATE_OFF_HOOK,  A_BUSY),
+        [CC_EVENT_AT_ERROR]       = T(CC_STATE_OFF_HOOK,  A_SETUP_FAILED),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+        [CC_EVENT_NUMBER_COMPLETE] = T(CC_STATE_OFF_HOOK, A_DIAL),
+    },
+    [CC_STATE_ANSWERING] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_RINGING,   A_NONE),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_OFF_HOOK,  A_RING_STOP),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_ACTIVE,    A_CALL_UP),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+    },
+    [CC_STATE_OUTGOING] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_HANGUP),
+        [CC_EVENT_SETUP_DIALING]  = T(CC_STATE_OUTGOING,  A_DIALING),
+        [CC_EVENT_SETUP_ALERTING] = T(CC_STATE_OUTGOING,  A_ALERTING),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_OFF_HOOK,  A_SETUP_FAILED),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_ACTIVE,    A_CALL_UP),
+        [CC_EVENT_AT_BUSY]        = T(CC_STATE_OFF_HOOK,  A_BUSY),
+        [CC_EVENT_AT_ERROR]       = T(CC_STATE_OFF_HOOK,  A_SETUP_FAILED),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+    },
+    [CC_STATE_ACTIVE] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_HANGUP),
+        [CC_EVENT_SETUP_INCOMING] = T(CC_STATE_ACTIVE,    A_WAITING_START),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_ACTIVE,    A_WAITING_STOP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_OFF_HOOK,  A_CALL_DOWN),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+        [CC_EVENT_HOOK_FLASH]     = T(CC_STATE_HELD,      A_HOLD),
+        [CC_EVENT_FLASH_SECOND]   = T(CC_STATE_RECALL,    A_RECALL),
+    },
+    [CC_STATE_ELSEWHERE] = {
+        [CC_EVENT_OFF_HOOK]       = T(CC_STATE_ACTIVE,    A_PICKUP),
+        [CC_EVENT_SETUP_INCOMING] = T(CC_STATE_ELSEWHERE, A_WAITING_START),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_ELSEWHERE, A_WAITING_STOP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_IDLE,      A_CALL_DOWN),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_IDLE,      A_LINK_LOST),
+    },
+    [CC_STATE_RECALL] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_HANGUP_ALL),
+        [CC_EVENT_DIGIT]          = T(CC_STATE_ACTIVE,    A_FLASH_CODE),
+        [CC_EVENT_HOOK_FLASH]     = T(CC_STATE_ACTIVE,    A_SWAP),
+        [CC_EVENT_FLASH_SECOND]   = T(CC_STATE_ACTIVE,    A_SWAP),
+        [CC_EVENT_RECALL_TIMEOUT] = T(CC_STATE_ACTIVE,    A_RECALL_CANCEL),
+        [CC_EVENT_SETUP_INCOMING] = T(CC_STATE_RECALL,    A_WAITING_START),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_RECALL,    A_WAITING_STOP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_OFF_HOOK,  A_CALL_DOWN),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+    },
+    [CC_STATE_HELD] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_HANGUP_ALL),
+        [CC_EVENT_NUMBER_COMPLETE] = T(CC_STATE_HELD,     A_DIAL),
+        [CC_EVENT_SETUP_DIALING]  = T(CC_STATE_ADDING,    A_DIALING),
+        [CC_EVENT_SETUP_ALERTING] = T(CC_STATE_ADDING,    A_ALERTING),
+        [CC_EVENT_HELD_ACTIVE]    = T(CC_STATE_ACTIVE,    A_CALL_UP),
+        [CC_EVENT_HOOK_FLASH]     = T(CC_STATE_ACTIVE,    A_SWAP),
+        [CC_EVENT_FLASH_SECOND]   = T(CC_STATE_ACTIVE,    A_SWAP),
+        [CC_EVENT_SETUP_INCOMING] = T(CC_STATE_HELD,      A_WAITING_START),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_HELD,      A_WAITING_STOP),
+        [CC_EVENT_AT_BUSY]        = T(CC_STATE_HELD,      A_BUSY),
+        [CC_EVENT_AT_ERROR]       = T(CC_STATE_HELD,      A_SETUP_FAILED),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_OFF_HOOK,  A_CALL_DOWN),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+    },
+    [CC_STATE_ADDING] = {
+        [CC_EVENT_ON_HOOK]        = T(CC_STATE_IDLE,      A_HANGUP_ALL),
+        [CC_EVENT_SETUP_DIALING]  = T(CC_STATE_ADDING,    A_DIALING),
+        [CC_EVENT_SETUP_ALERTING] = T(CC_STATE_ADDING,    A_ALERTING),
+        [CC_EVENT_SETUP_IDLE]     = T(CC_STATE_HELD,      A_SETUP_FAILED),
+        [CC_EVENT_HELD_ACTIVE]    = T(CC_STATE_ACTIVE,    A_CALL_UP),
+        [CC_EVENT_AT_BUSY]        = T(CC_STATE_HELD,      A_BUSY),
+        [CC_EVENT_AT_ERROR]       = T(CC_STATE_HELD,      A_SETUP_FAILED),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_OUTGOING,  A_NONE),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_OFF_HOOK,  A_LINK_LOST),
+    },
+    [CC_STATE_MACHINE] = {
+        [CC_EVENT_OFF_HOOK]       = T(CC_STATE_ACTIVE,    A_PICKUP),
+        [CC_EVENT_CALL_ACTIVE]    = T(CC_STATE_MACHINE,   A_CALL_UP),
+        [CC_EVENT_CALL_NONE]      = T(CC_STATE_IDLE,      A_CALL_DOWN),
+        [CC_EVENT_MACHINE_DONE]   = T(CC_STATE_IDLE,      A_HANGUP),
+        [CC_EVENT_SLC_DOWN]       = T(CC_STATE_IDLE,      A_LINK_LOST),
+    },
+};
+
+static const char *state_names[CC_STATE_COUNT] = {
+    "idle", "ringing", "off_hook", "answering", "outgoing", "active", "elsewhere",
+    "recall", "held", "adding", "machine"
+};
+
+static const char *event_names[CC_EVENT_COUNT] = {
+    "off_hook", "on_hook", "digit", "ring", "setup_incoming", "setup_dialing",
+    "setup_alerting", "setup_idle", "call_active", "call_none", "at_busy",
+    "at_error", "slc_down", "hook_flash", "flash_second", "number_complete",
+    "held_active", "recall_timeout", "machine_answer", "machine_done"
+};
+
+static SemaphoreHandle_t cc_mutex = NULL;
+static cc_state_t cc_state = CC_STATE_IDLE;
+static esp_timer_handle_t cc_recall_timer = NULL;
+
+// Latency per table cell: lookup and action only, not the publish that follows
+static portMUX_TYPE cc_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static cc_transition_stats_t cc_stats[CC_STATE_COUNT][CC_EVENT_COUNT];
+
+// Ask for the SCO link now so it is up by the time the call needs it
+static void preopen_audio(void)
+{
+#if AUDIO_SCO_PREOPEN
+    bt_app_hf_open_audio();
+#endif
+}
+
+// The call needs its voice path from here on: start the cut-through clock
+static void mark_cut_through(void)
+{
+    bool warm = ma_bell_state_bluetooth_bits_set(BT_STATE_AUDIO_CONNECTED) ||
+                bt_app_hf_audio_preopened();
+    audio_bridge_mark_cut_through(warm ? AUDIO_CUT_THROUGH_WARM : AUDIO_CUT_THROUGH_COLD);
+}
+
+static event_type_t act_none(ma_bell_state_cause_t cause)
+{
+    return 0;
+}
+
+static event_type_t act_ring_start(ma_bell_state_cause_t cause)
+{
+    ma_bell_state_update_phone_bits(PHONE_STATE_RINGING, 0, cause);
+    return PHONE_EVENT_RINGING_START;
+}
+
+static event_type_t act_ring_stop(ma_bell_state_cause_t cause)
+{
+    ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING, cause);
+    return PHONE_EVENT_RINGING_STOP;
+}
+
+static event_type_t act_answer(ma_bell_state_cause_t cause)
+{
+    // RINGING stays set until the AG reports the call active, so other
+    // subscribers to this off-hook still see an incoming call
+    esp_err_t ret = esp_hf_client_answer_call();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Answer failed: %s", esp_err_to_name(ret));
+    }
+    preopen_audio();
+    mark_cut_through();
+    return 0;
+}
+
+static event_type_t act_machine_answer(ma_bell_state_cause_t cause)
+{
+    // Ringing stops when the AG reports the call active; the voice path is
+    // needed at once for the greeting, pre-open or not
+    esp_err_t ret = esp_hf_client_answer_call();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Answer failed: %s", esp_err_to_name(ret));
+    }
+    bt_app_hf_open_audio();
+    return 0;
+}
+
+static event_type_t act_hangup(ma_bell_state_cause_t cause)
+{
+    // BT_STATE_IN_CALL is cleared when the AG reports call=0
+    esp_err_t ret = esp_hf_client_reject_call();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Hang up failed: %s", esp_err_to_name(ret));
+    }
+    bt_app_hf_release_audio();
+    return 0;
+}
+
+static event_type_t act_call_up(ma_bell_state_cause_t cause)
+{
+    // Answered calls are already being timed; a call up on the cell phone is not ours
+    if (ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK)) {
+        mark_cut_through();
+    }
+    ma_bell_state_update_call_bits(0, PHONE_STATE_RINGING, BT_STATE_IN_CALL, 0, cause);
+    return BT_EVENT_CALL_STARTED;
+}
+
+static event_type_t act_call_down(ma_bell_state_cause_t cause)
+{
+    // Hook state belongs to the SLIC; only the call bits are cleared here
+    ma_bell_state_update_call_bits(0, PHONE_STATE_RINGING | PHONE_STATE_CALL_WAITING,
+                                   0, BT_STATE_IN_CALL, cause);
+    return BT_EVENT_CALL_ENDED;
+}
+
+static event_type_t act_call_clear(ma_bell_state_cause_t cause)
+{
+    // The AG confirming a call the handset hung up. A call=0 with no call up
+    // (a repeated indicator, or the first report after the SLC comes up) is
+    // not a call ending and changes nothing.
+    if (!ma_bell_state_bluetooth_bits_set(BT_STATE_IN_CALL)) {
+        return 0;
+    }
+    return act_call_down(cause);
+}
+
+static event_type_t act_pickup(ma_bell_state_cause_t cause)
+{
+    preopen_audio();
+    mark_cut_through();
+    return BT_EVENT_CALL_STARTED;
+}
+
+static event_type_t act_dialing(ma_bell_state_cause_t cause)
+{
+    preopen_audio();
+    return BT_EVENT_CALL_DIALING;
+}
+
+static event_type_t act_alerting(ma_bell_state_cause_t cause)
+{
+    return BT_EVENT_CALL_ALERTING;
+}
+
+static event_type_t act_setup_failed(ma_bell_state_cause_t cause)
+{
+    return BT_EVENT_CALL_FAILED;
+}
+
+static event_type_t act_busy(ma_bell_state_cause_t cause)
+{
+    return BT_EVENT_CALL_BUSY;
+}
+
+static event_type_t act_waiting_start(ma_bell_state_cause_t cause)
+{
+    ma_bell_state_update_phone_bits(PHONE_STATE_CALL_WAITING, 0, cause);
+    return PHONE_EVENT_CALL_WAITING_START;
+}
+
+static event_type_t act_waiting_stop(ma_bell_state_cause_t cause)
+{
+    ma_bell_state_update_phone_bits(0, PHONE_STATE_CALL_WAITING, cause);
+    return PHONE_EVENT_CALL_WAITING_STOP;
+}
+
+static event_type_t act_link_lost(ma_bell_state_cause_t cause)
+{
+    ma_bell_state_update_call_bits(0, PHONE_STATE_RINGING | PHONE_STATE_CALL_WAITING,
+                                   0, BT_STATE_IN_CALL, cause);
+    return 0;
+}
+
+static event_type_t act_digit(ma_bell_state_cause_t cause)
+{
+    // Dialing has begun, a call is likely to follow
+    preopen_audio();
+    return 0;
+}
+
+static event_type_t act_release(ma_bell_state_cause_t cause)
+{
+    bt_app_hf_release_audio();
+    return 0;
+}
+
+static void send_chld(esp_hf_chld_type_t chld)
+{
+    esp_err_t ret = esp_hf_client_send_chld_cmd(chld, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "CHLD %d failed: %s", chld, esp_err_to_name(ret));
+    }
+}
+
+static event_type_t act_hold(ma_bell_state_cause_t cause)
+{
+    // With no other call, CHLD=2 just holds the active one; digits dialed
+    // next place the second call
+    send_chld(ESP_HF_CHLD_TYPE_HOLD_ACC);
+    dialer_reset();
+    return PHONE_EVENT_RECALL_START;
+}
+
+static event_type_t act_recall(ma_bell_state_cause_t cause)
+{
+    // The next digit picks the operation; see act_flash_code()
+    dialer_reset();
+    esp_timer_stop(cc_recall_timer);
+    esp_timer_start_once(cc_recall_timer, (uint64_t)CALL_RECALL_TIMEOUT_MS * 1000);
+    return PHONE_EVENT_RECALL_START;
+}
+
+static event_type_t act_flash_code(ma_bell_state_cause_t cause)
+{
+    char code = dialer_last_digit();
+    dialer_reset();
+    esp_timer_stop(cc_recall_timer);
+
+    switch (code) {
+        case '1':   // Release the active call, take the other
+            send_chld(ESP_HF_CHLD_TYPE_REL_ACC);
+            break;
+        case '2':   // Hold the active call, take the other
+            send_chld(ESP_HF_CHLD_TYPE_HOLD_ACC);
+            break;
+        case '3':   // Conference the held call in
+            send_chld(ESP_HF_CHLD_TYPE_MERGE);
+            break;
+        default:
+            ESP_LOGI(TAG, "Recall code %c not assigned", code);
+            break;
+    }
+    return PHONE_EVENT_RECALL_END;
+}
+
+static event_type_t act_swap(ma_bell_state_cause_t cause)
+{
+    // A second flash: hold the active call (if any) and take the other
+    dialer_reset();
+    esp_timer_stop(cc_recall_timer);
+    send_chld(ESP_HF_CHLD_TYPE_HOLD_ACC);
+    return PHONE_EVENT_RECALL_END;
+}
+
+static event_type_t act_recall_cancel(ma_bell_state_cause_t cause)
+{
+    dialer_reset();
+    return PHONE_EVENT_RECALL_END;
+}
+
+static event_type_t act_dial(ma_bell_state_cause_t cause)
+{
+    char digits[DIALER_MAX_DIGITS + 1];
+    char number[PHONEBOOK_NUMBER_LEN + 1];
+    dialer_get_number(digits, sizeof(digits));
+    dialer_reset();
+
+    // Voicemail and time codes only stand in for a first call; the handset's own
+    // audio is used, so a pre-opened SCO link is let go
+    if (cc_state == CC_STATE_OFF_HOOK &&
+        (voicemail_handset_code(digits) || announce_handset_code(digits))) {
+        bt_app_hf_release_audio();
+        return 0;
+    }
+
+    if (phonebook_speed_dial(digits, number, sizeof(number))) {
+        ESP_LOGI(TAG, "Speed dial %s: %s", digits, number);
+    } else {
+        strncpy(number, digits, sizeof(number) - 1);
+        number[sizeof(number) - 1] = '\0';
+        ESP_LOGI(TAG, "Dialing %s", number);
+    }
+    esp_err_t ret = esp_hf_client_dial(number);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Dial failed: %s", esp_err_to_name(ret));
+        return BT_EVENT_CALL_FAILED;
+    }
+    return 0;
+}
+
+static event_type_t act_hangup_all(ma_bell_state_cause_t cause)
+{
+    // Ends the active or outgoing call, then anything held or waiting
+    act_hangup(cause);
+    send_chld(ESP_HF_CHLD_TYPE_REL);
+    esp_timer_stop(cc_recall_timer);
+    return 0;
+}
+
+static event_type_t (*const cc_actions[A_COUNT])(ma_bell_state_cause_t) = {
+    [A_NONE]          = act_none,
+    [A_RING_START]    = act_ring_start,
+    [A_RING_STOP]     = act_ring_stop,
+    [A_ANSWER]        = act_answer,
+    [A_HANGUP]        = act_hangup,
+    [A_CALL_UP]       = act_call_up,
+    [A_CALL_DOWN]     = act_call_down,
+    [A_PICKUP]        = act_pickup,
+    [A_DIALING]       = act_dialing,
+    [A_ALERTING]      = act_alerting,
+    [A_SETUP_FAILED]  = act_setup_failed,
+    [A_BUSY]          = act_busy,
+    [A_WAITING_START] = act_waiting_start,
+    [A_WAITING_STOP]  = act_waiting_stop,
+    [A_LINK_LOST]     = act_link_lost,
+    [A_DIGIT]         = act_digit,
+    [A_RELEASE]       = act_release,
+    [A_HOLD]          = act_hold,
+    [A_RECALL]        = act_recall,
+    [A_FLASH_CODE]    = act_flash_code,
+    [A_SWAP]          = act_swap,
+    [A_RECALL_CANCEL] = act_recall_cancel,
+    [A_DIAL]          = act_dial,
+    [A_HANGUP_ALL]    = act_hangup_all,
+    [A_MACHINE_ANSWER] = act_machine_answer,
+    [A_CALL_CLEAR]    = act_call_clear,
+};
+
+static ma_bell_state_cause_t event_cause(cc_event_t event)
+{
+    switch (event) {
+        case CC_EVENT_OFF_HOOK:
+        case CC_EVENT_ON_HOOK:
+        case CC_EVENT_HOOK_FLASH:
+        case CC_EVENT_FLASH_SECOND:
+            return STATE_CAUSE_HOOK;
+        case CC_EVENT_NUMBER_COMPLETE:
+        case CC_EVENT_DIGIT:
+            return STATE_CAUSE_DIAL;
+        case CC_EVENT_MACHINE_ANSWER:
+            return STATE_CAUSE_TIMEOUT;
+        default:
+            return STATE_CAUSE_HFP;
+    }
+}
+
+void call_control_dispatch(cc_event_t event)
+{
+    if (event >= CC_EVENT_COUNT || cc_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(cc_mutex, portMAX_DELAY);
+    int64_t start = esp_timer_get_time();
+    cc_state_t from = cc_state;
+    cc_transition_t t = cc_table[from][event];
+    event_type_t publish = 0;
+    if (t.valid) {
+        publish = cc_actions[t.action](event_cause(event));
+        cc_state = (cc_state_t)t.next;
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    xSemaphoreGive(cc_mutex);
+
+    if (!t.valid) {
+        ESP_LOGD(TAG, "Ignored %s in %s", event_names[event], state_names[from]);
+        return;
+    }
+
+    portENTER_CRITICAL(&cc_stats_lock);
+    cc_transition_stats_t *stats = &cc_stats[from][event];
+    stats->count++;
+    stats->total_us += us;
+    if (us > stats->max_us) {
+        stats->max_us = us;
+    }
+    portEXIT_CRITICAL(&cc_stats_lock);
+
+    ESP_LOGD(TAG, "%s --%s--> %s (%" PRIu32 " us)", state_names[from],
+             event_names[event], state_names[t.next], us);
+
+    // Published outside the lock so subscribers may dispatch in turn
+    if (publish != 0) {
+        event_publish(publish, NULL);
+    }
+}
+
+static void call_control_event_handler(event_type_t event, void *user_data)
+{
+    switch (event) {
+        case PHONE_EVENT_OFF_HOOK:
+            call_control_dispatch(CC_EVENT_OFF_HOOK);
+            break;
+        case PHONE_EVENT_ON_HOOK:
+            call_control_dispatch(CC_EVENT_ON_HOOK);
+            break;
+        case PHONE_EVENT_DIGIT_DIALED:
+            call_control_dispatch(CC_EVENT_DIGIT);
+            break;
+        case PHONE_EVENT_HOOK_FLASH:
+            // Split here so the table can tell a 3-way hold from a recall
+            if (ma_bell_state_phone_bits_set(PHONE_STATE_CALL_WAITING) || ma_bell_state_has_held_call()) {
+                call_control_dispatch(CC_EVENT_FLASH_SECOND);
+            } else {
+                call_control_dispatch(CC_EVENT_HOOK_FLASH);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void call_control_recall_timeout(void *arg)
+{
+    call_control_dispatch(CC_EVENT_RECALL_TIMEOUT);
+}
+
+esp_err_t call_control_init(void)
+{
+    ESP_LOGI(TAG, "Initializing call control");
+
+    cc_mutex = xSemaphoreCreateMutex();
+    if (cc_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = call_control_recall_timeout,
+        .name = "cc_recall",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &cc_recall_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(cc_mutex);
+        cc_mutex = NULL;
+        return ret;
+    }
+
+    memset(cc_stats, 0, sizeof(cc_stats));
+    cc_state = ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK) ? CC_STATE_OFF_HOOK : CC_STATE_IDLE;
+
+    ret = event_subscribe(PHONE_EVENT_OFF_HOOK | PHONE_EVENT_ON_HOOK |
+                          PHONE_EVENT_DIGIT_DIALED | PHONE_EVENT_HOOK_FLASH,
+                          call_control_event_handler, NULL);
+    if (ret != ESP_OK) {
+        esp_timer_delete(cc_recall_timer);
+        cc_recall_timer = NULL;
+        vSemaphoreDelete(cc_mutex);
+        cc_mutex = NULL;
+        return ret;
+    }
+
+    return ESP_OK;
+}
+
+cc_state_t call_control_get_state(void)
+{
+    return cc_state;
+}
+
+esp_err_t call_control_get_stats(cc_state_t state, cc_event_t event, cc_transition_stats_t *out)
+{
+    if (state >= CC_STATE_COUNT || event >= CC_EVENT_COUNT || out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&cc_stats_lock);
+    *out = cc_stats[state][event];
+    portEXIT_CRITICAL(&cc_stats_lock);
+    return ESP_OK;
+}
+
+const char *call_control_state_name(cc_state_t state)
+{
+    return (state < CC_STATE_COUNT) ? state_names[state] : "unknown";
+}
+
+const char *call_control_event_name(cc_event_t event)
+{
+    return (event < CC_EVENT_COUNT) ? event_names[event] : "unknown";
+}
@@ -0,0 +1,119 @@
+#ifndef __CALL_CONTROL_H__
+#define __CALL_CONTROL_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @file call_control.h
+ * @brief Call-control state machine
+ *
+ * Owns the gateway's call lifecycle. Hook, digit and HFP events are looked up
+ * in a single compiled transition table (state x event -> action, next state)
+ * and the action is the only code that touches the call-related bits in
+ * ma_bell_state or sends call commands to the audio gateway.
+ */
+
+/**
+ * @brief Call-control states
+ */
+typedef enum {
+    CC_STATE_IDLE,        // On-hook, no call
+    CC_STATE_RINGING,     // On-hook, incoming call alerting
+    CC_STATE_OFF_HOOK,    // Off-hook, no call (dial tone, dialing, reorder)
+    CC_STATE_ANSWERING,   // Off-hook during an incoming call, answer sent
+    CC_STATE_OUTGOING,    // Off-hook, audio gateway placing a call
+    CC_STATE_ACTIVE,      // Off-hook, call in progress
+    CC_STATE_ELSEWHERE,   // On-hook, call in progress on the cell phone itself
+    CC_STATE_RECALL,      // Off-hook after a flash, picking what to do with a second call
+    CC_STATE_HELD,        // Off-hook, only call on hold, dialing a second one
+    CC_STATE_ADDING,      // Off-hook, second call being placed while the first is held
+    CC_STATE_MACHINE,     // On-hook, call taken by the answering machine
+    CC_STATE_COUNT
+} cc_state_t;
+
+/**
+ * @brief Call-control events
+ */
+typedef enum {
+    CC_EVENT_OFF_HOOK,          // SLIC: handset lifted
+    CC_EVENT_ON_HOOK,           // SLIC: handset replaced
+    CC_EVENT_DIGIT,             // Dialer: digit collected
+    CC_EVENT_RING,              // HFP: RING indication
+    CC_EVENT_SETUP_INCOMING,    // HFP: callsetup=1
+    CC_EVENT_SETUP_DIALING,     // HFP: callsetup=2
+    CC_EVENT_SETUP_ALERTING,    // HFP: callsetup=3
+    CC_EVENT_SETUP_IDLE,        // HFP: callsetup=0
+    CC_EVENT_CALL_ACTIVE,       // HFP: call=1
+    CC_EVENT_CALL_NONE,         // HFP: call=0
+    CC_EVENT_AT_BUSY,           // HFP: AT command answered BUSY
+    CC_EVENT_AT_ERROR,          // HFP: AT command failed
+    CC_EVENT_SLC_DOWN,          // HFP: service level connection lost
+    CC_EVENT_HOOK_FLASH,        // SLIC: hook flash, no other call
+    CC_EVENT_FLASH_SECOND,      // SLIC: hook flash with a second call waiting or held
+    CC_EVENT_NUMBER_COMPLETE,   // Dialer: number ready to dial
+    CC_EVENT_HELD_ACTIVE,       // HFP: callheld=1 (one call held, one active)
+    CC_EVENT_RECALL_TIMEOUT,    // No choice made in recall
+    CC_EVENT_MACHINE_ANSWER,    // Voicemail: rang out, answering machine takes the call
+    CC_EVENT_MACHINE_DONE,      // Voicemail: message recorded, hang up
+    CC_EVENT_COUNT
+} cc_event_t;
+
+/**
+ * @brief Per-transition latency statistics
+ *
+ * Microseconds spent on the table lookup and the action, timed with
+ * esp_timer so the figures hold whichever core the caller runs on. The events
+ * the action publishes, and their subscribers, are not included.
+ */
+typedef struct {
+    uint32_t count;        // Times this transition was taken
+    uint32_t max_us;       // Slowest lookup and action
+    uint64_t total_us;     // Sum, for averaging
+} cc_transition_stats_t;
+
+/**
+ * @brief Initialize call control and subscribe to hook and digit events
+ *
+ * Must be called after event_system_init() and ma_bell_state_init().
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t call_control_init(void);
+
+/**
+ * @brief Feed an event into the state machine
+ *
+ * Thread-safe. Events with no entry in the transition table for the current
+ * state are ignored.
+ *
+ * @param event Event to dispatch
+ */
+void call_control_dispatch(cc_event_t event);
+
+/**
+ * @brief Get the current call-control state
+ */
+cc_state_t call_control_get_state(void);
+
+/**
+ * @brief Get latency statistics for one table cell
+ *
+ * @param state State the transition starts from
+ * @param event Triggering event
+ * @param out Destination for a copy of the statistics
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on bad state/event
+ */
+esp_err_t call_control_get_stats(cc_state_t state, cc_event_t event, cc_transition_stats_t *out);
+
+/**
+ * @brief Get a short name for a state
+ */
+const char *call_control_state_name(cc_state_t state);
+
+/**
+ * @brief Get a short name for an event
+ */
+const char *call_control_event_name(cc_event_t event);
+
+#endif /* __CALL_CONTROL_H__ */
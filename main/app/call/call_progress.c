@@ -0,0 +1,310 @@
+#include "call_progress.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "audio/audio_output.h"
+#include "config/call_config.h"
+#include "storage/settings.h"
+#include "voicemail.h"
+#include "announce.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "call_progress";
+
+// Where the handset is in the life of a call, as far as tones are concerned
+typedef enum {
+    CP_IDLE,          // On-hook
+    CP_DIAL_TONE,     // Off-hook, waiting for the first digit
+    CP_DIALING,       // Digits being collected
+    CP_SETUP,         // Call being placed or answered, silence
+    CP_RINGBACK,      // Far end alerting
+    CP_CONNECTED,     // Call active, voice path open
+    CP_DISCONNECTED,  // Far end hung up, handset still off-hook
+    CP_BUSY,          // Far end busy
+    CP_REORDER,       // Call failed or timed out
+    CP_NO_SERVICE,    // No cell phone connected
+    CP_HOWLER,        // Off-hook warning
+    CP_RECALL,        // Flash during a call, waiting for a digit
+    CP_VOICEMAIL,     // Messages playing or greeting recording, audio from voicemail
+    CP_ANNOUNCE,      // Time of day being read out, audio from the announcement
+    CP_STAGE_COUNT
+} cp_stage_t;
+
+// Tone, phone-state bits and timeout for each stage
+typedef struct {
+    const char *name;
+    tone_type_t tone;
+    uint8_t phone_bits;
+    bool times_out;         // Duration from stage_timeout_ms()
+    cp_stage_t on_timeout;
+} cp_stage_info_t;
+
+static const cp_stage_info_t stage_info[CP_STAGE_COUNT] = {
+    [CP_IDLE]         = {"idle",         TONE_NONE,        0,                        false, CP_IDLE},
+    [CP_DIAL_TONE]    = {"dial_tone",    DIAL_TONE,        PHONE_STATE_DIAL_TONE,    true,  CP_REORDER},
+    [CP_DIALING]      = {"dialing",      TONE_NONE,        PHONE_STATE_DIALING,      true,  CP_REORDER},
+    [CP_SETUP]        = {"setup",        TONE_NONE,        0,                        false, CP_SETUP},
+    [CP_RINGBACK]     = {"ringback",     RINGBACK_TONE,    PHONE_STATE_RINGBACK,     false, CP_RINGBACK},
+    [CP_CONNECTED]    = {"connected",    TONE_NONE,        0,                        false, CP_CONNECTED},
+    [CP_DISCONNECTED] = {"disconnected", TONE_NONE,        0,                        true,  CP_REORDER},
+    [CP_BUSY]         = {"busy",         BUSY_SIGNAL,      PHONE_STATE_BUSY_TONE,    true,  CP_HOWLER},
+    [CP_REORDER]      = {"reorder",      REORDER_TONE,     PHONE_STATE_REORDER_TONE, true,  CP_HOWLER},
+    [CP_NO_SERVICE]   = {"no_service",   CONGESTION_TONE,  PHONE_STATE_REORDER_TONE, true,  CP_HOWLER},
+    [CP_HOWLER]       = {"howler",       OFF_HOOK_WARNING, 0,                        false, CP_HOWLER},
+    [CP_RECALL]       = {"recall",       STUTTER_DIAL_TONE, PHONE_STATE_DIAL_TONE,   false, CP_RECALL},
+    [CP_VOICEMAIL]    = {"voicemail",    TONE_NONE,        0,                        false, CP_VOICEMAIL},
+    [CP_ANNOUNCE]     = {"announce",     TONE_NONE,        0,                        false, CP_ANNOUNCE},
+};
+
+// Phone bits owned by this module
+#define CP_MANAGED_BITS (PHONE_STATE_DIAL_TONE | PHONE_STATE_DIALING | PHONE_STATE_BUSY_TONE | \
+                         PHONE_STATE_REORDER_TONE | PHONE_STATE_RINGBACK)
+
+#define CP_EVENTS (PHONE_EVENT_OFF_HOOK | PHONE_EVENT_ON_HOOK | PHONE_EVENT_DIGIT_DIALED | \
+                   PHONE_EVENT_RINGING_STOP | BT_EVENT_CONNECTED | BT_EVENT_DISCONNECTED | \
+                   BT_EVENT_AUDIO_CONNECTED | BT_EVENT_CALL_STARTED | BT_EVENT_CALL_ENDED | \
+                   BT_EVENT_CALL_DIALING | BT_EVENT_CALL_ALERTING | BT_EVENT_CALL_BUSY | \
+                   BT_EVENT_CALL_FAILED | PHONE_EVENT_RECALL_START | PHONE_EVENT_RECALL_END | \
+                   PHONE_EVENT_VOICEMAIL_START | PHONE_EVENT_VOICEMAIL_END | \
+                   PHONE_EVENT_ANNOUNCE_START | PHONE_EVENT_ANNOUNCE_END)
+
+// Events arrive from the SLIC, Bluetooth and timer tasks
+static SemaphoreHandle_t cp_mutex = NULL;
+static esp_timer_handle_t cp_timer = NULL;
+static cp_stage_t cp_stage = CP_IDLE;
+static int64_t cp_stage_entered_us = 0;
+static uint32_t cp_stage_timeout_ms = 0;   // 0 for none
+
+// Timeouts are part of the dial and tone plans in the settings record
+static uint32_t stage_timeout_ms(cp_stage_t stage)
+{
+    if (!stage_info[stage].times_out) {
+        return 0;
+    }
+
+    settings_t cfg;
+    settings_get(&cfg);
+    switch (stage) {
+    case CP_DIAL_TONE:
+        return cfg.tones.dial_tone_timeout_ms;
+    case CP_DIALING:
+        return cfg.dial.interdigit_timeout_ms;
+    case CP_DISCONNECTED:
+        return cfg.tones.disconnect_timeout_ms;
+    default:
+        return cfg.tones.reorder_timeout_ms;
+    }
+}
+
+// Switch stage: start the tone first so latency is not spent on bookkeeping.
+// An announcement, if any, goes ahead of the tone and holds off its timeout.
+// Called with cp_mutex held.
+static void enter_stage(cp_stage_t stage, int64_t event_us, const char *announcement)
+{
+    const cp_stage_info_t *info = &stage_info[stage];
+    tone_type_t tone = info->tone;
+
+    // With the SCO link up the network supplies in-band ringback, let it through
+    if (stage == CP_RINGBACK && ma_bell_state_bluetooth_bits_set(BT_STATE_AUDIO_CONNECTED)) {
+        tone = TONE_NONE;
+    }
+    // Message waiting indicator
+    if (stage == CP_DIAL_TONE && voicemail_waiting()) {
+        tone = STUTTER_DIAL_TONE;
+    }
+
+    // An announcement belongs to the stage that started it
+    if (stage != cp_stage) {
+        announce_stop();
+    }
+    uint32_t announce_ms = (announcement != NULL) ? announce_play(announcement) : 0;
+
+    audio_output_play_tone_stamped(tone, event_us);
+
+    uint32_t timeout_ms = stage_timeout_ms(stage);
+    if (timeout_ms > 0) {
+        timeout_ms += announce_ms;
+    }
+    esp_timer_stop(cp_timer);
+    if (timeout_ms > 0) {
+        esp_timer_start_once(cp_timer, (uint64_t)timeout_ms * 1000);
+    }
+
+    if (stage != cp_stage) {
+        ESP_LOGI(TAG, "%s -> %s", stage_info[cp_stage].name, info->name);
+    }
+    cp_stage = stage;
+    cp_stage_entered_us = event_us;
+    cp_stage_timeout_ms = timeout_ms;
+
+    ma_bell_state_update_phone_bits(info->phone_bits, CP_MANAGED_BITS & ~info->phone_bits,
+                                    STATE_CAUSE_TONE);
+}
+
+// Pick the next stage for an event, or the current stage to ignore it
+static cp_stage_t next_stage(cp_stage_t stage, event_type_t event)
+{
+    switch (event) {
+        case PHONE_EVENT_OFF_HOOK:
+            if (stage != CP_IDLE) {
+                return stage;
+            }
+            if (ma_bell_state_bluetooth_bits_set(BT_STATE_IN_CALL) ||
+                ma_bell_state_phone_bits_set(PHONE_STATE_RINGING)) {
+                return CP_SETUP;  // Answering, the call's own audio follows
+            }
+            if (!ma_bell_state_bluetooth_bits_set(BT_STATE_CONNECTED)) {
+                return CP_NO_SERVICE;
+            }
+            return CP_DIAL_TONE;
+
+        case PHONE_EVENT_ON_HOOK:
+            return CP_IDLE;
+
+        case PHONE_EVENT_DIGIT_DIALED:
+            // Re-entering CP_DIALING restarts the interdigit timer
+            return (stage == CP_DIAL_TONE || stage == CP_DIALING || stage == CP_RECALL)
+                   ? CP_DIALING : stage;
+
+        case PHONE_EVENT_RECALL_START:
+            return (stage == CP_IDLE) ? stage : CP_RECALL;
+
+        case PHONE_EVENT_RECALL_END:
+            // Back to a call, from recall, a digit or a failed second call
+            return (stage == CP_IDLE) ? stage : CP_CONNECTED;
+
+        case PHONE_EVENT_VOICEMAIL_START:
+            return (stage == CP_IDLE) ? stage : CP_VOICEMAIL;
+
+        case PHONE_EVENT_VOICEMAIL_END:
+            return (stage == CP_VOICEMAIL) ? CP_DIAL_TONE : stage;
+
+        case PHONE_EVENT_ANNOUNCE_START:
+            return (stage == CP_IDLE) ? stage : CP_ANNOUNCE;
+
+        case PHONE_EVENT_ANNOUNCE_END:
+            return (stage == CP_ANNOUNCE) ? CP_DIAL_TONE : stage;
+
+        case PHONE_EVENT_RINGING_STOP:
+            // Caller gave up while we were answering
+            return (stage == CP_SETUP) ? CP_DISCONNECTED : stage;
+
+        case BT_EVENT_CONNECTED:
+            return (stage == CP_NO_SERVICE) ? CP_DIAL_TONE : stage;
+
+        case BT_EVENT_DISCONNECTED:
+            return (stage == CP_IDLE || stage == CP_HOWLER) ? stage : CP_NO_SERVICE;
+
+        case BT_EVENT_AUDIO_CONNECTED:
+            // Re-evaluate local vs in-band ringback
+            return stage;
+
+        case BT_EVENT_CALL_DIALING:
+            return (stage == CP_IDLE) ? stage : CP_SETUP;
+
+        case BT_EVENT_CALL_ALERTING:
+            return (stage == CP_IDLE) ? stage : CP_RINGBACK;
+
+        case BT_EVENT_CALL_STARTED:
+            return (stage == CP_IDLE) ? stage : CP_CONNECTED;
+
+        case BT_EVENT_CALL_ENDED:
+            return (stage == CP_CONNECTED || stage == CP_SETUP || stage == CP_RINGBACK)
+                   ? CP_DISCONNECTED : stage;
+
+        case BT_EVENT_CALL_BUSY:
+            return (stage == CP_SETUP || stage == CP_RINGBACK || stage == CP_DIALING)
+                   ? CP_BUSY : stage;
+
+        case BT_EVENT_CALL_FAILED:
+            // AT errors are only a call failure while a call is being placed
+            return (stage == CP_SETUP || stage == CP_RINGBACK || stage == CP_DIALING)
+                   ? CP_REORDER : stage;
+
+        default:
+            return stage;
+    }
+}
+
+static void call_progress_event_handler(event_type_t event, void *user_data)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(cp_mutex, portMAX_DELAY);
+    cp_stage_t next = next_stage(cp_stage, event);
+    if (next != cp_stage || event == PHONE_EVENT_DIGIT_DIALED ||
+        (event == BT_EVENT_AUDIO_CONNECTED && cp_stage == CP_RINGBACK)) {
+        // Only a failed call reaches reorder on an event
+        enter_stage(next, now, (next == CP_REORDER && next != cp_stage) ? ANNOUNCE_INTERCEPT : NULL);
+    }
+    xSemaphoreGive(cp_mutex);
+}
+
+static void call_progress_timer_cb(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    // Never block the shared esp_timer task: if an event holds the lock, try
+    // again shortly. An event that changes stage re-arms the timer itself,
+    // and a stale retry is dropped by the check below.
+    if (xSemaphoreTake(cp_mutex, 0) != pdTRUE) {
+        esp_timer_start_once(cp_timer, (uint64_t)CALL_PROGRESS_TIMER_RETRY_MS * 1000);
+        return;
+    }
+    const cp_stage_info_t *info = &stage_info[cp_stage];
+    // Ignore a timeout that raced with an event which already changed stage
+    if (cp_stage_timeout_ms > 0 &&
+        now - cp_stage_entered_us >= (int64_t)cp_stage_timeout_ms * 1000) {
+        ESP_LOGI(TAG, "Timeout in %s", info->name);
+        // Left off-hook without a call: permanent signal
+        enter_stage(info->on_timeout, now,
+                    (info->on_timeout == CP_REORDER) ? ANNOUNCE_PERMANENT : NULL);
+    }
+    xSemaphoreGive(cp_mutex);
+}
+
+esp_err_t call_progress_init(void)
+{
+    ESP_LOGI(TAG, "Initializing call progress");
+
+    cp_mutex = xSemaphoreCreateMutex();
+    if (cp_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = call_progress_timer_cb,
+        .name = "call_progress",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &cp_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(cp_mutex);
+        cp_mutex = NULL;
+        return ret;
+    }
+
+    ret = event_subscribe(CP_EVENTS, call_progress_event_handler, NULL);
+    if (ret != ESP_OK) {
+        esp_timer_delete(cp_timer);
+        cp_timer = NULL;
+        vSemaphoreDelete(cp_mutex);
+        cp_mutex = NULL;
+        return ret;
+    }
+
+    // The handset may already be off-hook at boot
+    if (ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK)) {
+        call_progress_event_handler(PHONE_EVENT_OFF_HOOK, NULL);
+    }
+
+    return ESP_OK;
+}
+
+const char *call_progress_stage_name(void)
+{
+    return stage_info[cp_stage].name;
+}
@@ -0,0 +1,34 @@
+#ifndef __CALL_PROGRESS_H__
+#define __CALL_PROGRESS_H__
+
+#include "esp_err.h"
+
+/**
+ * @file call_progress.h
+ * @brief Call-progress tone manager
+ *
+ * Subscribes to hook and HFP events and selects the tone the handset should
+ * hear: dial tone on off-hook, ringback while the far end is alerting, busy
+ * or reorder when a call fails, and the off-hook warning ("howler") when the
+ * handset is left off-hook. Tones are started from the publishing task, so the
+ * tone generator picks them up at its next 20 ms frame. The matching
+ * PHONE_STATE_*_TONE bits are kept in step with the tone being played.
+ */
+
+/**
+ * @brief Initialize the call-progress tone manager
+ *
+ * Must be called after event_system_init() and audio_output_init().
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t call_progress_init(void);
+
+/**
+ * @brief Get the name of the current call-progress stage
+ *
+ * @return Stage name, e.g. "dial_tone" or "ringback"
+ */
+const char *call_progress_stage_name(void);
+
+#endif /* __CALL_PROGRESS_H__ */
@@ -0,0 +1,165 @@
+#include "call_waiting.h"
+#include "app/events/event_system.h"
+#include "app/state/ma_bell_state.h"
+#include "audio/audio_output.h"
+#include "audio/caller_id_fsk.h"
+#include "phonebook.h"
+#include "config/call_config.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "call_waiting";
+
+// Any of these ends the alert
+#define CW_STOP_EVENTS (PHONE_EVENT_CALL_WAITING_STOP | PHONE_EVENT_HOOK_FLASH | \
+                        PHONE_EVENT_ON_HOOK | BT_EVENT_CALL_ENDED | BT_EVENT_DISCONNECTED)
+
+static const audio_overlay_seg_t sas_only[] = {
+    { CALL_WAITING_SAS_FREQ, 0, CALL_WAITING_SAS_MS, CALL_WAITING_SAS_LEVEL, false },
+};
+
+#if CALL_WAITING_TYPE2_CID
+// SAS over the call, then CAS and a pause for the CPE with the far end muted.
+// There is no DTMF receiver for the CPE acknowledgement, so the burst follows
+// the pause unconditionally.
+static const audio_overlay_seg_t sas_cas[] = {
+    { CALL_WAITING_SAS_FREQ, 0, CALL_WAITING_SAS_MS, CALL_WAITING_SAS_LEVEL, false },
+    { CALL_WAITING_CAS_FREQ1, CALL_WAITING_CAS_FREQ2, CALL_WAITING_CAS_MS, CALL_WAITING_CAS_LEVEL, true },
+    { 0, 0, CALL_WAITING_ACK_WAIT_MS, 0, true },
+};
+#endif
+
+// CCWA arrives on the Bluetooth task, alert events on the publishing task
+// and repeats on the timer task
+static portMUX_TYPE cw_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t cw_timer = NULL;
+static bool cw_waiting = false;
+static bool cw_have_number = false;
+static char cw_number[CID_FIELD_MAX_LEN + 1];
+
+// Queue the Type II burst behind the CAS of the first alert
+static void call_waiting_send_caller_id(void)
+{
+#if CALL_WAITING_TYPE2_CID
+    char number[sizeof(cw_number)];
+
+    portENTER_CRITICAL(&cw_lock);
+    bool ready = cw_waiting && cw_have_number;
+    memcpy(number, cw_number, sizeof(number));
+    portEXIT_CRITICAL(&cw_lock);
+
+    if (!ready) {
+        return;
+    }
+
+    char name[PHONEBOOK_NAME_LEN + 1];
+    cid_info_t info = {
+        .number = number,
+        .name = phonebook_lookup_name(number, name, sizeof(name)) ? name : NULL,
+    };
+    uint8_t msg[CID_MDMF_MAX_LEN];
+    size_t len = cid_mdmf_build(&info, msg, sizeof(msg));
+    if (len > 0 && audio_output_overlay_caller_id(msg, len) != ESP_OK) {
+        ESP_LOGD(TAG, "Caller ID slot passed or already filled");
+    }
+#endif
+}
+
+static void call_waiting_timer_cb(void *arg)
+{
+    portENTER_CRITICAL(&cw_lock);
+    bool waiting = cw_waiting;
+    portEXIT_CRITICAL(&cw_lock);
+
+    if (waiting) {
+        audio_output_overlay_start(sas_only, sizeof(sas_only) / sizeof(sas_only[0]));
+    }
+}
+
+static void call_waiting_start(void)
+{
+    // A call carried on the cell phone itself alerts there
+    if (!ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK)) {
+        return;
+    }
+
+    portENTER_CRITICAL(&cw_lock);
+    cw_waiting = true;
+    portEXIT_CRITICAL(&cw_lock);
+
+#if CALL_WAITING_TYPE2_CID
+    audio_output_overlay_start(sas_cas, sizeof(sas_cas) / sizeof(sas_cas[0]));
+    call_waiting_send_caller_id();
+#else
+    audio_output_overlay_start(sas_only, sizeof(sas_only) / sizeof(sas_only[0]));
+#endif
+
+    esp_timer_stop(cw_timer);
+    esp_timer_start_periodic(cw_timer, (uint64_t)CALL_WAITING_REPEAT_MS * 1000);
+    ESP_LOGI(TAG, "Call waiting");
+}
+
+static void call_waiting_stop(void)
+{
+    portENTER_CRITICAL(&cw_lock);
+    bool was_waiting = cw_waiting;
+    cw_waiting = false;
+    cw_have_number = false;
+    portEXIT_CRITICAL(&cw_lock);
+
+    esp_timer_stop(cw_timer);
+    audio_output_overlay_stop();
+    if (was_waiting) {
+        ESP_LOGI(TAG, "Call waiting ended");
+    }
+}
+
+static void call_waiting_event_handler(event_type_t event, void *user_data)
+{
+    if (event == PHONE_EVENT_CALL_WAITING_START) {
+        call_waiting_start();
+    } else {
+        call_waiting_stop();
+    }
+}
+
+void call_waiting_on_ccwa(const char *number)
+{
+    portENTER_CRITICAL(&cw_lock);
+    memset(cw_number, 0, sizeof(cw_number));
+    if (number != NULL) {
+        strncpy(cw_number, number, sizeof(cw_number) - 1);
+    }
+    cw_have_number = true;
+    portEXIT_CRITICAL(&cw_lock);
+
+    ESP_LOGI(TAG, "Waiting caller: %s", (number && number[0]) ? number : "(withheld)");
+    call_waiting_send_caller_id();
+}
+
+esp_err_t call_waiting_init(void)
+{
+    ESP_LOGI(TAG, "Initializing call waiting");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = call_waiting_timer_cb,
+        .name = "call_waiting",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &cw_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = event_subscribe(PHONE_EVENT_CALL_WAITING_START | CW_STOP_EVENTS,
+                          call_waiting_event_handler, NULL);
+    if (ret != ESP_OK) {
+        esp_timer_delete(cw_timer);
+        cw_timer = NULL;
+        return ret;
+    }
+
+    return ESP_OK;
+}
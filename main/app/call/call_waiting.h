@@ -0,0 +1,36 @@
+#ifndef __CALL_WAITING_H__
+#define __CALL_WAITING_H__
+
+#include "esp_err.h"
+
+/**
+ * @file call_waiting.h
+ * @brief Call-waiting alerting
+ *
+ * While a second call waits behind the active one, plays the subscriber
+ * alerting signal (SAS) over the call's own audio every
+ * CALL_WAITING_REPEAT_MS. With CALL_WAITING_TYPE2_CID the first alert is
+ * followed by CAS and an off-hook Caller ID burst carrying the +CCWA number.
+ * Answering (hook flash) is handled by call control.
+ */
+
+/**
+ * @brief Initialize call waiting and subscribe to its events
+ *
+ * Must be called after event_system_init() and audio_output_init().
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t call_waiting_init(void);
+
+/**
+ * @brief Record the waiting caller's number
+ *
+ * Called from the HFP callback on +CCWA, which may arrive just before or
+ * just after the callsetup indicator that starts the alert.
+ *
+ * @param number Waiting number, NULL or "" if withheld
+ */
+void call_waiting_on_ccwa(const char *number);
+
+#endif /* __CALL_WAITING_H__ */
@@ -0,0 +1,114 @@
+#include "caller_id.h"
+#include "app/events/event_system.h"
+#include "audio/audio_output.h"
+#include "audio/caller_id_fsk.h"
+#include "phonebook.h"
+#include "network/clock/clock.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "caller_id";
+
+// Ringing ends on any of these; the pending number goes with it
+#define CID_STOP_EVENTS (PHONE_EVENT_RINGING_STOP | PHONE_EVENT_OFF_HOOK | \
+                         BT_EVENT_CALL_STARTED | BT_EVENT_DISCONNECTED)
+
+// Message for the current call. CLIP arrives on the Bluetooth task, ringing
+// events on whichever task publishes them.
+static portMUX_TYPE cid_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t cid_msg[CID_MDMF_MAX_LEN];
+static size_t cid_len = 0;
+static bool cid_queued = false;     // Handed to the ring generator this call
+
+// Hand the pending message to the ring generator once both are ready
+static void caller_id_try_queue(void)
+{
+    uint8_t msg[CID_MDMF_MAX_LEN];
+    size_t len;
+    bool ringing = audio_output_ringing();
+
+    portENTER_CRITICAL(&cid_lock);
+    len = (cid_queued || !ringing) ? 0 : cid_len;
+    if (len > 0) {
+        memcpy(msg, cid_msg, len);
+        cid_queued = true;
+    }
+    portEXIT_CRITICAL(&cid_lock);
+
+    if (len > 0 && audio_output_ring_caller_id(msg, len) != ESP_OK) {
+        ESP_LOGW(TAG, "Caller ID not sent, ring already past its slot");
+    }
+}
+
+static void caller_id_clear(void)
+{
+    portENTER_CRITICAL(&cid_lock);
+    cid_len = 0;
+    cid_queued = false;
+    portEXIT_CRITICAL(&cid_lock);
+}
+
+static void caller_id_event_handler(event_type_t event, void *user_data)
+{
+    if (event == PHONE_EVENT_RINGING_START) {
+        audio_output_ring_start();
+        caller_id_try_queue();
+    } else {
+        audio_output_ring_stop();
+        caller_id_clear();
+    }
+}
+
+void caller_id_on_clip(const char *number)
+{
+    // CLIP carries no name; the local phonebook may have one
+    char name[PHONEBOOK_NAME_LEN + 1];
+    bool named = number && phonebook_lookup_name(number, name, sizeof(name));
+    cid_info_t info = {
+        .number = number,
+        .name = named ? name : NULL,
+    };
+
+    // Date and time are left out until SNTP has set the clock
+    struct tm local;
+    if (clock_localtime(&local)) {
+        info.has_time = true;
+        info.month = local.tm_mon + 1;
+        info.day = local.tm_mday;
+        info.hour = local.tm_hour;
+        info.minute = local.tm_min;
+    }
+
+    uint8_t msg[CID_MDMF_MAX_LEN];
+    size_t len = cid_mdmf_build(&info, msg, sizeof(msg));
+    if (len == 0) {
+        return;
+    }
+
+    bool stored = false;
+    portENTER_CRITICAL(&cid_lock);
+    if (!cid_queued) {
+        memcpy(cid_msg, msg, len);
+        cid_len = len;
+        stored = true;
+    }
+    portEXIT_CRITICAL(&cid_lock);
+
+    if (stored) {
+        ESP_LOGI(TAG, "Caller ID: %s", (number && number[0]) ? number : "(withheld)");
+        caller_id_try_queue();
+    }
+}
+
+esp_err_t caller_id_init(void)
+{
+    ESP_LOGI(TAG, "Initializing Caller ID");
+
+    esp_err_t ret = event_subscribe(PHONE_EVENT_RINGING_START | CID_STOP_EVENTS,
+                                    caller_id_event_handler, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe to events: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
@@ -0,0 +1,35 @@
+#ifndef __CALLER_ID_H__
+#define __CALLER_ID_H__
+
+#include "esp_err.h"
+
+/**
+ * @file caller_id.h
+ * @brief On-hook Caller ID for incoming calls
+ *
+ * Drives the ring cadence from the phone ringing events and hands the CLIP
+ * number from the audio gateway to the FSK modulator, which sends it once in
+ * the silence after the first ring. CLIP may arrive before or after ringing
+ * starts; whichever comes second queues the burst.
+ */
+
+/**
+ * @brief Initialize Caller ID and subscribe to ringing events
+ *
+ * Must be called after event_system_init() and audio_output_init().
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t caller_id_init(void);
+
+/**
+ * @brief Record the calling number for the current incoming call
+ *
+ * Called from the HFP callback on +CLIP. Repeated CLIPs for the same call
+ * are ignored once a message has been queued.
+ *
+ * @param number Calling number, NULL or "" if withheld
+ */
+void caller_id_on_clip(const char *number);
+
+#endif /* __CALLER_ID_H__ */
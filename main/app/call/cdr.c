@@ -0,0 +1,411 @@
+#include "cdr.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "app/call/dialer.h"
+#include "audio/audio_bridge.h"
+#include "config/call_config.h"
+#include "network/clock/clock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "cdr";
+
+#define CDR_EVENTS (PHONE_EVENT_OFF_HOOK | PHONE_EVENT_DIGIT_DIALED | PHONE_EVENT_RINGING_START | \
+                    PHONE_EVENT_RINGING_STOP | BT_EVENT_CALL_DIALING | BT_EVENT_CALL_ALERTING | \
+                    BT_EVENT_CALL_STARTED | BT_EVENT_CALL_ENDED | BT_EVENT_CALL_BUSY | \
+                    BT_EVENT_CALL_FAILED | BT_EVENT_DISCONNECTED)
+
+static const char *outcome_names[CDR_OUTCOME_COUNT] = {
+    "answered", "missed", "abandoned", "busy", "failed", "link_lost",
+};
+
+// The call being followed. Events arrive from the SLIC and Bluetooth tasks.
+static SemaphoreHandle_t cdr_mutex = NULL;
+static bool call_open = false;
+static bool call_answered = false;
+static int64_t call_start_us;
+static int64_t last_digit_us;
+static uint32_t call_underruns_at_start;
+static cdr_record_t call_rec;
+
+// Finished records waiting for the writer task, under cdr_mutex
+static cdr_record_t queue[CDR_BATCH_RECORDS];
+static size_t queue_count = 0;
+
+// The log itself; only touched with log_mutex held
+static SemaphoreHandle_t log_mutex = NULL;
+static const esp_partition_t *log_part = NULL;
+static cdr_log_t cdr_log;
+static bool log_mounted = false;
+
+static TaskHandle_t cdr_task_handle = NULL;
+static esp_timer_handle_t flush_timer = NULL;
+
+static cdr_stats_t cdr_stats;
+static portMUX_TYPE cdr_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int part_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    return esp_partition_read(ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    return esp_partition_write(ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+static uint32_t underruns_now(void)
+{
+    uint32_t xruns[AUDIO_XRUN_KINDS];
+    audio_bridge_get_xruns(xruns);
+    return xruns[AUDIO_XRUN_DOWNLINK_UNDERRUN] + xruns[AUDIO_XRUN_UPLINK_UNDERRUN];
+}
+
+static void set_number(const char *number)
+{
+    memset(call_rec.number, 0, sizeof(call_rec.number));
+#if CDR_HASH_NUMBERS
+    // FNV-1a, enough to match repeat callers without keeping the number
+    uint32_t hash = 2166136261u;
+    for (const char *p = number; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    snprintf(call_rec.number, sizeof(call_rec.number), "#%08lx", (unsigned long)hash);
+#else
+    strncpy(call_rec.number, number, sizeof(call_rec.number) - 1);
+#endif
+}
+
+// The phone's own view of the number beats the digits dialed here
+static void take_number(void)
+{
+    ma_bell_state_t state;
+    ma_bell_state_snapshot(&state);
+
+    for (int i = 0; i < state.calls.count; i++) {
+        const ma_bell_call_t *call = &state.calls.list[i];
+        if (call->number[0] && call->incoming == (call_rec.direction == CDR_DIR_INCOMING)) {
+            set_number(call->number);
+            return;
+        }
+    }
+}
+
+// Called with cdr_mutex held
+static void call_begin(cdr_direction_t direction, int64_t now)
+{
+    memset(&call_rec, 0, sizeof(call_rec));
+    call_rec.direction = direction;
+    call_open = true;
+    call_answered = false;
+    call_start_us = now;
+    call_underruns_at_start = underruns_now();
+
+    // Left 0 until SNTP has set the clock
+    call_rec.start = (uint32_t)clock_now();
+
+    if (direction == CDR_DIR_OUTGOING) {
+        char digits[DIALER_MAX_DIGITS + 1];
+        if (dialer_get_number(digits, sizeof(digits)) > 0) {
+            set_number(digits);
+        }
+    }
+}
+
+// Called with cdr_mutex held
+static void call_end(cdr_outcome_t outcome, int64_t now)
+{
+    uint32_t underruns = underruns_now() - call_underruns_at_start;
+
+    take_number();
+    call_rec.outcome = outcome;
+    call_rec.duration_ms = (uint32_t)((now - call_start_us) / 1000);
+    call_rec.underruns = underruns > UINT16_MAX ? UINT16_MAX : underruns;
+    call_open = false;
+    last_digit_us = 0;
+
+    bool queued = queue_count < CDR_BATCH_RECORDS;
+    if (queued) {
+        queue[queue_count++] = call_rec;
+        if (queue_count == CDR_BATCH_RECORDS) {
+            xTaskNotifyGive(cdr_task_handle);
+        } else if (queue_count == 1) {
+            esp_timer_start_once(flush_timer, (uint64_t)CDR_FLUSH_MS * 1000);
+        }
+    }
+
+    portENTER_CRITICAL(&cdr_stats_lock);
+    cdr_stats.records++;
+    if (!queued) {
+        cdr_stats.dropped++;
+    }
+    portEXIT_CRITICAL(&cdr_stats_lock);
+
+    ESP_LOGI(TAG, "%s call %s, %" PRIu32 " ms",
+             call_rec.direction == CDR_DIR_INCOMING ? "Incoming" : "Outgoing",
+             outcome_names[outcome], call_rec.duration_ms);
+}
+
+static void cdr_event_handler(event_type_t event, void *user_data)
+{
+    int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(cdr_mutex, portMAX_DELAY);
+    switch (event) {
+        case PHONE_EVENT_OFF_HOOK:
+            if (!call_open) {
+                last_digit_us = 0;
+            }
+            break;
+
+        case PHONE_EVENT_DIGIT_DIALED:
+            if (!call_open) {
+                last_digit_us = now;
+            }
+            break;
+
+        case PHONE_EVENT_RINGING_START:
+            if (!call_open) {
+                call_begin(CDR_DIR_INCOMING, now);
+            }
+            break;
+
+        case BT_EVENT_CALL_DIALING:
+            if (!call_open) {
+                call_begin(CDR_DIR_OUTGOING, now);
+            }
+            break;
+
+        case BT_EVENT_CALL_ALERTING:
+            if (call_open && last_digit_us && call_rec.post_dial_ms == 0) {
+                int64_t pdd_ms = (now - last_digit_us) / 1000;
+                call_rec.post_dial_ms = pdd_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)pdd_ms;
+            }
+            break;
+
+        case BT_EVENT_CALL_STARTED:
+            if (!call_open) {
+                // Placed on the cell phone itself; timed from here
+                ma_bell_state_t state;
+                ma_bell_state_snapshot(&state);
+                call_begin(state.calls.count && state.calls.list[0].incoming
+                           ? CDR_DIR_INCOMING : CDR_DIR_OUTGOING, now);
+            }
+            if (!call_answered) {
+                call_answered = true;
+                call_rec.answer_ms = (uint32_t)((now - call_start_us) / 1000);
+            }
+            break;
+
+        case PHONE_EVENT_RINGING_STOP:
+            // Answering clears the ringing bit without this event
+            if (call_open && !call_answered && call_rec.direction == CDR_DIR_INCOMING) {
+                call_end(CDR_OUTCOME_MISSED, now);
+            }
+            break;
+
+        case BT_EVENT_CALL_BUSY:
+        case BT_EVENT_CALL_FAILED:
+            if (call_open && !call_answered) {
+                call_end(event == BT_EVENT_CALL_BUSY ? CDR_OUTCOME_BUSY : CDR_OUTCOME_FAILED, now);
+            }
+            break;
+
+        case BT_EVENT_CALL_ENDED:
+            if (call_open) {
+                call_end(call_answered ? CDR_OUTCOME_ANSWERED :
+                         call_rec.direction == CDR_DIR_INCOMING ? CDR_OUTCOME_MISSED :
+                         CDR_OUTCOME_ABANDONED, now);
+            }
+            break;
+
+        case BT_EVENT_DISCONNECTED:
+            if (call_open) {
+                call_end(CDR_OUTCOME_LINK_LOST, now);
+            }
+            break;
+
+        default:
+            break;
+    }
+    xSemaphoreGive(cdr_mutex);
+}
+
+void cdr_flush(void)
+{
+    cdr_record_t batch[CDR_BATCH_RECORDS];
+    size_t count;
+
+    // Log first, so two flushes cannot write their batches out of order
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    xSemaphoreTake(cdr_mutex, portMAX_DELAY);
+    count = queue_count;
+    memcpy(batch, queue, count * sizeof(cdr_record_t));
+    queue_count = 0;
+    esp_timer_stop(flush_timer);
+    xSemaphoreGive(cdr_mutex);
+
+    int ret = 0;
+    if (count > 0 && log_mounted) {
+        ret = cdr_log_append(&cdr_log, batch, count);
+    }
+    xSemaphoreGive(log_mutex);
+
+    if (count == 0 || !log_mounted) {
+        return;
+    }
+
+    portENTER_CRITICAL(&cdr_stats_lock);
+    if (ret == 0) {
+        cdr_stats.flushes++;
+    } else {
+        cdr_stats.write_errors++;
+    }
+    portEXIT_CRITICAL(&cdr_stats_lock);
+
+    if (ret != 0) {
+        ESP_LOGW(TAG, "Failed to write %u record(s)", (unsigned)count);
+    } else {
+        ESP_LOGD(TAG, "Wrote %u record(s)", (unsigned)count);
+    }
+}
+
+static void cdr_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        cdr_flush();
+    }
+}
+
+static void flush_timer_cb(void *arg)
+{
+    xTaskNotifyGive(cdr_task_handle);
+}
+
+static void mount_log(void)
+{
+    log_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                        CDR_PARTITION_LABEL);
+    if (log_part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, call records are not kept", CDR_PARTITION_LABEL);
+        return;
+    }
+
+    const cdr_flash_t flash = {
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+        .ctx = (void *)log_part,
+        .size = log_part->size - log_part->size % CDR_SECTOR_SIZE,
+    };
+    int64_t start = esp_timer_get_time();
+    if (cdr_log_mount(&cdr_log, &flash) != 0) {
+        ESP_LOGE(TAG, "Failed to scan call record log");
+        return;
+    }
+    log_mounted = true;
+
+    ESP_LOGI(TAG, "Call record log: %" PRIu32 " records, next #%" PRIu32 ", scanned in %lld ms",
+             cdr_log_capacity(&cdr_log), cdr_log.next_seq,
+             (long long)((esp_timer_get_time() - start) / 1000));
+}
+
+esp_err_t cdr_init(void)
+{
+    ESP_LOGI(TAG, "Initializing call records");
+
+    cdr_mutex = xSemaphoreCreateMutex();
+    log_mutex = xSemaphoreCreateMutex();
+    if (cdr_mutex == NULL || log_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    mount_log();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = flush_timer_cb,
+        .name = "cdr_flush",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &flush_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreate(cdr_task, "cdr", CDR_TASK_STACK_SIZE, NULL, CDR_TASK_PRIORITY,
+                    &cdr_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_FAIL;
+    }
+
+    return event_subscribe(CDR_EVENTS, cdr_event_handler, NULL);
+}
+
+void cdr_export_begin(cdr_cursor_t *cursor, uint32_t after_seq)
+{
+    cdr_flush();
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    if (log_mounted) {
+        cdr_log_iter_begin(&cdr_log, cursor, after_seq);
+    } else {
+        memset(cursor, 0, sizeof(*cursor));
+    }
+    xSemaphoreGive(log_mutex);
+}
+
+size_t cdr_export_read(cdr_cursor_t *cursor, cdr_record_t *out, size_t max)
+{
+    size_t count = 0;
+
+    if (!log_mounted) {
+        return 0;
+    }
+
+    // Short hold: the writer task waits at most one batch of reads
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    while (count < max && cdr_log_iter_next(&cdr_log, cursor, &out[count])) {
+        count++;
+    }
+    xSemaphoreGive(log_mutex);
+    return count;
+}
+
+void cdr_get_stats(cdr_stats_t *out)
+{
+    uint32_t capacity = 0;
+    uint32_t next_seq = 0;
+
+    if (log_mounted) {
+        xSemaphoreTake(log_mutex, portMAX_DELAY);
+        capacity = cdr_log_capacity(&cdr_log);
+        next_seq = cdr_log.next_seq;
+        xSemaphoreGive(log_mutex);
+    }
+
+    portENTER_CRITICAL(&cdr_stats_lock);
+    *out = cdr_stats;
+    portEXIT_CRITICAL(&cdr_stats_lock);
+    out->capacity = capacity;
+    out->next_seq = next_seq;
+    out->mounted = log_mounted;
+}
+
+const char *cdr_outcome_name(uint8_t outcome)
+{
+    return outcome < CDR_OUTCOME_COUNT ? outcome_names[outcome] : "unknown";
+}
@@ -0,0 +1,89 @@
+#ifndef __CDR_H__
+#define __CDR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "storage/cdr_log.h"
+
+/**
+ * @file cdr.h
+ * @brief Call detail records
+ *
+ * Follows each call through the call events (ring or dial, alerting,
+ * answer, end) and produces one cdr_record_t when it finishes: start time,
+ * time to answer, duration, direction, outcome, number, post-dial delay
+ * (last digit to far-end alerting) and audio underruns. Records are queued
+ * in RAM and appended to the "cdr" partition in batches by a low-priority
+ * task, never from the task that reported the call.
+ *
+ * One call is followed at a time; a second call taken with three-way
+ * calling is part of the first call's record.
+ */
+
+/**
+ * @brief CDR statistics
+ */
+typedef struct {
+    uint32_t records;        // Calls finished
+    uint32_t flushes;        // Batches written
+    uint32_t write_errors;   // Batches that failed to write
+    uint32_t dropped;        // Records lost because the queue was full
+    uint32_t capacity;       // Records kept before the oldest are overwritten
+    uint32_t next_seq;       // Sequence number the next record will get
+    bool mounted;            // Log partition found and scanned
+} cdr_stats_t;
+
+/**
+ * @brief Export position
+ */
+typedef cdr_log_iter_t cdr_cursor_t;
+
+/**
+ * @brief Mount the log, start the writer task and subscribe to call events
+ *
+ * Must be called after event_system_init(). A missing partition is logged
+ * and leaves records unsaved; it is not an error.
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t cdr_init(void);
+
+/**
+ * @brief Write queued records now
+ *
+ * Blocks the caller for the flash write.
+ */
+void cdr_flush(void);
+
+/**
+ * @brief Start an export at the oldest record
+ *
+ * Queued records are flushed first so the export is complete.
+ *
+ * @param cursor Position to initialize
+ * @param after_seq Only export records after this sequence number
+ */
+void cdr_export_begin(cdr_cursor_t *cursor, uint32_t after_seq);
+
+/**
+ * @brief Read the next records of an export
+ *
+ * @param cursor Position from cdr_export_begin()
+ * @param out Destination
+ * @param max Capacity of out
+ * @return Number of records read, 0 at the end
+ */
+size_t cdr_export_read(cdr_cursor_t *cursor, cdr_record_t *out, size_t max);
+
+/**
+ * @brief Get a copy of the statistics
+ */
+void cdr_get_stats(cdr_stats_t *out);
+
+/**
+ * @brief Get a short name for an outcome
+ */
+const char *cdr_outcome_name(uint8_t outcome);
+
+#endif /* __CDR_H__ */
@@ -0,0 +1,118 @@
+#include "dialer.h"
+#include "call_control.h"
+#include "app/events/event_system.h"
+#include "config/call_config.h"
+#include "storage/settings.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "dialer";
+
+// Digits come from the SLIC task, resets from call control and hook events
+static portMUX_TYPE dialer_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t dialer_timer = NULL;
+static char digits[DIALER_MAX_DIGITS + 1];
+static size_t digit_count = 0;
+static char last_digit = '\0';
+
+static void dialer_timer_cb(void *arg)
+{
+    portENTER_CRITICAL(&dialer_lock);
+    size_t count = digit_count;
+    portEXIT_CRITICAL(&dialer_lock);
+
+    if (count > 0) {
+        call_control_dispatch(CC_EVENT_NUMBER_COMPLETE);
+    }
+}
+
+static void dialer_event_handler(event_type_t event, void *user_data)
+{
+    dialer_reset();
+}
+
+void dialer_digit(char digit)
+{
+    bool stored = false;
+
+    portENTER_CRITICAL(&dialer_lock);
+    last_digit = digit;
+    if (digit_count < DIALER_MAX_DIGITS) {
+        digits[digit_count++] = digit;
+        digits[digit_count] = '\0';
+        stored = true;
+    }
+    portEXIT_CRITICAL(&dialer_lock);
+
+    if (!stored) {
+        ESP_LOGW(TAG, "Number too long, digit %c dropped", digit);
+    }
+
+    settings_t cfg;
+    settings_get(&cfg);
+    esp_timer_stop(dialer_timer);
+    esp_timer_start_once(dialer_timer, (uint64_t)cfg.dial.complete_ms * 1000);
+    event_publish(PHONE_EVENT_DIGIT_DIALED, NULL);
+}
+
+size_t dialer_get_number(char *out, size_t size)
+{
+    if (out == NULL || size == 0) {
+        return 0;
+    }
+
+    portENTER_CRITICAL(&dialer_lock);
+    size_t count = (digit_count < size - 1) ? digit_count : size - 1;
+    memcpy(out, digits, count);
+    out[count] = '\0';
+    portEXIT_CRITICAL(&dialer_lock);
+
+    return count;
+}
+
+char dialer_last_digit(void)
+{
+    portENTER_CRITICAL(&dialer_lock);
+    char digit = last_digit;
+    portEXIT_CRITICAL(&dialer_lock);
+    return digit;
+}
+
+void dialer_reset(void)
+{
+    if (dialer_timer != NULL) {
+        esp_timer_stop(dialer_timer);
+    }
+
+    portENTER_CRITICAL(&dialer_lock);
+    digit_count = 0;
+    digits[0] = '\0';
+    last_digit = '\0';
+    portEXIT_CRITICAL(&dialer_lock);
+}
+
+esp_err_t dialer_init(void)
+{
+    ESP_LOGI(TAG, "Initializing dialer");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = dialer_timer_cb,
+        .name = "dialer",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &dialer_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = event_subscribe(PHONE_EVENT_OFF_HOOK | PHONE_EVENT_ON_HOOK, dialer_event_handler, NULL);
+    if (ret != ESP_OK) {
+        esp_timer_delete(dialer_timer);
+        dialer_timer = NULL;
+        return ret;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,53 @@
+#ifndef __DIALER_H__
+#define __DIALER_H__
+
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @file dialer.h
+ * @brief Digit collection
+ *
+ * Collects the digits dialed from the handset. Each digit publishes
+ * PHONE_EVENT_DIGIT_DIALED; once no digit has arrived for
+ * DIALER_COMPLETE_MS the number is handed to call control as
+ * CC_EVENT_NUMBER_COMPLETE. The buffer is cleared on every hook change and
+ * whenever call control consumes it.
+ */
+
+/**
+ * @brief Initialize the dialer and subscribe to hook events
+ *
+ * Must be called after event_system_init() and before slic_interface_init().
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t dialer_init(void);
+
+/**
+ * @brief Add a digit dialed on the handset
+ *
+ * @param digit '0'-'9', '*' or '#'
+ */
+void dialer_digit(char digit);
+
+/**
+ * @brief Copy the digits collected so far
+ *
+ * @param out Destination, NUL-terminated
+ * @param size Size of out
+ * @return Number of digits
+ */
+size_t dialer_get_number(char *out, size_t size);
+
+/**
+ * @brief Most recent digit, or '\0' if none has been dialed
+ */
+char dialer_last_digit(void);
+
+/**
+ * @brief Discard the collected digits and any pending completion
+ */
+void dialer_reset(void);
+
+#endif /* __DIALER_H__ */
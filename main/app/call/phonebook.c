@@ -0,0 +1,384 @@
+#include "phonebook.h"
+#include "storage/storage.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char *TAG = "phonebook";
+
+#define PHONEBOOK_BLOB_VERSION 1
+
+_Static_assert(PHONEBOOK_MAX_ENTRIES <= 255, "Index entries hold an 8-bit slot");
+
+// Stored form: this header, then count entries
+typedef struct {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t count;
+} pb_blob_header_t;
+
+typedef struct {
+    char code[PHONEBOOK_CODE_MAX_LEN + 1];
+    uint8_t idx;
+} pb_code_key_t;
+
+typedef struct {
+    uint64_t key;           // Trailing digits, see suffix_key()
+    uint8_t idx;
+} pb_suffix_key_t;
+
+typedef struct {
+    uint16_t count;
+    uint16_t code_count;
+    uint16_t suffix_count;
+    phonebook_entry_t entries[PHONEBOOK_MAX_ENTRIES];
+    pb_code_key_t by_code[PHONEBOOK_MAX_ENTRIES];
+    pb_suffix_key_t by_suffix[PHONEBOOK_MAX_ENTRIES];
+} pb_table_t;
+
+// Replaced as a whole by an import; lookups run inside the lock and are short
+static pb_table_t *pb_table = NULL;
+static portMUX_TYPE pb_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Up to PHONEBOOK_MATCH_DIGITS trailing digits as a number, with the digit
+// count in the low bits so that "0123" and "123" differ. 0 if no digits.
+static uint64_t suffix_key(const char *number)
+{
+    uint64_t value = 0;
+    uint64_t scale = 1;
+    unsigned digits = 0;
+
+    for (size_t i = strlen(number); i > 0 && digits < PHONEBOOK_MATCH_DIGITS; i--) {
+        char c = number[i - 1];
+        if (c >= '0' && c <= '9') {
+            value += (uint64_t)(c - '0') * scale;
+            scale *= 10;
+            digits++;
+        }
+    }
+    return digits ? (value << 4) | digits : 0;
+}
+
+static int compare_code(const void *a, const void *b)
+{
+    return strcmp(((const pb_code_key_t *)a)->code, ((const pb_code_key_t *)b)->code);
+}
+
+static int compare_suffix(const void *a, const void *b)
+{
+    uint64_t ka = ((const pb_suffix_key_t *)a)->key;
+    uint64_t kb = ((const pb_suffix_key_t *)b)->key;
+    return (ka > kb) - (ka < kb);
+}
+
+// Sort the indexes; false on a duplicate speed-dial code
+static bool build_indexes(pb_table_t *table)
+{
+    table->code_count = 0;
+    table->suffix_count = 0;
+
+    for (uint16_t i = 0; i < table->count; i++) {
+        const phonebook_entry_t *e = &table->entries[i];
+        if (e->code[0]) {
+            pb_code_key_t *k = &table->by_code[table->code_count++];
+            memcpy(k->code, e->code, sizeof(k->code));
+            k->idx = i;
+        }
+        uint64_t key = suffix_key(e->number);
+        if (e->name[0] && key) {
+            table->by_suffix[table->suffix_count].key = key;
+            table->by_suffix[table->suffix_count].idx = i;
+            table->suffix_count++;
+        }
+    }
+
+    qsort(table->by_code, table->code_count, sizeof(pb_code_key_t), compare_code);
+    qsort(table->by_suffix, table->suffix_count, sizeof(pb_suffix_key_t), compare_suffix);
+
+    for (uint16_t i = 1; i < table->code_count; i++) {
+        if (strcmp(table->by_code[i - 1].code, table->by_code[i].code) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void install(pb_table_t *table)
+{
+    portENTER_CRITICAL(&pb_lock);
+    pb_table_t *old = pb_table;
+    pb_table = table;
+    portEXIT_CRITICAL(&pb_lock);
+
+    free(old);
+}
+
+static esp_err_t save(const pb_table_t *table)
+{
+    size_t len = sizeof(pb_blob_header_t) + table->count * sizeof(phonebook_entry_t);
+    uint8_t *blob = malloc(len);
+    if (blob == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pb_blob_header_t header = {
+        .version = PHONEBOOK_BLOB_VERSION,
+        .count = table->count,
+    };
+    memcpy(blob, &header, sizeof(header));
+    memcpy(blob + sizeof(header), table->entries, table->count * sizeof(phonebook_entry_t));
+
+    // Committed now: the import is only reported done once it is on flash
+    esp_err_t ret = storage_set_blob(STORAGE_NAMESPACE_PBOOK, STORAGE_KEY_PBOOK_ENTRIES, blob, len);
+    free(blob);
+    if (ret == ESP_OK) {
+        ret = storage_commit(STORAGE_NAMESPACE_PBOOK);
+    }
+    return ret;
+}
+
+static void load(pb_table_t *table)
+{
+    size_t len = sizeof(pb_blob_header_t) + sizeof(table->entries);
+    uint8_t *blob = malloc(len);
+    if (blob == NULL) {
+        return;
+    }
+
+    esp_err_t ret = storage_get_blob(STORAGE_NAMESPACE_PBOOK, STORAGE_KEY_PBOOK_ENTRIES, blob, &len);
+    if (ret == ESP_OK && len >= sizeof(pb_blob_header_t)) {
+        pb_blob_header_t header;
+        memcpy(&header, blob, sizeof(header));
+        if (header.version == PHONEBOOK_BLOB_VERSION && header.count <= PHONEBOOK_MAX_ENTRIES &&
+            len == sizeof(header) + header.count * sizeof(phonebook_entry_t)) {
+            memcpy(table->entries, blob + sizeof(header), header.count * sizeof(phonebook_entry_t));
+            table->count = header.count;
+        } else {
+            ESP_LOGW(TAG, "Stored phonebook not recognized, starting empty");
+        }
+    } else if (ret != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "Failed to read phonebook: %s", esp_err_to_name(ret));
+    }
+    free(blob);
+
+    if (!build_indexes(table)) {
+        ESP_LOGW(TAG, "Stored phonebook has duplicate codes, starting empty");
+        table->count = 0;
+        build_indexes(table);
+    }
+}
+
+esp_err_t phonebook_init(void)
+{
+    pb_table_t *table = calloc(1, sizeof(pb_table_t));
+    if (table == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate phonebook");
+        return ESP_ERR_NO_MEM;
+    }
+
+    load(table);
+    ESP_LOGI(TAG, "%u entries, %u speed-dial codes, %u names",
+             table->count, table->code_count, table->suffix_count);
+    install(table);
+    return ESP_OK;
+}
+
+bool phonebook_speed_dial(const char *code, char *number, size_t size)
+{
+    pb_code_key_t key;
+    bool found = false;
+
+    if (code == NULL || strlen(code) >= sizeof(key.code) || size == 0) {
+        return false;
+    }
+    memset(&key, 0, sizeof(key));
+    memcpy(key.code, code, strlen(code));
+
+    portENTER_CRITICAL(&pb_lock);
+    const pb_code_key_t *hit = pb_table ?
+        bsearch(&key, pb_table->by_code, pb_table->code_count, sizeof(key), compare_code) : NULL;
+    if (hit) {
+        strncpy(number, pb_table->entries[hit->idx].number, size - 1);
+        number[size - 1] = '\0';
+        found = true;
+    }
+    portEXIT_CRITICAL(&pb_lock);
+
+    return found;
+}
+
+bool phonebook_lookup_name(const char *number, char *name, size_t size)
+{
+    bool found = false;
+
+    if (number == NULL || size == 0) {
+        return false;
+    }
+    pb_suffix_key_t key = { .key = suffix_key(number) };
+    if (key.key == 0) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&pb_lock);
+    const pb_suffix_key_t *hit = pb_table ?
+        bsearch(&key, pb_table->by_suffix, pb_table->suffix_count, sizeof(key), compare_suffix) : NULL;
+    if (hit) {
+        strncpy(name, pb_table->entries[hit->idx].name, size - 1);
+        name[size - 1] = '\0';
+        found = true;
+    }
+    portEXIT_CRITICAL(&pb_lock);
+
+    return found;
+}
+
+// Strip surrounding blanks in place
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    size_t len = strlen(s);
+    while (len > 0 && (s[len - 1] == ' ' || s[len - 1] == '\t' || s[len - 1] == '\r')) {
+        s[--len] = '\0';
+    }
+    return s;
+}
+
+// Parse one code,number,name line into an entry
+static bool parse_line(char *line, phonebook_entry_t *e)
+{
+    char *number = strchr(line, ',');
+    if (number == NULL) {
+        return false;
+    }
+    *number++ = '\0';
+    char *name = strchr(number, ',');
+    if (name) {
+        *name++ = '\0';
+    }
+
+    char *code = trim(line);
+    if (strlen(code) > PHONEBOOK_CODE_MAX_LEN) {
+        return false;
+    }
+    for (const char *p = code; *p; p++) {
+        if (!isdigit((unsigned char)*p)) {
+            return false;
+        }
+    }
+    memset(e, 0, sizeof(*e));
+    strcpy(e->code, code);
+
+    size_t n = 0;
+    for (const char *p = trim(number); *p; p++) {
+        if (strchr(" -.()", *p)) {
+            continue;
+        }
+        if (!(isdigit((unsigned char)*p) || *p == '*' || *p == '#' || (*p == '+' && n == 0)) ||
+            n >= PHONEBOOK_NUMBER_LEN) {
+            return false;
+        }
+        e->number[n++] = *p;
+    }
+    if (n == 0) {
+        return false;
+    }
+
+    if (name) {
+        name = trim(name);
+        size_t len = strlen(name);
+        if (len >= 2 && name[0] == '"' && name[len - 1] == '"') {
+            name[len - 1] = '\0';
+            name++;
+        }
+        strncpy(e->name, name, PHONEBOOK_NAME_LEN);
+    }
+    return true;
+}
+
+esp_err_t phonebook_import_csv(const char *csv, size_t len, int *bad_line)
+{
+    if (bad_line) {
+        *bad_line = 0;
+    }
+
+    pb_table_t *table = calloc(1, sizeof(pb_table_t));
+    char *text = malloc(len + 1);
+    if (table == NULL || text == NULL) {
+        free(table);
+        free(text);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(text, csv, len);
+    text[len] = '\0';
+
+    esp_err_t ret = ESP_OK;
+    int line_no = 0;
+    char *next = text;
+    for (char *line = next; line && ret == ESP_OK; line = next) {
+        line_no++;
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+
+        char *content = trim(line);
+        if (content[0] == '\0' || content[0] == '#' ||
+            (line_no == 1 && strncmp(content, "code", 4) == 0)) {
+            continue;
+        }
+        if (table->count >= PHONEBOOK_MAX_ENTRIES) {
+            ret = ESP_ERR_INVALID_SIZE;
+        } else if (!parse_line(content, &table->entries[table->count])) {
+            ret = ESP_ERR_INVALID_ARG;
+        } else {
+            table->count++;
+        }
+    }
+    free(text);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Import rejected at line %d", line_no);
+        if (bad_line) {
+            *bad_line = line_no;
+        }
+    } else if (!build_indexes(table)) {
+        ESP_LOGW(TAG, "Import rejected: duplicate speed-dial code");
+        ret = ESP_ERR_INVALID_ARG;
+    } else {
+        ret = save(table);
+    }
+    if (ret != ESP_OK) {
+        free(table);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Imported %u entries, %u speed-dial codes, %u names",
+             table->count, table->code_count, table->suffix_count);
+    install(table);
+    return ESP_OK;
+}
+
+size_t phonebook_count(void)
+{
+    portENTER_CRITICAL(&pb_lock);
+    size_t count = pb_table ? pb_table->count : 0;
+    portEXIT_CRITICAL(&pb_lock);
+    return count;
+}
+
+bool phonebook_get(size_t index, phonebook_entry_t *out)
+{
+    bool found = false;
+
+    portENTER_CRITICAL(&pb_lock);
+    if (pb_table && index < pb_table->count) {
+        *out = pb_table->entries[index];
+        found = true;
+    }
+    portEXIT_CRITICAL(&pb_lock);
+    return found;
+}
@@ -0,0 +1,97 @@
+#ifndef __PHONEBOOK_H__
+#define __PHONEBOOK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "config/call_config.h"
+
+/**
+ * @file phonebook.h
+ * @brief Local phonebook: speed-dial codes and Caller ID names
+ *
+ * Entries are kept in one NVS blob and loaded into RAM at boot, together
+ * with two sorted indexes: speed-dial code, and a key built from the last
+ * PHONEBOOK_MATCH_DIGITS digits of the number. Both lookups are binary
+ * searches over at most PHONEBOOK_MAX_ENTRIES keys, cheap enough for the
+ * dial path and the +CLIP handler. The whole book is replaced at once by a
+ * CSV import; there is no per-entry editing.
+ *
+ * All functions are thread-safe.
+ */
+
+#define PHONEBOOK_NUMBER_LEN    32
+#define PHONEBOOK_NAME_LEN      15      // What a Caller ID name field can carry
+
+/**
+ * @brief One phonebook entry
+ */
+typedef struct {
+    char code[PHONEBOOK_CODE_MAX_LEN + 1];      // Speed-dial code, "" for none
+    char number[PHONEBOOK_NUMBER_LEN + 1];      // Digits, '*', '#' and a leading '+'
+    char name[PHONEBOOK_NAME_LEN + 1];          // "" for none
+} phonebook_entry_t;
+
+/**
+ * @brief Load the phonebook from NVS and build the indexes
+ *
+ * Must be called after storage_init(). A missing or unreadable phonebook
+ * leaves it empty.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the table cannot be allocated
+ */
+esp_err_t phonebook_init(void);
+
+/**
+ * @brief Resolve a speed-dial code
+ *
+ * @param code Digits as dialed
+ * @param number Destination for the number
+ * @param size Size of number
+ * @return True if code is a speed-dial code
+ */
+bool phonebook_speed_dial(const char *code, char *number, size_t size);
+
+/**
+ * @brief Find the name for a calling number
+ *
+ * @param number Number as received in +CLIP or +CCWA
+ * @param name Destination for the name
+ * @param size Size of name
+ * @return True if an entry with a name matched
+ */
+bool phonebook_lookup_name(const char *number, char *name, size_t size);
+
+/**
+ * @brief Replace the phonebook with the contents of a CSV document
+ *
+ * One entry per line as code,number,name. The code and name may be empty.
+ * The name may be quoted and may contain commas. Blank lines, lines
+ * starting with '#' and a header line starting with "code" are skipped.
+ * Spaces, dashes, dots and parentheses in numbers are dropped. Nothing
+ * changes unless every line is valid.
+ *
+ * @param csv Document, not necessarily NUL-terminated
+ * @param len Length of csv
+ * @param bad_line Set to the 1-based line number of the first invalid
+ *                 line, or 0. May be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG on a bad line or duplicate
+ *         code, ESP_ERR_INVALID_SIZE if there are too many entries, or the
+ *         NVS error if the new book could not be saved
+ */
+esp_err_t phonebook_import_csv(const char *csv, size_t len, int *bad_line);
+
+/**
+ * @brief Number of entries
+ */
+size_t phonebook_count(void);
+
+/**
+ * @brief Copy one entry, in import order
+ *
+ * @return True if index is in range
+ */
+bool phonebook_get(size_t index, phonebook_entry_t *out);
+
+#endif /* __PHONEBOOK_H__ */
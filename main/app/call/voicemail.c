@@ -0,0 +1,860 @@
+#include "voicemail.h"
+#include "call_control.h"
+#include "dialer.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "audio/audio_bridge.h"
+#include "audio/audio_output.h"
+#include "audio/ima_adpcm.h"
+#include "storage/settings.h"
+#include "config/call_config.h"
+#include "config/audio_config.h"
+#include "network/clock/clock.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "voicemail";
+
+#define VM_EVENTS (PHONE_EVENT_RINGING_START | PHONE_EVENT_RINGING_STOP | PHONE_EVENT_OFF_HOOK | \
+                   PHONE_EVENT_ON_HOOK | PHONE_EVENT_DIGIT_DIALED | BT_EVENT_CALL_STARTED | \
+                   BT_EVENT_CALL_ENDED | BT_EVENT_DISCONNECTED)
+
+// ADPCM is 4 bits a sample
+#define VM_BYTES_PER_SEC        (AUDIO_SAMPLE_RATE / 2)
+#define VM_MS_TO_BYTES(ms)      ((uint32_t)(ms) * VM_BYTES_PER_SEC / 1000)
+#define VM_BYTES_TO_MS(b)       ((uint32_t)((uint64_t)(b) * 1000 / VM_BYTES_PER_SEC))
+#define VM_MS_TO_SAMPLES(ms)    ((uint32_t)(ms) * AUDIO_SAMPLE_RATE / 1000)
+
+// Handset playback and greeting recording run in 20 ms frames
+#define VM_FRAME_SAMPLES        160
+#define VM_FRAME_BYTES          (VM_FRAME_SAMPLES / 2)
+
+// Hook or dial clicks at the end of a greeting are cut
+#define VM_GREETING_TAIL_MS     500
+
+// Between messages on the handset
+#define VM_SEPARATOR_BEEP_MS    200
+
+// Work for the voicemail task, as notification bits
+#define VM_CMD_TIMER            (1 << 0)    // Rang out, or the call guard expired
+#define VM_CMD_BLOCK            (1 << 1)    // A ping-pong block was handed over
+#define VM_CMD_END              (1 << 2)    // Machine call over: hang-up or pickup
+#define VM_CMD_PLAY             (1 << 3)    // Handset: play messages
+#define VM_CMD_GREETING         (1 << 4)    // Handset: record a greeting
+#define VM_CMD_HANDSET          (1 << 5)    // Handset: digit or hang-up, see poll_handset()
+
+typedef enum {
+    PHASE_IDLE,
+    PHASE_GREETING,     // Machine: greeting to the caller
+    PHASE_BEEP,         // Machine: beep to the caller
+    PHASE_RECORD,       // Machine: recording the caller
+    PHASE_PLAYBACK,     // Handset: playing messages
+    PHASE_GREETING_REC, // Handset: recording a greeting
+} vm_phase_t;
+
+#define VM_MACHINE_PHASE(p)     ((p) >= PHASE_GREETING && (p) <= PHASE_RECORD)
+#define VM_HANDSET_PHASE(p)     ((p) == PHASE_PLAYBACK || (p) == PHASE_GREETING_REC)
+
+// One cycle of 1 kHz at 8 kHz, in thousandths of the beep level
+static const int16_t beep_wave[8] = { 0, 707, 1000, 707, 0, -707, -1000, -707 };
+
+// The store is changed only by the voicemail task; readers take store_mutex
+static SemaphoreHandle_t store_mutex = NULL;
+static const esp_partition_t *vm_part = NULL;
+static vm_store_t store;
+static bool mounted = false;
+static volatile uint8_t unheard = 0;
+
+static TaskHandle_t vm_task_handle = NULL;
+static esp_timer_handle_t vm_timer = NULL;
+static volatile vm_phase_t phase = PHASE_IDLE;
+
+// Ping-pong buffer between the bridge taps and the voicemail task. A block
+// the taps hold (bit set in tap_owns) is filled or drained by the taps only;
+// the others belong to the task. Ownership moves under vm_lock.
+static portMUX_TYPE vm_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t blocks[2][VOICEMAIL_BLOCK_BYTES];
+static uint32_t block_len[2];
+static uint8_t tap_owns;
+static uint8_t task_block;          // Task side: block to write or refill next
+static bool greeting_eof;           // Task side has read the whole greeting
+
+// Tap side; greeting and beep run on the uplink task, recording on the downlink
+static uint8_t tap_block;
+static uint32_t tap_pos;
+static ima_adpcm_state_t tap_codec;
+static uint32_t beep_left;
+static uint32_t beep_pos;
+
+// Message being taken, task side
+static vm_writer_t rec_writer;
+static uint32_t rec_start;
+static uint32_t greeting_pos;
+static char rec_number[VM_NUMBER_LEN];
+
+// Handset session, set by the event handler
+static volatile bool handset_down = false;
+static volatile char handset_digit = 0;
+
+static voicemail_stats_t vm_stats;
+static portMUX_TYPE vm_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void stat_inc(uint32_t *counter)
+{
+    portENTER_CRITICAL(&vm_stats_lock);
+    (*counter)++;
+    portEXIT_CRITICAL(&vm_stats_lock);
+}
+
+static int part_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    return esp_partition_read(ctx, offset, dst, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    return esp_partition_write(ctx, offset, src, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase(void *ctx, uint32_t offset, size_t len)
+{
+    return esp_partition_erase_range(ctx, offset, len) == ESP_OK ? 0 : -1;
+}
+
+// Called with store_mutex held
+static void refresh_unheard(void)
+{
+    unheard = (uint8_t)vm_store_count(&store, VM_FLAG_NEW);
+}
+
+static void beep(int16_t *pcm, size_t samples, uint32_t *pos)
+{
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)(beep_wave[(*pos)++ & 7] * VOICEMAIL_BEEP_LEVEL / 1000);
+    }
+}
+
+static void take_number(void)
+{
+    ma_bell_state_t state;
+    ma_bell_state_snapshot(&state);
+
+    for (int i = 0; i < state.calls.count; i++) {
+        const ma_bell_call_t *call = &state.calls.list[i];
+        if (call->incoming && call->number[0]) {
+            strncpy(rec_number, call->number, sizeof(rec_number) - 1);
+            return;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Bridge taps: no flash, no blocking, only the block ownership lock
+
+// Hand the tap's current block to the task and move to the other one
+static void tap_hand_over(void)
+{
+    portENTER_CRITICAL(&vm_lock);
+    tap_owns &= ~(1 << tap_block);
+    portEXIT_CRITICAL(&vm_lock);
+    tap_block ^= 1;
+    tap_pos = 0;
+    xTaskNotify(vm_task_handle, VM_CMD_BLOCK, eSetBits);
+}
+
+static bool tap_has_block(bool *eof)
+{
+    portENTER_CRITICAL(&vm_lock);
+    bool owned = tap_owns & (1 << tap_block);
+    if (eof != NULL) {
+        *eof = greeting_eof;
+    }
+    portEXIT_CRITICAL(&vm_lock);
+    return owned;
+}
+
+// Decode the greeting into the frame; returns the samples written
+static size_t greeting_out(int16_t *pcm, size_t samples)
+{
+    size_t done = 0;
+
+    while (done + 1 < samples) {
+        bool eof;
+        if (!tap_has_block(&eof)) {
+            if (eof) {
+                phase = PHASE_BEEP;
+                beep_left = VM_MS_TO_SAMPLES(VOICEMAIL_BEEP_MS);
+                beep_pos = 0;
+            } else {
+                stat_inc(&vm_stats.underruns);
+            }
+            break;
+        }
+
+        size_t bytes = (samples - done) / 2;
+        if (bytes > block_len[tap_block] - tap_pos) {
+            bytes = block_len[tap_block] - tap_pos;
+        }
+        done += ima_adpcm_decode(&tap_codec, blocks[tap_block] + tap_pos, bytes, pcm + done);
+        tap_pos += bytes;
+        if (tap_pos == block_len[tap_block]) {
+            tap_hand_over();
+        }
+    }
+    return done;
+}
+
+// Beep into the frame, then switch the taps to recording
+static size_t beep_out(int16_t *pcm, size_t samples)
+{
+    size_t n = (samples < beep_left) ? samples : beep_left;
+    beep(pcm, n, &beep_pos);
+    beep_left -= n;
+
+    if (beep_left == 0) {
+        // The task is done with the greeting blocks once it has seen the end
+        portENTER_CRITICAL(&vm_lock);
+        tap_owns = 0x3;
+        block_len[0] = block_len[1] = 0;
+        task_block = 0;
+        portEXIT_CRITICAL(&vm_lock);
+        tap_block = 0;
+        ima_adpcm_init(&tap_codec);
+        phase = PHASE_RECORD;
+    }
+    return n;
+}
+
+// The caller hears the greeting, the beep, then silence: the handset is on-hook
+static void machine_uplink(int16_t *pcm, size_t samples, void *ctx)
+{
+    size_t done = 0;
+
+    if (phase == PHASE_GREETING) {
+        done = greeting_out(pcm, samples);
+    }
+    if (phase == PHASE_BEEP) {
+        done += beep_out(pcm + done, samples - done);
+    }
+    memset(pcm + done, 0, (samples - done) * sizeof(int16_t));
+}
+
+// Encode the caller straight from the ring buffer item
+static bool machine_downlink(const int16_t *pcm, size_t samples, void *ctx)
+{
+    samples &= ~(size_t)1;
+
+    while (phase == PHASE_RECORD && samples > 0) {
+        if (!tap_has_block(NULL)) {
+            stat_inc(&vm_stats.overruns);
+            break;
+        }
+
+        uint8_t *block = blocks[tap_block];
+        size_t bytes = samples / 2;
+        if (bytes > VOICEMAIL_BLOCK_BYTES - block_len[tap_block]) {
+            bytes = VOICEMAIL_BLOCK_BYTES - block_len[tap_block];
+        }
+        ima_adpcm_encode(&tap_codec, pcm, 2 * bytes, block + block_len[tap_block]);
+        pcm += 2 * bytes;
+        samples -= 2 * bytes;
+
+        portENTER_CRITICAL(&vm_lock);
+        block_len[tap_block] += bytes;
+        bool full = block_len[tap_block] == VOICEMAIL_BLOCK_BYTES;
+        portEXIT_CRITICAL(&vm_lock);
+        if (full) {
+            tap_hand_over();
+        }
+    }
+
+    // Nothing is played to the on-hook handset
+    return true;
+}
+
+static const audio_bridge_tap_t machine_tap = {
+    .downlink = machine_downlink,
+    .uplink = machine_uplink,
+};
+
+// ---------------------------------------------------------------------------
+// Voicemail task
+
+// Append a block to the message; false once the slot is full or flash failed
+static bool save_block(uint8_t b)
+{
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    int n = vm_store_write(&store, &rec_writer, blocks[b], block_len[b]);
+    xSemaphoreGive(store_mutex);
+
+    if (n < 0) {
+        stat_inc(&vm_stats.write_errors);
+        ESP_LOGW(TAG, "Flash write failed in slot %u", rec_writer.slot);
+    }
+    return n == (int)block_len[b];
+}
+
+// Move blocks the taps handed over: refill greeting, write recording.
+// Returns false once the recording cannot go on.
+static bool service_blocks(void)
+{
+    for (;;) {
+        portENTER_CRITICAL(&vm_lock);
+        uint8_t b = task_block;
+        bool mine = !(tap_owns & (1 << b));
+        vm_phase_t now = phase;
+        bool eof = greeting_eof;
+        portEXIT_CRITICAL(&vm_lock);
+
+        if (!mine) {
+            return true;
+        }
+
+        if (now == PHASE_GREETING && !eof) {
+            xSemaphoreTake(store_mutex, portMAX_DELAY);
+            int n = vm_store_read(&store, VM_GREETING, greeting_pos, blocks[b], VOICEMAIL_BLOCK_BYTES);
+            xSemaphoreGive(store_mutex);
+
+            portENTER_CRITICAL(&vm_lock);
+            if (n > 0) {
+                block_len[b] = (uint32_t)n;
+                tap_owns |= 1 << b;
+                task_block ^= 1;
+            } else {
+                greeting_eof = true;
+            }
+            portEXIT_CRITICAL(&vm_lock);
+            if (n <= 0) {
+                return true;
+            }
+            greeting_pos += (uint32_t)n;
+        } else if (now == PHASE_RECORD && block_len[b] > 0) {
+            bool ok = save_block(b);
+            portENTER_CRITICAL(&vm_lock);
+            block_len[b] = 0;
+            tap_owns |= 1 << b;
+            task_block ^= 1;
+            portEXIT_CRITICAL(&vm_lock);
+            if (!ok) {
+                return false;
+            }
+        } else {
+            return true;
+        }
+    }
+}
+
+// Retire the oldest message if no slot is left empty for the next call.
+// Caller holds store_mutex, or the store is not in use yet.
+static void make_room(void)
+{
+    int retired = vm_store_make_room(&store);
+    if (retired > 0) {
+        ESP_LOGI(TAG, "Store full, deleted the oldest message (slot %d)", retired);
+    } else if (retired < 0) {
+        stat_inc(&vm_stats.write_errors);
+        ESP_LOGW(TAG, "Failed to free a slot; the next call records over the oldest message");
+    }
+}
+
+// Stop the taps and keep what was recorded; hang_up ends the call as well
+static void machine_end(bool hang_up)
+{
+    if (!VM_MACHINE_PHASE(phase)) {
+        return;
+    }
+
+    // From here on the taps are not running and every block is the task's
+    audio_bridge_set_tap(NULL);
+    esp_timer_stop(vm_timer);
+    vm_phase_t was = phase;
+    phase = PHASE_IDLE;
+
+    bool ok = true;
+    if (was == PHASE_RECORD) {
+        // Full blocks oldest first, then the one the taps had started
+        for (int i = 0; i < 2 && ok; i++) {
+            uint8_t b = task_block ^ i;
+            if (!(tap_owns & (1 << b)) && block_len[b] > 0) {
+                ok = save_block(b);
+            }
+        }
+        if (ok && (tap_owns & (1 << tap_block)) && block_len[tap_block] > 0) {
+            save_block(tap_block);
+        }
+    }
+
+    uint32_t ms = VM_BYTES_TO_MS(rec_writer.length);
+    if (rec_writer.length >= VM_MS_TO_BYTES(VOICEMAIL_MIN_MESSAGE_MS)) {
+        if (rec_number[0] == '\0') {
+            take_number();
+        }
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+        int ret = vm_store_finish(&store, &rec_writer, rec_start, rec_number);
+        if (ret == 0) {
+            make_room();
+        }
+        refresh_unheard();
+        xSemaphoreGive(store_mutex);
+
+        if (ret == 0) {
+            stat_inc(&vm_stats.recorded);
+            ESP_LOGI(TAG, "Message from %s, %" PRIu32 " ms, slot %u",
+                     rec_number[0] ? rec_number : "(unknown)", ms, rec_writer.slot);
+        } else {
+            stat_inc(&vm_stats.write_errors);
+            ESP_LOGW(TAG, "Failed to save message header in slot %u", rec_writer.slot);
+        }
+    } else if (was == PHASE_RECORD) {
+        ESP_LOGI(TAG, "Caller left no message (%" PRIu32 " ms)", ms);
+    }
+
+    if (hang_up) {
+        call_control_dispatch(CC_EVENT_MACHINE_DONE);
+    }
+}
+
+static void machine_answer(void)
+{
+    if (!mounted || phase != PHASE_IDLE || call_control_get_state() != CC_STATE_RINGING) {
+        return;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    bool have_greeting = vm_store_live(&store, VM_GREETING);
+    vm_store_begin(&store, vm_store_pick(&store), &rec_writer);
+    xSemaphoreGive(store_mutex);
+
+    memset(rec_number, 0, sizeof(rec_number));
+    take_number();
+    rec_start = (uint32_t)clock_now();
+    greeting_pos = 0;
+
+    portENTER_CRITICAL(&vm_lock);
+    tap_owns = 0;
+    block_len[0] = block_len[1] = 0;
+    task_block = 0;
+    greeting_eof = !have_greeting;
+    portEXIT_CRITICAL(&vm_lock);
+    tap_block = 0;
+    tap_pos = 0;
+    ima_adpcm_init(&tap_codec);
+    phase = PHASE_GREETING;
+
+    // Both halves are full before the first uplink frame asks for them
+    service_blocks();
+    audio_bridge_set_tap(&machine_tap);
+
+    call_control_dispatch(CC_EVENT_MACHINE_ANSWER);
+    if (call_control_get_state() != CC_STATE_MACHINE) {
+        // Picked up, or the caller gave up, in the meantime
+        machine_end(false);
+        return;
+    }
+
+    stat_inc(&vm_stats.answered);
+    esp_timer_start_once(vm_timer, (uint64_t)VOICEMAIL_CALL_GUARD_MS * 1000);
+    ESP_LOGI(TAG, "Answered, recording to slot %u%s", rec_writer.slot,
+             have_greeting ? "" : " (no greeting recorded)");
+}
+
+// Digit dialed or hang-up during a handset session: the digit, -1 once
+// the handset is down, 0 for neither. Stray commands are dropped.
+static int poll_handset(void)
+{
+    uint32_t cmds;
+    xTaskNotifyWait(0, UINT32_MAX, &cmds, 0);
+
+    if (handset_down) {
+        return -1;
+    }
+    return __atomic_exchange_n(&handset_digit, 0, __ATOMIC_RELAXED);
+}
+
+// Play to the handset, paced by the I2S DMA
+static void handset_write(const int16_t *pcm, size_t samples)
+{
+    size_t written = 0;
+    audio_output_write(pcm, samples * sizeof(int16_t), &written, 100);
+    if (written == 0) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+}
+
+static int handset_beep(uint32_t ms)
+{
+    int16_t pcm[VM_FRAME_SAMPLES];
+    uint32_t pos = 0;
+
+    for (uint32_t left = VM_MS_TO_SAMPLES(ms); left > 0; ) {
+        int cut = poll_handset();
+        if (cut != 0) {
+            return cut;
+        }
+        size_t n = (left < VM_FRAME_SAMPLES) ? left : VM_FRAME_SAMPLES;
+        beep(pcm, n, &pos);
+        handset_write(pcm, n);
+        left -= n;
+    }
+    return 0;
+}
+
+// Play one message; returns the digit that cut it short, -1 on hang-up, 0 at its end
+static int play_slot(uint8_t slot)
+{
+    ima_adpcm_state_t codec;
+    uint8_t adpcm[VM_FRAME_BYTES];
+    int16_t pcm[VM_FRAME_SAMPLES];
+    uint32_t offset = 0;
+
+    ima_adpcm_init(&codec);
+    for (;;) {
+        int cut = poll_handset();
+        if (cut != 0) {
+            return cut;
+        }
+
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+        int n = vm_store_read(&store, slot, offset, adpcm, sizeof(adpcm));
+        xSemaphoreGive(store_mutex);
+        if (n <= 0) {
+            return 0;
+        }
+        offset += (uint32_t)n;
+        handset_write(pcm, ima_adpcm_decode(&codec, adpcm, (size_t)n, pcm));
+    }
+}
+
+static void handset_begin(vm_phase_t session)
+{
+    phase = session;
+    event_publish(PHONE_EVENT_VOICEMAIL_START, NULL);
+}
+
+static void handset_end(void)
+{
+    phase = PHASE_IDLE;
+    event_publish(PHONE_EVENT_VOICEMAIL_END, NULL);
+}
+
+static void play_messages(void)
+{
+    uint8_t list[VM_MAX_SLOTS];
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    size_t n = vm_store_list(&store, list, VM_MAX_SLOTS);
+    xSemaphoreGive(store_mutex);
+
+    handset_begin(PHASE_PLAYBACK);
+    ESP_LOGI(TAG, "Playing %u message(s)", (unsigned)n);
+
+    for (size_t i = 0; i < n; i++) {
+        int cut = handset_beep(VM_SEPARATOR_BEEP_MS);
+        if (cut == 0) {
+            cut = play_slot(list[i]);
+        }
+        if (cut < 0) {
+            break;
+        }
+
+        // Heard once played through or skipped; 7 deletes
+        uint8_t clear = (cut == '7') ? (VM_FLAG_NEW | VM_FLAG_LIVE) : VM_FLAG_NEW;
+        xSemaphoreTake(store_mutex, portMAX_DELAY);
+        if (vm_store_clear_flags(&store, list[i], clear) != 0) {
+            stat_inc(&vm_stats.write_errors);
+        }
+        refresh_unheard();
+        xSemaphoreGive(store_mutex);
+        if (cut == '7') {
+            ESP_LOGI(TAG, "Deleted message in slot %u", list[i]);
+        }
+    }
+
+    handset_end();
+}
+
+static void record_greeting(void)
+{
+    i2s_chan_handle_t rx = audio_output_get_rx_handle();
+    ima_adpcm_state_t codec;
+    int16_t pcm[VM_FRAME_SAMPLES];
+    uint8_t *block = blocks[0];
+    uint32_t fill = 0;
+    vm_writer_t w;
+
+    handset_begin(PHASE_GREETING_REC);
+    int cut = handset_beep(VOICEMAIL_BEEP_MS);
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    vm_store_begin(&store, VM_GREETING, &w);
+    xSemaphoreGive(store_mutex);
+    ima_adpcm_init(&codec);
+
+    bool ok = true;
+    while (cut == 0 && ok) {
+        size_t got = 0;
+        if (i2s_channel_read(rx, pcm, sizeof(pcm), &got, 40) == ESP_OK && got > 0) {
+            fill += ima_adpcm_encode(&codec, pcm, got / sizeof(int16_t), block + fill);
+        }
+        if (fill + VM_FRAME_BYTES > VOICEMAIL_BLOCK_BYTES) {
+            xSemaphoreTake(store_mutex, portMAX_DELAY);
+            ok = vm_store_write(&store, &w, block, fill) == (int)fill;
+            xSemaphoreGive(store_mutex);
+            fill = 0;
+        }
+        cut = poll_handset();
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    if (ok && fill > 0) {
+        vm_store_write(&store, &w, block, fill);
+    }
+    // Ended by a full slot, a hang-up or a digit; the last two leave clicks
+    if (cut != 0) {
+        uint32_t tail = VM_MS_TO_BYTES(VM_GREETING_TAIL_MS);
+        w.length = (w.length > tail) ? w.length - tail : 0;
+    }
+    int ret = -1;
+    if (w.length >= VM_MS_TO_BYTES(VOICEMAIL_MIN_MESSAGE_MS)) {
+        ret = vm_store_finish(&store, &w, (uint32_t)clock_now(), NULL);
+    }
+    xSemaphoreGive(store_mutex);
+
+    if (ret == 0) {
+        ESP_LOGI(TAG, "New greeting, %" PRIu32 " ms", VM_BYTES_TO_MS(w.length));
+        if (cut >= 0) {
+            handset_beep(VOICEMAIL_BEEP_MS);
+        }
+    } else {
+        ESP_LOGI(TAG, "Greeting too short, not saved");
+    }
+    handset_end();
+}
+
+static void voicemail_task(void *arg)
+{
+    for (;;) {
+        uint32_t cmds = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &cmds, portMAX_DELAY);
+
+        if ((cmds & VM_CMD_BLOCK) && !service_blocks()) {
+            ESP_LOGI(TAG, "Slot full, hanging up");
+            machine_end(true);
+        }
+        if (cmds & VM_CMD_END) {
+            machine_end(false);
+        }
+        if (cmds & VM_CMD_TIMER) {
+            if (phase == PHASE_IDLE) {
+                machine_answer();
+            } else if (VM_MACHINE_PHASE(phase)) {
+                ESP_LOGW(TAG, "Call still up after %d ms, hanging up", VOICEMAIL_CALL_GUARD_MS);
+                machine_end(true);
+            }
+        }
+        if (cmds & VM_CMD_PLAY) {
+            play_messages();
+        } else if (cmds & VM_CMD_GREETING) {
+            record_greeting();
+        }
+    }
+}
+
+static void vm_timer_cb(void *arg)
+{
+    xTaskNotify(vm_task_handle, VM_CMD_TIMER, eSetBits);
+}
+
+static void voicemail_event_handler(event_type_t event, void *user_data)
+{
+    vm_phase_t now = phase;
+
+    switch (event) {
+        case PHONE_EVENT_RINGING_START: {
+            settings_t cfg;
+            settings_get(&cfg);
+            if (mounted && now == PHASE_IDLE && cfg.voicemail.answer_rings > 0) {
+                // Pick up in the silence after the last ring
+                uint32_t ms = cfg.voicemail.answer_rings * (RING_ON_MS + RING_OFF_MS) - RING_OFF_MS / 2;
+                esp_timer_stop(vm_timer);
+                esp_timer_start_once(vm_timer, (uint64_t)ms * 1000);
+            }
+            break;
+        }
+
+        case PHONE_EVENT_RINGING_STOP:
+        case BT_EVENT_CALL_STARTED:
+            if (now == PHASE_IDLE) {
+                esp_timer_stop(vm_timer);
+            }
+            break;
+
+        case PHONE_EVENT_OFF_HOOK:
+        case BT_EVENT_CALL_ENDED:
+        case BT_EVENT_DISCONNECTED:
+            if (now == PHASE_IDLE) {
+                esp_timer_stop(vm_timer);
+            } else if (VM_MACHINE_PHASE(now)) {
+                xTaskNotify(vm_task_handle, VM_CMD_END, eSetBits);
+            }
+            break;
+
+        case PHONE_EVENT_ON_HOOK:
+            if (VM_HANDSET_PHASE(now)) {
+                handset_down = true;
+                xTaskNotify(vm_task_handle, VM_CMD_HANDSET, eSetBits);
+            }
+            break;
+
+        case PHONE_EVENT_DIGIT_DIALED:
+            // Controls, not a number: keep them from the dialer
+            if (VM_HANDSET_PHASE(now)) {
+                handset_digit = dialer_last_digit();
+                dialer_reset();
+                xTaskNotify(vm_task_handle, VM_CMD_HANDSET, eSetBits);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void mount_store(void)
+{
+    vm_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                       VOICEMAIL_PARTITION_LABEL);
+    if (vm_part == NULL) {
+        ESP_LOGW(TAG, "No \"%s\" partition, answering machine off", VOICEMAIL_PARTITION_LABEL);
+        return;
+    }
+
+    const vm_flash_t flash = {
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+        .ctx = (void *)vm_part,
+        .size = vm_part->size - vm_part->size % VM_SECTOR_SIZE,
+    };
+    if (vm_store_mount(&store, &flash, VOICEMAIL_GREETING_SECTORS * VM_SECTOR_SIZE,
+                       VOICEMAIL_SLOT_SECTORS * VM_SECTOR_SIZE) != 0) {
+        ESP_LOGE(TAG, "Failed to scan message store");
+        return;
+    }
+    mounted = true;
+    make_room();
+    refresh_unheard();
+
+    ESP_LOGI(TAG, "%u slot(s) of %" PRIu32 " s, %u message(s), %u unheard, greeting %s",
+             store.slot_count, VM_BYTES_TO_MS(store.slot_size - VM_HEADER_SIZE) / 1000,
+             (unsigned)vm_store_count(&store, 0), unheard,
+             vm_store_live(&store, VM_GREETING) ? "recorded" : "not recorded");
+}
+
+esp_err_t voicemail_init(void)
+{
+    ESP_LOGI(TAG, "Initializing voicemail");
+
+    store_mutex = xSemaphoreCreateMutex();
+    if (store_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    mount_store();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = vm_timer_cb,
+        .name = "voicemail",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &vm_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreate(voicemail_task, "voicemail", VOICEMAIL_TASK_STACK_SIZE, NULL,
+                    VOICEMAIL_TASK_PRIORITY, &vm_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        esp_timer_delete(vm_timer);
+        vm_timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ret = event_subscribe(VM_EVENTS, voicemail_event_handler, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe to events: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+bool voicemail_waiting(void)
+{
+    return unheard > 0;
+}
+
+bool voicemail_handset_code(const char *digits)
+{
+    uint32_t cmd = (strcmp(digits, VOICEMAIL_ACCESS_CODE) == 0) ? VM_CMD_PLAY :
+                   (strcmp(digits, VOICEMAIL_GREETING_CODE) == 0) ? VM_CMD_GREETING : 0;
+    if (cmd == 0) {
+        return false;
+    }
+
+    if (!mounted || phase != PHASE_IDLE) {
+        ESP_LOGW(TAG, "Voicemail code %s ignored, store not available", digits);
+        return true;
+    }
+    handset_down = false;
+    handset_digit = 0;
+    xTaskNotify(vm_task_handle, cmd, eSetBits);
+    return true;
+}
+
+size_t voicemail_list(voicemail_message_t *out, size_t max)
+{
+    uint8_t list[VM_MAX_SLOTS];
+
+    if (!mounted) {
+        return 0;
+    }
+
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    size_t n = vm_store_list(&store, list, (max < VM_MAX_SLOTS) ? max : VM_MAX_SLOTS);
+    for (size_t i = 0; i < n; i++) {
+        const vm_header_t *hdr = &store.slots[list[i]];
+        out[i].slot = list[i];
+        out[i].seq = hdr->seq;
+        out[i].start = hdr->start;
+        out[i].duration_ms = VM_BYTES_TO_MS(hdr->length);
+        out[i].heard = !(hdr->flags & VM_FLAG_NEW);
+        memcpy(out[i].number, hdr->number, sizeof(out[i].number));
+    }
+    xSemaphoreGive(store_mutex);
+    return n;
+}
+
+void voicemail_get_stats(voicemail_stats_t *out)
+{
+    portENTER_CRITICAL(&vm_stats_lock);
+    *out = vm_stats;
+    portEXIT_CRITICAL(&vm_stats_lock);
+
+    out->mounted = mounted;
+    if (!mounted) {
+        return;
+    }
+    xSemaphoreTake(store_mutex, portMAX_DELAY);
+    out->greeting = vm_store_live(&store, VM_GREETING);
+    out->slots = store.slot_count;
+    out->messages = (uint8_t)vm_store_count(&store, 0);
+    out->unheard = (uint8_t)vm_store_count(&store, VM_FLAG_NEW);
+    out->slot_ms = VM_BYTES_TO_MS(store.slot_size - VM_HEADER_SIZE);
+    xSemaphoreGive(store_mutex);
+}
@@ -0,0 +1,100 @@
+#ifndef __VOICEMAIL_H__
+#define __VOICEMAIL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "storage/vm_store.h"
+
+/**
+ * @file voicemail.h
+ * @brief Answering machine
+ *
+ * An incoming call still ringing after the configured number of rings is
+ * answered by the gateway itself. The caller hears the greeting and a beep
+ * and is then recorded until they hang up, the handset is lifted or the
+ * message slot is full. Audio is IMA ADPCM at 8 kHz, 4000 bytes a second.
+ *
+ * The codec runs inside the audio bridge tasks on each frame where it
+ * already lies (audio_bridge_tap_t); the greeting is decoded straight into
+ * the uplink frame and the caller is encoded straight out of the downlink
+ * ring buffer item. Encoded audio moves to and from flash through a
+ * two-block ping-pong buffer, and all flash work is done by a task of its
+ * own, so neither bridge task ever waits on an erase.
+ *
+ * Off-hook, VOICEMAIL_ACCESS_CODE plays the messages oldest first and
+ * VOICEMAIL_GREETING_CODE records a new greeting. Dial tone stutters while
+ * any message is unheard.
+ */
+
+/**
+ * @brief One stored message
+ */
+typedef struct {
+    uint8_t slot;
+    uint32_t seq;
+    uint32_t start;                 // Unix time, 0 if the clock was unset
+    uint32_t duration_ms;
+    bool heard;
+    char number[VM_NUMBER_LEN];
+} voicemail_message_t;
+
+/**
+ * @brief Answering machine statistics
+ */
+typedef struct {
+    bool mounted;                   // Partition found and scanned
+    bool greeting;                  // A greeting has been recorded
+    uint8_t slots;                  // Message slots
+    uint8_t messages;               // Messages kept
+    uint8_t unheard;                // Messages not yet played
+    uint32_t slot_ms;               // Longest message
+    uint32_t answered;              // Calls taken since boot
+    uint32_t recorded;              // Messages saved since boot
+    uint32_t overruns;              // Caller frames dropped, flash writes behind
+    uint32_t underruns;             // Greeting frames cut short, flash reads behind
+    uint32_t write_errors;          // Flash operations that failed
+} voicemail_stats_t;
+
+/**
+ * @brief Mount the message store, start the voicemail task and subscribe
+ *        to ringing, hook and call events
+ *
+ * Must be called after event_system_init(), settings_init() and
+ * audio_bridge_init(). A missing partition is logged and leaves the
+ * answering machine off; it is not an error.
+ *
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t voicemail_init(void);
+
+/**
+ * @brief Whether any message is unheard
+ *
+ * Cheap; called by call progress each time it starts dial tone.
+ */
+bool voicemail_waiting(void);
+
+/**
+ * @brief Start a handset session if the digits are a voicemail code
+ *
+ * Called by call control with the number about to be dialed.
+ *
+ * @return True if the digits were a voicemail code and must not be dialed
+ */
+bool voicemail_handset_code(const char *digits);
+
+/**
+ * @brief List stored messages, oldest first
+ *
+ * @return Number of messages written to out
+ */
+size_t voicemail_list(voicemail_message_t *out, size_t max);
+
+/**
+ * @brief Get answering machine statistics
+ */
+void voicemail_get_stats(voicemail_stats_t *out);
+
+#endif /* __VOICEMAIL_H__ */
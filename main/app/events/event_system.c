@@ -5,13 +5,15 @@
 
 #include <string.h>
 #include "event_system.h"
+#include "config/system_config.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 
 static const char *TAG = "EVENT_SYS";
 
-#define MAX_SUBSCRIBERS 10
+_Static_assert(EVENT_MAX_SUBSCRIBERS >= EVENT_SUBSCRIBERS_KNOWN,
+               "EVENT_MAX_SUBSCRIBERS is too small for the modules that subscribe");
 
 // Subscriber structure
 typedef struct {
@@ -22,7 +24,7 @@ typedef struct {
 } subscriber_t;
 
 // Global subscriber list
-static subscriber_t subscribers[MAX_SUBSCRIBERS];
+static subscriber_t subscribers[EVENT_MAX_SUBSCRIBERS];
 static SemaphoreHandle_t subscribers_mutex = NULL;
 
 esp_err_t event_system_init(void)
@@ -32,8 +34,9 @@ esp_err_t event_system_init(void)
     // Initialize subscriber list
     memset(subscribers, 0, sizeof(subscribers));
 
-    // Create mutex for thread-safe access
-    subscribers_mutex = xSemaphoreCreateMutex();
+    // Create mutex for thread-safe access. Recursive so that a subscriber
+    // callback may publish a follow-on event.
+    subscribers_mutex = xSemaphoreCreateRecursiveMutex();
     if (subscribers_mutex == NULL) {
         ESP_LOGE(TAG, "Failed to create mutex");
         return ESP_FAIL;
@@ -51,14 +54,14 @@ esp_err_t event_publish(event_type_t event, void* event_data)
     }
 
     // Take mutex to protect subscriber list
-    if (xSemaphoreTake(subscribers_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    if (xSemaphoreTakeRecursive(subscribers_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGW(TAG, "Failed to acquire mutex for event publish");
         return ESP_FAIL;
     }
 
     // Iterate through subscribers and call matching callbacks
     int callbacks_called = 0;
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
         if (subscribers[i].active && (subscribers[i].events & event)) {
             // This subscriber is interested in this event
             if (subscribers[i].callback != NULL) {
@@ -68,7 +71,7 @@ esp_err_t event_publish(event_type_t event, void* event_data)
         }
     }
 
-    xSemaphoreGive(subscribers_mutex);
+    xSemaphoreGiveRecursive(subscribers_mutex);
 
     if (callbacks_called > 0) {
         ESP_LOGD(TAG, "Event 0x%x published to %d subscribers", event, callbacks_called);
@@ -92,14 +95,14 @@ esp_err_t event_subscribe(event_type_t events,
     }
 
     // Take mutex to protect subscriber list
-    if (xSemaphoreTake(subscribers_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+    if (xSemaphoreTakeRecursive(subscribers_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
         ESP_LOGE(TAG, "Failed to acquire mutex for subscription");
         return ESP_FAIL;
     }
 
     // Find an empty slot
     esp_err_t ret = ESP_FAIL;
-    for (int i = 0; i < MAX_SUBSCRIBERS; i++) {
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
         if (!subscribers[i].active) {
             subscribers[i].events = events;
             subscribers[i].callback = callback;
@@ -111,10 +114,10 @@ esp_err_t event_subscribe(event_type_t events,
         }
     }
 
-    xSemaphoreGive(subscribers_mutex);
+    xSemaphoreGiveRecursive(subscribers_mutex);
 
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to register subscriber - max subscribers (%d) reached", MAX_SUBSCRIBERS);
+        ESP_LOGE(TAG, "Failed to register subscriber - max subscribers (%d) reached", EVENT_MAX_SUBSCRIBERS);
     }
 
     return ret;
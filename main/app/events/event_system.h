@@ -29,6 +29,32 @@ typedef enum {
     // System events
     SYS_EVENT_ERROR                = (1 << 14),
     SYS_EVENT_LOW_BATTERY          = (1 << 15),
+
+    // Call progress events (reported by the audio gateway)
+    BT_EVENT_CALL_DIALING          = (1 << 16),
+    BT_EVENT_CALL_ALERTING         = (1 << 17),
+    BT_EVENT_CALL_BUSY             = (1 << 18),
+    BT_EVENT_CALL_FAILED           = (1 << 19),
+
+    // Audio gateway status indicator changed (see bt_indicators.h)
+    BT_EVENT_INDICATOR_CHANGED     = (1 << 20),
+
+    // Hook flash and call waiting
+    PHONE_EVENT_HOOK_FLASH         = (1 << 21),
+    PHONE_EVENT_CALL_WAITING_START = (1 << 22),
+    PHONE_EVENT_CALL_WAITING_STOP  = (1 << 23),
+
+    // Recall dial tone after a flash during a call, and back to the call
+    PHONE_EVENT_RECALL_START       = (1 << 24),
+    PHONE_EVENT_RECALL_END         = (1 << 25),
+
+    // Handset listening to messages or recording a greeting, and back to dial tone
+    PHONE_EVENT_VOICEMAIL_START    = (1 << 26),
+    PHONE_EVENT_VOICEMAIL_END      = (1 << 27),
+
+    // Handset listening to the time of day, and back to dial tone
+    PHONE_EVENT_ANNOUNCE_START     = (1 << 28),
+    PHONE_EVENT_ANNOUNCE_END       = (1 << 29),
 } event_type_t;
 
 // Event callback function type
@@ -1,5 +1,6 @@
 #include "ma_bell_state.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
 #include <inttypes.h>
 
@@ -8,17 +9,103 @@ static const char *TAG = "ma_bell_state";
 // Global state instance
 static ma_bell_state_t g_state = {0};
 
-// List of tasks registered for notifications
-#define MAX_NOTIFIED_TASKS 8
+// Seqlock guarding g_state. Writers serialize on a short spinlock and bump the
+// sequence to odd before touching g_state and back to even afterwards. Readers
+// never take the lock; they copy the struct and retry if the sequence moved,
+// so a web request can never stall the audio or BT paths.
+static portMUX_TYPE g_state_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t g_state_seq = 0;
+
+// State-transition journal. Entries are appended inside the seqlock write
+// section (so writers are already serialized); each slot carries its own
+// sequence stamp so readers can detect a slot being overwritten under them.
 typedef struct {
-    TaskHandle_t task;
-    uint32_t notification_bits;
-} notified_task_t;
+    volatile uint32_t stamp;     // 2*seq+1 while being written, 2*seq+2 when stable
+    ma_bell_journal_entry_t entry;
+} journal_slot_t;
+
+static journal_slot_t g_journal[MA_BELL_JOURNAL_SIZE];
+static volatile uint32_t g_journal_head = 0;   // Next sequence number to write
+
+static const char *category_names[STATE_CATEGORY_COUNT] = {
+    "phone", "bluetooth", "network", "system"
+};
+
+static const char *cause_names[STATE_CAUSE_COUNT] = {
+    "none", "init", "hook", "dial", "hfp", "gap", "wifi", "tone", "timeout"
+};
+
+// Event groups mirroring each category for waiters. Bits 0-7 follow the state
+// bits, bits 8-15 follow their complement so a waiter can ask for a bit to be
+// clear as well as set.
+#define MIRROR_CLEAR_SHIFT 8
+
+static StaticEventGroup_t g_mirror_storage[STATE_CATEGORY_COUNT];
+static EventGroupHandle_t g_mirror[STATE_CATEGORY_COUNT] = {0};
+
+static inline void state_write_begin(void) {
+    taskENTER_CRITICAL(&g_state_lock);
+    g_state_seq++;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void state_write_end(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    g_state_seq++;
+    taskEXIT_CRITICAL(&g_state_lock);
+}
+
+// Append a transition to the journal. Must be called inside a write section.
+static void journal_append(ma_bell_state_category_t category, ma_bell_state_cause_t cause,
+                           uint8_t old_bits, uint8_t new_bits) {
+    uint32_t seq = g_journal_head;
+    journal_slot_t *slot = &g_journal[seq & (MA_BELL_JOURNAL_SIZE - 1)];
 
-static notified_task_t g_notified_tasks[MAX_NOTIFIED_TASKS] = {0};
-static int g_notified_task_count = 0;
+    slot->stamp = 2 * seq + 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    slot->entry.seq = seq;
+    slot->entry.category = category;
+    slot->entry.cause = cause;
+    slot->entry.old_bits = old_bits;
+    slot->entry.new_bits = new_bits;
+    slot->entry.timestamp_us = esp_timer_get_time();
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    slot->stamp = 2 * seq + 2;
+    __atomic_store_n(&g_journal_head, seq + 1, __ATOMIC_RELEASE);
+}
+
+static volatile uint8_t *category_field(ma_bell_state_category_t category) {
+    switch (category) {
+        case STATE_CATEGORY_PHONE:     return &g_state.phone.state;
+        case STATE_CATEGORY_BLUETOOTH: return &g_state.bluetooth.state;
+        case STATE_CATEGORY_NETWORK:   return &g_state.network.state;
+        case STATE_CATEGORY_SYSTEM:    return &g_state.system.state;
+        default:                       return NULL;
+    }
+}
+
+// Bring a category's event group in line with its state bits. Called after a
+// change, outside the write section. If another writer moved the bits while we
+// were publishing, go round again so the mirror always ends up matching.
+static void mirror_publish(ma_bell_state_category_t category) {
+    EventGroupHandle_t group = g_mirror[category];
+    volatile uint8_t *field = category_field(category);
+    uint8_t bits;
+
+    if (group == NULL) {
+        return;
+    }
+
+    do {
+        bits = *field;
+        uint8_t inverse = (uint8_t)~bits;
+        xEventGroupClearBits(group, inverse | ((EventBits_t)bits << MIRROR_CLEAR_SHIFT));
+        xEventGroupSetBits(group, bits | ((EventBits_t)inverse << MIRROR_CLEAR_SHIFT));
+    } while (bits != *field);
+}
 
 esp_err_t ma_bell_state_init(void) {
+    state_write_begin();
     memset(&g_state, 0, sizeof(g_state));
     
     // Initialize system state
@@ -29,6 +116,16 @@ esp_err_t ma_bell_state_init(void) {
     g_state.bluetooth.volume = 8;  // Default to middle volume
     g_state.network.rssi = 0;
     g_state.system.battery_level = 100;
+    journal_append(STATE_CATEGORY_SYSTEM, STATE_CAUSE_INIT, 0, g_state.system.state);
+    state_write_end();
+
+    // Create the waiter mirrors and seed them with the initial bits
+    for (int i = 0; i < STATE_CATEGORY_COUNT; i++) {
+        if (g_mirror[i] == NULL) {
+            g_mirror[i] = xEventGroupCreateStatic(&g_mirror_storage[i]);
+        }
+        mirror_publish((ma_bell_state_category_t)i);
+    }
     
     ESP_LOGI(TAG, "State management system initialized");
     return ESP_OK;
@@ -38,52 +135,123 @@ const ma_bell_state_t* ma_bell_state_get(void) {
     return &g_state;
 }
 
-// Helper function to notify tasks of state changes
-static void notify_state_change(uint32_t notification_bit) {
-    for (int i = 0; i < g_notified_task_count; i++) {
-        if (g_notified_tasks[i].notification_bits & notification_bit) {
-            xTaskNotify(g_notified_tasks[i].task, notification_bit, eSetBits);
+void ma_bell_state_snapshot(ma_bell_state_t *out) {
+    if (out == NULL) {
+        return;
+    }
+
+    for (;;) {
+        uint32_t start = __atomic_load_n(&g_state_seq, __ATOMIC_ACQUIRE);
+        if (start & 1) {
+            continue;  // Writer in progress on the other core
         }
+        memcpy(out, (const void *)&g_state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&g_state_seq, __ATOMIC_RELAXED) == start) {
+            return;
+        }
+    }
+}
+
+bool ma_bell_state_has_held_call(void) {
+    for (;;) {
+        uint32_t start = __atomic_load_n(&g_state_seq, __ATOMIC_ACQUIRE);
+        if (start & 1) {
+            continue;
+        }
+        bool held = false;
+        uint8_t count = g_state.calls.count;
+        for (uint8_t i = 0; i < count && i < MA_BELL_MAX_CALLS; i++) {
+            if (g_state.calls.list[i].status == CALL_STATUS_HELD) {
+                held = true;
+                break;
+            }
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&g_state_seq, __ATOMIC_RELAXED) == start) {
+            return held;
+        }
+    }
+}
+
+// Apply set/clear masks to one bitmask field inside a write section,
+// journaling the transition if anything changed
+static inline uint8_t apply_bits(ma_bell_state_category_t category, uint8_t *field,
+                                 uint8_t set_bits, uint8_t clear_bits,
+                                 ma_bell_state_cause_t cause) {
+    uint8_t old_state = *field;
+    *field = (old_state | set_bits) & ~clear_bits;
+    if (*field != old_state) {
+        journal_append(category, cause, old_state, *field);
     }
+    return old_state;
 }
 
-void ma_bell_state_update_phone_bits(uint8_t set_bits, uint8_t clear_bits) {
-    uint8_t old_state = g_state.phone.state;
-    g_state.phone.state = (g_state.phone.state | set_bits) & ~clear_bits;
+void ma_bell_state_update_phone_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause) {
+    state_write_begin();
+    uint8_t old_state = apply_bits(STATE_CATEGORY_PHONE, &g_state.phone.state, set_bits, clear_bits, cause);
+    uint8_t new_state = g_state.phone.state;
+    state_write_end();
     
-    if (old_state != g_state.phone.state) {
-        ESP_LOGI(TAG, "Phone state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, g_state.phone.state);
-        notify_state_change(NOTIFY_PHONE_STATE_CHANGED);
+    if (old_state != new_state) {
+        ESP_LOGI(TAG, "Phone state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, new_state);
+        mirror_publish(STATE_CATEGORY_PHONE);
     }
 }
 
-void ma_bell_state_update_bluetooth_bits(uint8_t set_bits, uint8_t clear_bits) {
-    uint8_t old_state = g_state.bluetooth.state;
-    g_state.bluetooth.state = (g_state.bluetooth.state | set_bits) & ~clear_bits;
+void ma_bell_state_update_bluetooth_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause) {
+    state_write_begin();
+    uint8_t old_state = apply_bits(STATE_CATEGORY_BLUETOOTH, &g_state.bluetooth.state, set_bits, clear_bits, cause);
+    uint8_t new_state = g_state.bluetooth.state;
+    state_write_end();
     
-    if (old_state != g_state.bluetooth.state) {
-        ESP_LOGI(TAG, "Bluetooth state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, g_state.bluetooth.state);
-        notify_state_change(NOTIFY_BT_STATE_CHANGED);
+    if (old_state != new_state) {
+        ESP_LOGI(TAG, "Bluetooth state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, new_state);
+        mirror_publish(STATE_CATEGORY_BLUETOOTH);
     }
 }
 
-void ma_bell_state_update_network_bits(uint8_t set_bits, uint8_t clear_bits) {
-    uint8_t old_state = g_state.network.state;
-    g_state.network.state = (g_state.network.state | set_bits) & ~clear_bits;
+void ma_bell_state_update_network_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause) {
+    state_write_begin();
+    uint8_t old_state = apply_bits(STATE_CATEGORY_NETWORK, &g_state.network.state, set_bits, clear_bits, cause);
+    uint8_t new_state = g_state.network.state;
+    state_write_end();
     
-    if (old_state != g_state.network.state) {
-        ESP_LOGI(TAG, "Network state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, g_state.network.state);
-        notify_state_change(NOTIFY_NETWORK_STATE_CHANGED);
+    if (old_state != new_state) {
+        ESP_LOGI(TAG, "Network state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, new_state);
+        mirror_publish(STATE_CATEGORY_NETWORK);
     }
 }
 
-void ma_bell_state_update_system_bits(uint8_t set_bits, uint8_t clear_bits) {
-    uint8_t old_state = g_state.system.state;
-    g_state.system.state = (g_state.system.state | set_bits) & ~clear_bits;
+void ma_bell_state_update_system_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause) {
+    state_write_begin();
+    uint8_t old_state = apply_bits(STATE_CATEGORY_SYSTEM, &g_state.system.state, set_bits, clear_bits, cause);
+    uint8_t new_state = g_state.system.state;
+    state_write_end();
     
-    if (old_state != g_state.system.state) {
-        ESP_LOGI(TAG, "System state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, g_state.system.state);
-        notify_state_change(NOTIFY_SYSTEM_STATE_CHANGED);
+    if (old_state != new_state) {
+        ESP_LOGI(TAG, "System state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_state, new_state);
+        mirror_publish(STATE_CATEGORY_SYSTEM);
+    }
+}
+
+void ma_bell_state_update_call_bits(uint8_t phone_set, uint8_t phone_clear,
+                                   uint8_t bt_set, uint8_t bt_clear,
+                                   ma_bell_state_cause_t cause) {
+    state_write_begin();
+    uint8_t old_phone = apply_bits(STATE_CATEGORY_PHONE, &g_state.phone.state, phone_set, phone_clear, cause);
+    uint8_t old_bt = apply_bits(STATE_CATEGORY_BLUETOOTH, &g_state.bluetooth.state, bt_set, bt_clear, cause);
+    uint8_t new_phone = g_state.phone.state;
+    uint8_t new_bt = g_state.bluetooth.state;
+    state_write_end();
+
+    if (old_phone != new_phone) {
+        ESP_LOGI(TAG, "Phone state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_phone, new_phone);
+        mirror_publish(STATE_CATEGORY_PHONE);
+    }
+    if (old_bt != new_bt) {
+        ESP_LOGI(TAG, "Bluetooth state changed: 0x%02" PRIx8 " -> 0x%02" PRIx8, old_bt, new_bt);
+        mirror_publish(STATE_CATEGORY_BLUETOOTH);
     }
 }
 
@@ -103,76 +271,174 @@ int ma_bell_state_system_bits_set(uint8_t bits) {
     return (g_state.system.state & bits) == bits;
 }
 
-esp_err_t ma_bell_state_register_for_notifications(uint32_t notification_bits) {
-    TaskHandle_t current_task = xTaskGetCurrentTaskHandle();
-    
-    // Check if task is already registered
-    for (int i = 0; i < g_notified_task_count; i++) {
-        if (g_notified_tasks[i].task == current_task) {
-            g_notified_tasks[i].notification_bits |= notification_bits;
+static TickType_t wait_ticks(uint32_t timeout_ms) {
+    return (timeout_ms == 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+}
+
+// Ticks left before the deadline, 0 once it has passed
+static TickType_t ticks_remaining(TickType_t start, TickType_t ticks) {
+    if (ticks == portMAX_DELAY) {
+        return portMAX_DELAY;
+    }
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    return (elapsed >= ticks) ? 0 : ticks - elapsed;
+}
+
+esp_err_t ma_bell_state_wait_bits(ma_bell_state_category_t category,
+                                  uint8_t set_bits, uint8_t clear_bits,
+                                  uint32_t timeout_ms) {
+    if (category >= STATE_CATEGORY_COUNT || g_mirror[category] == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    volatile uint8_t *field = category_field(category);
+    EventBits_t wait_mask = set_bits | ((EventBits_t)clear_bits << MIRROR_CLEAR_SHIFT);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = wait_ticks(timeout_ms);
+
+    for (;;) {
+        uint8_t bits = *field;
+        if ((bits & set_bits) == set_bits && (bits & clear_bits) == 0) {
             return ESP_OK;
         }
+
+        TickType_t remaining = ticks_remaining(start, ticks);
+        if (remaining == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        // The mirror can briefly disagree with a racing writer, so the real
+        // bits are re-checked after every wake-up
+        xEventGroupWaitBits(g_mirror[category], wait_mask, pdFALSE, pdTRUE, remaining);
     }
-    
-    // Add new task registration
-    if (g_notified_task_count >= MAX_NOTIFIED_TASKS) {
-        ESP_LOGE(TAG, "Too many tasks registered for notifications");
-        return ESP_ERR_NO_MEM;
-    }
-    
-    g_notified_tasks[g_notified_task_count].task = current_task;
-    g_notified_tasks[g_notified_task_count].notification_bits = notification_bits;
-    g_notified_task_count++;
-    
-    ESP_LOGI(TAG, "Task registered for notifications: 0x%08" PRIx32, notification_bits);
-    return ESP_OK;
 }
 
-uint32_t ma_bell_state_wait_for_notification(uint32_t notification_bits, uint32_t timeout_ms) {
-    uint32_t notification_value = 0;
-    BaseType_t result;
-    
-    if (timeout_ms == 0) {
-        result = xTaskNotifyWait(0, notification_bits, &notification_value, portMAX_DELAY);
-    } else {
-        result = xTaskNotifyWait(0, notification_bits, &notification_value, pdMS_TO_TICKS(timeout_ms));
-    }
-    
-    if (result != pdTRUE) {
-        return 0;  // Timeout
+uint8_t ma_bell_state_wait_for_change(ma_bell_state_category_t category,
+                                      uint8_t known_bits, uint32_t timeout_ms) {
+    if (category >= STATE_CATEGORY_COUNT || g_mirror[category] == NULL) {
+        return known_bits;
     }
 
-    return notification_value & notification_bits;
+    volatile uint8_t *field = category_field(category);
+    // Any clear bit becoming set, or any set bit becoming clear
+    EventBits_t wait_mask = (uint8_t)~known_bits |
+                            ((EventBits_t)known_bits << MIRROR_CLEAR_SHIFT);
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = wait_ticks(timeout_ms);
+
+    for (;;) {
+        uint8_t bits = *field;
+        if (bits != known_bits) {
+            return bits;
+        }
+
+        TickType_t remaining = ticks_remaining(start, ticks);
+        if (remaining == 0) {
+            return bits;
+        }
+
+        xEventGroupWaitBits(g_mirror[category], wait_mask, pdFALSE, pdFALSE, remaining);
+    }
 }
 
 void ma_bell_state_set_ip_address(const char* ip) {
     if (ip) {
+        state_write_begin();
         strncpy(g_state.network.ip_address, ip, sizeof(g_state.network.ip_address) - 1);
         g_state.network.ip_address[sizeof(g_state.network.ip_address) - 1] = '\0';
-        ESP_LOGI(TAG, "IP address set to: %s", g_state.network.ip_address);
+        state_write_end();
+        ESP_LOGI(TAG, "IP address set to: %s", ip);
     }
 }
 
 void ma_bell_state_set_wifi_info(int8_t rssi, uint8_t channel) {
+    state_write_begin();
     g_state.network.rssi = (uint8_t)(-rssi);  // Convert negative RSSI to positive for display
     g_state.network.channel = channel;
+    state_write_end();
     ESP_LOGI(TAG, "WiFi info: RSSI=%d, Channel=%d", rssi, channel);
 }
 
 void ma_bell_state_set_bt_device_name(const char* name) {
     if (name) {
+        state_write_begin();
         strncpy(g_state.bluetooth.device_name, name, sizeof(g_state.bluetooth.device_name) - 1);
         g_state.bluetooth.device_name[sizeof(g_state.bluetooth.device_name) - 1] = '\0';
-        ESP_LOGI(TAG, "BT device name set to: %s", g_state.bluetooth.device_name);
+        state_write_end();
+        ESP_LOGI(TAG, "BT device name set to: %s", name);
     }
 }
 
 void ma_bell_state_set_bt_metrics(uint8_t volume, uint8_t signal, uint8_t battery) {
+    state_write_begin();
     if (volume != 0xFF) g_state.bluetooth.volume = volume;
     if (signal != 0xFF) g_state.bluetooth.signal_strength = signal;
     if (battery != 0xFF) g_state.bluetooth.battery_level = battery;
-    ESP_LOGI(TAG, "BT metrics: vol=%d, sig=%d, bat=%d",
-             g_state.bluetooth.volume,
-             g_state.bluetooth.signal_strength,
-             g_state.bluetooth.battery_level);
-} 
\ No newline at end of file
+    volume = g_state.bluetooth.volume;
+    signal = g_state.bluetooth.signal_strength;
+    battery = g_state.bluetooth.battery_level;
+    state_write_end();
+    ESP_LOGI(TAG, "BT metrics: vol=%d, sig=%d, bat=%d", volume, signal, battery);
+}
+
+void ma_bell_state_set_bt_network_info(const char *operator_name, const char *subscriber) {
+    state_write_begin();
+    if (operator_name) {
+        strncpy(g_state.bluetooth.operator_name, operator_name,
+                sizeof(g_state.bluetooth.operator_name) - 1);
+        g_state.bluetooth.operator_name[sizeof(g_state.bluetooth.operator_name) - 1] = '\0';
+    }
+    if (subscriber) {
+        strncpy(g_state.bluetooth.subscriber, subscriber, sizeof(g_state.bluetooth.subscriber) - 1);
+        g_state.bluetooth.subscriber[sizeof(g_state.bluetooth.subscriber) - 1] = '\0';
+    }
+    state_write_end();
+}
+
+void ma_bell_state_set_calls(const ma_bell_call_t *calls, uint8_t count) {
+    if (count > MA_BELL_MAX_CALLS) {
+        count = MA_BELL_MAX_CALLS;
+    }
+    state_write_begin();
+    memcpy(g_state.calls.list, calls, count * sizeof(ma_bell_call_t));
+    memset(&g_state.calls.list[count], 0, (MA_BELL_MAX_CALLS - count) * sizeof(ma_bell_call_t));
+    g_state.calls.count = count;
+    g_state.calls.seq++;
+    state_write_end();
+}
+
+size_t ma_bell_state_journal_read(uint32_t from_seq, ma_bell_journal_entry_t *out,
+                                  size_t max_entries, uint32_t *next_seq) {
+    uint32_t head = __atomic_load_n(&g_journal_head, __ATOMIC_ACQUIRE);
+    uint32_t oldest = (head > MA_BELL_JOURNAL_SIZE) ? head - MA_BELL_JOURNAL_SIZE : 0;
+    uint32_t seq = (from_seq > oldest) ? from_seq : oldest;
+    size_t count = 0;
+
+    for (; seq < head && count < max_entries; seq++) {
+        const journal_slot_t *slot = &g_journal[seq & (MA_BELL_JOURNAL_SIZE - 1)];
+        uint32_t stable = 2 * seq + 2;
+
+        if (slot->stamp != stable) {
+            continue;  // Already overwritten by a newer transition
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        out[count] = slot->entry;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (slot->stamp == stable) {
+            count++;
+        }
+    }
+
+    if (next_seq) {
+        *next_seq = seq;
+    }
+    return count;
+}
+
+const char *ma_bell_state_category_name(ma_bell_state_category_t category) {
+    return (category < STATE_CATEGORY_COUNT) ? category_names[category] : "unknown";
+}
+
+const char *ma_bell_state_cause_name(ma_bell_state_cause_t cause) {
+    return (cause < STATE_CAUSE_COUNT) ? cause_names[cause] : "unknown";
+}
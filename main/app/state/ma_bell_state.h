@@ -6,17 +6,24 @@
  * @brief Centralized state management system for the Ma Bell Gateway
  * 
  * This module provides a centralized way to track and manage the system's state
- * using bitmasks for efficient state representation and FreeRTOS task notifications
+ * using bitmasks for efficient state representation and FreeRTOS event groups
  * for state change awareness.
+ *
+ * All writes go through a seqlock: writers serialize on a short spinlock and
+ * never wait for readers, readers take consistent copies with
+ * ma_bell_state_snapshot() and simply retry if a write raced with them.
  * 
  * For detailed implementation information and thread safety considerations,
  * see the documentation in docs/source/implementation/state_management.rst
  */
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 
 // Phone state bitmasks
 #define PHONE_STATE_OFF_HOOK     (1 << 0)
@@ -59,11 +66,74 @@
 // Invalid digit marker
 #define INVALID_DIGIT 0xFF
 
-// Notification bits for state changes
-#define NOTIFY_PHONE_STATE_CHANGED    (1 << 0)
-#define NOTIFY_BT_STATE_CHANGED       (1 << 1)
-#define NOTIFY_NETWORK_STATE_CHANGED  (1 << 2)
-#define NOTIFY_SYSTEM_STATE_CHANGED   (1 << 3)
+// Size of the state-transition journal (must be a power of two)
+#define MA_BELL_JOURNAL_SIZE 64
+
+// Calls tracked at once (active, held, waiting and one being set up)
+#define MA_BELL_MAX_CALLS 4
+
+/**
+ * @brief Call status, same values as the +CLCC <stat> field
+ */
+typedef enum {
+    CALL_STATUS_ACTIVE = 0,
+    CALL_STATUS_HELD,
+    CALL_STATUS_DIALING,
+    CALL_STATUS_ALERTING,
+    CALL_STATUS_INCOMING,
+    CALL_STATUS_WAITING,
+    CALL_STATUS_RESPONSE_HOLD,
+} ma_bell_call_status_t;
+
+/**
+ * @brief One call on the audio gateway
+ */
+typedef struct {
+    uint8_t idx;                 // +CLCC index, 0 until the phone has listed the call
+    uint8_t incoming;            // 1 if mobile-terminated
+    uint8_t status;              // ma_bell_call_status_t
+    uint8_t mpty;                // 1 if part of a conference
+    char number[33];             // Remote number, empty if unknown or withheld
+} ma_bell_call_t;
+
+/**
+ * @brief State categories, as recorded in the transition journal
+ */
+typedef enum {
+    STATE_CATEGORY_PHONE = 0,
+    STATE_CATEGORY_BLUETOOTH,
+    STATE_CATEGORY_NETWORK,
+    STATE_CATEGORY_SYSTEM,
+    STATE_CATEGORY_COUNT
+} ma_bell_state_category_t;
+
+/**
+ * @brief What triggered a state transition
+ */
+typedef enum {
+    STATE_CAUSE_NONE = 0,
+    STATE_CAUSE_INIT,            // Boot / subsystem initialization
+    STATE_CAUSE_HOOK,            // SLIC hook switch
+    STATE_CAUSE_DIAL,            // Digit collection
+    STATE_CAUSE_HFP,             // HFP client event from the phone
+    STATE_CAUSE_GAP,             // Bluetooth GAP / connection manager
+    STATE_CAUSE_WIFI,            // WiFi / IP event
+    STATE_CAUSE_TONE,            // Call progress tone selection
+    STATE_CAUSE_TIMEOUT,         // Timer expiry
+    STATE_CAUSE_COUNT
+} ma_bell_state_cause_t;
+
+/**
+ * @brief One recorded state transition
+ */
+typedef struct {
+    uint32_t seq;                // Journal sequence number (monotonic)
+    uint8_t category;            // ma_bell_state_category_t
+    uint8_t cause;               // ma_bell_state_cause_t
+    uint8_t old_bits;            // Bitmask before the transition
+    uint8_t new_bits;            // Bitmask after the transition
+    int64_t timestamp_us;        // esp_timer time of the transition
+} ma_bell_journal_entry_t;
 
 /**
  * @brief Structure containing the current state of the Ma Bell system
@@ -82,6 +152,8 @@ typedef struct {
         uint8_t signal_strength; // Signal strength (0-5)
         uint8_t battery_level;   // Battery level (0-5)
         char device_name[32];    // Name of connected device
+        char operator_name[17];  // Network operator (AT+COPS), empty if unknown
+        char subscriber[33];     // Phone's own number (AT+CNUM), empty if unknown
     } bluetooth;
 
     struct {
@@ -98,6 +170,12 @@ typedef struct {
         uint8_t battery_level;   // System battery level (0-100)
         uint8_t temperature;     // System temperature
     } system;
+
+    struct {
+        uint8_t count;           // Entries of list in use
+        uint32_t seq;            // Bumped on every change to the list
+        ma_bell_call_t list[MA_BELL_MAX_CALLS];
+    } calls;
 } ma_bell_state_t;
 
 /**
@@ -109,42 +187,77 @@ esp_err_t ma_bell_state_init(void);
 
 /**
  * @brief Get the current state of the system
- * 
+ *
+ * The returned structure is live and may be mid-update. Use it only for
+ * single-field reads; use ma_bell_state_snapshot() when several fields
+ * (or any string) must be consistent with each other.
+ *
  * @return Pointer to the current state structure
  */
 const ma_bell_state_t* ma_bell_state_get(void);
 
+/**
+ * @brief Take a consistent copy of the whole state structure
+ *
+ * Lock-free for the caller: the copy is retried if a writer updated the
+ * state while it was being taken, so writers are never blocked by readers.
+ * Safe to call from any task.
+ *
+ * @param out Destination for the snapshot
+ */
+void ma_bell_state_snapshot(ma_bell_state_t *out);
+
 /**
  * @brief Update phone state bits and notify waiting tasks
  * 
  * @param set_bits Bits to set
  * @param clear_bits Bits to clear
+ * @param cause What triggered the change (recorded in the journal)
  */
-void ma_bell_state_update_phone_bits(uint8_t set_bits, uint8_t clear_bits);
+void ma_bell_state_update_phone_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause);
 
 /**
  * @brief Update bluetooth state bits and notify waiting tasks
  * 
  * @param set_bits Bits to set
  * @param clear_bits Bits to clear
+ * @param cause What triggered the change (recorded in the journal)
  */
-void ma_bell_state_update_bluetooth_bits(uint8_t set_bits, uint8_t clear_bits);
+void ma_bell_state_update_bluetooth_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause);
 
 /**
  * @brief Update network state bits and notify waiting tasks
  * 
  * @param set_bits Bits to set
  * @param clear_bits Bits to clear
+ * @param cause What triggered the change (recorded in the journal)
  */
-void ma_bell_state_update_network_bits(uint8_t set_bits, uint8_t clear_bits);
+void ma_bell_state_update_network_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause);
 
 /**
  * @brief Update system state bits and notify waiting tasks
  * 
  * @param set_bits Bits to set
  * @param clear_bits Bits to clear
+ * @param cause What triggered the change (recorded in the journal)
  */
-void ma_bell_state_update_system_bits(uint8_t set_bits, uint8_t clear_bits);
+void ma_bell_state_update_system_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause);
+
+/**
+ * @brief Atomically update phone and bluetooth state bits together
+ *
+ * Both masks are applied inside a single write section, so a snapshot can
+ * never observe one half of a call transition without the other.
+ *
+ * @param phone_set Phone bits to set
+ * @param phone_clear Phone bits to clear
+ * @param bt_set Bluetooth bits to set
+ * @param bt_clear Bluetooth bits to clear
+ * @param cause What triggered the change (recorded in the journal)
+ */
+void ma_bell_state_update_call_bits(uint8_t phone_set, uint8_t phone_clear,
+                                   uint8_t bt_set, uint8_t bt_clear,
+                                   ma_bell_state_cause_t cause);
 
 /**
  * @brief Set network IP address
@@ -177,6 +290,22 @@ void ma_bell_state_set_bt_device_name(const char* name);
  */
 void ma_bell_state_set_bt_metrics(uint8_t volume, uint8_t signal, uint8_t battery);
 
+/**
+ * @brief Set the phone's network operator and subscriber number
+ *
+ * @param operator_name Operator name (NULL to skip, "" to clear)
+ * @param subscriber Subscriber number (NULL to skip, "" to clear)
+ */
+void ma_bell_state_set_bt_network_info(const char *operator_name, const char *subscriber);
+
+/**
+ * @brief Replace the call list
+ *
+ * @param calls Calls, in display order
+ * @param count Number of calls, at most MA_BELL_MAX_CALLS
+ */
+void ma_bell_state_set_calls(const ma_bell_call_t *calls, uint8_t count);
+
 /**
  * @brief Check if specific phone state bits are set
  *
@@ -185,6 +314,13 @@ void ma_bell_state_set_bt_metrics(uint8_t volume, uint8_t signal, uint8_t batter
  */
 int ma_bell_state_phone_bits_set(uint8_t bits);
 
+/**
+ * @brief Check whether any call in the call list is on hold
+ *
+ * @return true if a call has status CALL_STATUS_HELD
+ */
+bool ma_bell_state_has_held_call(void);
+
 /**
  * @brief Check if specific bluetooth state bits are set
  * 
@@ -210,21 +346,63 @@ int ma_bell_state_network_bits_set(uint8_t bits);
 int ma_bell_state_system_bits_set(uint8_t bits);
 
 /**
- * @brief Register current task to receive state change notifications
- * 
- * @param notification_bits Bitmask of notifications to receive
- * @return ESP_OK on success, ESP_FAIL on failure
+ * @brief Wait until a category's bits reach the requested values
+ *
+ * Blocks until every bit in set_bits is set and every bit in clear_bits is
+ * clear, e.g. ma_bell_state_wait_bits(STATE_CATEGORY_BLUETOOTH,
+ * BT_STATE_AUDIO_CONNECTED, 0, 5000). Backed by one event group per category
+ * that mirrors the bits and their complements, so any number of tasks can
+ * wait and a condition that already holds returns immediately.
+ * Must not be called from an ISR.
+ *
+ * @param category State category to watch
+ * @param set_bits Bits that must be set
+ * @param clear_bits Bits that must be clear
+ * @param timeout_ms Timeout in milliseconds (0 for no timeout)
+ * @return ESP_OK when the condition holds, ESP_ERR_TIMEOUT on timeout
  */
-esp_err_t ma_bell_state_register_for_notifications(uint32_t notification_bits);
+esp_err_t ma_bell_state_wait_bits(ma_bell_state_category_t category,
+                                  uint8_t set_bits, uint8_t clear_bits,
+                                  uint32_t timeout_ms);
 
 /**
- * @brief Wait for state change notification
+ * @brief Wait until a category's bits differ from a known value
+ *
+ * Intended for loops that read the bits, act on them and then wait for the
+ * next change relative to what they acted on, so nothing in between is lost.
  *
- * @param notification_bits Bitmask of notifications to wait for
+ * @param category State category to watch
+ * @param known_bits Bitmask the caller last observed
  * @param timeout_ms Timeout in milliseconds (0 for no timeout)
- * @return Bitmask of received notifications, 0 on timeout
+ * @return Current bitmask (equal to known_bits on timeout)
+ */
+uint8_t ma_bell_state_wait_for_change(ma_bell_state_category_t category,
+                                      uint8_t known_bits, uint32_t timeout_ms);
+
+/**
+ * @brief Read entries from the state-transition journal
+ *
+ * Copies entries with sequence number >= from_seq, oldest first. Entries that
+ * have already been overwritten are skipped. Never blocks writers.
+ *
+ * @param from_seq First sequence number of interest (0 for oldest available)
+ * @param out Destination array
+ * @param max_entries Capacity of out
+ * @param next_seq Set to the sequence number to pass on the next call (optional)
+ * @return Number of entries copied
+ */
+size_t ma_bell_state_journal_read(uint32_t from_seq, ma_bell_journal_entry_t *out,
+                                  size_t max_entries, uint32_t *next_seq);
+
+/**
+ * @brief Get a short name for a state category
+ */
+const char *ma_bell_state_category_name(ma_bell_state_category_t category);
+
+/**
+ * @brief Get a short name for a transition cause
  */
-uint32_t ma_bell_state_wait_for_notification(uint32_t notification_bits, uint32_t timeout_ms);
+const char *ma_bell_state_cause_name(ma_bell_state_cause_t cause);
 
 /**
  * @brief Check if WiFi initialization is complete
@@ -1,12 +1,29 @@
 #include "web_interface.h"
 #include "app/state/ma_bell_state.h"
+#include "app/call/call_progress.h"
+#include "app/call/call_control.h"
+#include "app/call/cdr.h"
+#include "app/call/voicemail.h"
+#include "app/call/phonebook.h"
+#include "bluetooth/bt_app_core.h"
+#include "bluetooth/bt_connection_manager.h"
+#include "bluetooth/bt_hf_warmup.h"
+#include "bluetooth/bt_calls.h"
+#include "bluetooth/bt_indicators.h"
+#include "bluetooth/bt_link_quality.h"
+#include "audio/audio_output.h"
+#include "audio/audio_bridge.h"
 #include "config/web_config.h"
 #include "network/wifi/wifi.h"
+#include "storage/storage.h"
+#include "storage/settings.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <esp_log.h>
 #include <string.h>
+#include <stdlib.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <esp_http_server.h>
 
 static const char *TAG = "WEB_IF";
@@ -19,9 +36,6 @@ static httpd_handle_t server = NULL;
 static bool server_running = false;
 static SemaphoreHandle_t server_mutex = NULL;
 
-// Cache WiFi SSID to avoid NVS contention during status requests
-static char cached_wifi_ssid[33] = "Not configured";
-
 // HTML content for the main page
 // JSON API documentation (simple endpoint list)
 static const char *api_docs =
@@ -39,6 +53,61 @@ static const char *api_docs =
     "      \"description\": \"System status (phone, bluetooth, wifi, system)\""
     "    },"
     "    {"
+    "      \"path\": \"/state/history\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"State-transition journal (optional ?since=<seq>)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/call/transitions\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Call-control state and per-transition dispatch latency\""
+    "    },"
+    "    {"
+    "      \"path\": \"/bt/dispatch\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"BT app task dispatch statistics (lanes, drops, parameter slabs, stack headroom)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/bt/reconnect\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Reconnect engine state and time-to-reconnect statistics\""
+    "    },"
+    "    {"
+    "      \"path\": \"/calls\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Current calls by index (direction, status, conference, number)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/cdr\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Call detail records, oldest first (optional ?since=<seq>)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/voicemail\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Answering machine status and stored messages, oldest first\""
+    "    },"
+    "    {"
+    "      \"path\": \"/phonebook\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Phonebook as CSV (code,number,name)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/phonebook\","
+    "      \"method\": \"POST\","
+    "      \"description\": \"Replace the phonebook with a CSV body (code,number,name)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/bt/indicators\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"Phone status indicators with min/max/histogram (optional ?since=<seq> for changes only)\""
+    "    },"
+    "    {"
+    "      \"path\": \"/bt/link_quality\","
+    "      \"method\": \"GET\","
+    "      \"description\": \"SCO packet statistics and bridge glitches, current and previous audio link\""
+    "    },"
+    "    {"
     "      \"path\": \"/tasks\","
     "      \"method\": \"GET\","
     "      \"description\": \"FreeRTOS task information\""
@@ -67,6 +136,25 @@ static esp_err_t http_error_handler(httpd_req_t *req, httpd_err_code_t err) {
     return ESP_OK;
 }
 
+// Append to a response buffer; false (offset unchanged) if it does not fit
+static bool __attribute__((format(printf, 4, 5)))
+json_append(char *buf, size_t size, size_t *offset, const char *fmt, ...)
+{
+    if (*offset >= size) {
+        return false;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + *offset, size - *offset, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - *offset) {
+        buf[*offset] = '\0';
+        return false;
+    }
+    *offset += n;
+    return true;
+}
+
 // Handler for the API endpoint list
 static esp_err_t html_handler(httpd_req_t *req) {
     ESP_LOGI(TAG, "Received request for API endpoint list");
@@ -107,9 +195,13 @@ static esp_err_t status_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
-    const ma_bell_state_t* state = ma_bell_state_get();
+    // Consistent copy - never blocks the tasks that update state
+    ma_bell_state_t state;
+    ma_bell_state_snapshot(&state);
 
-    // Use cached SSID (read once during init to avoid NVS contention)
+    // SSID from the settings record in RAM
+    char ssid[MAX_SSID_LEN + 1];
+    settings_get_ssid(ssid, sizeof(ssid));
 
     // Calculate uptime
     uint32_t uptime_sec = esp_log_timestamp() / 1000;
@@ -117,10 +209,42 @@ static esp_err_t status_handler(httpd_req_t *req) {
     uint32_t uptime_mins = (uptime_sec % 3600) / 60;
     uint32_t uptime_secs = uptime_sec % 60;
 
+    // Event-to-tone latency from the tone generator
+    audio_tone_latency_t latency;
+    audio_output_get_tone_latency(&latency);
+    uint32_t latency_avg_us = latency.count ? (uint32_t)(latency.total_us / latency.count) : 0;
+
+    // Answer/connect to first downlink audio, with and without SCO already up
+    audio_cut_through_t cut[AUDIO_CUT_THROUGH_KINDS];
+    audio_bridge_get_cut_through(cut);
+    const audio_cut_through_t *cold = &cut[AUDIO_CUT_THROUGH_COLD];
+    const audio_cut_through_t *warm = &cut[AUDIO_CUT_THROUGH_WARM];
+
+    // Connect to operator/subscriber/call list cached
+    bt_hf_warmup_stats_t warmup;
+    bt_hf_warmup_get_stats(&warmup);
+
+    // NVS traffic behind the write-behind cache
+    storage_stats_t nvs;
+    storage_get_stats(&nvs);
+    // Both buffers are too big for the httpd task stack; handlers all run on
+    // the single httpd task, and this one under server_mutex, so static is safe
+    static char nvs_failed[STORAGE_STATS_FAILED_KEYS * 128];
+    size_t nvs_failed_len = 0;
+    nvs_failed[0] = '\0';
+    for (uint32_t i = 0; i < nvs.failing && i < STORAGE_STATS_FAILED_KEYS; i++) {
+        if (!json_append(nvs_failed, sizeof(nvs_failed), &nvs_failed_len,
+                         "%s{\"key\": \"%s/%s\", \"attempts\": %" PRIu32 ", \"error\": \"%s\"}",
+                         i ? ", " : "", nvs.failed[i].namespace, nvs.failed[i].key,
+                         nvs.failed[i].attempts, esp_err_to_name(nvs.failed[i].last_error))) {
+            break;
+        }
+    }
+
     // Streamlined buffer for essential status fields
-    char response[800];
+    static char response[2560 + sizeof(nvs_failed)];
 
-    snprintf(response, sizeof(response),
+    int len = snprintf(response, sizeof(response),
              "{"
              "  \"phone\": {"
              "    \"status\": {"
@@ -135,7 +259,13 @@ static esp_err_t status_handler(httpd_req_t *req) {
              "      \"busy_tone\": %s,"
              "      \"ringback\": %s,"
              "      \"reorder\": %s,"
-             "      \"call_waiting\": %s"
+             "      \"call_waiting\": %s,"
+             "      \"progress\": \"%s\","
+             "      \"latency_us\": {\"last\": %" PRIu32 ", \"max\": %" PRIu32 ", \"avg\": %" PRIu32 "}"
+             "    },"
+             "    \"cut_through_us\": {"
+             "      \"cold\": {\"count\": %" PRIu32 ", \"last\": %" PRIu32 ", \"max\": %" PRIu32 ", \"avg\": %" PRIu32 "},"
+             "      \"warm\": {\"count\": %" PRIu32 ", \"last\": %" PRIu32 ", \"max\": %" PRIu32 ", \"avg\": %" PRIu32 "}"
              "    }"
              "  },"
              "  \"bluetooth\": {"
@@ -144,7 +274,12 @@ static esp_err_t status_handler(httpd_req_t *req) {
              "    \"in_call\": %s,"
              "    \"volume\": %d,"
              "    \"phone_battery\": %d,"
-             "    \"phone_signal\": %d"
+             "    \"phone_signal\": %d,"
+             "    \"operator\": \"%s\","
+             "    \"subscriber\": \"%s\","
+             "    \"ready\": %s,"
+             "    \"ready_ms\": {\"last\": %" PRIu32 ", \"max\": %" PRIu32 ", \"avg\": %" PRIu32 "},"
+             "    \"warmup_timeouts\": %" PRIu32
              "  },"
              "  \"wifi\": {"
              "    \"connected\": %s,"
@@ -156,47 +291,74 @@ static esp_err_t status_handler(httpd_req_t *req) {
              "  \"system\": {"
              "    \"uptime\": \"%" PRIu32 "h %" PRIu32 "m %" PRIu32 "s\","
              "    \"error\": %s,"
-             "    \"error_code\": %d"
+             "    \"error_code\": %d,"
+             "    \"storage\": {\"reads\": %" PRIu32 ", \"writes\": %" PRIu32 ", \"erases\": %" PRIu32 ", "
+             "\"commits\": %" PRIu32 ", \"opens\": %" PRIu32 ", \"cache_hits\": %" PRIu32 ", "
+             "\"coalesced\": %" PRIu32 ", \"unchanged\": %" PRIu32 ", \"pending\": %" PRIu32 ", "
+             "\"flush_errors\": %" PRIu32 ", \"failing\": %" PRIu32 ", \"failed\": [%s]}"
              "  }"
              "}",
              // Phone status
-             ma_bell_state_phone_bits_set(PHONE_STATE_OFF_HOOK) ? "Off-hook" : "On-hook",
-             ma_bell_state_phone_bits_set(PHONE_STATE_RINGING) ? "true" : "false",
-             state->phone.ring_count,
-             ma_bell_state_phone_bits_set(PHONE_STATE_DIALING) ? "true" : "false",
-             state->phone.last_digit == INVALID_DIGIT ? "None" : (char[]){state->phone.last_digit + '0', '\0'},
+             (state.phone.state & PHONE_STATE_OFF_HOOK) ? "Off-hook" : "On-hook",
+             (state.phone.state & PHONE_STATE_RINGING) ? "true" : "false",
+             state.phone.ring_count,
+             (state.phone.state & PHONE_STATE_DIALING) ? "true" : "false",
+             state.phone.last_digit == INVALID_DIGIT ? "None" : (char[]){state.phone.last_digit + '0', '\0'},
              // Phone tones
-             ma_bell_state_phone_bits_set(PHONE_STATE_DIAL_TONE) ? "true" : "false",
-             ma_bell_state_phone_bits_set(PHONE_STATE_BUSY_TONE) ? "true" : "false",
-             ma_bell_state_phone_bits_set(PHONE_STATE_RINGBACK) ? "true" : "false",
-             ma_bell_state_phone_bits_set(PHONE_STATE_REORDER_TONE) ? "true" : "false",
-             ma_bell_state_phone_bits_set(PHONE_STATE_CALL_WAITING) ? "true" : "false",
+             (state.phone.state & PHONE_STATE_DIAL_TONE) ? "true" : "false",
+             (state.phone.state & PHONE_STATE_BUSY_TONE) ? "true" : "false",
+             (state.phone.state & PHONE_STATE_RINGBACK) ? "true" : "false",
+             (state.phone.state & PHONE_STATE_REORDER_TONE) ? "true" : "false",
+             (state.phone.state & PHONE_STATE_CALL_WAITING) ? "true" : "false",
+             call_progress_stage_name(),
+             latency.last_us, latency.max_us, latency_avg_us,
+             // Voice cut-through
+             cold->count, cold->last_us, cold->max_us,
+             cold->count ? (uint32_t)(cold->total_us / cold->count) : 0,
+             warm->count, warm->last_us, warm->max_us,
+             warm->count ? (uint32_t)(warm->total_us / warm->count) : 0,
              // Bluetooth
-             ma_bell_state_bluetooth_bits_set(BT_STATE_CONNECTED) ? "true" : "false",
-             state->bluetooth.device_name[0] ? state->bluetooth.device_name : "None",
-             ma_bell_state_bluetooth_bits_set(BT_STATE_IN_CALL) ? "true" : "false",
-             state->bluetooth.volume,
-             state->bluetooth.battery_level * 20,  // Convert 0-5 to 0-100%
-             state->bluetooth.signal_strength,
+             (state.bluetooth.state & BT_STATE_CONNECTED) ? "true" : "false",
+             state.bluetooth.device_name[0] ? state.bluetooth.device_name : "None",
+             (state.bluetooth.state & BT_STATE_IN_CALL) ? "true" : "false",
+             state.bluetooth.volume,
+             state.bluetooth.battery_level * 20,  // Convert 0-5 to 0-100%
+             state.bluetooth.signal_strength,
+             state.bluetooth.operator_name,
+             state.bluetooth.subscriber,
+             warmup.ready ? "true" : "false",
+             warmup.last_ready_ms, warmup.max_ready_ms,
+             warmup.warmups ? (uint32_t)(warmup.total_ready_ms / warmup.warmups) : 0,
+             warmup.timeouts,
              // WiFi
-             ma_bell_state_network_bits_set(NET_STATE_WIFI_CONNECTED) ? "true" : "false",
-             cached_wifi_ssid,
-             state->network.ip_address[0] ? state->network.ip_address : "0.0.0.0",
-             state->network.rssi,
-             state->network.channel,
+             (state.network.state & NET_STATE_WIFI_CONNECTED) ? "true" : "false",
+             ssid[0] ? ssid : "Not configured",
+             state.network.ip_address[0] ? state.network.ip_address : "0.0.0.0",
+             state.network.rssi,
+             state.network.channel,
              // System
              uptime_hours, uptime_mins, uptime_secs,
-             ma_bell_state_system_bits_set(SYS_STATE_ERROR) ? "true" : "false",
-             state->system.error_code);
+             (state.system.state & SYS_STATE_ERROR) ? "true" : "false",
+             state.system.error_code,
+             nvs.nvs_reads, nvs.nvs_writes, nvs.nvs_erases, nvs.nvs_commits, nvs.nvs_opens,
+             nvs.cache_hits, nvs.coalesced, nvs.unchanged, nvs.pending, nvs.flush_errors,
+             nvs.failing, nvs_failed);
 
-    xSemaphoreGive(server_mutex);
+    if (len < 0 || (size_t)len >= sizeof(response)) {
+        xSemaphoreGive(server_mutex);
+        ESP_LOGE(TAG, "Status response does not fit %u bytes", (unsigned)sizeof(response));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+        return ESP_FAIL;
+    }
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
     httpd_resp_set_hdr(req, "Pragma", "no-cache");
     httpd_resp_set_hdr(req, "Expires", "0");
 
-    esp_err_t ret = httpd_resp_send(req, response, strlen(response));
+    // Sent before the mutex is given back; response is shared
+    esp_err_t ret = httpd_resp_send(req, response, len);
+    xSemaphoreGive(server_mutex);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to send status response");
     } else {
@@ -205,6 +367,622 @@ static esp_err_t status_handler(httpd_req_t *req) {
     return ret;
 }
 
+// Handler for the state-transition journal endpoint
+// Streams entries in chunks so the whole journal never sits in one buffer.
+static esp_err_t state_history_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    // Optional ?since=<seq> to fetch only entries newer than a previous poll
+    uint32_t since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    ma_bell_journal_entry_t entries[8];
+    char line[160];
+    uint32_t next = since;
+    bool first = true;
+    size_t count;
+
+    esp_err_t ret = httpd_resp_sendstr_chunk(req, "{\"entries\": [");
+    while (ret == ESP_OK &&
+           (count = ma_bell_state_journal_read(next, entries, 8, &next)) > 0) {
+        for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+            snprintf(line, sizeof(line),
+                     "%s{\"seq\":%" PRIu32 ",\"t_us\":%lld,\"category\":\"%s\","
+                     "\"old\":%u,\"new\":%u,\"cause\":\"%s\"}",
+                     first ? "" : ",",
+                     entries[i].seq,
+                     (long long)entries[i].timestamp_us,
+                     ma_bell_state_category_name(entries[i].category),
+                     entries[i].old_bits,
+                     entries[i].new_bits,
+                     ma_bell_state_cause_name(entries[i].cause));
+            ret = httpd_resp_sendstr_chunk(req, line);
+            first = false;
+        }
+    }
+
+    if (ret == ESP_OK) {
+        snprintf(line, sizeof(line), "], \"next\": %" PRIu32 "}", next);
+        ret = httpd_resp_sendstr_chunk(req, line);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send state history response");
+    }
+    return ret;
+}
+
+// Handler for the call-control transition statistics endpoint
+// Lists only the table cells that have been taken at least once.
+static esp_err_t call_transitions_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    char line[192];
+    bool first = true;
+
+    snprintf(line, sizeof(line), "{\"state\": \"%s\", \"transitions\": [",
+             call_control_state_name(call_control_get_state()));
+    esp_err_t ret = httpd_resp_sendstr_chunk(req, line);
+
+    for (int st = 0; st < CC_STATE_COUNT && ret == ESP_OK; st++) {
+        for (int ev = 0; ev < CC_EVENT_COUNT && ret == ESP_OK; ev++) {
+            cc_transition_stats_t stats;
+            call_control_get_stats((cc_state_t)st, (cc_event_t)ev, &stats);
+            if (stats.count == 0) {
+                continue;
+            }
+            snprintf(line, sizeof(line),
+                     "%s{\"from\":\"%s\",\"event\":\"%s\",\"count\":%" PRIu32 ","
+                     "\"avg_us\":%" PRIu32 ",\"max_us\":%" PRIu32 "}",
+                     first ? "" : ",",
+                     call_control_state_name((cc_state_t)st),
+                     call_control_event_name((cc_event_t)ev),
+                     stats.count,
+                     (uint32_t)(stats.total_us / stats.count),
+                     stats.max_us);
+            ret = httpd_resp_sendstr_chunk(req, line);
+            first = false;
+        }
+    }
+
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, "]}");
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send call transitions response");
+    }
+    return ret;
+}
+
+// Handler for the BT app task dispatch statistics endpoint
+static esp_err_t bt_dispatch_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    bt_app_slab_stats_t slab;
+    bt_app_slab_get_stats(&slab);
+    bt_app_dispatch_stats_t dispatch;
+    bt_app_dispatch_get_stats(&dispatch);
+
+    // Worst case (every event id counted) is too big for the httpd task stack;
+    // handlers all run on the single httpd task, so a static buffer is safe
+    static char response[2048];
+    size_t offset = 0;
+    if (!json_append(response, sizeof(response), &offset, "{\"lanes\": {")) {
+        goto truncated;
+    }
+    for (int l = 0; l < BT_APP_LANE_COUNT; l++) {
+        const bt_app_lane_stats_t *lane = &dispatch.lanes[l];
+        if (!json_append(response, sizeof(response), &offset,
+                         "%s\"%s\":{\"handled\":%" PRIu32 ",\"residency_max_us\":%" PRIu32
+                         ",\"residency_avg_us\":%" PRIu32 "}",
+                         l ? "," : "", bt_app_lane_name(l), lane->handled, lane->residency_max_us,
+                         lane->handled ? (uint32_t)(lane->residency_total_us / lane->handled) : 0)) {
+            goto truncated;
+        }
+    }
+
+    // Per-event counters, keyed by event id, non-zero entries only
+    const char *sep = "";
+    if (!json_append(response, sizeof(response), &offset, "}, \"drops\": {")) {
+        goto truncated;
+    }
+    for (int e = 0; e < BT_APP_EVENT_STATS_SIZE; e++) {
+        if (dispatch.drops[e]) {
+            if (!json_append(response, sizeof(response), &offset,
+                             "%s\"%d\":%" PRIu32, sep, e, dispatch.drops[e])) {
+                goto truncated;
+            }
+            sep = ",";
+        }
+    }
+    sep = "";
+    if (!json_append(response, sizeof(response), &offset, "}, \"coalesced\": {")) {
+        goto truncated;
+    }
+    for (int e = 0; e < BT_APP_EVENT_STATS_SIZE; e++) {
+        if (dispatch.coalesced[e]) {
+            if (!json_append(response, sizeof(response), &offset,
+                             "%s\"%d\":%" PRIu32, sep, e, dispatch.coalesced[e])) {
+                goto truncated;
+            }
+            sep = ",";
+        }
+    }
+
+    if (!json_append(response, sizeof(response), &offset, "}, \"slabs\": [")) {
+        goto truncated;
+    }
+    for (int c = 0; c < BT_APP_SLAB_CLASSES; c++) {
+        if (!json_append(response, sizeof(response), &offset,
+                         "%s{\"block_size\":%u,\"blocks\":%u,\"in_use\":%u,"
+                         "\"high_water\":%u,\"allocs\":%" PRIu32 "}",
+                         c ? "," : "",
+                         slab.classes[c].block_size, slab.classes[c].blocks,
+                         slab.classes[c].in_use, slab.classes[c].high_water,
+                         slab.classes[c].allocs)) {
+            goto truncated;
+        }
+    }
+    if (!json_append(response, sizeof(response), &offset,
+                     "], \"heap_fallbacks\": %" PRIu32 ", \"alloc_failures\": %" PRIu32
+                     ", \"stack_free_min\": %" PRIu32 "}",
+                     slab.heap_fallbacks, slab.alloc_failures, dispatch.stack_free_min)) {
+        goto truncated;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    esp_err_t ret = httpd_resp_send(req, response, offset);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send BT dispatch response");
+    }
+    return ret;
+
+truncated:
+    ESP_LOGE(TAG, "BT dispatch response does not fit %u bytes", (unsigned)sizeof(response));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+    return ESP_FAIL;
+}
+
+// Handler for the Bluetooth reconnect statistics endpoint
+static esp_err_t bt_reconnect_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    bt_reconnect_stats_t rc;
+    bt_connection_manager_get_stats(&rc);
+
+    char response[384];
+    snprintf(response, sizeof(response),
+             "{\"state\": \"%s\", \"attempts\": %" PRIu32 ", \"failures\": %" PRIu32
+             ", \"consecutive_failures\": %" PRIu32 ", \"next_attempt_ms\": %" PRIu32
+             ", \"reconnects\": %" PRIu32 ", \"ttr_ms\": {\"last\": %" PRIu32
+             ", \"max\": %" PRIu32 ", \"avg\": %" PRIu32 "}}",
+             bt_connection_manager_state_name(rc.state), rc.attempts, rc.failures,
+             rc.consecutive_failures, rc.next_attempt_ms, rc.reconnects,
+             rc.last_ttr_ms, rc.max_ttr_ms,
+             rc.reconnects ? (uint32_t)(rc.total_ttr_ms / rc.reconnects) : 0);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    esp_err_t ret = httpd_resp_send(req, response, strlen(response));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send BT reconnect response");
+    }
+    return ret;
+}
+
+// Handler for the current calls endpoint
+static esp_err_t calls_handler(httpd_req_t *req) {
+    static const char *status_names[] = {
+        "active", "held", "dialing", "alerting", "incoming", "waiting", "response_hold",
+    };
+
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    ma_bell_state_t state;
+    ma_bell_state_snapshot(&state);
+    bt_calls_stats_t stats;
+    bt_calls_get_stats(&stats);
+
+    char response[192 + MA_BELL_MAX_CALLS * 160];
+    int offset = snprintf(response, sizeof(response),
+                          "{\"seq\": %" PRIu32 ", \"deltas\": %" PRIu32 ", \"listings\": %" PRIu32
+                          ", \"requeries\": %" PRIu32 ", \"query_errors\": %" PRIu32 ", \"calls\": [",
+                          state.calls.seq, stats.deltas, stats.listings,
+                          stats.requeries, stats.query_errors);
+    for (int i = 0; i < state.calls.count && i < MA_BELL_MAX_CALLS; i++) {
+        const ma_bell_call_t *call = &state.calls.list[i];
+        offset += snprintf(response + offset, sizeof(response) - offset,
+                           "%s{\"idx\": %u, \"direction\": \"%s\", \"status\": \"%s\""
+                           ", \"mpty\": %s, \"number\": \"%s\"}",
+                           i ? "," : "", call->idx, call->incoming ? "incoming" : "outgoing",
+                           call->status < sizeof(status_names) / sizeof(status_names[0])
+                               ? status_names[call->status] : "unknown",
+                           call->mpty ? "true" : "false", call->number);
+    }
+    snprintf(response + offset, sizeof(response) - offset, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    esp_err_t ret = httpd_resp_send(req, response, strlen(response));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send calls response");
+    }
+    return ret;
+}
+
+// Handler for the call detail record export
+// Streams from flash in chunks; the log can hold thousands of records.
+static esp_err_t cdr_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    // Optional ?since=<seq> to fetch only records newer than a previous export
+    uint32_t since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    cdr_cursor_t cursor;
+    cdr_export_begin(&cursor, since);
+    cdr_stats_t stats;
+    cdr_get_stats(&stats);
+
+    cdr_record_t records[8];
+    char line[256];
+    uint32_t next = since;
+    bool first = true;
+    size_t count;
+
+    snprintf(line, sizeof(line),
+             "{\"capacity\": %" PRIu32 ", \"calls\": %" PRIu32 ", \"write_errors\": %" PRIu32
+             ", \"dropped\": %" PRIu32 ", \"records\": [",
+             stats.capacity, stats.records, stats.write_errors, stats.dropped);
+    esp_err_t ret = httpd_resp_sendstr_chunk(req, line);
+    while (ret == ESP_OK && (count = cdr_export_read(&cursor, records, 8)) > 0) {
+        for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+            const cdr_record_t *rec = &records[i];
+            snprintf(line, sizeof(line),
+                     "%s{\"seq\":%" PRIu32 ",\"start\":%" PRIu32 ",\"direction\":\"%s\","
+                     "\"outcome\":\"%s\",\"number\":\"%.*s\",\"answer_ms\":%" PRIu32 ","
+                     "\"duration_ms\":%" PRIu32 ",\"post_dial_ms\":%u,\"underruns\":%u}",
+                     first ? "" : ",", rec->seq, rec->start,
+                     rec->direction == CDR_DIR_INCOMING ? "incoming" : "outgoing",
+                     cdr_outcome_name(rec->outcome),
+                     (int)strnlen(rec->number, sizeof(rec->number)), rec->number,
+                     rec->answer_ms, rec->duration_ms, rec->post_dial_ms, rec->underruns);
+            ret = httpd_resp_sendstr_chunk(req, line);
+            next = rec->seq;
+            first = false;
+        }
+    }
+
+    if (ret == ESP_OK) {
+        snprintf(line, sizeof(line), "], \"next\": %" PRIu32 "}", next);
+        ret = httpd_resp_sendstr_chunk(req, line);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send CDR response");
+    }
+    return ret;
+}
+
+// Handler for the answering machine: counters and the message list
+static esp_err_t voicemail_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    voicemail_stats_t stats;
+    voicemail_get_stats(&stats);
+    voicemail_message_t messages[VM_MAX_SLOTS];
+    size_t count = voicemail_list(messages, VM_MAX_SLOTS);
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "{\"mounted\": %s, \"greeting\": %s, \"slots\": %u, \"slot_ms\": %" PRIu32
+             ", \"unheard\": %u, \"answered\": %" PRIu32 ", \"recorded\": %" PRIu32
+             ", \"overruns\": %" PRIu32 ", \"underruns\": %" PRIu32 ", \"write_errors\": %" PRIu32
+             ", \"messages\": [",
+             stats.mounted ? "true" : "false", stats.greeting ? "true" : "false",
+             stats.slots, stats.slot_ms, stats.unheard, stats.answered, stats.recorded,
+             stats.overruns, stats.underruns, stats.write_errors);
+    esp_err_t ret = httpd_resp_sendstr_chunk(req, line);
+
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        const voicemail_message_t *msg = &messages[i];
+        snprintf(line, sizeof(line),
+                 "%s{\"seq\":%" PRIu32 ",\"slot\":%u,\"start\":%" PRIu32 ",\"number\":\"%.*s\","
+                 "\"duration_ms\":%" PRIu32 ",\"heard\":%s}",
+                 i == 0 ? "" : ",", msg->seq, msg->slot, msg->start,
+                 (int)strnlen(msg->number, sizeof(msg->number)), msg->number,
+                 msg->duration_ms, msg->heard ? "true" : "false");
+        ret = httpd_resp_sendstr_chunk(req, line);
+    }
+
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, "]}");
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send voicemail response");
+    }
+    return ret;
+}
+
+// Handler for the phonebook export, one CSV line per entry
+static esp_err_t phonebook_get_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "text/csv");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    phonebook_entry_t entry;
+    char line[96];
+    esp_err_t ret = httpd_resp_sendstr_chunk(req, "code,number,name\n");
+    for (size_t i = 0; ret == ESP_OK && phonebook_get(i, &entry); i++) {
+        snprintf(line, sizeof(line), "%s,%s,\"%s\"\n", entry.code, entry.number, entry.name);
+        ret = httpd_resp_sendstr_chunk(req, line);
+    }
+    if (ret == ESP_OK) {
+        ret = httpd_resp_sendstr_chunk(req, NULL);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send phonebook");
+    }
+    return ret;
+}
+
+// Handler for the phonebook import; the body replaces the whole book
+static esp_err_t phonebook_post_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+    if (req->content_len > PHONEBOOK_CSV_MAX_LEN) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Phonebook too large");
+        return ESP_FAIL;
+    }
+
+    char *body = malloc(req->content_len + 1);
+    if (body == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+        return ESP_FAIL;
+    }
+
+    size_t received = 0;
+    while (received < req->content_len) {
+        int n = httpd_req_recv(req, body + received, req->content_len - received);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (n <= 0) {
+            free(body);
+            ESP_LOGE(TAG, "Failed to receive phonebook");
+            return ESP_FAIL;
+        }
+        received += n;
+    }
+
+    int bad_line = 0;
+    esp_err_t ret = phonebook_import_csv(body, received, &bad_line);
+    free(body);
+
+    char response[96];
+    if (ret == ESP_OK) {
+        snprintf(response, sizeof(response), "{\"entries\": %u}", (unsigned)phonebook_count());
+    } else if (bad_line > 0) {
+        snprintf(response, sizeof(response), "Invalid entry on line %d", bad_line);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, response);
+        return ESP_FAIL;
+    } else if (ret == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Duplicate speed-dial code");
+        return ESP_FAIL;
+    } else {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Phonebook not saved");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    ret = httpd_resp_send(req, response, strlen(response));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send phonebook import response");
+    }
+    return ret;
+}
+
+// Handler for the phone status indicator endpoint
+static esp_err_t bt_indicators_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    // Optional ?since=<seq> to fetch only indicators changed after a previous poll
+    uint32_t since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+
+    char response[1024];
+    size_t offset = 0;
+    uint32_t seq = bt_indicators_seq();
+    if (!json_append(response, sizeof(response), &offset,
+                     "{\"seq\": %" PRIu32 ", \"indicators\": [", seq)) {
+        goto truncated;
+    }
+    bool first = true;
+    for (int i = 0; i < BT_IND_COUNT; i++) {
+        bt_indicator_stats_t ind;
+        bt_indicators_get(i, &ind);
+        if (ind.changes == 0 || ind.seq <= since) {
+            continue;
+        }
+        if (!json_append(response, sizeof(response), &offset,
+                         "%s{\"name\": \"%s\", \"valid\": %s, ",
+                         first ? "" : ",", bt_indicators_name(i), ind.valid ? "true" : "false")) {
+            goto truncated;
+        }
+        if (i == BT_IND_OPERATOR) {
+            char name[24];
+            bt_indicators_get_operator(name, sizeof(name));
+            if (!json_append(response, sizeof(response), &offset, "\"value\": \"%s\", ", name)) {
+                goto truncated;
+            }
+        } else {
+            if (!json_append(response, sizeof(response), &offset,
+                             "\"value\": %u, \"min\": %u, \"max\": %u, \"histogram\": [",
+                             ind.value, ind.min, ind.max)) {
+                goto truncated;
+            }
+            for (int b = 0; b < BT_IND_HISTOGRAM_BINS; b++) {
+                if (!json_append(response, sizeof(response), &offset,
+                                 "%s%" PRIu32, b ? "," : "", ind.histogram[b])) {
+                    goto truncated;
+                }
+            }
+            if (!json_append(response, sizeof(response), &offset, "], ")) {
+                goto truncated;
+            }
+        }
+        if (!json_append(response, sizeof(response), &offset,
+                         "\"reports\": %" PRIu32 ", \"changes\": %" PRIu32 "}",
+                         ind.reports, ind.changes)) {
+            goto truncated;
+        }
+        first = false;
+    }
+    if (!json_append(response, sizeof(response), &offset, "]}")) {
+        goto truncated;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    esp_err_t ret = httpd_resp_send(req, response, offset);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send BT indicators response");
+    }
+    return ret;
+
+truncated:
+    ESP_LOGE(TAG, "BT indicators response does not fit %u bytes", (unsigned)sizeof(response));
+    httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+    return ESP_FAIL;
+}
+
+// Append one link-quality record to a JSON buffer
+static bool format_link_quality(char *buf, size_t size, size_t *offset, const char *name,
+                                const bt_link_quality_t *lq)
+{
+    return json_append(buf, size, offset,
+                       "\"%s\": {\"active\": %s, \"duration_ms\": %" PRIu32 ", \"samples\": %" PRIu32
+                       ", \"rx\": {\"total\": %" PRIu32 ", \"good\": %" PRIu32 ", \"err\": %" PRIu32
+                       ", \"none\": %" PRIu32 ", \"lost\": %" PRIu32 ", \"bad_permille\": %u"
+                       ", \"worst_bad_permille\": %u}"
+                       ", \"tx\": {\"total\": %" PRIu32 ", \"discarded\": %" PRIu32 "}"
+                       ", \"bridge\": {\"downlink_underruns\": %" PRIu32 ", \"downlink_overruns\": %" PRIu32
+                       ", \"uplink_underruns\": %" PRIu32 ", \"uplink_overruns\": %" PRIu32 "}"
+                       ", \"glitches\": {\"rf\": %" PRIu32 ", \"scheduling\": %" PRIu32 "}}",
+                       name, lq->active ? "true" : "false", lq->duration_ms, lq->samples,
+                       lq->rx_total, lq->rx_good, lq->rx_err, lq->rx_none, lq->rx_lost,
+                       lq->rx_bad_permille, lq->worst_rx_bad_permille,
+                       lq->tx_total, lq->tx_discarded,
+                       lq->xruns[AUDIO_XRUN_DOWNLINK_UNDERRUN], lq->xruns[AUDIO_XRUN_DOWNLINK_OVERRUN],
+                       lq->xruns[AUDIO_XRUN_UPLINK_UNDERRUN], lq->xruns[AUDIO_XRUN_UPLINK_OVERRUN],
+                       lq->rf_glitches, lq->sched_glitches);
+}
+
+// Handler for the SCO link-quality endpoint
+static esp_err_t bt_link_quality_handler(httpd_req_t *req) {
+    if (!server_running) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not running");
+        return ESP_FAIL;
+    }
+
+    bt_link_quality_t current, last;
+    bt_link_quality_get(false, &current);
+    bt_link_quality_get(true, &last);
+
+    char response[1280];
+    size_t offset = 0;
+    if (!json_append(response, sizeof(response), &offset, "{") ||
+        !format_link_quality(response, sizeof(response), &offset, "current", &current) ||
+        !json_append(response, sizeof(response), &offset, ", ") ||
+        !format_link_quality(response, sizeof(response), &offset, "last", &last) ||
+        !json_append(response, sizeof(response), &offset, "}")) {
+        ESP_LOGE(TAG, "BT link quality response does not fit %u bytes", (unsigned)sizeof(response));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Response too large");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+
+    esp_err_t ret = httpd_resp_send(req, response, offset);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send BT link quality response");
+    }
+    return ret;
+}
+
 // Handler for the tasks JSON endpoint
 static esp_err_t tasks_handler(httpd_req_t *req) {
     if (!server_running) {
@@ -303,6 +1081,72 @@ esp_err_t web_interface_init(void) {
         .handler = status_handler,
         .user_ctx = NULL
     };
+    httpd_uri_t uri_state_history = {
+        .uri = "/state/history",
+        .method = HTTP_GET,
+        .handler = state_history_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_call_transitions = {
+        .uri = "/call/transitions",
+        .method = HTTP_GET,
+        .handler = call_transitions_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_bt_dispatch = {
+        .uri = "/bt/dispatch",
+        .method = HTTP_GET,
+        .handler = bt_dispatch_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_bt_reconnect = {
+        .uri = "/bt/reconnect",
+        .method = HTTP_GET,
+        .handler = bt_reconnect_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_calls = {
+        .uri = "/calls",
+        .method = HTTP_GET,
+        .handler = calls_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_cdr = {
+        .uri = "/cdr",
+        .method = HTTP_GET,
+        .handler = cdr_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_voicemail = {
+        .uri = "/voicemail",
+        .method = HTTP_GET,
+        .handler = voicemail_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_phonebook_get = {
+        .uri = "/phonebook",
+        .method = HTTP_GET,
+        .handler = phonebook_get_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_phonebook_post = {
+        .uri = "/phonebook",
+        .method = HTTP_POST,
+        .handler = phonebook_post_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_bt_indicators = {
+        .uri = "/bt/indicators",
+        .method = HTTP_GET,
+        .handler = bt_indicators_handler,
+        .user_ctx = NULL
+    };
+    httpd_uri_t uri_bt_link_quality = {
+        .uri = "/bt/link_quality",
+        .method = HTTP_GET,
+        .handler = bt_link_quality_handler,
+        .user_ctx = NULL
+    };
     httpd_uri_t uri_tasks = {
         .uri = "/tasks",
         .method = HTTP_GET,
@@ -331,6 +1175,87 @@ esp_err_t web_interface_init(void) {
     }
     ESP_LOGI(TAG, "Registered status handler for /status");
 
+    if (httpd_register_uri_handler(server, &uri_state_history) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register state history handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered state history handler for /state/history");
+
+    if (httpd_register_uri_handler(server, &uri_call_transitions) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register call transitions handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered call transitions handler for /call/transitions");
+
+    if (httpd_register_uri_handler(server, &uri_bt_dispatch) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register BT dispatch handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered BT dispatch handler for /bt/dispatch");
+
+    if (httpd_register_uri_handler(server, &uri_bt_reconnect) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register BT reconnect handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered BT reconnect handler for /bt/reconnect");
+
+    if (httpd_register_uri_handler(server, &uri_calls) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register calls handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered calls handler for /calls");
+
+    if (httpd_register_uri_handler(server, &uri_cdr) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register CDR handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered CDR handler for /cdr");
+
+    if (httpd_register_uri_handler(server, &uri_voicemail) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register voicemail handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered voicemail handler for /voicemail");
+
+    if (httpd_register_uri_handler(server, &uri_phonebook_get) != ESP_OK ||
+        httpd_register_uri_handler(server, &uri_phonebook_post) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register phonebook handlers");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered phonebook handlers for /phonebook");
+
+    if (httpd_register_uri_handler(server, &uri_bt_indicators) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register BT indicators handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered BT indicators handler for /bt/indicators");
+
+    if (httpd_register_uri_handler(server, &uri_bt_link_quality) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register BT link quality handler");
+        httpd_stop(server);
+        vSemaphoreDelete(server_mutex);
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Registered BT link quality handler for /bt/link_quality");
+
     if (httpd_register_uri_handler(server, &uri_tasks) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to register tasks handler");
         httpd_stop(server);
@@ -342,18 +1267,6 @@ esp_err_t web_interface_init(void) {
     server_running = true;
     ESP_LOGI(TAG, "Web server started successfully on port %d", config.server_port);
 
-    // Cache WiFi SSID once to avoid NVS contention during status requests
-    // This happens after WiFi is already connected, so safe to read NVS
-    char temp_pass[65];
-    esp_err_t ret = wifi_get_credentials(cached_wifi_ssid, sizeof(cached_wifi_ssid),
-                                          temp_pass, sizeof(temp_pass));
-    if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "Cached WiFi SSID: %s", cached_wifi_ssid);
-    } else {
-        ESP_LOGI(TAG, "No WiFi credentials found in NVS");
-        strncpy(cached_wifi_ssid, "Not configured", sizeof(cached_wifi_ssid));
-    }
-
     return ESP_OK;
 }
 
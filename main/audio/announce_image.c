@@ -0,0 +1,61 @@
+#include "announce_image.h"
+#include "storage/crc32.h"
+#include <string.h>
+
+int announce_image_open(announce_image_t *img, const void *base, uint32_t size)
+{
+    const announce_image_header_t *hdr = base;
+
+    if (size < sizeof(*hdr) || hdr->magic != ANNOUNCE_IMAGE_MAGIC ||
+        hdr->version != ANNOUNCE_IMAGE_VERSION || hdr->size > size) {
+        return -1;
+    }
+
+    uint32_t dir_end = sizeof(*hdr) + (uint32_t)hdr->count * sizeof(announce_image_entry_t);
+    if (dir_end > hdr->size) {
+        return -1;
+    }
+
+    uint32_t crc = crc32_update(0, hdr, offsetof(announce_image_header_t, crc));
+    crc = crc32_update(crc, (const uint8_t *)base + sizeof(*hdr), dir_end - sizeof(*hdr));
+    if (crc != hdr->crc) {
+        return -1;
+    }
+
+    const announce_image_entry_t *entries =
+        (const announce_image_entry_t *)((const uint8_t *)base + sizeof(*hdr));
+    for (uint16_t i = 0; i < hdr->count; i++) {
+        if (entries[i].offset < dir_end || entries[i].offset > hdr->size ||
+            entries[i].length > hdr->size - entries[i].offset) {
+            return -1;
+        }
+    }
+
+    img->base = base;
+    img->size = hdr->size;
+    img->count = hdr->count;
+    img->entries = entries;
+    return 0;
+}
+
+const announce_image_entry_t *announce_image_find(const announce_image_t *img, const char *name)
+{
+    // A few dozen clips at most, looked up once per announcement
+    for (uint16_t i = 0; i < img->count; i++) {
+        const announce_image_entry_t *entry = &img->entries[i];
+        if (strncmp(entry->name, name, ANNOUNCE_NAME_LEN) == 0) {
+            return (entry->format == ANNOUNCE_FORMAT_IMA_ADPCM) ? entry : NULL;
+        }
+    }
+    return NULL;
+}
+
+const uint8_t *announce_image_data(const announce_image_t *img, const announce_image_entry_t *entry)
+{
+    return img->base + entry->offset;
+}
+
+bool announce_image_check_clip(const announce_image_t *img, const announce_image_entry_t *entry)
+{
+    return crc32_update(0, announce_image_data(img, entry), entry->length) == entry->crc;
+}
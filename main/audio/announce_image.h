@@ -0,0 +1,93 @@
+#ifndef __ANNOUNCE_IMAGE_H__
+#define __ANNOUNCE_IMAGE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file announce_image.h
+ * @brief Recorded announcement image, as built by tools/pack_announcements.py
+ *
+ * Pure integer code with no ESP-IDF dependencies. The image is used where it
+ * lies: the directory and the audio are read in place through the pointer
+ * the image was opened with, normally a memory-mapped flash partition.
+ *
+ * Layout (little endian): a 16-byte header, count 32-byte directory
+ * entries, then the clips, each starting on a 4-byte boundary. Clips are
+ * 8 kHz IMA ADPCM as ima_adpcm.c writes it, each encoded from a fresh
+ * codec state so it can be played on its own. The header CRC covers the
+ * header and the directory; each entry carries a CRC of its own clip.
+ */
+
+#define ANNOUNCE_IMAGE_MAGIC        0x434E4E41  // "ANNC"
+#define ANNOUNCE_IMAGE_VERSION      1
+#define ANNOUNCE_NAME_LEN           16          // Name field, NUL padded
+#define ANNOUNCE_FORMAT_IMA_ADPCM   1           // 8 kHz mono, two samples a byte
+
+/**
+ * @brief Image header
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // ANNOUNCE_IMAGE_MAGIC
+    uint16_t version;           // ANNOUNCE_IMAGE_VERSION
+    uint16_t count;             // Directory entries
+    uint32_t size;              // Bytes in the whole image
+    uint32_t crc;               // CRC-32 of the header up to here, then the directory
+} announce_image_header_t;
+
+/**
+ * @brief Directory entry
+ */
+typedef struct __attribute__((packed)) {
+    char name[ANNOUNCE_NAME_LEN];
+    uint32_t offset;            // From the start of the image
+    uint32_t length;            // Bytes of audio
+    uint16_t format;            // ANNOUNCE_FORMAT_*
+    uint16_t reserved;
+    uint32_t crc;               // CRC-32 of the audio
+} announce_image_entry_t;
+
+_Static_assert(sizeof(announce_image_header_t) == 16, "Image header must stay 16 bytes");
+_Static_assert(sizeof(announce_image_entry_t) == 32, "Directory entry must stay 32 bytes");
+
+/**
+ * @brief Opened image; points into the caller's buffer
+ */
+typedef struct {
+    const uint8_t *base;
+    uint32_t size;
+    uint16_t count;
+    const announce_image_entry_t *entries;
+} announce_image_t;
+
+/**
+ * @brief Check the header and directory and open the image
+ *
+ * Every entry's clip must lie inside the image. Clip CRCs are not checked
+ * here; that would read the whole image (see announce_image_check_clip()).
+ *
+ * @param base Start of the image, 4-byte aligned
+ * @param size Bytes available at base, e.g. the partition size
+ * @return 0 on success, -1 if there is no valid image
+ */
+int announce_image_open(announce_image_t *img, const void *base, uint32_t size);
+
+/**
+ * @brief Find a clip by name
+ *
+ * @return The entry, or NULL if there is none or its format is unknown
+ */
+const announce_image_entry_t *announce_image_find(const announce_image_t *img, const char *name);
+
+/**
+ * @brief Audio of a clip, in place
+ */
+const uint8_t *announce_image_data(const announce_image_t *img, const announce_image_entry_t *entry);
+
+/**
+ * @brief Whether a clip matches its CRC
+ */
+bool announce_image_check_clip(const announce_image_t *img, const announce_image_entry_t *entry);
+
+#endif /* __ANNOUNCE_IMAGE_H__ */
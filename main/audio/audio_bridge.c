@@ -5,25 +5,133 @@
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "freertos/ringbuf.h"
 #include "esp_hf_client_api.h"
+#include "esp_timer.h"
 #include <string.h>
+#include <stdbool.h>
 
 static const char *TAG = "audio_bridge";
 
-// FreeRTOS task handles
+// Audio frame size for 8kHz, 16-bit, 20ms = 160 samples * 2 bytes = 320 bytes
+#define AUDIO_FRAME_SIZE 320
+#define AUDIO_FRAME_DURATION_MS 20
+
+// Longest a bridge task blocks on I/O, so it notices a pause within one frame
+#define BRIDGE_IO_TIMEOUT_MS    (2 * AUDIO_FRAME_DURATION_MS)
+
+// Set by each task once it is parked and holds no I2S transfer or ring buffer item
+#define BRIDGE_RX_PARKED        BIT0
+#define BRIDGE_TX_PARKED        BIT1
+#define BRIDGE_ALL_PARKED       (BRIDGE_RX_PARKED | BRIDGE_TX_PARKED)
+
+// The whole pipeline is allocated at build time. Both tasks live for the
+// whole run; start and stop only flip the run flag and handshake.
+static StaticTask_t audio_rx_task_tcb;
+static StaticTask_t audio_tx_task_tcb;
+static StackType_t audio_rx_task_stack[AUDIO_BRIDGE_TASK_STACK];
+static StackType_t audio_tx_task_stack[AUDIO_BRIDGE_TASK_STACK];
 static TaskHandle_t audio_rx_task_handle = NULL;
 static TaskHandle_t audio_tx_task_handle = NULL;
 
+static StaticEventGroup_t bridge_events_storage;
+static EventGroupHandle_t bridge_events = NULL;
+static volatile bool bridge_running = false;
+
 // Ring buffers for audio bridging
 // RX buffer: Bluetooth → ESP32 → Phone (from BT incoming callback to I2S TX)
 // TX buffer: Phone → ESP32 → Bluetooth (from I2S RX to BT outgoing callback)
+static StaticRingbuffer_t bt_rx_ringbuf_struct;
+static StaticRingbuffer_t bt_tx_ringbuf_struct;
+// Aligned so a downlink item can be handed to a tap as samples in place;
+// items are whole samples, so every item starts on an even offset.
+static uint8_t bt_rx_ringbuf_storage[AUDIO_HFP_RINGBUF_SIZE] __attribute__((aligned(4)));
+static uint8_t bt_tx_ringbuf_storage[AUDIO_HFP_RINGBUF_SIZE] __attribute__((aligned(4)));
 static RingbufHandle_t bt_rx_ringbuf = NULL;  // Audio from Bluetooth
 static RingbufHandle_t bt_tx_ringbuf = NULL;  // Audio to Bluetooth
 
-// Audio frame size for 8kHz, 16-bit, 20ms = 160 samples * 2 bytes = 320 bytes
-#define AUDIO_FRAME_SIZE 320
-#define AUDIO_FRAME_DURATION_MS 20
+// Pending cut-through measurement and results
+static portMUX_TYPE cut_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t cut_start_us = 0;    // 0 when nothing is pending
+static audio_cut_through_kind_t cut_kind;
+static audio_cut_through_t cut_stats[AUDIO_CUT_THROUGH_KINDS];
+
+// Frame taps. Each task marks itself inside a tap under tap_lock, so
+// audio_bridge_set_tap() can wait for a tap being replaced to return.
+static portMUX_TYPE tap_lock = portMUX_INITIALIZER_UNLOCKED;
+static const audio_bridge_tap_t *bridge_tap = NULL;
+static uint8_t tap_users = 0;       // BRIDGE_*_PARKED bit per task inside a tap
+
+// Underrun/overrun totals, bumped atomically from the bridge tasks and the
+// Bluetooth data callbacks
+static uint32_t xrun_counts[AUDIO_XRUN_KINDS];
+
+// Park while paused, reporting it so audio_bridge_stop() can flush safely.
+// Returns once the bridge is running.
+static void bridge_park(EventBits_t parked_bit)
+{
+    if (bridge_running) {
+        return;
+    }
+
+    while (!bridge_running) {
+        xEventGroupSetBits(bridge_events, parked_bit);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    xEventGroupClearBits(bridge_events, parked_bit);
+}
+
+// Discard everything queued in a ring buffer
+static void ringbuf_flush(RingbufHandle_t rb)
+{
+    size_t item_size;
+    uint8_t *data;
+    while ((data = xRingbufferReceive(rb, &item_size, 0)) != NULL) {
+        vRingbufferReturnItem(rb, data);
+    }
+}
+
+// Get the current tap and mark this task as using it; tap_release() when done
+static const audio_bridge_tap_t *tap_acquire(uint8_t user)
+{
+    portENTER_CRITICAL(&tap_lock);
+    const audio_bridge_tap_t *tap = bridge_tap;
+    if (tap != NULL) {
+        tap_users |= user;
+    }
+    portEXIT_CRITICAL(&tap_lock);
+    return tap;
+}
+
+static void tap_release(uint8_t user)
+{
+    portENTER_CRITICAL(&tap_lock);
+    tap_users &= ~user;
+    portEXIT_CRITICAL(&tap_lock);
+}
+
+// Complete a pending cut-through measurement on the first downlink frame
+static void cut_through_frame(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&cut_lock);
+    if (cut_start_us != 0) {
+        int64_t delay = now - cut_start_us;
+        if (delay <= (int64_t)AUDIO_CUT_THROUGH_MAX_MS * 1000) {
+            audio_cut_through_t *st = &cut_stats[cut_kind];
+            st->count++;
+            st->last_us = (uint32_t)delay;
+            st->total_us += (uint64_t)delay;
+            if (st->last_us > st->max_us) {
+                st->max_us = st->last_us;
+            }
+        }
+        cut_start_us = 0;
+    }
+    portEXIT_CRITICAL(&cut_lock);
+}
 
 /**
  * @brief Audio RX task - Reads audio from PCM1808 ADC and sends to Bluetooth
@@ -36,34 +144,40 @@ static void audio_rx_task(void *arg)
 {
     ESP_LOGI(TAG, "Audio RX task started (Phone → Bluetooth)");
 
-    // Get RX handle from audio_output module
-    i2s_chan_handle_t rx_handle = audio_output_get_rx_handle();
-    if (rx_handle == NULL) {
-        ESP_LOGE(TAG, "RX handle not available - audio_output not initialized?");
-        vTaskDelete(NULL);
-        return;
-    }
+    // Verified by audio_bridge_init() before the task was created
+    i2s_chan_handle_t rx_handle = (i2s_chan_handle_t)arg;
 
-    uint8_t i2s_rx_buffer[AUDIO_FRAME_SIZE];
+    int16_t i2s_rx_buffer[AUDIO_FRAME_SIZE / sizeof(int16_t)];
     size_t bytes_read;
 
     while (1) {
+        bridge_park(BRIDGE_RX_PARKED);
+
         // Read audio from PCM1808 ADC via I2S RX
         esp_err_t ret = i2s_channel_read(rx_handle, i2s_rx_buffer,
                                           AUDIO_FRAME_SIZE, &bytes_read,
-                                          portMAX_DELAY);
+                                          BRIDGE_IO_TIMEOUT_MS);
 
         if (ret == ESP_OK && bytes_read > 0) {
+            const audio_bridge_tap_t *tap = tap_acquire(BRIDGE_RX_PARKED);
+            if (tap != NULL) {
+                if (tap->uplink != NULL) {
+                    tap->uplink(i2s_rx_buffer, bytes_read / sizeof(int16_t), tap->ctx);
+                }
+                tap_release(BRIDGE_RX_PARKED);
+            }
+
             // Write audio to Bluetooth TX ring buffer
             BaseType_t done = xRingbufferSend(bt_tx_ringbuf, i2s_rx_buffer,
                                                bytes_read, pdMS_TO_TICKS(10));
             if (!done) {
                 ESP_LOGW(TAG, "BT TX ring buffer full, dropping audio frame");
+                audio_bridge_count_xrun(AUDIO_XRUN_UPLINK_OVERRUN);
             } else {
                 // Notify Bluetooth stack that data is ready
                 esp_hf_client_outgoing_data_ready();
             }
-        } else {
+        } else if (ret != ESP_ERR_TIMEOUT) {
             ESP_LOGW(TAG, "I2S RX read failed: %s", esp_err_to_name(ret));
         }
 
@@ -87,13 +201,29 @@ static void audio_tx_task(void *arg)
     size_t item_size = 0;
 
     while (1) {
+        bridge_park(BRIDGE_TX_PARKED);
+
         // Read audio from Bluetooth RX ring buffer
         uint8_t *data = xRingbufferReceiveUpTo(bt_rx_ringbuf, &item_size,
-                                                 pdMS_TO_TICKS(100),
+                                                 pdMS_TO_TICKS(BRIDGE_IO_TIMEOUT_MS),
                                                  AUDIO_FRAME_SIZE);
 
+        bool consumed = false;
         if (data != NULL && item_size > 0) {
-            // Copy data to local buffer
+            const audio_bridge_tap_t *tap = tap_acquire(BRIDGE_TX_PARKED);
+            if (tap != NULL) {
+                if (tap->downlink != NULL) {
+                    consumed = tap->downlink((const int16_t *)data, item_size / sizeof(int16_t),
+                                             tap->ctx);
+                }
+                tap_release(BRIDGE_TX_PARKED);
+            }
+        }
+
+        if (consumed) {
+            vRingbufferReturnItem(bt_rx_ringbuf, data);
+        } else if (data != NULL && item_size > 0) {
+            // Copy data to local buffer so the item is returned straight away
             memcpy(bt_audio_buffer, data, item_size);
             vRingbufferReturnItem(bt_rx_ringbuf, data);
 
@@ -101,11 +231,15 @@ static void audio_tx_task(void *arg)
             // If a tone is playing, this will be silently dropped (tone has priority)
             size_t bytes_written;
             esp_err_t ret = audio_output_write(bt_audio_buffer, item_size,
-                                                &bytes_written, 100);
+                                                &bytes_written, BRIDGE_IO_TIMEOUT_MS);
 
             if (ret != ESP_OK) {
                 ESP_LOGW(TAG, "Audio output write failed: %s", esp_err_to_name(ret));
+            } else {
+                cut_through_frame();
             }
+        } else if (data == NULL) {
+            audio_bridge_count_xrun(AUDIO_XRUN_DOWNLINK_UNDERRUN);
         }
 
         // Small delay to prevent task starvation
@@ -118,89 +252,139 @@ esp_err_t audio_bridge_init(void)
     ESP_LOGI(TAG, "Initializing audio bridge");
 
     // Verify I2S RX channel is available from audio_output module
-    if (audio_output_get_rx_handle() == NULL) {
+    i2s_chan_handle_t rx_handle = audio_output_get_rx_handle();
+    if (rx_handle == NULL) {
         ESP_LOGE(TAG, "I2S RX channel not available - call audio_output_init() first");
         return ESP_ERR_INVALID_STATE;
     }
 
-    // Create ring buffers for audio bridging
-    bt_rx_ringbuf = xRingbufferCreate(AUDIO_HFP_RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF);
-    if (bt_rx_ringbuf == NULL) {
-        ESP_LOGE(TAG, "Failed to create BT RX ring buffer");
-        return ESP_FAIL;
-    }
-
-    bt_tx_ringbuf = xRingbufferCreate(AUDIO_HFP_RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF);
-    if (bt_tx_ringbuf == NULL) {
-        ESP_LOGE(TAG, "Failed to create BT TX ring buffer");
-        vRingbufferDelete(bt_rx_ringbuf);
-        bt_rx_ringbuf = NULL;
-        return ESP_FAIL;
+    if (audio_rx_task_handle != NULL) {
+        return ESP_OK;  // Already initialized
     }
 
-    ESP_LOGI(TAG, "Audio bridge initialized (ring buffers ready)");
+    // None of these can fail: all storage is static
+    bridge_events = xEventGroupCreateStatic(&bridge_events_storage);
+    bt_rx_ringbuf = xRingbufferCreateStatic(AUDIO_HFP_RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF,
+                                            bt_rx_ringbuf_storage, &bt_rx_ringbuf_struct);
+    bt_tx_ringbuf = xRingbufferCreateStatic(AUDIO_HFP_RINGBUF_SIZE, RINGBUF_TYPE_BYTEBUF,
+                                            bt_tx_ringbuf_storage, &bt_tx_ringbuf_struct);
+
+    audio_rx_task_handle = xTaskCreateStatic(audio_rx_task, "audio_rx", AUDIO_BRIDGE_TASK_STACK,
+                                             rx_handle, AUDIO_BRIDGE_TASK_PRIORITY,
+                                             audio_rx_task_stack, &audio_rx_task_tcb);
+    audio_tx_task_handle = xTaskCreateStatic(audio_tx_task, "audio_tx", AUDIO_BRIDGE_TASK_STACK,
+                                             NULL, AUDIO_BRIDGE_TASK_PRIORITY,
+                                             audio_tx_task_stack, &audio_tx_task_tcb);
+
+    ESP_LOGI(TAG, "Audio bridge initialized (ring buffers ready, tasks parked)");
     return ESP_OK;
 }
 
 void audio_bridge_start(void)
 {
-    ESP_LOGI(TAG, "Starting audio bridge");
-
     if (audio_rx_task_handle == NULL) {
-        BaseType_t ret = xTaskCreate(audio_rx_task, "audio_rx",
-                                      4096, NULL, 10, &audio_rx_task_handle);
-        if (ret != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create audio RX task");
-            return;
-        }
+        ESP_LOGE(TAG, "Audio bridge not initialized");
+        return;
     }
-
-    if (audio_tx_task_handle == NULL) {
-        BaseType_t ret = xTaskCreate(audio_tx_task, "audio_tx",
-                                      4096, NULL, 10, &audio_tx_task_handle);
-        if (ret != pdPASS) {
-            ESP_LOGE(TAG, "Failed to create audio TX task");
-            return;
-        }
+    if (bridge_running) {
+        return;
     }
 
+    // Anything left over belongs to the previous link
+    ringbuf_flush(bt_rx_ringbuf);
+    ringbuf_flush(bt_tx_ringbuf);
+
+    bridge_running = true;
+    xTaskNotifyGive(audio_rx_task_handle);
+    xTaskNotifyGive(audio_tx_task_handle);
+
     ESP_LOGI(TAG, "Audio bridge started - bidirectional audio active");
 }
 
 void audio_bridge_stop(void)
 {
+    if (audio_rx_task_handle == NULL || !bridge_running) {
+        return;
+    }
+
     ESP_LOGI(TAG, "Stopping audio bridge");
 
-    if (audio_rx_task_handle != NULL) {
-        vTaskDelete(audio_rx_task_handle);
-        audio_rx_task_handle = NULL;
+    // Tasks finish the frame in hand, then park and report it
+    bridge_running = false;
+    EventBits_t parked = xEventGroupWaitBits(bridge_events, BRIDGE_ALL_PARKED, pdFALSE, pdTRUE,
+                                             pdMS_TO_TICKS(AUDIO_BRIDGE_DRAIN_TIMEOUT_MS));
+    if ((parked & BRIDGE_ALL_PARKED) != BRIDGE_ALL_PARKED) {
+        ESP_LOGW(TAG, "Bridge tasks did not park in %d ms (rx %s, tx %s)",
+                 AUDIO_BRIDGE_DRAIN_TIMEOUT_MS,
+                 (parked & BRIDGE_RX_PARKED) ? "parked" : "busy",
+                 (parked & BRIDGE_TX_PARKED) ? "parked" : "busy");
     }
 
-    if (audio_tx_task_handle != NULL) {
-        vTaskDelete(audio_tx_task_handle);
-        audio_tx_task_handle = NULL;
-    }
+    // Nobody is producing or consuming now; a late frame is flushed on start
+    ringbuf_flush(bt_rx_ringbuf);
+    ringbuf_flush(bt_tx_ringbuf);
 
-    // Clear ring buffers
-    if (bt_rx_ringbuf != NULL) {
-        // Drain the buffer
-        size_t item_size;
-        uint8_t *data;
-        while ((data = xRingbufferReceive(bt_rx_ringbuf, &item_size, 0)) != NULL) {
-            vRingbufferReturnItem(bt_rx_ringbuf, data);
+    ESP_LOGI(TAG, "Audio bridge stopped");
+}
+
+bool audio_bridge_is_running(void)
+{
+    return bridge_running;
+}
+
+void audio_bridge_set_tap(const audio_bridge_tap_t *tap)
+{
+    portENTER_CRITICAL(&tap_lock);
+    bridge_tap = tap;
+    portEXIT_CRITICAL(&tap_lock);
+
+    // A task already inside the old tap finishes its frame first
+    for (;;) {
+        portENTER_CRITICAL(&tap_lock);
+        uint8_t users = tap_users;
+        portEXIT_CRITICAL(&tap_lock);
+        if (users == 0) {
+            break;
         }
+        vTaskDelay(1);
     }
+}
 
-    if (bt_tx_ringbuf != NULL) {
-        // Drain the buffer
-        size_t item_size;
-        uint8_t *data;
-        while ((data = xRingbufferReceive(bt_tx_ringbuf, &item_size, 0)) != NULL) {
-            vRingbufferReturnItem(bt_tx_ringbuf, data);
-        }
+void audio_bridge_mark_cut_through(audio_cut_through_kind_t kind)
+{
+    if (kind >= AUDIO_CUT_THROUGH_KINDS) {
+        return;
     }
 
-    ESP_LOGI(TAG, "Audio bridge stopped");
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&cut_lock);
+    if (cut_start_us == 0 || now - cut_start_us > (int64_t)AUDIO_CUT_THROUGH_MAX_MS * 1000) {
+        cut_start_us = now;
+        cut_kind = kind;
+    }
+    portEXIT_CRITICAL(&cut_lock);
+}
+
+void audio_bridge_get_cut_through(audio_cut_through_t out[AUDIO_CUT_THROUGH_KINDS])
+{
+    portENTER_CRITICAL(&cut_lock);
+    memcpy(out, cut_stats, sizeof(cut_stats));
+    portEXIT_CRITICAL(&cut_lock);
+}
+
+void audio_bridge_count_xrun(audio_xrun_kind_t kind)
+{
+    if (kind < AUDIO_XRUN_KINDS && bridge_running) {
+        __atomic_fetch_add(&xrun_counts[kind], 1, __ATOMIC_RELAXED);
+    }
+}
+
+void audio_bridge_get_xruns(uint32_t out[AUDIO_XRUN_KINDS])
+{
+    for (int i = 0; i < AUDIO_XRUN_KINDS; i++) {
+        out[i] = __atomic_load_n(&xrun_counts[i], __ATOMIC_RELAXED);
+    }
 }
 
 /**
@@ -1,15 +1,69 @@
 #ifndef __AUDIO_BRIDGE_H__
 #define __AUDIO_BRIDGE_H__
 
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "freertos/ringbuf.h"
 
+/**
+ * @brief Whether the SCO link was already up when a call's voice path was needed
+ */
+typedef enum {
+    AUDIO_CUT_THROUGH_COLD,   // Waiting for the audio gateway to open SCO
+    AUDIO_CUT_THROUGH_WARM,   // SCO already up, or requested by the gateway itself
+    AUDIO_CUT_THROUGH_KINDS
+} audio_cut_through_kind_t;
+
+/**
+ * @brief Voice cut-through delay statistics
+ *
+ * Measured from the moment the call needs a voice path (answer sent, or the
+ * audio gateway reporting an outgoing call active) to the first downlink
+ * frame written to the DAC.
+ */
+typedef struct {
+    uint32_t count;      // Calls measured
+    uint32_t last_us;    // Most recent delay
+    uint32_t max_us;     // Worst delay
+    uint64_t total_us;   // Sum, for averaging
+} audio_cut_through_t;
+
+/**
+ * @brief Ways the bridge can glitch, counted while it runs
+ */
+typedef enum {
+    AUDIO_XRUN_DOWNLINK_UNDERRUN,   // DAC side waited a full I/O timeout for Bluetooth audio
+    AUDIO_XRUN_DOWNLINK_OVERRUN,    // Bluetooth audio dropped, downlink ring buffer full
+    AUDIO_XRUN_UPLINK_UNDERRUN,     // Stack asked for microphone audio, none ready
+    AUDIO_XRUN_UPLINK_OVERRUN,      // Microphone frame dropped, uplink ring buffer full
+    AUDIO_XRUN_KINDS
+} audio_xrun_kind_t;
+
+/**
+ * @brief Per-frame hooks into the bridge tasks
+ *
+ * Taps run on the bridge tasks, once per frame, and see the samples where
+ * they already are: the downlink frame in the ring buffer item and the
+ * uplink frame in the I2S read buffer. They must not block.
+ */
+typedef struct {
+    // Downlink frame from Bluetooth before it reaches the DAC. Return true
+    // to consume it; it is then not played.
+    bool (*downlink)(const int16_t *pcm, size_t samples, void *ctx);
+    // Uplink frame from the ADC before it is queued for Bluetooth. May
+    // rewrite the samples in place.
+    void (*uplink)(int16_t *pcm, size_t samples, void *ctx);
+    void *ctx;
+} audio_bridge_tap_t;
+
 /**
  * @brief Initialize the audio bridge module
  *
- * Sets up I2S RX channel for receiving audio from PCM1808 ADC.
- * The TX channel is managed by audio_output module.
- * Must be called after audio_output_init().
+ * Sets up the ring buffers and creates the bridge tasks from static storage;
+ * the tasks stay parked until audio_bridge_start(). The I2S channels are
+ * managed by the audio_output module. Must be called after audio_output_init().
  *
  * @return ESP_OK on success, error code on failure
  */
@@ -18,10 +72,12 @@ esp_err_t audio_bridge_init(void);
 /**
  * @brief Start audio bridging between I2S and Bluetooth
  *
- * Creates two FreeRTOS tasks:
+ * Flushes the ring buffers and wakes the two resident bridge tasks:
  * - audio_rx_task: Reads audio from PCM1808 ADC (I2S RX) and sends to Bluetooth
  * - audio_tx_task: Reads audio from Bluetooth and writes to PCM5100 DAC (I2S TX)
  *
+ * Constant time, no allocation. Does nothing if already running.
+ *
  * Should be called when Bluetooth audio connection is established.
  */
 void audio_bridge_start(void);
@@ -29,11 +85,61 @@ void audio_bridge_start(void);
 /**
  * @brief Stop audio bridging
  *
- * Deletes the audio RX and TX tasks.
+ * Asks the audio RX and TX tasks to park, waits (at most
+ * AUDIO_BRIDGE_DRAIN_TIMEOUT_MS) until both have finished the frame in hand,
+ * then flushes the ring buffers. Tasks are never deleted, so none is killed
+ * mid-transfer or while holding a ring buffer item.
  * Should be called when Bluetooth audio connection is disconnected.
  */
 void audio_bridge_stop(void);
 
+/**
+ * @brief Whether the bridge tasks are currently moving audio
+ */
+bool audio_bridge_is_running(void);
+
+/**
+ * @brief Install or remove the frame taps
+ *
+ * Once this returns, the previous tap is not called again, so its buffers
+ * can be reused. Either callback may be NULL.
+ *
+ * @param tap Taps to call, kept by reference until replaced; NULL to remove
+ */
+void audio_bridge_set_tap(const audio_bridge_tap_t *tap);
+
+/**
+ * @brief Start a cut-through measurement
+ *
+ * Called when a call needs its voice path. The measurement completes on the
+ * next downlink frame written to the DAC. Ignored if one is already pending.
+ *
+ * @param kind Whether the SCO link is already open
+ */
+void audio_bridge_mark_cut_through(audio_cut_through_kind_t kind);
+
+/**
+ * @brief Get cut-through delay statistics
+ *
+ * @param out Array of AUDIO_CUT_THROUGH_KINDS entries, indexed by kind
+ */
+void audio_bridge_get_cut_through(audio_cut_through_t out[AUDIO_CUT_THROUGH_KINDS]);
+
+/**
+ * @brief Count an underrun or overrun
+ *
+ * Safe from any task, including the Bluetooth data callbacks. Ignored while
+ * the bridge is stopped.
+ */
+void audio_bridge_count_xrun(audio_xrun_kind_t kind);
+
+/**
+ * @brief Get the running underrun/overrun totals since boot
+ *
+ * @param out Array of AUDIO_XRUN_KINDS entries, indexed by kind
+ */
+void audio_bridge_get_xruns(uint32_t out[AUDIO_XRUN_KINDS]);
+
 /**
  * @brief Get the Bluetooth RX ring buffer handle
  *
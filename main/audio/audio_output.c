@@ -1,14 +1,21 @@
 #include "audio_output.h"
 #include "config/audio_config.h"
 #include "config/pin_assignments.h"
+#include "config/call_config.h"
 #include "tones.h"
+#include "caller_id_fsk.h"
+#include "ima_adpcm.h"
+#include "storage/settings.h"
+#include "driver/gpio.h"
 #include "driver/i2s_std.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include <math.h>
 #include <string.h>
+#include <inttypes.h>
 
 static const char *TAG = "audio_output";
 
@@ -21,160 +28,342 @@ static i2s_chan_handle_t rx_handle = NULL;
 // Tone state - protected by mutex
 static SemaphoreHandle_t tone_mutex = NULL;
 static volatile tone_type_t current_tone = TONE_NONE;
+static int64_t tone_event_us = 0;  // Timestamp of the event that requested current_tone
 static TaskHandle_t tone_task_handle = NULL;
 
-// Volume factor for tone generation (0.0 to 1.0)
-#define TONE_VOLUME 0.2f
+// Event-to-tone latency - protected by tone_mutex
+static audio_tone_latency_t tone_latency = { .min_us = UINT32_MAX };
+
+// Ringing - protected by tone_mutex. Positions count output samples, so the
+// ring command edges and the Caller ID burst run off one clock.
+typedef enum {
+    RING_CID_IDLE,      // No message for this ring
+    RING_CID_QUEUED,    // Waiting for its slot after the first ring
+    RING_CID_SENDING,   // Burst in progress
+    RING_CID_DONE,      // Sent, or its slot has passed
+} ring_cid_state_t;
+
+static bool ring_active = false;
+static uint32_t ring_pos = 0;       // Samples into the current cadence cycle
+static uint32_t ring_cycle = 0;     // Cadence cycles completed
+static ring_cid_state_t ring_cid_state = RING_CID_IDLE;
+static cid_fsk_t ring_cid;
+
+_Static_assert(AUDIO_SAMPLE_RATE == CID_SAMPLE_RATE, "Caller ID modulator rate");
+
+#define MS_TO_SAMPLES(ms)       ((uint32_t)(ms) * AUDIO_SAMPLE_RATE / 1000)
+#define RING_ON_SAMPLES         MS_TO_SAMPLES(RING_ON_MS)
+#define RING_CYCLE_SAMPLES      MS_TO_SAMPLES(RING_ON_MS + RING_OFF_MS)
+#define CID_FIRST_SAMPLE        (RING_ON_SAMPLES + MS_TO_SAMPLES(CALLER_ID_DELAY_MS))
+#define CID_END_LIMIT           (RING_CYCLE_SAMPLES - MS_TO_SAMPLES(CALLER_ID_GUARD_MS))
+
+// Downlink overlay - protected by tone_mutex. Advanced by the voice samples
+// passing through audio_output_write(), so it never opens a gap in the call.
+static bool overlay_active = false;
+static audio_overlay_seg_t overlay_segs[AUDIO_OVERLAY_MAX_SEGS];
+static size_t overlay_count = 0;
+static size_t overlay_index = 0;        // Segment playing, overlay_count once into the burst
+static uint32_t overlay_left = 0;       // Samples left in the segment
+static float overlay_phase1 = 0.0f;
+static float overlay_phase2 = 0.0f;
+static bool overlay_cid_queued = false;
+static cid_fsk_t overlay_cid;
+
+// Announcement clips - protected by tone_mutex. Only the descriptors are
+// held here; the audio is decoded from flash into the output frame.
+static audio_clip_t clips[AUDIO_CLIPS_MAX];
+static size_t clip_count = 0;           // 0 when no clips are playing
+static size_t clip_index = 0;
+static uint32_t clip_pos = 0;           // Bytes into the clip
+static ima_adpcm_state_t clip_codec;
 
 // Pre-computed values for efficiency
 #define TWO_PI (2.0f * M_PI)
 
+static void record_tone_latency(int64_t event_us)
+{
+    int64_t elapsed = esp_timer_get_time() - event_us;
+    uint32_t latency_us = (elapsed > 0) ? (uint32_t)elapsed : 0;
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    tone_latency.count++;
+    tone_latency.last_us = latency_us;
+    tone_latency.total_us += latency_us;
+    if (latency_us < tone_latency.min_us) tone_latency.min_us = latency_us;
+    if (latency_us > tone_latency.max_us) tone_latency.max_us = latency_us;
+    xSemaphoreGive(tone_mutex);
+
+    ESP_LOGD(TAG, "Tone started %" PRIu32 " us after event", latency_us);
+}
+
+/**
+ * @brief Mix the overlay into voice samples in place
+ *
+ * Called with tone_mutex held.
+ */
+static void overlay_mix(int16_t *samples, size_t count)
+{
+    size_t i = 0;
+
+    while (i < count && overlay_active) {
+        if (overlay_index < overlay_count) {
+            const audio_overlay_seg_t *seg = &overlay_segs[overlay_index];
+            float inc1 = TWO_PI * seg->freq1 / AUDIO_SAMPLE_RATE;
+            float inc2 = TWO_PI * seg->freq2 / AUDIO_SAMPLE_RATE;
+            size_t n = count - i;
+            if (n > overlay_left) {
+                n = overlay_left;
+            }
+
+            for (size_t k = i; k < i + n; k++) {
+                float tone = 0.0f;
+                if (seg->freq1) {
+                    tone += sinf(overlay_phase1);
+                    overlay_phase1 += inc1;
+                    if (overlay_phase1 >= TWO_PI) overlay_phase1 -= TWO_PI;
+                }
+                if (seg->freq2) {
+                    tone += sinf(overlay_phase2);
+                    overlay_phase2 += inc2;
+                    if (overlay_phase2 >= TWO_PI) overlay_phase2 -= TWO_PI;
+                }
+                int32_t mixed = (seg->mute_voice ? 0 : samples[k]) + (int32_t)(seg->level * tone);
+                if (mixed > INT16_MAX) mixed = INT16_MAX;
+                if (mixed < INT16_MIN) mixed = INT16_MIN;
+                samples[k] = (int16_t)mixed;
+            }
+
+            i += n;
+            overlay_left -= n;
+            if (overlay_left == 0) {
+                overlay_index++;
+                overlay_phase1 = 0.0f;
+                overlay_phase2 = 0.0f;
+                if (overlay_index < overlay_count) {
+                    overlay_left = MS_TO_SAMPLES(overlay_segs[overlay_index].duration_ms);
+                }
+            }
+        } else if (overlay_cid_queued) {
+            // The burst replaces the voice outright
+            size_t n = cid_fsk_render(&overlay_cid, samples + i, count - i);
+            i += n;
+            if (i < count) {
+                overlay_active = false;
+            }
+        } else {
+            overlay_active = false;
+        }
+    }
+}
+
+/**
+ * @brief Decode the next frame of the clips
+ *
+ * Pads the frame with silence after the last clip. Returns false if the
+ * clips had already ended and nothing was rendered.
+ */
+static bool clips_render_frame(int16_t *buffer)
+{
+    size_t filled = 0;
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    while (filled < AUDIO_FRAME_SAMPLES && clip_index < clip_count) {
+        const audio_clip_t *clip = &clips[clip_index];
+        uint32_t bytes = (AUDIO_FRAME_SAMPLES - filled) / 2;
+        if (bytes > clip->len - clip_pos) {
+            bytes = clip->len - clip_pos;
+        }
+
+        if (clip->adpcm != NULL) {
+            ima_adpcm_decode(&clip_codec, clip->adpcm + clip_pos, bytes, buffer + filled);
+        } else {
+            memset(buffer + filled, 0, 2 * bytes * sizeof(int16_t));
+        }
+        filled += 2 * bytes;
+        clip_pos += bytes;
+
+        if (clip_pos >= clip->len) {
+            clip_index++;
+            clip_pos = 0;
+            ima_adpcm_init(&clip_codec);
+        }
+    }
+    if (clip_index >= clip_count) {
+        clip_count = 0;
+    }
+    xSemaphoreGive(tone_mutex);
+
+    memset(buffer + filled, 0, (AUDIO_FRAME_SAMPLES - filled) * sizeof(int16_t));
+    return filled > 0;
+}
+
+/**
+ * @brief Render one frame of the ring cadence
+ *
+ * Silence, apart from the Caller ID burst in the first off period. Sets the
+ * ring command for the frame. Returns the sample offset from the end of the
+ * first ring at which a Caller ID burst started in this frame, or -1.
+ */
+static int32_t ring_render_frame(int16_t *buffer)
+{
+    int32_t cid_started = -1;
+
+    memset(buffer, 0, AUDIO_FRAME_SAMPLES * sizeof(int16_t));
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool ring_on = ring_pos < RING_ON_SAMPLES;
+    uint32_t offset = 0;
+
+    if (ring_cid_state == RING_CID_QUEUED && !ring_on) {
+        uint32_t start = (ring_pos > CID_FIRST_SAMPLE) ? ring_pos : CID_FIRST_SAMPLE;
+        if (ring_cycle > 0 || start + cid_fsk_samples(&ring_cid) > CID_END_LIMIT) {
+            ring_cid_state = RING_CID_DONE;     // Would run into the second ring
+        } else if (start < ring_pos + AUDIO_FRAME_SAMPLES) {
+            offset = start - ring_pos;
+            cid_started = (int32_t)(start - RING_ON_SAMPLES);
+            ring_cid_state = RING_CID_SENDING;
+        }
+    }
+    if (ring_cid_state == RING_CID_SENDING) {
+        size_t want = AUDIO_FRAME_SAMPLES - offset;
+        if (cid_fsk_render(&ring_cid, buffer + offset, want) < want) {
+            ring_cid_state = RING_CID_DONE;
+        }
+    }
+
+    ring_pos += AUDIO_FRAME_SAMPLES;
+    if (ring_pos >= RING_CYCLE_SAMPLES) {
+        ring_pos = 0;
+        ring_cycle++;
+    }
+    xSemaphoreGive(tone_mutex);
+
+    gpio_set_level(PIN_RING_COMMAND, ring_on ? 1 : 0);
+    return cid_started;
+}
+
 /**
  * @brief Tone generation task
  *
- * Runs continuously, generating audio samples when a tone is active.
+ * Sleeps until a tone is requested, then generates it one 20 ms frame at a
+ * time so a change of tone takes effect at the next frame boundary.
  * Uses sine wave synthesis for dual-frequency tones.
  */
 static void tone_generation_task(void *arg)
 {
     ESP_LOGI(TAG, "Tone generation task started");
 
-    int16_t buffer[AUDIO_BUFFER_SIZE];
+    int16_t buffer[AUDIO_FRAME_SAMPLES];
+    tone_type_t playing = TONE_NONE;
     float phase1 = 0.0f;
     float phase2 = 0.0f;
+    float phase_inc1 = 0.0f;
+    float phase_inc2 = 0.0f;
+    bool dual = false;
+    float amplitude = 0.0f;    // Tone level from the settings, in sample units
+    int samples_on = 0;
+    int cadence_len = 0;   // Samples per on/off cycle, 0 for continuous
+    int cadence_pos = 0;
 
     while (1) {
-        // Check if we have a tone to play
         xSemaphoreTake(tone_mutex, portMAX_DELAY);
-        tone_type_t tone_to_play = current_tone;
+        tone_type_t requested = current_tone;
+        int64_t event_us = tone_event_us;
+        bool ringing = ring_active;
+        bool announcing = (clip_count > 0);
         xSemaphoreGive(tone_mutex);
 
-        if (tone_to_play == TONE_NONE) {
-            // No tone active, sleep briefly
-            vTaskDelay(pdMS_TO_TICKS(50));
-            phase1 = 0.0f;
-            phase2 = 0.0f;
+        if (announcing) {
+            // The tone, if any, restarts its cadence once the clips end
+            playing = TONE_NONE;
+            if (clips_render_frame(buffer)) {
+                size_t bytes_written;
+                i2s_channel_write(tx_handle, buffer, sizeof(buffer), &bytes_written, portMAX_DELAY);
+                continue;
+            }
+        }
+
+        if (requested == TONE_NONE && ringing) {
+            // Keep the stream running so cadence and Caller ID stay sample-locked
+            playing = TONE_NONE;
+            int32_t cid_offset = ring_render_frame(buffer);
+            size_t bytes_written;
+            i2s_channel_write(tx_handle, buffer, sizeof(buffer), &bytes_written, portMAX_DELAY);
+            if (cid_offset >= 0) {
+                ESP_LOGI(TAG, "Caller ID started %" PRId32 " samples after the first ring",
+                         cid_offset);
+            }
             continue;
         }
 
-        // Get tone parameters
-        const tone_t *tone = tone_get_definition(tone_to_play);
-        if (tone == NULL) {
-            ESP_LOGW(TAG, "Invalid tone type: %d", tone_to_play);
-            vTaskDelay(pdMS_TO_TICKS(100));
+        if (requested == TONE_NONE) {
+            // Nothing to play - sleep until audio_output_play_tone() wakes us
+            playing = TONE_NONE;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
             continue;
         }
 
-        // Calculate phase increments per sample
-        float phase_inc1 = TWO_PI * tone->freq1 / AUDIO_SAMPLE_RATE;
-        float phase_inc2 = tone->freq2 ? (TWO_PI * tone->freq2 / AUDIO_SAMPLE_RATE) : 0.0f;
-
-        if (tone->duration_on < 0) {
-            // Continuous tone - generate until stopped or changed
-            while (1) {
-                // Check if tone changed
-                xSemaphoreTake(tone_mutex, portMAX_DELAY);
-                if (current_tone != tone_to_play) {
-                    xSemaphoreGive(tone_mutex);
-                    break;
-                }
-                xSemaphoreGive(tone_mutex);
-
-                // Generate buffer of samples
-                for (int i = 0; i < AUDIO_BUFFER_SIZE; i++) {
-                    float sample1 = sinf(phase1);
-                    float sample2 = tone->freq2 ? sinf(phase2) : 0.0f;
-                    float mixed = (sample1 + sample2) / 2.0f;
-                    buffer[i] = (int16_t)(32767.0f * TONE_VOLUME * mixed);
-
-                    phase1 += phase_inc1;
-                    if (phase1 >= TWO_PI) phase1 -= TWO_PI;
-                    phase2 += phase_inc2;
-                    if (phase2 >= TWO_PI) phase2 -= TWO_PI;
-                }
+        bool started = false;
+        if (requested != playing) {
+            const tone_t *tone = tone_get_definition(requested);
+            if (tone == NULL) {
+                ESP_LOGW(TAG, "Invalid tone type: %d", requested);
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+                continue;
+            }
 
-                // Write to I2S
-                size_t bytes_written;
-                esp_err_t ret = i2s_channel_write(tx_handle, buffer,
-                                                   AUDIO_BUFFER_SIZE * sizeof(int16_t),
-                                                   &bytes_written, portMAX_DELAY);
-                if (ret != ESP_OK) {
-                    ESP_LOGW(TAG, "I2S write failed: %s", esp_err_to_name(ret));
-                }
+            // Calculate phase increments per sample and the cadence
+            phase1 = 0.0f;
+            phase2 = 0.0f;
+            phase_inc1 = TWO_PI * tone->freq1 / AUDIO_SAMPLE_RATE;
+            phase_inc2 = tone->freq2 ? (TWO_PI * tone->freq2 / AUDIO_SAMPLE_RATE) : 0.0f;
+            dual = (tone->freq2 != 0);
+            settings_t cfg;
+            settings_get(&cfg);
+            amplitude = 32767.0f * cfg.audio.tone_level_pct / 100.0f;
+            if (tone->duration_on < 0) {
+                samples_on = 0;
+                cadence_len = 0;
+            } else {
+                int samples_off = (tone->duration_off > 0) ? (int)(tone->duration_off * AUDIO_SAMPLE_RATE) : 0;
+                samples_on = (int)(tone->duration_on * AUDIO_SAMPLE_RATE);
+                cadence_len = samples_on + samples_off;
             }
-        } else {
-            // Pulsed tone - on/off cadence
-            int samples_on = (int)(tone->duration_on * AUDIO_SAMPLE_RATE);
-            int samples_off = (int)(tone->duration_off * AUDIO_SAMPLE_RATE);
-
-            while (1) {
-                // Check if tone changed
-                xSemaphoreTake(tone_mutex, portMAX_DELAY);
-                if (current_tone != tone_to_play) {
-                    xSemaphoreGive(tone_mutex);
-                    break;
-                }
-                xSemaphoreGive(tone_mutex);
-
-                // Generate "on" phase
-                int samples_generated = 0;
-                while (samples_generated < samples_on) {
-                    int samples_this_buffer = AUDIO_BUFFER_SIZE;
-                    if (samples_generated + samples_this_buffer > samples_on) {
-                        samples_this_buffer = samples_on - samples_generated;
-                    }
-
-                    for (int i = 0; i < samples_this_buffer; i++) {
-                        float sample1 = sinf(phase1);
-                        float sample2 = tone->freq2 ? sinf(phase2) : 0.0f;
-                        float mixed = (sample1 + sample2) / 2.0f;
-                        buffer[i] = (int16_t)(32767.0f * TONE_VOLUME * mixed);
-
-                        phase1 += phase_inc1;
-                        if (phase1 >= TWO_PI) phase1 -= TWO_PI;
-                        phase2 += phase_inc2;
-                        if (phase2 >= TWO_PI) phase2 -= TWO_PI;
-                    }
-
-                    size_t bytes_written;
-                    i2s_channel_write(tx_handle, buffer,
-                                      samples_this_buffer * sizeof(int16_t),
-                                      &bytes_written, portMAX_DELAY);
-                    samples_generated += samples_this_buffer;
-                }
+            cadence_pos = 0;
+            playing = requested;
+            started = true;
+        }
 
-                // Generate "off" phase (silence)
-                if (samples_off > 0) {
-                    memset(buffer, 0, AUDIO_BUFFER_SIZE * sizeof(int16_t));
-                    samples_generated = 0;
-                    while (samples_generated < samples_off) {
-                        int samples_this_buffer = AUDIO_BUFFER_SIZE;
-                        if (samples_generated + samples_this_buffer > samples_off) {
-                            samples_this_buffer = samples_off - samples_generated;
-                        }
-
-                        size_t bytes_written;
-                        i2s_channel_write(tx_handle, buffer,
-                                          samples_this_buffer * sizeof(int16_t),
-                                          &bytes_written, portMAX_DELAY);
-                        samples_generated += samples_this_buffer;
-
-                        // Check if tone changed during silence
-                        xSemaphoreTake(tone_mutex, portMAX_DELAY);
-                        if (current_tone != tone_to_play) {
-                            xSemaphoreGive(tone_mutex);
-                            goto next_tone;
-                        }
-                        xSemaphoreGive(tone_mutex);
-                    }
-                }
+        // Generate one frame, silencing the "off" part of the cadence
+        for (int i = 0; i < AUDIO_FRAME_SAMPLES; i++) {
+            if (cadence_len == 0 || cadence_pos < samples_on) {
+                float sample1 = sinf(phase1);
+                float sample2 = dual ? sinf(phase2) : 0.0f;
+                float mixed = (sample1 + sample2) / 2.0f;
+                buffer[i] = (int16_t)(amplitude * mixed);
+
+                phase1 += phase_inc1;
+                if (phase1 >= TWO_PI) phase1 -= TWO_PI;
+                phase2 += phase_inc2;
+                if (phase2 >= TWO_PI) phase2 -= TWO_PI;
+            } else {
+                buffer[i] = 0;
+            }
+
+            if (cadence_len > 0 && ++cadence_pos >= cadence_len) {
+                cadence_pos = 0;
             }
-            next_tone:;
         }
 
-        // Reset phases for next tone
-        phase1 = 0.0f;
-        phase2 = 0.0f;
+        // Write to I2S
+        size_t bytes_written;
+        esp_err_t ret = i2s_channel_write(tx_handle, buffer, sizeof(buffer),
+                                          &bytes_written, portMAX_DELAY);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "I2S write failed: %s", esp_err_to_name(ret));
+        } else if (started && event_us != 0) {
+            record_tone_latency(event_us);
+        }
     }
 }
 
@@ -192,6 +381,9 @@ esp_err_t audio_output_init(void)
     // I2S channel configuration - create both TX and RX channels together
     // This is required by ESP-IDF: both channels on same port must be created in single call
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(AUDIO_I2S_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = AUDIO_I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = AUDIO_I2S_DMA_FRAME_NUM;
+    chan_cfg.auto_clear = true;  // Send silence rather than stale samples on underrun
 
     // Create both TX and RX channels in one call
     esp_err_t ret = i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle);
@@ -317,14 +509,47 @@ esp_err_t audio_output_write(const void *data, size_t len, size_t *bytes_written
         return ESP_ERR_INVALID_STATE;
     }
 
-    // If a tone is playing, block or return
-    if (audio_output_tone_active()) {
+    // If a tone or announcement is playing or the handset is ringing, block or return
+    if (audio_output_tone_active() || audio_output_clips_active() || audio_output_ringing()) {
         *bytes_written = 0;
         return ESP_OK;  // Silently drop - tone has priority
     }
 
-    return i2s_channel_write(tx_handle, data, len, bytes_written,
-                              pdMS_TO_TICKS(timeout_ms));
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool mixing = overlay_active;
+    xSemaphoreGive(tone_mutex);
+
+    if (!mixing) {
+        return i2s_channel_write(tx_handle, data, len, bytes_written,
+                                  pdMS_TO_TICKS(timeout_ms));
+    }
+
+    // Mix the overlay into a copy of the voice, one frame at a time
+    int16_t mixed[AUDIO_FRAME_SAMPLES];
+    const uint8_t *src = data;
+    *bytes_written = 0;
+
+    while (*bytes_written < len) {
+        size_t chunk = len - *bytes_written;
+        if (chunk > sizeof(mixed)) {
+            chunk = sizeof(mixed);
+        }
+        memcpy(mixed, src + *bytes_written, chunk);
+
+        xSemaphoreTake(tone_mutex, portMAX_DELAY);
+        overlay_mix(mixed, chunk / sizeof(int16_t));
+        xSemaphoreGive(tone_mutex);
+
+        size_t written = 0;
+        esp_err_t ret = i2s_channel_write(tx_handle, mixed, chunk, &written,
+                                          pdMS_TO_TICKS(timeout_ms));
+        *bytes_written += written;
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    return ESP_OK;
 }
 
 i2s_chan_handle_t audio_output_get_rx_handle(void)
@@ -333,6 +558,11 @@ i2s_chan_handle_t audio_output_get_rx_handle(void)
 }
 
 esp_err_t audio_output_play_tone(tone_type_t tone)
+{
+    return audio_output_play_tone_stamped(tone, 0);
+}
+
+esp_err_t audio_output_play_tone_stamped(tone_type_t tone, int64_t event_us)
 {
     if (tone_mutex == NULL) {
         return ESP_ERR_INVALID_STATE;
@@ -343,13 +573,40 @@ esp_err_t audio_output_play_tone(tone_type_t tone)
     }
 
     xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool changed = (current_tone != tone);
     current_tone = tone;
+    if (changed) {
+        tone_event_us = event_us;
+    }
     xSemaphoreGive(tone_mutex);
 
-    ESP_LOGI(TAG, "Playing tone: %d", tone);
+    if (changed) {
+        xTaskNotifyGive(tone_task_handle);
+        ESP_LOGI(TAG, "Playing tone: %d", tone);
+    }
     return ESP_OK;
 }
 
+void audio_output_get_tone_latency(audio_tone_latency_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+
+    memset(out, 0, sizeof(*out));
+    if (tone_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    *out = tone_latency;
+    xSemaphoreGive(tone_mutex);
+
+    if (out->count == 0) {
+        out->min_us = 0;
+    }
+}
+
 esp_err_t audio_output_stop_tone(void)
 {
     return audio_output_play_tone(TONE_NONE);
@@ -380,3 +637,172 @@ tone_type_t audio_output_get_current_tone(void)
 
     return tone;
 }
+
+esp_err_t audio_output_ring_start(void)
+{
+    if (tone_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool was_active = ring_active;
+    if (!was_active) {
+        ring_active = true;
+        ring_pos = 0;
+        ring_cycle = 0;
+        ring_cid_state = RING_CID_IDLE;
+    }
+    xSemaphoreGive(tone_mutex);
+
+    if (!was_active) {
+        xTaskNotifyGive(tone_task_handle);
+        ESP_LOGI(TAG, "Ringing");
+    }
+    return ESP_OK;
+}
+
+esp_err_t audio_output_ring_caller_id(const uint8_t *msg, size_t len)
+{
+    if (tone_mutex == NULL || msg == NULL || len == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    if (ring_active && ring_cid_state == RING_CID_IDLE) {
+        cid_fsk_init(&ring_cid, msg, len, CALLER_ID_LEVEL);
+        ring_cid_state = RING_CID_QUEUED;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(tone_mutex);
+    return ret;
+}
+
+void audio_output_ring_stop(void)
+{
+    if (tone_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool was_active = ring_active;
+    ring_active = false;
+    ring_cid_state = RING_CID_IDLE;
+    xSemaphoreGive(tone_mutex);
+
+    // Ring trip: drop the ring command now rather than at the next frame
+    gpio_set_level(PIN_RING_COMMAND, 0);
+    if (was_active) {
+        ESP_LOGI(TAG, "Ringing stopped");
+    }
+}
+
+bool audio_output_ringing(void)
+{
+    if (tone_mutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool active = ring_active;
+    xSemaphoreGive(tone_mutex);
+
+    return active;
+}
+
+esp_err_t audio_output_overlay_start(const audio_overlay_seg_t *segs, size_t count)
+{
+    if (tone_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (segs == NULL || count == 0 || count > AUDIO_OVERLAY_MAX_SEGS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    memcpy(overlay_segs, segs, count * sizeof(audio_overlay_seg_t));
+    overlay_count = count;
+    overlay_index = 0;
+    overlay_left = MS_TO_SAMPLES(segs[0].duration_ms);
+    overlay_phase1 = 0.0f;
+    overlay_phase2 = 0.0f;
+    overlay_cid_queued = false;
+    overlay_active = true;
+    xSemaphoreGive(tone_mutex);
+
+    return ESP_OK;
+}
+
+esp_err_t audio_output_overlay_caller_id(const uint8_t *msg, size_t len)
+{
+    if (tone_mutex == NULL || msg == NULL || len == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    if (overlay_active && overlay_index < overlay_count && !overlay_cid_queued) {
+        cid_fsk_init(&overlay_cid, msg, len, CALLER_ID_LEVEL);
+        overlay_cid_queued = true;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(tone_mutex);
+    return ret;
+}
+
+void audio_output_overlay_stop(void)
+{
+    if (tone_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    overlay_active = false;
+    overlay_cid_queued = false;
+    xSemaphoreGive(tone_mutex);
+}
+
+esp_err_t audio_output_play_clips(const audio_clip_t *list, size_t count)
+{
+    if (tone_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (list == NULL || count == 0 || count > AUDIO_CLIPS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    memcpy(clips, list, count * sizeof(audio_clip_t));
+    clip_count = count;
+    clip_index = 0;
+    clip_pos = 0;
+    ima_adpcm_init(&clip_codec);
+    xSemaphoreGive(tone_mutex);
+
+    xTaskNotifyGive(tone_task_handle);
+    return ESP_OK;
+}
+
+void audio_output_stop_clips(void)
+{
+    if (tone_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    clip_count = 0;
+    xSemaphoreGive(tone_mutex);
+}
+
+bool audio_output_clips_active(void)
+{
+    if (tone_mutex == NULL) {
+        return false;
+    }
+
+    xSemaphoreTake(tone_mutex, portMAX_DELAY);
+    bool active = (clip_count > 0);
+    xSemaphoreGive(tone_mutex);
+
+    return active;
+}
@@ -1,6 +1,8 @@
 #ifndef __AUDIO_OUTPUT_H__
 #define __AUDIO_OUTPUT_H__
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "driver/i2s_std.h"
 #include "audio/tones.h"
@@ -12,7 +14,7 @@
  * - TX: Audio output to phone speaker (tones and BT audio)
  * - RX: Audio input from phone microphone (to Bluetooth)
  *
- * Creates the tone generation task.
+ * Creates the tone generation task, which sleeps until a tone is started.
  * Must be called before audio_bridge_init().
  *
  * @return ESP_OK on success, error code on failure
@@ -54,6 +56,37 @@ esp_err_t audio_output_write(const void *data, size_t len, size_t *bytes_written
  */
 esp_err_t audio_output_play_tone(tone_type_t tone);
 
+/**
+ * @brief Start playing a tone on behalf of a timestamped event
+ *
+ * Same as audio_output_play_tone(), but records the time from event_us to
+ * the moment the first frame of the tone is queued to I2S in the latency
+ * statistics (see audio_output_get_tone_latency()).
+ *
+ * @param tone The tone type to play, or TONE_NONE to stop
+ * @param event_us esp_timer_get_time() of the triggering event
+ * @return ESP_OK on success
+ */
+esp_err_t audio_output_play_tone_stamped(tone_type_t tone, int64_t event_us);
+
+/**
+ * @brief Event-to-tone latency statistics
+ */
+typedef struct {
+    uint32_t count;      // Number of stamped tone starts measured
+    uint32_t last_us;    // Latency of the most recent start
+    uint32_t min_us;     // Best case
+    uint32_t max_us;     // Worst case
+    uint64_t total_us;   // Sum, for averaging
+} audio_tone_latency_t;
+
+/**
+ * @brief Get event-to-tone latency statistics
+ *
+ * @param out Destination for a copy of the statistics
+ */
+void audio_output_get_tone_latency(audio_tone_latency_t *out);
+
 /**
  * @brief Stop the currently playing tone
  *
@@ -77,4 +110,119 @@ bool audio_output_tone_active(void);
  */
 tone_type_t audio_output_get_current_tone(void);
 
+/**
+ * @brief One segment of a downlink overlay
+ */
+typedef struct {
+    uint16_t freq1;         // Hz, 0 for silence
+    uint16_t freq2;         // Hz, 0 for a single tone
+    uint16_t duration_ms;
+    int16_t level;          // Peak amplitude of each component
+    bool mute_voice;        // Replace the far end instead of mixing over it
+} audio_overlay_seg_t;
+
+/**
+ * @brief Mix a short tone sequence into the Bluetooth downlink
+ *
+ * Unlike a tone, which replaces the voice path, an overlay is added to the
+ * voice samples as they pass through audio_output_write(), so the call keeps
+ * playing underneath. Segments are timed in voice samples and play back to
+ * back; a Caller ID burst queued with audio_output_overlay_caller_id()
+ * follows the last one. Starting an overlay replaces any in progress.
+ *
+ * @param segs Segments, copied
+ * @param count Number of segments, at most AUDIO_OVERLAY_MAX_SEGS
+ * @return ESP_OK, ESP_ERR_INVALID_ARG on a bad count, ESP_ERR_INVALID_STATE
+ *         before audio_output_init()
+ */
+esp_err_t audio_output_overlay_start(const audio_overlay_seg_t *segs, size_t count);
+
+/**
+ * @brief Append an off-hook (Type II) Caller ID burst to the current overlay
+ *
+ * The far end is muted while the burst plays.
+ *
+ * @param msg MDMF message from cid_mdmf_build()
+ * @param len Message length
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE if no overlay is playing or its
+ *         segments have already finished
+ */
+esp_err_t audio_output_overlay_caller_id(const uint8_t *msg, size_t len);
+
+/**
+ * @brief Cancel the overlay; voice continues unmixed from the next write
+ */
+void audio_output_overlay_stop(void);
+
+/**
+ * @brief One clip of an announcement
+ */
+typedef struct {
+    const uint8_t *adpcm;   // 8 kHz IMA ADPCM, NULL for silence
+    uint32_t len;           // Bytes; two samples each, silence included
+} audio_clip_t;
+
+/**
+ * @brief Play recorded clips back to back on the handset
+ *
+ * The clips are decoded frame by frame straight from where they lie,
+ * normally a memory-mapped flash partition, so they must stay mapped until
+ * they have played or audio_output_stop_clips() has returned. Each clip
+ * starts from a fresh codec state. Clips go ahead of any tone; the tone
+ * picks up from the start of its cadence when they end. Starting clips
+ * replaces any in progress.
+ *
+ * @param clips Clips, copied; the audio is not
+ * @param count Number of clips, at most AUDIO_CLIPS_MAX
+ * @return ESP_OK, ESP_ERR_INVALID_ARG on a bad count, ESP_ERR_INVALID_STATE
+ *         before audio_output_init()
+ */
+esp_err_t audio_output_play_clips(const audio_clip_t *clips, size_t count);
+
+/**
+ * @brief Stop the clips; no clip audio is read after this returns
+ */
+void audio_output_stop_clips(void);
+
+/**
+ * @brief Whether clips are playing
+ */
+bool audio_output_clips_active(void);
+
+/**
+ * @brief Start ringing the handset
+ *
+ * The tone task drives PIN_RING_COMMAND with the RING_ON_MS/RING_OFF_MS
+ * cadence and keeps the output stream running, so ring edges and any Caller
+ * ID burst are positioned by the same sample count. A requested tone takes
+ * precedence; Bluetooth audio is dropped while ringing.
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_STATE before audio_output_init()
+ */
+esp_err_t audio_output_ring_start(void);
+
+/**
+ * @brief Queue an on-hook Caller ID message for the current ring
+ *
+ * The FSK burst starts CALLER_ID_DELAY_MS after the end of the first ring,
+ * exactly, or as soon as possible if the message arrives later and the
+ * burst still ends CALLER_ID_GUARD_MS before the second ring.
+ *
+ * @param msg MDMF message from cid_mdmf_build()
+ * @param len Message length
+ * @return ESP_OK if queued, ESP_ERR_INVALID_STATE if not ringing or a
+ *         message was already queued or sent for this ring
+ */
+esp_err_t audio_output_ring_caller_id(const uint8_t *msg, size_t len);
+
+/**
+ * @brief Stop ringing, releasing the ring command at once
+ */
+void audio_output_ring_stop(void);
+
+/**
+ * @brief Whether the handset is being rung
+ */
+bool audio_output_ringing(void);
+
 #endif /* __AUDIO_OUTPUT_H__ */
@@ -0,0 +1,175 @@
+#include "caller_id_fsk.h"
+#include <string.h>
+
+// MDMF message and parameter types (Bellcore GR-30)
+#define MDMF_MESSAGE_TYPE       0x80
+#define MDMF_PARAM_DATE_TIME    0x01
+#define MDMF_PARAM_NUMBER       0x02
+#define MDMF_PARAM_NO_NUMBER    0x04
+#define MDMF_PARAM_NAME         0x07
+#define MDMF_PARAM_NO_NAME      0x08
+#define MDMF_ABSENCE_OUT_OF_AREA 'O'
+
+#define FSK_BAUD                1200
+#define FSK_MARK_HZ             1200
+#define FSK_SPACE_HZ            2200
+#define FSK_SEIZURE_BITS        300
+#define FSK_MARK_BITS           180
+#define FSK_PREAMBLE_BITS       (FSK_SEIZURE_BITS + FSK_MARK_BITS)
+#define FSK_BITS_PER_BYTE       10      // Start, 8 data, stop
+
+// Phase step per sample for each tone, full circle = 2^32
+#define FSK_PHASE_STEP(hz)      ((uint32_t)(((uint64_t)(hz) << 32) / CID_SAMPLE_RATE))
+
+// First quadrant of a 256-point sine, Q15
+static const int16_t sine_quarter[65] = {
+        0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+     6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
+
+static int32_t sine_q15(uint32_t phase)
+{
+    uint8_t index = phase >> 24;
+    uint8_t step = index & 63;
+
+    switch (index >> 6) {
+        case 0:  return sine_quarter[step];
+        case 1:  return sine_quarter[64 - step];
+        case 2:  return -sine_quarter[step];
+        default: return -sine_quarter[64 - step];
+    }
+}
+
+// Append one parameter; returns the new length, 0 if it does not fit
+static size_t mdmf_param(uint8_t *buf, size_t len, size_t size, uint8_t type,
+                         const char *value, size_t value_len)
+{
+    if (len + 2 + value_len > size) {
+        return 0;
+    }
+    buf[len++] = type;
+    buf[len++] = (uint8_t)value_len;
+    memcpy(buf + len, value, value_len);
+    return len + value_len;
+}
+
+size_t cid_mdmf_build(const cid_info_t *info, uint8_t *buf, size_t size)
+{
+    // Leave room for the checksum
+    size_t limit = size - 1;
+    size_t len = 2;     // Type and length filled in last
+    static const char absent = MDMF_ABSENCE_OUT_OF_AREA;
+
+    if (size < CID_MDMF_MAX_LEN) {
+        return 0;
+    }
+
+    if (info->has_time) {
+        char stamp[9];
+        stamp[0] = '0' + info->month / 10;
+        stamp[1] = '0' + info->month % 10;
+        stamp[2] = '0' + info->day / 10;
+        stamp[3] = '0' + info->day % 10;
+        stamp[4] = '0' + info->hour / 10;
+        stamp[5] = '0' + info->hour % 10;
+        stamp[6] = '0' + info->minute / 10;
+        stamp[7] = '0' + info->minute % 10;
+        len = mdmf_param(buf, len, limit, MDMF_PARAM_DATE_TIME, stamp, 8);
+    }
+
+    if (len && info->number && info->number[0]) {
+        len = mdmf_param(buf, len, limit, MDMF_PARAM_NUMBER, info->number,
+                         strnlen(info->number, CID_FIELD_MAX_LEN));
+    } else if (len) {
+        len = mdmf_param(buf, len, limit, MDMF_PARAM_NO_NUMBER, &absent, 1);
+    }
+
+    if (len && info->name && info->name[0]) {
+        len = mdmf_param(buf, len, limit, MDMF_PARAM_NAME, info->name,
+                         strnlen(info->name, CID_FIELD_MAX_LEN));
+    } else if (len) {
+        len = mdmf_param(buf, len, limit, MDMF_PARAM_NO_NAME, &absent, 1);
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    buf[0] = MDMF_MESSAGE_TYPE;
+    buf[1] = (uint8_t)(len - 2);
+
+    // Checksum: twos complement of the modulo-256 sum of every other byte
+    uint8_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += buf[i];
+    }
+    buf[len++] = (uint8_t)(0x100 - sum);
+    return len;
+}
+
+void cid_fsk_init(cid_fsk_t *fsk, const uint8_t *msg, size_t len, int16_t level)
+{
+    if (len > CID_MDMF_MAX_LEN) {
+        len = CID_MDMF_MAX_LEN;
+    }
+    memcpy(fsk->msg, msg, len);
+    fsk->len = len;
+    fsk->bit_index = 0;
+    fsk->total_bits = FSK_PREAMBLE_BITS + len * FSK_BITS_PER_BYTE;
+    fsk->phase = 0;
+    fsk->bit_clock = 0;
+    fsk->level = level;
+}
+
+uint32_t cid_fsk_samples(const cid_fsk_t *fsk)
+{
+    return (fsk->total_bits * CID_SAMPLE_RATE + FSK_BAUD - 1) / FSK_BAUD;
+}
+
+// Bit n of the whole sequence
+static int fsk_bit(const cid_fsk_t *fsk, uint32_t n)
+{
+    if (n < FSK_SEIZURE_BITS) {
+        return n & 1;   // Seizure starts with a space
+    }
+    if (n < FSK_PREAMBLE_BITS) {
+        return 1;
+    }
+
+    n -= FSK_PREAMBLE_BITS;
+    uint32_t pos = n % FSK_BITS_PER_BYTE;
+    if (pos == 0) {
+        return 0;       // Start bit
+    }
+    if (pos == FSK_BITS_PER_BYTE - 1) {
+        return 1;       // Stop bit
+    }
+    return (fsk->msg[n / FSK_BITS_PER_BYTE] >> (pos - 1)) & 1;
+}
+
+size_t cid_fsk_render(cid_fsk_t *fsk, int16_t *out, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count && fsk->bit_index < fsk->total_bits; i++) {
+        uint32_t step = fsk_bit(fsk, fsk->bit_index) ? FSK_PHASE_STEP(FSK_MARK_HZ)
+                                                     : FSK_PHASE_STEP(FSK_SPACE_HZ);
+        out[i] = (int16_t)((sine_q15(fsk->phase) * fsk->level) >> 15);
+        fsk->phase += step;
+
+        // 1200 bits in 8000 samples: a bit lasts 6 or 7 samples, exact on average
+        fsk->bit_clock += FSK_BAUD;
+        if (fsk->bit_clock >= CID_SAMPLE_RATE) {
+            fsk->bit_clock -= CID_SAMPLE_RATE;
+            fsk->bit_index++;
+        }
+    }
+    return i;
+}
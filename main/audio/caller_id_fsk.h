@@ -0,0 +1,95 @@
+#ifndef __CALLER_ID_FSK_H__
+#define __CALLER_ID_FSK_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file caller_id_fsk.h
+ * @brief On-hook Caller ID: MDMF message builder and Bell 202 FSK modulator
+ *
+ * Pure integer code with no ESP-IDF dependencies, so the message and the
+ * waveform can be generated and checked off-target.
+ *
+ * The modulator produces the Bellcore GR-30 sequence: 300 bits of channel
+ * seizure (alternating 0/1), 180 mark bits, then the message bytes, each
+ * framed with a start bit and a stop bit and sent LSB first. Mark (1) is
+ * 1200 Hz and space (0) is 2200 Hz at 1200 baud. The carrier phase is never
+ * reset between bits.
+ */
+
+// Output sample rate; must match AUDIO_SAMPLE_RATE
+#define CID_SAMPLE_RATE         8000
+
+// Largest MDMF message, header and checksum included
+#define CID_MDMF_MAX_LEN        64
+
+// Longest number or name carried in a message
+#define CID_FIELD_MAX_LEN       15
+
+/**
+ * @brief What to announce
+ */
+typedef struct {
+    bool has_time;          // Include the date/time parameter
+    uint8_t month;          // 1-12
+    uint8_t day;            // 1-31
+    uint8_t hour;           // 0-23
+    uint8_t minute;         // 0-59
+    const char *number;     // Calling number, NULL or "" if withheld
+    const char *name;       // Calling name, NULL or "" if unknown
+} cid_info_t;
+
+/**
+ * @brief Modulator state
+ */
+typedef struct {
+    uint8_t msg[CID_MDMF_MAX_LEN];
+    size_t len;
+    uint32_t bit_index;     // Next bit of the whole sequence
+    uint32_t total_bits;    // Seizure + mark + framed message
+    uint32_t phase;         // Carrier phase, full circle = 2^32
+    uint32_t bit_clock;     // Bit timing, advances by the baud rate each sample
+    int16_t level;          // Peak amplitude
+} cid_fsk_t;
+
+/**
+ * @brief Build an MDMF (multiple data message format) Caller ID message
+ *
+ * A missing number or name is sent as the matching "reason for absence"
+ * parameter ('O', out of area).
+ *
+ * @param info What to announce
+ * @param buf Destination
+ * @param size Size of buf, at least CID_MDMF_MAX_LEN
+ * @return Message length including the checksum, 0 if buf is too small
+ */
+size_t cid_mdmf_build(const cid_info_t *info, uint8_t *buf, size_t size);
+
+/**
+ * @brief Prepare the modulator for one message
+ *
+ * @param fsk Modulator state
+ * @param msg Message from cid_mdmf_build()
+ * @param len Message length
+ * @param level Peak amplitude of the output samples
+ */
+void cid_fsk_init(cid_fsk_t *fsk, const uint8_t *msg, size_t len, int16_t level);
+
+/**
+ * @brief Number of samples the whole burst takes
+ */
+uint32_t cid_fsk_samples(const cid_fsk_t *fsk);
+
+/**
+ * @brief Render the next samples of the burst
+ *
+ * @param fsk Modulator state
+ * @param out Destination, 16-bit signed PCM at CID_SAMPLE_RATE
+ * @param count Samples wanted
+ * @return Samples written; fewer than count once the burst is complete
+ */
+size_t cid_fsk_render(cid_fsk_t *fsk, int16_t *out, size_t count);
+
+#endif /* __CALLER_ID_FSK_H__ */
@@ -0,0 +1,91 @@
+#include "ima_adpcm.h"
+
+static const int16_t step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// Apply one code to the state; shared by both directions so they track exactly
+static void update(ima_adpcm_state_t *st, uint8_t code)
+{
+    int32_t step = step_table[st->index];
+    int32_t diff = step >> 3;
+
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+
+    int32_t pred = st->predictor + ((code & 8) ? -diff : diff);
+    if (pred > INT16_MAX) pred = INT16_MAX;
+    if (pred < INT16_MIN) pred = INT16_MIN;
+    st->predictor = (int16_t)pred;
+
+    int index = st->index + index_table[code & 7];
+    st->index = (index < 0) ? 0 : (index > 88) ? 88 : (uint8_t)index;
+}
+
+static uint8_t encode_sample(ima_adpcm_state_t *st, int16_t sample)
+{
+    int32_t step = step_table[st->index];
+    int32_t diff = sample - st->predictor;
+    uint8_t code = 0;
+
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        code |= 4;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 2;
+        diff -= step;
+    }
+    step >>= 1;
+    if (diff >= step) {
+        code |= 1;
+    }
+
+    update(st, code);
+    return code;
+}
+
+void ima_adpcm_init(ima_adpcm_state_t *st)
+{
+    st->predictor = 0;
+    st->index = 0;
+}
+
+size_t ima_adpcm_encode(ima_adpcm_state_t *st, const int16_t *pcm, size_t count, uint8_t *out)
+{
+    size_t bytes = count / 2;
+
+    for (size_t i = 0; i < bytes; i++) {
+        uint8_t lo = encode_sample(st, pcm[2 * i]);
+        uint8_t hi = encode_sample(st, pcm[2 * i + 1]);
+        out[i] = (uint8_t)(lo | (hi << 4));
+    }
+    return bytes;
+}
+
+size_t ima_adpcm_decode(ima_adpcm_state_t *st, const uint8_t *in, size_t len, int16_t *pcm)
+{
+    for (size_t i = 0; i < len; i++) {
+        update(st, in[i] & 0x0F);
+        pcm[2 * i] = st->predictor;
+        update(st, in[i] >> 4);
+        pcm[2 * i + 1] = st->predictor;
+    }
+    return 2 * len;
+}
@@ -0,0 +1,53 @@
+#ifndef __IMA_ADPCM_H__
+#define __IMA_ADPCM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file ima_adpcm.h
+ * @brief IMA/DVI ADPCM codec, 16-bit PCM to 4 bits per sample
+ *
+ * Pure integer code with no ESP-IDF dependencies, so recordings can be
+ * encoded and decoded off-target.
+ *
+ * Samples are packed two to a byte, first sample in the low nibble, as in
+ * IMA ADPCM WAV files. A stream is decoded with a state initialised the same
+ * way it was encoded, so a recording starts from ima_adpcm_init() and is
+ * decoded from its first byte.
+ */
+
+/**
+ * @brief Predictor state, one per stream and direction
+ */
+typedef struct {
+    int16_t predictor;      // Last reconstructed sample
+    uint8_t index;          // Step table index, 0-88
+} ima_adpcm_state_t;
+
+/**
+ * @brief Reset a state to the start of a stream
+ */
+void ima_adpcm_init(ima_adpcm_state_t *st);
+
+/**
+ * @brief Encode samples
+ *
+ * @param pcm Samples to encode
+ * @param count Number of samples; an odd last sample is ignored
+ * @param out count / 2 bytes
+ * @return Bytes written
+ */
+size_t ima_adpcm_encode(ima_adpcm_state_t *st, const int16_t *pcm, size_t count, uint8_t *out);
+
+/**
+ * @brief Decode bytes
+ *
+ * @param in Encoded bytes
+ * @param len Number of bytes
+ * @param pcm 2 * len samples
+ * @return Samples written
+ */
+size_t ima_adpcm_decode(ima_adpcm_state_t *st, const uint8_t *in, size_t len, int16_t *pcm);
+
+#endif /* __IMA_ADPCM_H__ */
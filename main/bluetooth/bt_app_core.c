@@ -7,11 +7,14 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOSConfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "bt_app_core.h"
 #include "config/bluetooth_config.h"
 
@@ -20,11 +23,153 @@ static bool bt_app_send_msg(bt_app_msg_t *msg);
 static void bt_app_work_dispatched(bt_app_msg_t *msg);
 
 static QueueHandle_t bt_app_task_queue = NULL;
+static QueueHandle_t bt_app_bg_queue = NULL;
 static TaskHandle_t bt_app_task_handle = NULL;
 
+/*
+ * Coalesced events park in a small slot table keyed by (callback, event id)
+ * instead of a queue, so a burst of indicator updates collapses to the latest
+ * value and can never push call-control work out of the urgent lane.
+ */
+typedef struct {
+    bool                 pending;
+    bt_app_msg_t         msg;
+} bt_app_coalesce_slot_t;
+
+static bt_app_coalesce_slot_t coalesce_slots[BT_APP_COALESCE_SLOTS];
+static portMUX_TYPE dispatch_lock = portMUX_INITIALIZER_UNLOCKED;
+static bt_app_dispatch_stats_t dispatch_stats;
+
+static const char *lane_names[BT_APP_LANE_COUNT] = {
+    [BT_APP_LANE_URGENT]     = "urgent",
+    [BT_APP_LANE_BACKGROUND] = "background",
+    [BT_APP_LANE_COALESCE]   = "coalesce",
+};
+
+/*
+ * Message parameters come from fixed, size-classed slabs instead of the heap
+ * the controller also allocates from. Each class tracks free blocks in a
+ * bitmap, so allocation and free are a few instructions under a spinlock.
+ * Parameters larger than the biggest class, or arriving while a class is
+ * exhausted, fall back to malloc and are counted.
+ */
+_Static_assert(BT_APP_SLAB_BLOCKS <= 32, "slab bitmap holds at most 32 blocks");
+
+typedef struct {
+    uint8_t              *base;
+    uint16_t             block_size;
+    uint32_t             used;        /* bit n set = block n allocated */
+    uint16_t             in_use;
+    uint16_t             high_water;
+    uint32_t             allocs;
+} bt_app_slab_t;
+
+static uint8_t slab_small[BT_APP_SLAB_BLOCKS][BT_APP_SLAB_SMALL_SIZE] __attribute__((aligned(8)));
+static uint8_t slab_medium[BT_APP_SLAB_BLOCKS][BT_APP_SLAB_MEDIUM_SIZE] __attribute__((aligned(8)));
+static uint8_t slab_large[BT_APP_SLAB_BLOCKS][BT_APP_SLAB_LARGE_SIZE] __attribute__((aligned(8)));
+
+static bt_app_slab_t slabs[BT_APP_SLAB_CLASSES] = {
+    { .base = &slab_small[0][0],  .block_size = BT_APP_SLAB_SMALL_SIZE },
+    { .base = &slab_medium[0][0], .block_size = BT_APP_SLAB_MEDIUM_SIZE },
+    { .base = &slab_large[0][0],  .block_size = BT_APP_SLAB_LARGE_SIZE },
+};
+
+static portMUX_TYPE slab_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t slab_heap_fallbacks = 0;
+static uint32_t slab_alloc_failures = 0;
+
+#define SLAB_FULL_MASK   ((BT_APP_SLAB_BLOCKS == 32) ? 0xFFFFFFFFu : ((1u << BT_APP_SLAB_BLOCKS) - 1))
+
+static void *bt_app_param_alloc(size_t len)
+{
+    for (int c = 0; c < BT_APP_SLAB_CLASSES; c++) {
+        bt_app_slab_t *slab = &slabs[c];
+        if (len > slab->block_size) {
+            continue;
+        }
+
+        void *block = NULL;
+        portENTER_CRITICAL(&slab_lock);
+        if (slab->used != SLAB_FULL_MASK) {
+            int idx = __builtin_ctz(~slab->used);
+            slab->used |= (1u << idx);
+            slab->allocs++;
+            if (++slab->in_use > slab->high_water) {
+                slab->high_water = slab->in_use;
+            }
+            block = slab->base + (size_t)idx * slab->block_size;
+        }
+        portEXIT_CRITICAL(&slab_lock);
+
+        if (block) {
+            return block;
+        }
+        /* class exhausted, try the next size up */
+    }
+
+    void *p = malloc(len);
+    portENTER_CRITICAL(&slab_lock);
+    slab_heap_fallbacks++;
+    if (p == NULL) {
+        slab_alloc_failures++;
+    }
+    portEXIT_CRITICAL(&slab_lock);
+    return p;
+}
+
+static void bt_app_param_free(void *p)
+{
+    uint8_t *ptr = (uint8_t *)p;
+
+    for (int c = 0; c < BT_APP_SLAB_CLASSES; c++) {
+        bt_app_slab_t *slab = &slabs[c];
+        size_t span = (size_t)slab->block_size * BT_APP_SLAB_BLOCKS;
+        if (ptr >= slab->base && ptr < slab->base + span) {
+            int idx = (ptr - slab->base) / slab->block_size;
+            portENTER_CRITICAL(&slab_lock);
+            slab->used &= ~(1u << idx);
+            slab->in_use--;
+            portEXIT_CRITICAL(&slab_lock);
+            return;
+        }
+    }
+
+    free(p);
+}
+
+void bt_app_slab_get_stats(bt_app_slab_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&slab_lock);
+    for (int c = 0; c < BT_APP_SLAB_CLASSES; c++) {
+        out->classes[c].block_size = slabs[c].block_size;
+        out->classes[c].blocks = BT_APP_SLAB_BLOCKS;
+        out->classes[c].in_use = slabs[c].in_use;
+        out->classes[c].high_water = slabs[c].high_water;
+        out->classes[c].allocs = slabs[c].allocs;
+    }
+    out->heap_fallbacks = slab_heap_fallbacks;
+    out->alloc_failures = slab_alloc_failures;
+    portEXIT_CRITICAL(&slab_lock);
+}
+
+static inline int bt_app_event_bucket(uint16_t event)
+{
+    return (event < BT_APP_EVENT_STATS_SIZE) ? event : BT_APP_EVENT_STATS_SIZE - 1;
+}
+
 bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback)
 {
-    ESP_LOGD(BT_APP_CORE_TAG, "%s event 0x%x, param len %d", __func__, event, param_len);
+    return bt_app_work_dispatch_lane(p_cback, event, p_params, param_len, p_copy_cback, BT_APP_LANE_URGENT);
+}
+
+bool bt_app_work_dispatch_lane(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len,
+                               bt_app_copy_cb_t p_copy_cback, bt_app_lane_t lane)
+{
+    ESP_LOGD(BT_APP_CORE_TAG, "%s event 0x%x, param len %d, lane %d", __func__, event, param_len, lane);
 
     bt_app_msg_t msg;
     memset(&msg, 0, sizeof(bt_app_msg_t));
@@ -32,36 +177,195 @@ bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, i
     msg.sig = BT_APP_SIG_WORK_DISPATCH;
     msg.event = event;
     msg.cb = p_cback;
+    msg.lane = (lane < BT_APP_LANE_COUNT) ? lane : BT_APP_LANE_URGENT;
 
     if (param_len == 0) {
-        return bt_app_send_msg(&msg);
+        if (bt_app_send_msg(&msg)) {
+            return true;
+        }
     } else if (p_params && param_len > 0) {
-        if ((msg.param = malloc(param_len)) != NULL) {
+        if ((msg.param = bt_app_param_alloc(param_len)) != NULL) {
             memcpy(msg.param, p_params, param_len);
             /* check if caller has provided a copy callback to do the deep copy */
             if (p_copy_cback) {
                 p_copy_cback(&msg, msg.param, p_params);
             }
-            return bt_app_send_msg(&msg);
+            if (bt_app_send_msg(&msg)) {
+                return true;
+            }
+            bt_app_param_free(msg.param);
         }
     }
 
+    portENTER_CRITICAL(&dispatch_lock);
+    dispatch_stats.drops[bt_app_event_bucket(event)]++;
+    portEXIT_CRITICAL(&dispatch_lock);
     return false;
 }
 
+/* Park msg in its coalescing slot, returning any parameter it superseded */
+static bool bt_app_coalesce_put(bt_app_msg_t *msg, void **superseded)
+{
+    bt_app_coalesce_slot_t *free_slot = NULL;
+    bool stored = false;
+
+    *superseded = NULL;
+    portENTER_CRITICAL(&dispatch_lock);
+    for (int i = 0; i < BT_APP_COALESCE_SLOTS; i++) {
+        bt_app_coalesce_slot_t *slot = &coalesce_slots[i];
+        if (!slot->pending) {
+            if (free_slot == NULL) {
+                free_slot = slot;
+            }
+            continue;
+        }
+        if (slot->msg.cb == msg->cb && slot->msg.event == msg->event) {
+            /* latest value wins; keep the original time so residency covers the whole wait */
+            *superseded = slot->msg.param;
+            slot->msg.param = msg->param;
+            dispatch_stats.coalesced[bt_app_event_bucket(msg->event)]++;
+            stored = true;
+            break;
+        }
+    }
+    if (!stored && free_slot) {
+        free_slot->msg = *msg;
+        free_slot->pending = true;
+        stored = true;
+    }
+    portEXIT_CRITICAL(&dispatch_lock);
+
+    return stored;
+}
+
+/* Take the longest-waiting coalesced event */
+static bool bt_app_coalesce_take(bt_app_msg_t *msg)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    bt_app_coalesce_slot_t *oldest = NULL;
+
+    portENTER_CRITICAL(&dispatch_lock);
+    for (int i = 0; i < BT_APP_COALESCE_SLOTS; i++) {
+        bt_app_coalesce_slot_t *slot = &coalesce_slots[i];
+        if (slot->pending &&
+            (oldest == NULL || now - slot->msg.enqueue_us > now - oldest->msg.enqueue_us)) {
+            oldest = slot;
+        }
+    }
+    if (oldest) {
+        *msg = oldest->msg;
+        oldest->pending = false;
+    }
+    portEXIT_CRITICAL(&dispatch_lock);
+
+    return oldest != NULL;
+}
+
 static bool bt_app_send_msg(bt_app_msg_t *msg)
 {
     if (msg == NULL) {
         return false;
     }
 
-    if (xQueueSend(bt_app_task_queue, msg, 10 / portTICK_PERIOD_MS) != pdTRUE) {
-        ESP_LOGE(BT_APP_CORE_TAG, "%s xQueue send failed", __func__);
-        return false;
+    msg->enqueue_us = (uint32_t)esp_timer_get_time();
+
+    switch (msg->lane) {
+        case BT_APP_LANE_COALESCE: {
+            void *superseded;
+            if (!bt_app_coalesce_put(msg, &superseded)) {
+                ESP_LOGW(BT_APP_CORE_TAG, "%s coalesce slots full, event 0x%x dropped", __func__, msg->event);
+                return false;
+            }
+            if (superseded) {
+                bt_app_param_free(superseded);
+            }
+            break;
+        }
+
+        case BT_APP_LANE_BACKGROUND:
+            /* state changes too, so wait briefly like the urgent lane; only coalesced events may be lost */
+            if (xQueueSend(bt_app_bg_queue, msg, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+                ESP_LOGW(BT_APP_CORE_TAG, "%s background lane full, event 0x%x dropped", __func__, msg->event);
+                return false;
+            }
+            break;
+
+        default:
+            if (xQueueSend(bt_app_task_queue, msg, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+                ESP_LOGE(BT_APP_CORE_TAG, "%s xQueue send failed", __func__);
+                return false;
+            }
+            break;
+    }
+
+    if (bt_app_task_handle) {
+        xTaskNotifyGive(bt_app_task_handle);
     }
     return true;
 }
 
+/* Next message in lane priority order */
+static bool bt_app_next_msg(bt_app_msg_t *msg)
+{
+    if (xQueueReceive(bt_app_task_queue, msg, 0) == pdTRUE) {
+        return true;
+    }
+    if (xQueueReceive(bt_app_bg_queue, msg, 0) == pdTRUE) {
+        return true;
+    }
+    return bt_app_coalesce_take(msg);
+}
+
+static void bt_app_account_residency(const bt_app_msg_t *msg)
+{
+    uint32_t waited = (uint32_t)esp_timer_get_time() - msg->enqueue_us;
+    bt_app_lane_stats_t *lane = &dispatch_stats.lanes[msg->lane];
+
+    portENTER_CRITICAL(&dispatch_lock);
+    lane->handled++;
+    lane->residency_total_us += waited;
+    if (waited > lane->residency_max_us) {
+        lane->residency_max_us = waited;
+    }
+    portEXIT_CRITICAL(&dispatch_lock);
+}
+
+void bt_app_dispatch_get_stats(bt_app_dispatch_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&dispatch_lock);
+    *out = dispatch_stats;
+    portEXIT_CRITICAL(&dispatch_lock);
+}
+
+const char *bt_app_lane_name(bt_app_lane_t lane)
+{
+    return (lane < BT_APP_LANE_COUNT) ? lane_names[lane] : "unknown";
+}
+
+/* Record the least stack left free; the handlers run every event subscriber */
+static void bt_app_check_stack(void)
+{
+    uint32_t free_bytes = uxTaskGetStackHighWaterMark(NULL);
+    bool crossed = false;
+
+    portENTER_CRITICAL(&dispatch_lock);
+    if (free_bytes < dispatch_stats.stack_free_min) {
+        crossed = (dispatch_stats.stack_free_min >= BT_APP_TASK_STACK_MARGIN &&
+                   free_bytes < BT_APP_TASK_STACK_MARGIN);
+        dispatch_stats.stack_free_min = free_bytes;
+    }
+    portEXIT_CRITICAL(&dispatch_lock);
+
+    if (crossed) {
+        ESP_LOGW(BT_APP_CORE_TAG, "%s only %" PRIu32 " of %d stack bytes left free",
+                 BT_APP_TASK_NAME, free_bytes, BT_APP_TASK_STACK_SIZE);
+    }
+}
+
 static void bt_app_work_dispatched(bt_app_msg_t *msg)
 {
     if (msg->cb) {
@@ -73,8 +377,13 @@ static void bt_app_task_handler(void *arg)
 {
     bt_app_msg_t msg;
     for (;;) {
-        if (pdTRUE == xQueueReceive(bt_app_task_queue, &msg, (TickType_t)portMAX_DELAY)) {
+        /* senders notify after queuing, so nothing is missed between drain and wait */
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (bt_app_next_msg(&msg)) {
             ESP_LOGD(BT_APP_CORE_TAG, "%s, sig 0x%x, 0x%x", __func__, msg.sig, msg.event);
+            bt_app_account_residency(&msg);
+
             switch (msg.sig) {
                 case BT_APP_SIG_WORK_DISPATCH:
                 {
@@ -88,15 +397,20 @@ static void bt_app_task_handler(void *arg)
             } // switch (msg.sig)
 
             if (msg.param) {
-                free(msg.param);
+                bt_app_param_free(msg.param);
             }
         }
+
+        /* the high-water mark keeps the deepest point, so once per drain is enough */
+        bt_app_check_stack();
     }
 }
 
 void bt_app_task_start_up(void)
 {
     bt_app_task_queue = xQueueCreate(BT_APP_TASK_QUEUE_SIZE, sizeof(bt_app_msg_t));
+    bt_app_bg_queue = xQueueCreate(BT_APP_BG_QUEUE_SIZE, sizeof(bt_app_msg_t));
+    dispatch_stats.stack_free_min = BT_APP_TASK_STACK_SIZE;
     xTaskCreate(bt_app_task_handler, BT_APP_TASK_NAME, BT_APP_TASK_STACK_SIZE, NULL, BT_APP_TASK_PRIORITY, &bt_app_task_handle);
     return;
 }
@@ -111,4 +425,14 @@ void bt_app_task_shut_down(void)
         vQueueDelete(bt_app_task_queue);
         bt_app_task_queue = NULL;
     }
+    if (bt_app_bg_queue) {
+        vQueueDelete(bt_app_bg_queue);
+        bt_app_bg_queue = NULL;
+    }
+    for (int i = 0; i < BT_APP_COALESCE_SLOTS; i++) {
+        if (coalesce_slots[i].pending && coalesce_slots[i].msg.param) {
+            bt_app_param_free(coalesce_slots[i].msg.param);
+        }
+        coalesce_slots[i].pending = false;
+    }
 }
@@ -20,11 +20,23 @@
  */
 typedef void (* bt_app_cb_t) (uint16_t event, void *param);
 
+/**
+ * @brief     dispatch lanes, serviced in this order
+ */
+typedef enum {
+    BT_APP_LANE_URGENT = 0,       /*!< call, audio and connection state */
+    BT_APP_LANE_BACKGROUND,       /*!< voice recognition and volume, FIFO */
+    BT_APP_LANE_COALESCE,         /*!< indicator updates, latest value per event wins */
+    BT_APP_LANE_COUNT,
+} bt_app_lane_t;
+
 /* message to be sent */
 typedef struct {
     uint16_t             sig;      /*!< signal to bt_app_task */
     uint16_t             event;    /*!< message event id */
     bt_app_cb_t          cb;       /*!< context switch callback */
+    uint32_t             enqueue_us; /*!< low 32 bits of esp_timer time when queued */
+    uint8_t              lane;     /*!< bt_app_lane_t */
     void                 *param;   /*!< parameter area needs to be the last */
 } bt_app_msg_t;
 
@@ -34,10 +46,82 @@ typedef struct {
 typedef void (* bt_app_copy_cb_t) (bt_app_msg_t *msg, void *p_dest, void *p_src);
 
 /**
- * @brief     work dispatcher for the application task
+ * @brief     work dispatcher for the application task (urgent lane)
  */
 bool bt_app_work_dispatch(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len, bt_app_copy_cb_t p_copy_cback);
 
+/**
+ * @brief     work dispatcher with an explicit lane
+ *
+ *            The app task always drains the urgent lane before taking
+ *            background work. A coalesced event replaces any pending event
+ *            with the same callback and id instead of queuing behind it.
+ *            The urgent and background lanes wait briefly for queue space;
+ *            only a coalesced event finding every slot taken is dropped and
+ *            counted.
+ */
+bool bt_app_work_dispatch_lane(bt_app_cb_t p_cback, uint16_t event, void *p_params, int param_len,
+                               bt_app_copy_cb_t p_copy_cback, bt_app_lane_t lane);
+
+/**
+ * @brief     statistics for one parameter slab class
+ */
+typedef struct {
+    uint16_t             block_size;  /*!< bytes per block */
+    uint16_t             blocks;      /*!< blocks in the class */
+    uint16_t             in_use;      /*!< blocks currently allocated */
+    uint16_t             high_water;  /*!< most blocks ever allocated at once */
+    uint32_t             allocs;      /*!< total allocations served */
+} bt_app_slab_class_stats_t;
+
+#define BT_APP_SLAB_CLASSES               (3)
+
+/**
+ * @brief     parameter allocator statistics
+ */
+typedef struct {
+    bt_app_slab_class_stats_t classes[BT_APP_SLAB_CLASSES];
+    uint32_t             heap_fallbacks;  /*!< parameters too large or slabs exhausted */
+    uint32_t             alloc_failures;  /*!< heap fallback also failed */
+} bt_app_slab_stats_t;
+
+/**
+ * @brief     get a snapshot of the parameter allocator statistics
+ */
+void bt_app_slab_get_stats(bt_app_slab_stats_t *out);
+
+/* per-event counters are indexed by event id; ids above the last bucket share it */
+#define BT_APP_EVENT_STATS_SIZE           (32)
+
+/**
+ * @brief     time spent queued, per lane
+ */
+typedef struct {
+    uint32_t             handled;           /*!< messages handled */
+    uint32_t             residency_max_us;  /*!< longest time from dispatch to handling */
+    uint64_t             residency_total_us;/*!< sum, for averaging */
+} bt_app_lane_stats_t;
+
+/**
+ * @brief     dispatch queue statistics
+ */
+typedef struct {
+    bt_app_lane_stats_t  lanes[BT_APP_LANE_COUNT];
+    uint32_t             drops[BT_APP_EVENT_STATS_SIZE];      /*!< lost to a full lane, by event id */
+    uint32_t             coalesced[BT_APP_EVENT_STATS_SIZE];  /*!< superseded before handling, by event id */
+    uint32_t             stack_free_min;  /*!< least BtAppT stack ever left free, bytes */
+} bt_app_dispatch_stats_t;
+
+/**
+ * @brief     get a snapshot of the dispatch queue statistics
+ */
+void bt_app_dispatch_get_stats(bt_app_dispatch_stats_t *out);
+
+/**
+ * @brief     get a short name for a lane
+ */
+const char *bt_app_lane_name(bt_app_lane_t lane);
+
 void bt_app_task_start_up(void);
 
 void bt_app_task_shut_down(void);
@@ -18,9 +18,18 @@
 #include "nvs_flash.h"
 #include "bt_app_hf.h"
 #include "bt_app_core.h"
+#include "bt_device_registry.h"
+#include "bt_hf_warmup.h"
+#include "bt_calls.h"
+#include "bt_indicators.h"
+#include "bt_link_quality.h"
 #include "app_hf_msg_set.h"
 #include "ma_bell_state.h"
 #include "app/events/event_system.h"
+#include "app/call/call_control.h"
+#include "app/call/caller_id.h"
+#include "app/call/call_waiting.h"
+#include "config/bluetooth_config.h"
 #include "audio/audio_bridge.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -173,9 +182,14 @@ const char *c_inband_ring_state_str[] = {
     "Provided",
 };
 
-extern esp_bd_addr_t peer_addr;
-// If you want to connect a specific device, add it's address here
-// esp_bd_addr_t peer_addr = {0xac, 0x67, 0xb2, 0x53, 0x77, 0xbe};
+// Audio gateway of the current service level connection, captured on connect.
+// Also used by the console commands in app_hf_msg_set.c.
+esp_bd_addr_t peer_addr;
+
+// SCO link state, tracked from AUDIO_STATE_EVT
+static volatile esp_hf_client_audio_state_t hf_audio_state = ESP_HF_CLIENT_AUDIO_STATE_DISCONNECTED;
+// Set when the link was requested by bt_app_hf_open_audio() rather than the AG
+static volatile bool hf_audio_opened_locally = false;
 
 #if CONFIG_BT_HFP_AUDIO_DATA_PATH_HCI
 
@@ -200,9 +214,11 @@ static uint32_t bt_app_hf_client_outgoing_cb(uint8_t *p_buf, uint32_t sz)
         return sz;
     } else if (0 < item_size) {
         vRingbufferReturnItem(bt_tx_ringbuf, data);
+        audio_bridge_count_xrun(AUDIO_XRUN_UPLINK_UNDERRUN);
         return 0;
     } else {
         // data not enough, do not read
+        audio_bridge_count_xrun(AUDIO_XRUN_UPLINK_UNDERRUN);
         return 0;
     }
 }
@@ -218,6 +234,7 @@ static void bt_app_hf_client_incoming_cb(const uint8_t *buf, uint32_t sz)
     BaseType_t done = xRingbufferSend(bt_rx_ringbuf, (uint8_t *)buf, sz, 0);
     if (!done) {
         ESP_LOGE(BT_HF_TAG, "BT RX ring buffer send fail");
+        audio_bridge_count_xrun(AUDIO_XRUN_DOWNLINK_OVERRUN);
     }
     // Note: We don't call esp_hf_client_outgoing_data_ready() here anymore
     // because outgoing data comes from the phone microphone (I2S RX),
@@ -241,20 +258,34 @@ void bt_app_hf_register_data_callbacks(void)
 
 static const char *TAG = "bt_app_hf";
 
-/* callback for HF_CLIENT */
-void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_t *param)
+/* handler for HF_CLIENT events, runs in the app task */
+static void bt_app_hf_evt_hdl(uint16_t event, void *p_param)
 {
+    esp_hf_client_cb_param_t *param = (esp_hf_client_cb_param_t *)p_param;
+
     switch (event) {
         case ESP_HF_CLIENT_CONNECTION_STATE_EVT:
             ESP_LOGI(TAG, "Connection state: %d", param->conn_stat.state);
             if (param->conn_stat.state == ESP_HF_CLIENT_CONNECTION_STATE_CONNECTED) {
+                memcpy(peer_addr, param->conn_stat.remote_bda, sizeof(esp_bd_addr_t));
+                // Most recent phone is paged first next time
+                bt_registry_touch(param->conn_stat.remote_bda);
+                bt_hf_warmup_connected();
                 // Update state
-                ma_bell_state_update_bluetooth_bits(BT_STATE_CONNECTED, 0);
+                ma_bell_state_update_bluetooth_bits(BT_STATE_CONNECTED, 0, STATE_CAUSE_HFP);
                 // Publish connection event
                 event_publish(BT_EVENT_CONNECTED, NULL);
+            } else if (param->conn_stat.state == ESP_HF_CLIENT_CONNECTION_STATE_SLC_CONNECTED) {
+                bt_hf_warmup_slc_up();
             } else if (param->conn_stat.state == ESP_HF_CLIENT_CONNECTION_STATE_DISCONNECTED) {
+                bt_hf_warmup_disconnected();
+                bt_indicators_reset();
+                bt_calls_reset();
                 // Update state
-                ma_bell_state_update_bluetooth_bits(0, BT_STATE_CONNECTED);
+                ma_bell_state_update_bluetooth_bits(0, BT_STATE_CONNECTED, STATE_CAUSE_HFP);
+                hf_audio_state = ESP_HF_CLIENT_AUDIO_STATE_DISCONNECTED;
+                hf_audio_opened_locally = false;
+                call_control_dispatch(CC_EVENT_SLC_DOWN);
                 // Publish disconnection event
                 event_publish(BT_EVENT_DISCONNECTED, NULL);
             }
@@ -262,19 +293,23 @@ void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_
 
         case ESP_HF_CLIENT_AUDIO_STATE_EVT:
             ESP_LOGI(TAG, "Audio state: %s", c_audio_state_str[param->audio_stat.state]);
+            hf_audio_state = param->audio_stat.state;
             if (param->audio_stat.state == ESP_HF_CLIENT_AUDIO_STATE_CONNECTED) {
                 // Audio connected - start audio bridge tasks
-                ma_bell_state_update_bluetooth_bits(BT_STATE_AUDIO_CONNECTED, 0);
+                ma_bell_state_update_bluetooth_bits(BT_STATE_AUDIO_CONNECTED, 0, STATE_CAUSE_HFP);
 #if CONFIG_BT_HFP_AUDIO_DATA_PATH_HCI
                 audio_bridge_start();
 #endif
+                bt_link_quality_start(param->audio_stat.sync_conn_handle);
                 event_publish(BT_EVENT_AUDIO_CONNECTED, NULL);
             } else if (param->audio_stat.state == ESP_HF_CLIENT_AUDIO_STATE_DISCONNECTED) {
                 // Audio disconnected - stop audio bridge tasks
+                bt_link_quality_stop();
 #if CONFIG_BT_HFP_AUDIO_DATA_PATH_HCI
                 audio_bridge_stop();
 #endif
-                ma_bell_state_update_bluetooth_bits(0, BT_STATE_AUDIO_CONNECTED);
+                hf_audio_opened_locally = false;
+                ma_bell_state_update_bluetooth_bits(0, BT_STATE_AUDIO_CONNECTED, STATE_CAUSE_HFP);
                 event_publish(BT_EVENT_AUDIO_DISCONNECTED, NULL);
             }
             break;
@@ -283,76 +318,116 @@ void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_
             ESP_LOGI(TAG, "VR state: %d", param->bvra.value);
             break;
 
+        // Call lifecycle: translate indicators into call-control events, the
+        // transition table owns the resulting state bits and notifications
         case ESP_HF_CLIENT_RING_IND_EVT:
             ESP_LOGI(TAG, "Incoming call ring indication");
-            // Update phone state to indicate ringing
-            ma_bell_state_update_phone_bits(PHONE_STATE_RINGING, 0);
+            call_control_dispatch(CC_EVENT_RING);
             break;
 
         case ESP_HF_CLIENT_CIND_CALL_EVT:
             ESP_LOGI(TAG, "Call state changed: %s", c_call_str[param->call.status]);
-            if (param->call.status == 0) {  // No call in progress
-                // Call ended (hung up)
-                ESP_LOGI(TAG, "Call ended - returning to idle state");
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING | PHONE_STATE_OFF_HOOK);
-                ma_bell_state_update_bluetooth_bits(0, BT_STATE_IN_CALL | BT_STATE_AUDIO_CONNECTED);
-                // Publish call ended event
-                event_publish(BT_EVENT_CALL_ENDED, NULL);
-            } else if (param->call.status == 1) {  // Call in progress
-                // Call active
-                ESP_LOGI(TAG, "Call active - updating state");
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING);
-                ma_bell_state_update_bluetooth_bits(BT_STATE_IN_CALL, 0);
-                // Publish call started event
-                event_publish(BT_EVENT_CALL_STARTED, NULL);
-            }
+            bt_calls_call(param->call.status);
+            call_control_dispatch(param->call.status == ESP_HF_CALL_STATUS_CALL_IN_PROGRESS ?
+                                  CC_EVENT_CALL_ACTIVE : CC_EVENT_CALL_NONE);
             break;
 
         case ESP_HF_CLIENT_CIND_CALL_SETUP_EVT:
             ESP_LOGI(TAG, "Call setup state: %s", c_call_setup_str[param->call_setup.status]);
-            if (param->call_setup.status == ESP_HF_CALL_SETUP_STATUS_INCOMING) {
-                // Incoming call
-                ESP_LOGI(TAG, "Incoming call detected");
-                ma_bell_state_update_phone_bits(PHONE_STATE_RINGING, 0);
-            } else if (param->call_setup.status == ESP_HF_CALL_SETUP_STATUS_IDLE) {
-                // Call setup ended (could be hangup, reject, or timeout)
-                ESP_LOGI(TAG, "Call setup ended - clearing ringing state");
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING);
+            bt_calls_call_setup(param->call_setup.status);
+            switch (param->call_setup.status) {
+                case ESP_HF_CALL_SETUP_STATUS_INCOMING:
+                    call_control_dispatch(CC_EVENT_SETUP_INCOMING);
+                    break;
+                case ESP_HF_CALL_SETUP_STATUS_OUTGOING_DIALING:
+                    call_control_dispatch(CC_EVENT_SETUP_DIALING);
+                    break;
+                case ESP_HF_CALL_SETUP_STATUS_OUTGOING_ALERTING:
+                    call_control_dispatch(CC_EVENT_SETUP_ALERTING);
+                    break;
+                default:
+                    call_control_dispatch(CC_EVENT_SETUP_IDLE);
+                    break;
             }
             break;
 
         case ESP_HF_CLIENT_CIND_CALL_HELD_EVT:
+            // The call indicator stays 1 while calls are held; hook flash
+            // needs to know there is a held call to swap to
             ESP_LOGI(TAG, "Call held state: %s", c_call_held_str[param->call_held.status]);
-            if (param->call_held.status == ESP_HF_CALL_HELD_STATUS_NONE) {
-                // Call released
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING);
-                ma_bell_state_update_bluetooth_bits(0, BT_STATE_IN_CALL);
-            } else if (param->call_held.status == ESP_HF_CALL_HELD_STATUS_HELD_AND_ACTIVE) {
-                // Call held and active
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING);
-                ma_bell_state_update_bluetooth_bits(BT_STATE_IN_CALL, 0);
-            } else if (param->call_held.status == ESP_HF_CALL_HELD_STATUS_HELD) {
-                // Call held
-                ma_bell_state_update_phone_bits(0, PHONE_STATE_RINGING);
-                ma_bell_state_update_bluetooth_bits(BT_STATE_IN_CALL, 0);
+            bt_calls_call_held(param->call_held.status);
+            if (param->call_held.status == ESP_HF_CALL_HELD_STATUS_HELD_AND_ACTIVE) {
+                call_control_dispatch(CC_EVENT_HELD_ACTIVE);
+            }
+            break;
+
+        case ESP_HF_CLIENT_AT_RESPONSE_EVT:
+            // Results of outstanding warm-up queries come first, then call listings
+            if (bt_hf_warmup_at_response(param->at_response.code == ESP_HF_AT_RESPONSE_CODE_OK)) {
+                break;
+            }
+            if (bt_calls_at_response(param->at_response.code == ESP_HF_AT_RESPONSE_CODE_OK)) {
+                break;
+            }
+            if (param->at_response.code != ESP_HF_AT_RESPONSE_CODE_OK) {
+                ESP_LOGI(TAG, "AT response: code %d, cme %d",
+                         param->at_response.code, param->at_response.cme);
+                call_control_dispatch(param->at_response.code == ESP_HF_AT_RESPONSE_CODE_BUSY ?
+                                      CC_EVENT_AT_BUSY : CC_EVENT_AT_ERROR);
             }
             break;
 
+        // Status indicators: the cache drops repeats and publishes changes
         case ESP_HF_CLIENT_CIND_SERVICE_AVAILABILITY_EVT:
+            bt_indicators_update(BT_IND_SERVICE, param->service_availability.status);
+            break;
+
         case ESP_HF_CLIENT_CIND_SIGNAL_STRENGTH_EVT:
+            bt_indicators_update(BT_IND_SIGNAL, param->signal_strength.value);
+            break;
+
         case ESP_HF_CLIENT_CIND_ROAMING_STATUS_EVT:
+            bt_indicators_update(BT_IND_ROAMING, param->roaming.status);
+            break;
+
         case ESP_HF_CLIENT_CIND_BATTERY_LEVEL_EVT:
+            bt_indicators_update(BT_IND_BATTERY, param->battery_level.value);
+            break;
+
         case ESP_HF_CLIENT_COPS_CURRENT_OPERATOR_EVT:
-        case ESP_HF_CLIENT_BTRH_EVT:
+            bt_indicators_update_operator(param->cops.name);
+            break;
+
+        case ESP_HF_CLIENT_CNUM_EVT:
+            bt_hf_warmup_subscriber(param->cnum.number);
+            break;
+
+        case ESP_HF_CLIENT_CLCC_EVT:
+            ESP_LOGI(TAG, "Current call %d: status %d, dir %d",
+                     param->clcc.idx, param->clcc.status, param->clcc.dir);
+            bt_calls_clcc(param->clcc.idx, param->clcc.dir, param->clcc.status,
+                          param->clcc.mpty, param->clcc.number);
+            bt_hf_warmup_call_listed();
+            break;
+
+        case ESP_HF_CLIENT_PKT_STAT_NUMS_GET_EVT:
+            bt_link_quality_sample(param);
+            break;
+
         case ESP_HF_CLIENT_CLIP_EVT:
+            bt_calls_number(param->clip.number);
+            caller_id_on_clip(param->clip.number);
+            break;
+
         case ESP_HF_CLIENT_CCWA_EVT:
-        case ESP_HF_CLIENT_CLCC_EVT:
+            bt_calls_number(param->ccwa.number);
+            call_waiting_on_ccwa(param->ccwa.number);
+            break;
+
+        case ESP_HF_CLIENT_BTRH_EVT:
         case ESP_HF_CLIENT_VOLUME_CONTROL_EVT:
-        case ESP_HF_CLIENT_AT_RESPONSE_EVT:
-        case ESP_HF_CLIENT_CNUM_EVT:
         case ESP_HF_CLIENT_BSIR_EVT:
         case ESP_HF_CLIENT_BINP_EVT:
-        case ESP_HF_CLIENT_PKT_STAT_NUMS_GET_EVT:
             // These events are not currently handled
             ESP_LOGD(TAG, "Unhandled event: %d", event);
             break;
@@ -362,3 +437,120 @@ void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_
             break;
     }
 }
+
+// Longest string an HFP event can carry into the app task (number or operator name)
+#define HF_EVT_MAX_STR_LEN  (BT_APP_SLAB_LARGE_SIZE - sizeof(esp_hf_client_cb_param_t) - 1)
+_Static_assert(sizeof(esp_hf_client_cb_param_t) + 33 <= BT_APP_SLAB_LARGE_SIZE,
+               "large slab too small for an HFP event with a phone number");
+
+// String field of events that carry one. The stack owns the string only for
+// the duration of the callback, so it is copied after the parameter struct.
+static const char **hf_evt_string(uint16_t event, esp_hf_client_cb_param_t *param)
+{
+    switch (event) {
+        case ESP_HF_CLIENT_COPS_CURRENT_OPERATOR_EVT: return &param->cops.name;
+        case ESP_HF_CLIENT_CLIP_EVT:                  return &param->clip.number;
+        case ESP_HF_CLIENT_CCWA_EVT:                  return &param->ccwa.number;
+        case ESP_HF_CLIENT_CLCC_EVT:                  return (const char **)&param->clcc.number;
+        case ESP_HF_CLIENT_CNUM_EVT:                  return &param->cnum.number;
+        case ESP_HF_CLIENT_BINP_EVT:                  return &param->binp.number;
+        default:                                      return NULL;
+    }
+}
+
+// Deep copy: point the string field at the copy stored after the struct
+static void bt_app_hf_copy_cb(bt_app_msg_t *msg, void *p_dest, void *p_src)
+{
+    esp_hf_client_cb_param_t *dest = (esp_hf_client_cb_param_t *)p_dest;
+    const char **field = hf_evt_string(msg->event, dest);
+    if (field && *field) {
+        *field = (const char *)(dest + 1);
+    }
+}
+
+// Lane for each event: call and link state jump the queue, indicator
+// updates collapse to their latest value, everything else waits its turn
+static bt_app_lane_t hf_evt_lane(uint16_t event)
+{
+    switch (event) {
+        case ESP_HF_CLIENT_CIND_SERVICE_AVAILABILITY_EVT:
+        case ESP_HF_CLIENT_CIND_SIGNAL_STRENGTH_EVT:
+        case ESP_HF_CLIENT_CIND_ROAMING_STATUS_EVT:
+        case ESP_HF_CLIENT_CIND_BATTERY_LEVEL_EVT:
+        case ESP_HF_CLIENT_PKT_STAT_NUMS_GET_EVT:
+            return BT_APP_LANE_COALESCE;
+
+        case ESP_HF_CLIENT_BVRA_EVT:
+        case ESP_HF_CLIENT_VOLUME_CONTROL_EVT:
+            return BT_APP_LANE_BACKGROUND;
+
+        default:
+            // Including AT responses (COPS, CLCC, CNUM, BINP): each CLCC
+            // line is a call, and all of them must be handled ahead of their OK
+            return BT_APP_LANE_URGENT;
+    }
+}
+
+/* callback for HF_CLIENT, runs in the Bluetooth stack task */
+void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_t *param)
+{
+    // Stage the event and any string it carries, then hand it to the app
+    // task so the stack task never waits on state, event or audio work
+    uint8_t staged[sizeof(esp_hf_client_cb_param_t) + HF_EVT_MAX_STR_LEN + 1];
+    int len = sizeof(esp_hf_client_cb_param_t);
+    memcpy(staged, param, sizeof(esp_hf_client_cb_param_t));
+
+    const char **field = hf_evt_string(event, param);
+    if (field && *field) {
+        size_t n = strnlen(*field, HF_EVT_MAX_STR_LEN);
+        memcpy(staged + len, *field, n);
+        staged[len + n] = '\0';
+        len += n + 1;
+    }
+
+    if (!bt_app_work_dispatch_lane(bt_app_hf_evt_hdl, event, staged, len, bt_app_hf_copy_cb,
+                                   hf_evt_lane(event))) {
+        ESP_LOGE(TAG, "Failed to dispatch HF event %d", event);
+    }
+}
+
+esp_err_t bt_app_hf_open_audio(void)
+{
+    if (!ma_bell_state_bluetooth_bits_set(BT_STATE_CONNECTED)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (hf_audio_state != ESP_HF_CLIENT_AUDIO_STATE_DISCONNECTED) {
+        return ESP_OK;  // Already up or on its way
+    }
+
+    esp_err_t ret = esp_hf_client_connect_audio(peer_addr);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Audio connect request failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    hf_audio_state = ESP_HF_CLIENT_AUDIO_STATE_CONNECTING;
+    hf_audio_opened_locally = true;
+    ESP_LOGI(TAG, "Requested SCO ahead of call audio");
+    return ESP_OK;
+}
+
+bool bt_app_hf_audio_preopened(void)
+{
+    return hf_audio_opened_locally;
+}
+
+void bt_app_hf_release_audio(void)
+{
+    // A link the AG opened for a call is its to close
+    if (!hf_audio_opened_locally || ma_bell_state_bluetooth_bits_set(BT_STATE_IN_CALL)) {
+        return;
+    }
+
+    esp_err_t ret = esp_hf_client_disconnect_audio(peer_addr);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Audio disconnect request failed: %s", esp_err_to_name(ret));
+        return;
+    }
+    hf_audio_opened_locally = false;
+    ESP_LOGI(TAG, "Released pre-opened SCO");
+}
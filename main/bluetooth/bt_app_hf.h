@@ -8,6 +8,8 @@
 #define __BT_APP_HF_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
 #include "esp_hf_client_api.h"
 
 
@@ -26,4 +28,24 @@ void bt_app_hf_client_cb(esp_hf_client_cb_event_t event, esp_hf_client_cb_param_
  */
 void bt_app_hf_register_data_callbacks(void);
 
+/**
+ * @brief     Open the SCO link to the connected audio gateway ahead of call audio
+ *
+ *            Does nothing if the link is already up or being set up.
+ *
+ * @return    ESP_OK if the link is up or requested, ESP_ERR_INVALID_STATE
+ *            with no service level connection
+ */
+esp_err_t bt_app_hf_open_audio(void);
+
+/**
+ * @brief     Whether the current SCO link was requested by bt_app_hf_open_audio()
+ */
+bool bt_app_hf_audio_preopened(void);
+
+/**
+ * @brief     Close a SCO link opened by bt_app_hf_open_audio() that no call used
+ */
+void bt_app_hf_release_audio(void);
+
 #endif /* __BT_APP_HF_H__*/
@@ -0,0 +1,433 @@
+/*
+ * Per-call table
+ * Maintained from CIEV deltas, corrected by CLCC listings when ambiguous
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_hf_client_api.h"
+#include "bt_calls.h"
+#include "bt_app_core.h"
+#include "bt_hf_warmup.h"
+#include "app/state/ma_bell_state.h"
+#include "config/bluetooth_config.h"
+
+static const char *TAG = "bt_calls";
+
+// A listing error this many times in a row means the phone has no CLCC
+#define CALLS_MAX_QUERY_ERRORS 3
+
+typedef struct {
+    bool in_use;
+    uint32_t seen;          // Listing generation that last confirmed the call
+    ma_bell_call_t call;
+} call_slot_t;
+
+static call_slot_t slots[MA_BELL_MAX_CALLS];
+static uint8_t call_ind;                // Last call indicator
+static uint8_t held_ind;                // Last callheld indicator
+static uint32_t list_gen;
+static bool listing;                    // A listing is being merged
+static volatile bool query_outstanding; // Read from the stack task
+static bool requery_wanted;             // Ambiguity seen while a listing was in flight
+static uint8_t query_errors_in_row;
+static esp_timer_handle_t requery_timer = NULL;
+
+static bt_calls_stats_t calls_stats;
+static portMUX_TYPE calls_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool is_connected(const call_slot_t *s)
+{
+    return s->in_use && (s->call.status == CALL_STATUS_ACTIVE ||
+                         s->call.status == CALL_STATUS_HELD ||
+                         s->call.status == CALL_STATUS_RESPONSE_HOLD);
+}
+
+static bool is_setup(const call_slot_t *s)
+{
+    return s->in_use && !is_connected(s);
+}
+
+static int count_connected(void)
+{
+    int n = 0;
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        n += is_connected(&slots[i]);
+    }
+    return n;
+}
+
+static call_slot_t *find_setup(void)
+{
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        if (is_setup(&slots[i])) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static call_slot_t *find_status(uint8_t status)
+{
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        if (slots[i].in_use && slots[i].call.status == status) {
+            return &slots[i];
+        }
+    }
+    return NULL;
+}
+
+static call_slot_t *add_call(bool incoming, uint8_t status)
+{
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        if (!slots[i].in_use) {
+            memset(&slots[i], 0, sizeof(call_slot_t));
+            slots[i].in_use = true;
+            slots[i].seen = list_gen;
+            slots[i].call.incoming = incoming;
+            slots[i].call.status = status;
+            return &slots[i];
+        }
+    }
+    ESP_LOGW(TAG, "Call table full");
+    return NULL;
+}
+
+static void set_all(uint8_t from, uint8_t to)
+{
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        if (slots[i].in_use && slots[i].call.status == from) {
+            slots[i].call.status = to;
+        }
+    }
+}
+
+// Copy the table into ma_bell_state if it changed, listed calls first
+static void publish(void)
+{
+    static ma_bell_call_t last[MA_BELL_MAX_CALLS];
+    static uint8_t last_count;
+    ma_bell_call_t list[MA_BELL_MAX_CALLS];
+    uint8_t count = 0;
+
+    memset(list, 0, sizeof(list));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+            if (slots[i].in_use && (slots[i].call.idx != 0) == (pass == 0)) {
+                list[count++] = slots[i].call;
+            }
+        }
+    }
+
+    if (count == last_count && memcmp(list, last, sizeof(list)) == 0) {
+        return;
+    }
+    memcpy(last, list, sizeof(list));
+    last_count = count;
+    ma_bell_state_set_calls(list, count);
+}
+
+static void count_delta(void)
+{
+    portENTER_CRITICAL(&calls_stats_lock);
+    calls_stats.deltas++;
+    portEXIT_CRITICAL(&calls_stats_lock);
+}
+
+// A change could not be pinned on one call: ask the phone, once the burst settles
+static void request_listing(void)
+{
+    if (query_errors_in_row >= CALLS_MAX_QUERY_ERRORS) {
+        return;
+    }
+    if (query_outstanding) {
+        requery_wanted = true;
+        return;
+    }
+    esp_timer_stop(requery_timer);
+    esp_timer_start_once(requery_timer, (uint64_t)BT_CALLS_REQUERY_MS * 1000);
+}
+
+// Runs on the BT app task, dispatched from the timer
+static void requery_hdl(uint16_t event, void *param)
+{
+    // A warm-up listing already covers it
+    if (query_outstanding || bt_hf_warmup_pending()) {
+        return;
+    }
+
+    query_outstanding = true;
+    bt_calls_list_begin();
+    esp_err_t ret = esp_hf_client_query_current_calls();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "CLCC not sent: %s", esp_err_to_name(ret));
+        query_outstanding = false;
+        listing = false;
+        return;
+    }
+
+    portENTER_CRITICAL(&calls_stats_lock);
+    calls_stats.requeries++;
+    portEXIT_CRITICAL(&calls_stats_lock);
+}
+
+static void requery_timer_cb(void *arg)
+{
+    bt_app_work_dispatch(requery_hdl, 0, NULL, 0, NULL);
+}
+
+esp_err_t bt_calls_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = requery_timer_cb,
+        .name = "bt_calls",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &requery_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+void bt_calls_reset(void)
+{
+    if (requery_timer) {
+        esp_timer_stop(requery_timer);
+    }
+    memset(slots, 0, sizeof(slots));
+    call_ind = 0;
+    held_ind = 0;
+    listing = false;
+    query_outstanding = false;
+    requery_wanted = false;
+    query_errors_in_row = 0;
+    publish();
+}
+
+void bt_calls_call(uint8_t call)
+{
+    call_ind = call;
+
+    if (call == 0) {
+        // No active or held calls remain; a call still being offered is now alone
+        for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+            if (is_connected(&slots[i])) {
+                slots[i].in_use = false;
+            }
+        }
+        set_all(CALL_STATUS_WAITING, CALL_STATUS_INCOMING);
+    } else if (count_connected() == 0) {
+        // The call being set up was answered, or one started on the phone unseen
+        call_slot_t *slot = find_setup();
+        if (slot) {
+            slot->call.status = CALL_STATUS_ACTIVE;
+        } else {
+            add_call(false, CALL_STATUS_ACTIVE);
+            request_listing();
+        }
+    }
+
+    count_delta();
+    publish();
+}
+
+void bt_calls_call_setup(uint8_t call_setup)
+{
+    call_slot_t *slot = find_setup();
+
+    switch (call_setup) {
+        case ESP_HF_CALL_SETUP_STATUS_INCOMING:
+            if (slot == NULL) {
+                add_call(true, count_connected() ? CALL_STATUS_WAITING : CALL_STATUS_INCOMING);
+            }
+            break;
+
+        case ESP_HF_CALL_SETUP_STATUS_OUTGOING_DIALING:
+        case ESP_HF_CALL_SETUP_STATUS_OUTGOING_ALERTING:
+            if (slot == NULL) {
+                slot = add_call(false, 0);
+            }
+            if (slot) {
+                slot->call.status = (call_setup == ESP_HF_CALL_SETUP_STATUS_OUTGOING_DIALING)
+                                    ? CALL_STATUS_DIALING : CALL_STATUS_ALERTING;
+            }
+            break;
+
+        default:
+            if (slot == NULL) {
+                break;
+            }
+            if (count_connected() == 0) {
+                // Alone: it connected if call=1, otherwise it never did
+                if (call_ind) {
+                    slot->call.status = CALL_STATUS_ACTIVE;
+                } else {
+                    slot->in_use = false;
+                }
+            } else {
+                // Accepted (callheld follows) or given up: only the phone knows
+                request_listing();
+            }
+            break;
+    }
+
+    count_delta();
+    publish();
+}
+
+void bt_calls_call_held(uint8_t call_held)
+{
+    uint8_t previous = held_ind;
+    held_ind = call_held;
+
+    switch (call_held) {
+        case ESP_HF_CALL_HELD_STATUS_HELD:
+            set_all(CALL_STATUS_ACTIVE, CALL_STATUS_HELD);
+            break;
+
+        case ESP_HF_CALL_HELD_STATUS_HELD_AND_ACTIVE: {
+            call_slot_t *offered = find_setup();
+            call_slot_t *active = find_status(CALL_STATUS_ACTIVE);
+            call_slot_t *held = find_status(CALL_STATUS_HELD);
+            if (offered) {
+                // Waiting call accepted, or a second outgoing call answered
+                set_all(CALL_STATUS_ACTIVE, CALL_STATUS_HELD);
+                offered->call.status = CALL_STATUS_ACTIVE;
+            } else if (active && held && count_connected() == 2) {
+                active->call.status = CALL_STATUS_HELD;
+                held->call.status = CALL_STATUS_ACTIVE;
+            } else {
+                request_listing();
+            }
+            break;
+        }
+
+        default:
+            if (previous == ESP_HF_CALL_HELD_STATUS_HELD) {
+                set_all(CALL_STATUS_HELD, CALL_STATUS_ACTIVE);
+            } else {
+                // Conference, or the held call went away
+                request_listing();
+            }
+            break;
+    }
+
+    count_delta();
+    publish();
+}
+
+void bt_calls_number(const char *number)
+{
+    if (number == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        call_slot_t *s = &slots[i];
+        if (is_setup(s) && s->call.incoming && s->call.number[0] == '\0') {
+            strncpy(s->call.number, number, sizeof(s->call.number) - 1);
+            publish();
+            return;
+        }
+    }
+}
+
+void bt_calls_clcc(int idx, int dir, int status, int mpty, const char *number)
+{
+    bool incoming = (dir == ESP_HF_CURRENT_CALL_DIRECTION_INCOMING);
+    call_slot_t *slot = NULL;
+
+    // Same index, else a call we only know from indicators, same direction first
+    for (int i = 0; i < MA_BELL_MAX_CALLS && slot == NULL; i++) {
+        if (slots[i].in_use && slots[i].call.idx == idx) {
+            slot = &slots[i];
+        }
+    }
+    for (int pass = 0; pass < 2 && slot == NULL; pass++) {
+        for (int i = 0; i < MA_BELL_MAX_CALLS && slot == NULL; i++) {
+            if (slots[i].in_use && slots[i].call.idx == 0 &&
+                (pass == 1 || slots[i].call.incoming == incoming)) {
+                slot = &slots[i];
+            }
+        }
+    }
+    if (slot == NULL) {
+        slot = add_call(incoming, status);
+        if (slot == NULL) {
+            return;
+        }
+    }
+
+    slot->seen = list_gen;
+    slot->call.idx = idx;
+    slot->call.incoming = incoming;
+    slot->call.status = status;
+    slot->call.mpty = (mpty == ESP_HF_CURRENT_CALL_MPTY_TYPE_MULTI);
+    if (number) {
+        memset(slot->call.number, 0, sizeof(slot->call.number));
+        strncpy(slot->call.number, number, sizeof(slot->call.number) - 1);
+    }
+    publish();
+}
+
+void bt_calls_list_begin(void)
+{
+    list_gen++;
+    listing = true;
+}
+
+void bt_calls_list_end(void)
+{
+    if (!listing) {
+        return;
+    }
+    listing = false;
+
+    for (int i = 0; i < MA_BELL_MAX_CALLS; i++) {
+        if (slots[i].in_use && slots[i].seen != list_gen) {
+            slots[i].in_use = false;
+        }
+    }
+
+    portENTER_CRITICAL(&calls_stats_lock);
+    calls_stats.listings++;
+    portEXIT_CRITICAL(&calls_stats_lock);
+    publish();
+}
+
+bool bt_calls_at_response(bool ok)
+{
+    if (!query_outstanding) {
+        return false;
+    }
+    query_outstanding = false;
+
+    if (ok) {
+        query_errors_in_row = 0;
+        bt_calls_list_end();
+    } else {
+        listing = false;
+        query_errors_in_row++;
+        portENTER_CRITICAL(&calls_stats_lock);
+        calls_stats.query_errors++;
+        portEXIT_CRITICAL(&calls_stats_lock);
+        if (query_errors_in_row >= CALLS_MAX_QUERY_ERRORS) {
+            ESP_LOGW(TAG, "Phone rejects CLCC, relying on indicators only");
+        }
+    }
+
+    if (requery_wanted) {
+        requery_wanted = false;
+        request_listing();
+    }
+    return true;
+}
+
+void bt_calls_get_stats(bt_calls_stats_t *out)
+{
+    portENTER_CRITICAL(&calls_stats_lock);
+    *out = calls_stats;
+    portEXIT_CRITICAL(&calls_stats_lock);
+}
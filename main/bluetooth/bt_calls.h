@@ -0,0 +1,98 @@
+#ifndef __BT_CALLS_H__
+#define __BT_CALLS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @file bt_calls.h
+ * @brief Per-call table for the current audio gateway
+ *
+ * Keeps index, direction, status, conference flag and number for each call
+ * and publishes the list through ma_bell_state_set_calls(). The call,
+ * callsetup and callheld indicators are applied as deltas as they arrive,
+ * with the number filled in from CLIP/CCWA. Only changes that cannot be
+ * attributed to a single call (a waiting call ending while another is up,
+ * a held call disappearing) trigger an AT+CLCC listing, and listings replace
+ * the guesses with the phone's own view.
+ *
+ * All functions except bt_calls_get_stats() must be called from the BT app
+ * task.
+ */
+
+/**
+ * @brief Call table statistics
+ */
+typedef struct {
+    uint32_t deltas;         // Indicator changes applied without a query
+    uint32_t listings;       // Complete CLCC listings merged
+    uint32_t requeries;      // Listings requested because a delta was ambiguous
+    uint32_t query_errors;   // Listings answered with an error
+} bt_calls_stats_t;
+
+/**
+ * @brief Create the requery timer
+ */
+esp_err_t bt_calls_init(void);
+
+/**
+ * @brief Forget all calls (link lost)
+ */
+void bt_calls_reset(void);
+
+/**
+ * @brief Apply a change of the call indicator
+ */
+void bt_calls_call(uint8_t call);
+
+/**
+ * @brief Apply a change of the callsetup indicator
+ */
+void bt_calls_call_setup(uint8_t call_setup);
+
+/**
+ * @brief Apply a change of the callheld indicator
+ */
+void bt_calls_call_held(uint8_t call_held);
+
+/**
+ * @brief Attach a CLIP or CCWA number to the call being offered
+ */
+void bt_calls_number(const char *number);
+
+/**
+ * @brief Merge one +CLCC line
+ */
+void bt_calls_clcc(int idx, int dir, int status, int mpty, const char *number);
+
+/**
+ * @brief A CLCC listing is about to be requested by someone else
+ *
+ * Calls not listed between this and bt_calls_list_end() are dropped.
+ */
+void bt_calls_list_begin(void);
+
+/**
+ * @brief The listing started by bt_calls_list_begin() is complete
+ */
+void bt_calls_list_end(void);
+
+/**
+ * @brief Offer an AT command result to the call table
+ *
+ * Called after the warm-up has had its turn; results arrive in command
+ * order, so while a listing is outstanding the next result belongs to it.
+ *
+ * @param ok True for OK, false for any error result
+ * @return True if the result answered a listing and must not be treated as
+ *         the result of a call command
+ */
+bool bt_calls_at_response(bool ok);
+
+/**
+ * @brief Get a copy of the statistics
+ */
+void bt_calls_get_stats(bt_calls_stats_t *out);
+
+#endif /* __BT_CALLS_H__ */
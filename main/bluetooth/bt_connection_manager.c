@@ -5,122 +5,271 @@
 
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "esp_gap_bt_api.h"
 #include "esp_hf_client_api.h"
 #include "bt_connection_manager.h"
-#include "app/bluetooth/app_hf_msg_set.h"
+#include "bt_device_registry.h"
 #include "app/state/ma_bell_state.h"
 #include "app/events/event_system.h"
 #include "config/bluetooth_config.h"
 
 static const char *TAG = "BT_CONN_MGR";
 
-// Global variable to track if we're currently trying to connect
-static bool is_connecting = false;
+// Reasons the reconnect task is woken, delivered as task notification bits
+#define RC_NOTIFY_LINK_UP     (1 << 0)
+#define RC_NOTIFY_LINK_DOWN   (1 << 1)
+#define RC_NOTIFY_KICK        (1 << 2)  // Handset lifted: the user wants the phone now
 
 // Reconnection task handle
 static TaskHandle_t reconnect_task_handle = NULL;
 
-// Cache for paired device info (avoid repeated NVS queries)
-static struct {
-    bool valid;
-    esp_bd_addr_t addr;
-    char name[32];
-} paired_device_cache = {.valid = false};
+// Engine state, owned by the reconnect task; stats are copied out under the lock
+static portMUX_TYPE rc_lock = portMUX_INITIALIZER_UNLOCKED;
+static bt_reconnect_stats_t rc_stats = {.state = BT_RECONNECT_IDLE};
+static int64_t rc_deadline_us = 0;      // Next page timeout or retry, 0 for none
+static int64_t rc_link_lost_us = 0;     // When the link dropped, 0 if never up
+static int rc_device_idx = 0;           // Registry position paged in the current round
 
-// Reconnection task
+static const char *rc_state_names[] = {
+    [BT_RECONNECT_IDLE]       = "idle",
+    [BT_RECONNECT_CONNECTED]  = "connected",
+    [BT_RECONNECT_PAGING]     = "paging",
+    [BT_RECONNECT_BACKOFF]    = "backoff",
+    [BT_RECONNECT_PARKED]     = "parked",
+};
+
+static void rc_set_state(bt_reconnect_state_t state)
+{
+    portENTER_CRITICAL(&rc_lock);
+    rc_stats.state = state;
+    portEXIT_CRITICAL(&rc_lock);
+}
+
+// Exponential backoff for the given failure count, with +/- jitter so a
+// gateway and phone that lost the link together do not keep colliding
+static uint32_t rc_backoff_ms(uint32_t failures)
+{
+    uint32_t backoff = BT_RECONNECT_BACKOFF_MIN_MS;
+    for (uint32_t i = 1; i < failures && backoff < BT_RECONNECT_BACKOFF_MAX_MS; i++) {
+        backoff *= 2;
+    }
+    if (backoff > BT_RECONNECT_BACKOFF_MAX_MS) {
+        backoff = BT_RECONNECT_BACKOFF_MAX_MS;
+    }
+
+    uint32_t span = backoff * BT_RECONNECT_JITTER_PCT / 100;
+    if (span > 0) {
+        backoff = backoff - span + esp_random() % (2 * span + 1);
+    }
+    return backoff;
+}
+
+static void rc_attempt_failed(int64_t now);
+
+// Page the next phone of this round directly; no inquiry, addresses are known.
+// Rounds go most recently connected first.
+static void rc_attempt(int64_t now)
+{
+    bt_registry_entry_t phone;
+    if (bt_registry_get(rc_device_idx, &phone) != ESP_OK) {
+        if (rc_device_idx == 0) {
+            ESP_LOGI(TAG, "No paired device found, waiting for new connection");
+            // Set discoverable and connectable mode for new connections
+            esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE);
+            rc_deadline_us = 0;
+            rc_set_state(BT_RECONNECT_IDLE);
+        } else {
+            rc_attempt_failed(now);  // Registry shrank mid-round
+        }
+        return;
+    }
+
+    ESP_LOGI(TAG, "Paging %s (%d of %d, round %" PRIu32 ")", phone.name, rc_device_idx + 1,
+             bt_registry_count(), rc_stats.consecutive_failures + 1);
+
+    portENTER_CRITICAL(&rc_lock);
+    rc_stats.attempts++;
+    rc_stats.state = BT_RECONNECT_PAGING;
+    portEXIT_CRITICAL(&rc_lock);
+
+    rc_deadline_us = now + (int64_t)BT_RECONNECT_ATTEMPT_TIMEOUT_MS * 1000;
+    esp_err_t ret = esp_hf_client_connect(phone.addr);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Connect request failed: %s", esp_err_to_name(ret));
+        rc_deadline_us = now;  // Counts as a failed page on the next pass
+    }
+}
+
+// Start a new round at the most recent phone
+static void rc_start_round(int64_t now)
+{
+    rc_device_idx = 0;
+    rc_attempt(now);
+}
+
+// A page failed or timed out: try the next phone, or back off once every
+// phone has been tried, or park once they all seem gone
+static void rc_attempt_failed(int64_t now)
+{
+    uint32_t failures;
+
+    portENTER_CRITICAL(&rc_lock);
+    rc_stats.failures++;
+    portEXIT_CRITICAL(&rc_lock);
+
+    if (++rc_device_idx < bt_registry_count()) {
+        rc_attempt(now);
+        return;
+    }
+
+    portENTER_CRITICAL(&rc_lock);
+    failures = ++rc_stats.consecutive_failures;
+    portEXIT_CRITICAL(&rc_lock);
+
+    if (failures >= BT_RECONNECT_MAX_ATTEMPTS) {
+        // Still connectable, so a phone can come to us when it is back
+        ESP_LOGI(TAG, "No phone reachable after %" PRIu32 " rounds, parking", failures);
+        rc_deadline_us = 0;
+        rc_set_state(BT_RECONNECT_PARKED);
+        return;
+    }
+
+    uint32_t backoff = rc_backoff_ms(failures);
+    ESP_LOGI(TAG, "No phone answered, retrying in %" PRIu32 " ms", backoff);
+    rc_deadline_us = now + (int64_t)backoff * 1000;
+    rc_set_state(BT_RECONNECT_BACKOFF);
+}
+
+static void rc_link_up(int64_t now)
+{
+    portENTER_CRITICAL(&rc_lock);
+    if (rc_link_lost_us != 0) {
+        uint32_t ttr_ms = (uint32_t)((now - rc_link_lost_us) / 1000);
+        rc_stats.reconnects++;
+        rc_stats.last_ttr_ms = ttr_ms;
+        rc_stats.total_ttr_ms += ttr_ms;
+        if (ttr_ms > rc_stats.max_ttr_ms) {
+            rc_stats.max_ttr_ms = ttr_ms;
+        }
+    }
+    rc_stats.consecutive_failures = 0;
+    rc_stats.state = BT_RECONNECT_CONNECTED;
+    portEXIT_CRITICAL(&rc_lock);
+
+    rc_link_lost_us = 0;
+    rc_deadline_us = 0;
+}
+
+// Reconnection task: sleeps until a link event, a kick or its own deadline
 static void bt_reconnect_task(void *pvParameters)
 {
+    // Bound every page so a missing phone cannot hold the radio for long
+    esp_err_t ret = esp_bt_gap_set_page_timeout((uint16_t)(BT_RECONNECT_PAGE_TIMEOUT_MS * 8 / 5));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set page timeout: %s", esp_err_to_name(ret));
+    }
+
+    // Boot counts as a link loss: reconnect straight away
+    if (bt_connection_manager_is_connected()) {
+        rc_link_up(esp_timer_get_time());
+    } else {
+        rc_link_lost_us = esp_timer_get_time();
+        rc_start_round(rc_link_lost_us);
+    }
+
     while (1) {
-        // Only attempt reconnection if we're not already connected and not currently trying to connect
-        if (!ma_bell_state_bluetooth_bits_set(BT_STATE_CONNECTED) && !is_connecting) {
-            // Only query storage if cache is invalid
-            if (!paired_device_cache.valid) {
-                esp_err_t ret = app_hf_get_paired_device(
-                    paired_device_cache.addr,
-                    paired_device_cache.name,
-                    sizeof(paired_device_cache.name)
-                );
-
-                if (ret == ESP_OK) {
-                    // Check if we have a valid stored device (not all zeros)
-                    bool has_valid_device = false;
-                    for (int i = 0; i < ESP_BD_ADDR_LEN; i++) {
-                        if (paired_device_cache.addr[i] != 0) {
-                            has_valid_device = true;
-                            break;
-                        }
-                    }
-                    paired_device_cache.valid = has_valid_device;
-                }
+        TickType_t wait = portMAX_DELAY;
+        if (rc_deadline_us != 0) {
+            int64_t remaining_us = rc_deadline_us - esp_timer_get_time();
+            wait = remaining_us > 0 ? pdMS_TO_TICKS((remaining_us + 999) / 1000) : 0;
+        }
+
+        uint32_t notes = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &notes, wait);
+        int64_t now = esp_timer_get_time();
+        bt_reconnect_state_t state = rc_stats.state;
+
+        if (notes & RC_NOTIFY_LINK_UP) {
+            rc_link_up(now);
+            continue;
+        }
+
+        if (notes & RC_NOTIFY_LINK_DOWN) {
+            if (state == BT_RECONNECT_PAGING) {
+                // The page itself failed, no need to wait out the timeout
+                rc_attempt_failed(now);
+            } else if (state == BT_RECONNECT_CONNECTED) {
+                ESP_LOGI(TAG, "Link lost, reconnecting");
+                rc_link_lost_us = now;
+                rc_start_round(now);
             }
+            continue;
+        }
 
-            if (paired_device_cache.valid) {
-                ESP_LOGI(TAG, "Found stored device %s, attempting to reconnect", paired_device_cache.name);
-                is_connecting = true;
-
-                // Start inquiry to find the device
-                esp_bt_inq_mode_t inq_mode = ESP_BT_INQ_MODE_GENERAL_INQUIRY;
-                uint8_t inq_len = BT_DISCOVERY_DURATION;
-                uint8_t inq_num_rsps = BT_DISCOVERY_MAX_RESPONSES;
-                esp_err_t ret = esp_bt_gap_start_discovery(inq_mode, inq_len, inq_num_rsps);
-                if (ret != ESP_OK) {
-                    ESP_LOGE(TAG, "Failed to start discovery: %s", esp_err_to_name(ret));
-                    is_connecting = false;
-                }
-            } else {
-                ESP_LOGI(TAG, "No paired device found, waiting for new connection");
-                // Set discoverable and connectable mode for new connections
-                ESP_ERROR_CHECK(esp_bt_gap_set_scan_mode(ESP_BT_CONNECTABLE, ESP_BT_GENERAL_DISCOVERABLE));
+        if ((notes & RC_NOTIFY_KICK) &&
+            (state == BT_RECONNECT_PARKED || state == BT_RECONNECT_BACKOFF)) {
+            ESP_LOGI(TAG, "Handset lifted, paging now");
+            portENTER_CRITICAL(&rc_lock);
+            rc_stats.consecutive_failures = 0;
+            portEXIT_CRITICAL(&rc_lock);
+            rc_start_round(now);
+            continue;
+        }
+
+        if (rc_deadline_us != 0 && now >= rc_deadline_us) {
+            if (state == BT_RECONNECT_PAGING) {
+                rc_attempt_failed(now);
+            } else if (state == BT_RECONNECT_BACKOFF) {
+                rc_start_round(now);
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(BT_RECONNECT_INTERVAL_MS));
     }
 }
 
-// GAP callback for connection management
-void bt_connection_manager_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param)
+// Forward link and hook events to the reconnect task
+static void bt_reconnect_event_handler(event_type_t event, void *user_data)
 {
+    uint32_t note = 0;
+
     switch (event) {
-        case ESP_BT_GAP_DISC_STATE_CHANGED_EVT:
-            ESP_LOGI(TAG, "Discovery state changed: %d", param->disc_st_chg.state);
-            if (param->disc_st_chg.state == ESP_BT_GAP_DISCOVERY_STOPPED) {
-                is_connecting = false;
-                // Publish disconnection event if stopped while connecting
-                event_publish(BT_EVENT_DISCONNECTED, NULL);
-            }
+        case BT_EVENT_CONNECTED:
+            note = RC_NOTIFY_LINK_UP;
             break;
-
-        case ESP_BT_GAP_DISC_RES_EVT:
-            // Use cached data instead of querying storage again
-            if (is_connecting && paired_device_cache.valid) {
-                // Check if this is our paired device
-                if (memcmp(param->disc_res.bda, paired_device_cache.addr, ESP_BD_ADDR_LEN) == 0) {
-                    ESP_LOGI(TAG, "Matched paired device %s, initiating connection", paired_device_cache.name);
-                    esp_bt_gap_cancel_discovery();
-                    esp_hf_client_connect(param->disc_res.bda);
-                    // Publish connection event (will be confirmed by HFP callback)
-                    event_publish(BT_EVENT_CONNECTED, NULL);
-                }
-            }
+        case BT_EVENT_DISCONNECTED:
+            note = RC_NOTIFY_LINK_DOWN;
             break;
+        case PHONE_EVENT_OFF_HOOK:
+            note = RC_NOTIFY_KICK;
+            break;
+        default:
+            return;
+    }
+
+    if (reconnect_task_handle != NULL) {
+        xTaskNotify(reconnect_task_handle, note, eSetBits);
+    }
+}
 
+// GAP callback for connection management
+void bt_connection_manager_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_param_t *param)
+{
+    switch (event) {
         case ESP_BT_GAP_AUTH_CMPL_EVT:
             if (param->auth_cmpl.stat == ESP_BT_STATUS_SUCCESS) {
                 ESP_LOGI(TAG, "Authentication success with device: %s", param->auth_cmpl.device_name);
                 // Convert device name to string and store paired device info
                 char device_name[32] = {0};
                 strncpy(device_name, (const char*)param->auth_cmpl.device_name, sizeof(device_name) - 1);
-                app_hf_store_paired_device(param->auth_cmpl.bda, device_name);
+                bt_registry_add(param->auth_cmpl.bda, device_name);
                 ESP_LOGI(TAG, "Stored paired device: %s", device_name);
-                // Invalidate cache to force refresh on next reconnection attempt
-                paired_device_cache.valid = false;
             } else {
                 ESP_LOGE(TAG, "Authentication failed: %d", param->auth_cmpl.stat);
-                is_connecting = false;
             }
             break;
 
@@ -132,6 +281,12 @@ void bt_connection_manager_gap_cb(esp_bt_gap_cb_event_t event, esp_bt_gap_cb_par
             esp_bt_gap_pin_reply(param->pin_req.bda, true, BT_PIN_CODE_LEN, pin_code);
             break;
 
+        case ESP_BT_GAP_SET_PAGE_TO_EVT:
+            if (param->set_page_timeout.stat != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGW(TAG, "Page timeout not applied: %d", param->set_page_timeout.stat);
+            }
+            break;
+
         default:
             break;
     }
@@ -142,6 +297,11 @@ esp_err_t bt_connection_manager_init(void)
 {
     ESP_LOGI(TAG, "Initializing Bluetooth connection manager");
 
+    esp_err_t reg_ret = bt_registry_init();
+    if (reg_ret != ESP_OK) {
+        return reg_ret;
+    }
+
     // Create reconnection task
     BaseType_t ret = xTaskCreate(bt_reconnect_task,
                                   BT_RECONNECT_TASK_NAME,
@@ -155,6 +315,13 @@ esp_err_t bt_connection_manager_init(void)
         return ESP_FAIL;
     }
 
+    esp_err_t err = event_subscribe(BT_EVENT_CONNECTED | BT_EVENT_DISCONNECTED | PHONE_EVENT_OFF_HOOK,
+                                    bt_reconnect_event_handler, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe to link events: %s", esp_err_to_name(err));
+        return err;
+    }
+
     ESP_LOGI(TAG, "Bluetooth connection manager initialized successfully");
     return ESP_OK;
 }
@@ -164,3 +331,24 @@ bool bt_connection_manager_is_connected(void)
 {
     return ma_bell_state_bluetooth_bits_set(BT_STATE_CONNECTED);
 }
+
+void bt_connection_manager_get_stats(bt_reconnect_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&rc_lock);
+    *out = rc_stats;
+    portEXIT_CRITICAL(&rc_lock);
+
+    int64_t deadline = rc_deadline_us;
+    int64_t remaining_us = deadline ? deadline - esp_timer_get_time() : 0;
+    out->next_attempt_ms = (out->state == BT_RECONNECT_BACKOFF && remaining_us > 0)
+                           ? (uint32_t)(remaining_us / 1000) : 0;
+}
+
+const char *bt_connection_manager_state_name(bt_reconnect_state_t state)
+{
+    return (state <= BT_RECONNECT_PARKED) ? rc_state_names[state] : "unknown";
+}
@@ -1,13 +1,48 @@
 #ifndef __BT_CONNECTION_MANAGER_H__
 #define __BT_CONNECTION_MANAGER_H__
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "esp_err.h"
 #include "esp_gap_bt_api.h"
 
+/**
+ * @brief Reconnect engine state
+ */
+typedef enum {
+    BT_RECONNECT_IDLE,        // No paired phone, discoverable and waiting
+    BT_RECONNECT_CONNECTED,   // Link up
+    BT_RECONNECT_PAGING,      // Page to the paired phone in progress
+    BT_RECONNECT_BACKOFF,     // Waiting to page again
+    BT_RECONNECT_PARKED,      // Phone appears away; no wakeups until it or the handset returns
+} bt_reconnect_state_t;
+
+/**
+ * @brief Reconnect statistics
+ *
+ * Time-to-reconnect runs from the link dropping (or boot) to the next
+ * connection, whichever side initiated it.
+ */
+typedef struct {
+    bt_reconnect_state_t state;
+    uint32_t attempts;              // Pages started
+    uint32_t failures;              // Pages that failed or timed out
+    uint32_t consecutive_failures;  // Failed rounds since the last connection
+    uint32_t reconnects;            // Links restored after a loss
+    uint32_t last_ttr_ms;           // Most recent time-to-reconnect
+    uint32_t max_ttr_ms;            // Worst time-to-reconnect
+    uint64_t total_ttr_ms;          // Sum, for averaging
+    uint32_t next_attempt_ms;       // Until the next page while backing off, else 0
+} bt_reconnect_stats_t;
+
 /**
  * @brief Initialize the Bluetooth connection manager
  *
- * This starts the reconnection task and registers GAP callback
+ * Starts the reconnection task and subscribes it to link and hook events.
+ * When the link drops the task pages each registered phone once, most
+ * recently connected first. It repeats such rounds with jittered
+ * exponential backoff, and parks after BT_RECONNECT_MAX_ATTEMPTS failed
+ * rounds until a phone connects to us or the handset is lifted.
  *
  * @return ESP_OK on success, error code on failure
  */
@@ -16,7 +51,7 @@ esp_err_t bt_connection_manager_init(void);
 /**
  * @brief GAP callback for connection management
  *
- * Handles discovery, authentication, and PIN requests
+ * Handles authentication and PIN requests
  *
  * @param event GAP event type
  * @param param Event parameters
@@ -31,4 +66,16 @@ void bt_connection_manager_gap_cb(esp_bt_gap_cb_event_t event,
  */
 bool bt_connection_manager_is_connected(void);
 
+/**
+ * @brief Get a snapshot of the reconnect statistics
+ *
+ * @param out Destination for the copy
+ */
+void bt_connection_manager_get_stats(bt_reconnect_stats_t *out);
+
+/**
+ * @brief Get a short name for a reconnect state
+ */
+const char *bt_connection_manager_state_name(bt_reconnect_state_t state);
+
 #endif /* __BT_CONNECTION_MANAGER_H__ */
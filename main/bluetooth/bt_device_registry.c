@@ -0,0 +1,228 @@
+/*
+ * Paired phone registry
+ * MRU-ordered list of paired audio gateways, mirrored in one NVS blob
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "bt_device_registry.h"
+#include "storage/storage.h"
+#include "config/bluetooth_config.h"
+#include "network/clock/clock.h"
+
+static const char *TAG = "bt_registry";
+
+// Bump when bt_registry_blob_t changes; older blobs are discarded
+#define BT_REGISTRY_VERSION  1
+
+// On-flash layout, entries most recent first
+typedef struct {
+    uint16_t version;
+    uint8_t count;
+    uint8_t reserved;
+    uint32_t next_seq;
+    bt_registry_entry_t entries[BT_REGISTRY_MAX_DEVICES];
+} bt_registry_blob_t;
+
+// RAM copy is the index; NVS is only written on change
+static bt_registry_blob_t registry;
+static SemaphoreHandle_t registry_mutex = NULL;
+
+static int find_locked(const esp_bd_addr_t addr)
+{
+    for (int i = 0; i < registry.count; i++) {
+        if (memcmp(registry.entries[i].addr, addr, ESP_BD_ADDR_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Move entry idx to the front, shifting the more recent ones down
+static void promote_locked(int idx)
+{
+    if (idx <= 0) {
+        return;
+    }
+    bt_registry_entry_t entry = registry.entries[idx];
+    memmove(&registry.entries[1], &registry.entries[0], idx * sizeof(bt_registry_entry_t));
+    registry.entries[0] = entry;
+}
+
+static void stamp_locked(bt_registry_entry_t *entry)
+{
+    entry->last_connected = (uint32_t)clock_now();
+    entry->connect_seq = ++registry.next_seq;
+}
+
+// Insert at the front (evicting the oldest if full) or promote an existing entry
+static bt_registry_entry_t *upsert_locked(const esp_bd_addr_t addr)
+{
+    int idx = find_locked(addr);
+    if (idx < 0) {
+        if (registry.count < BT_REGISTRY_MAX_DEVICES) {
+            registry.count++;
+        } else {
+            ESP_LOGI(TAG, "Registry full, forgetting %s", registry.entries[registry.count - 1].name);
+        }
+        idx = registry.count - 1;
+        memset(&registry.entries[idx], 0, sizeof(bt_registry_entry_t));
+        memcpy(registry.entries[idx].addr, addr, ESP_BD_ADDR_LEN);
+    }
+    promote_locked(idx);
+    return &registry.entries[0];
+}
+
+static esp_err_t save_locked(void)
+{
+    esp_err_t ret = storage_set_blob(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_REGISTRY,
+                                     &registry, sizeof(registry));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save registry: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+// Import the single device stored by earlier firmware, then drop its keys
+static void migrate_legacy(void)
+{
+    char addr_str[18];
+    if (storage_get_str(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_PAIRED_DEV,
+                        addr_str, sizeof(addr_str)) != ESP_OK) {
+        return;
+    }
+
+    unsigned int v[ESP_BD_ADDR_LEN];
+    if (sscanf(addr_str, "%x:%x:%x:%x:%x:%x", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) == 6) {
+        esp_bd_addr_t addr;
+        for (int i = 0; i < ESP_BD_ADDR_LEN; i++) {
+            addr[i] = (uint8_t)v[i];
+        }
+
+        bt_registry_entry_t *entry = upsert_locked(addr);
+        if (storage_get_str(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_PAIRED_NAME,
+                            entry->name, sizeof(entry->name)) != ESP_OK) {
+            entry->name[0] = '\0';
+        }
+        entry->connect_seq = ++registry.next_seq;
+
+        if (save_locked() != ESP_OK) {
+            return;  // Keep the legacy keys and try again next boot
+        }
+        ESP_LOGI(TAG, "Migrated paired device %s (%s)", entry->name, addr_str);
+    } else {
+        ESP_LOGW(TAG, "Discarding malformed legacy address: %s", addr_str);
+    }
+
+    storage_delete(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_PAIRED_DEV);
+    storage_delete(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_PAIRED_NAME);
+}
+
+esp_err_t bt_registry_init(void)
+{
+    if (registry_mutex == NULL) {
+        registry_mutex = xSemaphoreCreateMutex();
+        if (registry_mutex == NULL) {
+            ESP_LOGE(TAG, "Failed to create mutex");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+
+    size_t len = sizeof(registry);
+    esp_err_t ret = storage_get_blob(STORAGE_NAMESPACE_BT, STORAGE_KEY_BT_REGISTRY, &registry, &len);
+    if (ret != ESP_OK || len != sizeof(registry) || registry.version != BT_REGISTRY_VERSION ||
+        registry.count > BT_REGISTRY_MAX_DEVICES) {
+        if (ret == ESP_OK) {
+            ESP_LOGW(TAG, "Ignoring registry blob (version %u, %u bytes)", registry.version, (unsigned)len);
+        }
+        memset(&registry, 0, sizeof(registry));
+        registry.version = BT_REGISTRY_VERSION;
+        migrate_legacy();
+    }
+
+    for (int i = 0; i < registry.count; i++) {
+        registry.entries[i].name[BT_REGISTRY_NAME_LEN - 1] = '\0';
+    }
+    ESP_LOGI(TAG, "%u paired phone(s)%s%s", registry.count,
+             registry.count ? ", most recent: " : "",
+             registry.count ? registry.entries[0].name : "");
+
+    xSemaphoreGive(registry_mutex);
+    return ESP_OK;
+}
+
+esp_err_t bt_registry_add(const esp_bd_addr_t addr, const char *name)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    bt_registry_entry_t *entry = upsert_locked(addr);
+    if (name) {
+        strncpy(entry->name, name, BT_REGISTRY_NAME_LEN - 1);
+        entry->name[BT_REGISTRY_NAME_LEN - 1] = '\0';
+    }
+    stamp_locked(entry);
+    esp_err_t ret = save_locked();
+    xSemaphoreGive(registry_mutex);
+    return ret;
+}
+
+esp_err_t bt_registry_touch(const esp_bd_addr_t addr)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    bt_registry_entry_t *entry = upsert_locked(addr);
+    stamp_locked(entry);
+    esp_err_t ret = save_locked();
+    xSemaphoreGive(registry_mutex);
+    return ret;
+}
+
+esp_err_t bt_registry_remove(const esp_bd_addr_t addr)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    int idx = find_locked(addr);
+    if (idx < 0) {
+        xSemaphoreGive(registry_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memmove(&registry.entries[idx], &registry.entries[idx + 1],
+            (registry.count - idx - 1) * sizeof(bt_registry_entry_t));
+    registry.count--;
+    memset(&registry.entries[registry.count], 0, sizeof(bt_registry_entry_t));
+    esp_err_t ret = save_locked();
+    xSemaphoreGive(registry_mutex);
+    return ret;
+}
+
+esp_err_t bt_registry_clear(void)
+{
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    uint32_t seq = registry.next_seq;
+    memset(&registry, 0, sizeof(registry));
+    registry.version = BT_REGISTRY_VERSION;
+    registry.next_seq = seq;
+    esp_err_t ret = save_locked();
+    xSemaphoreGive(registry_mutex);
+    return ret;
+}
+
+int bt_registry_count(void)
+{
+    return registry.count;
+}
+
+esp_err_t bt_registry_get(int index, bt_registry_entry_t *out)
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(registry_mutex, portMAX_DELAY);
+    if (index >= 0 && index < registry.count) {
+        *out = registry.entries[index];
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(registry_mutex);
+    return ret;
+}
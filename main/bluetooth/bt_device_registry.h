@@ -0,0 +1,88 @@
+#ifndef __BT_DEVICE_REGISTRY_H__
+#define __BT_DEVICE_REGISTRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_gap_bt_api.h"
+
+/**
+ * @file bt_device_registry.h
+ * @brief Registry of paired phones (audio gateways)
+ *
+ * Up to BT_REGISTRY_MAX_DEVICES phones are kept most-recently-connected
+ * first, in RAM, and persisted as a single versioned NVS blob. Lookups never
+ * touch NVS; only pairing, connecting and removal write it back.
+ */
+
+#define BT_REGISTRY_NAME_LEN  32
+
+/**
+ * @brief One paired phone
+ */
+typedef struct {
+    esp_bd_addr_t addr;
+    char name[BT_REGISTRY_NAME_LEN];
+    uint32_t last_connected;   // Unix time of the last connection, 0 if the clock was not set
+    uint32_t connect_seq;      // Registry-wide connection counter, orders entries without a clock
+} bt_registry_entry_t;
+
+/**
+ * @brief Load the registry from NVS
+ *
+ * Migrates the legacy single paired-device keys on first boot with the new
+ * format. Must be called after storage_init().
+ *
+ * @return ESP_OK on success (an empty or unreadable registry starts empty)
+ */
+esp_err_t bt_registry_init(void);
+
+/**
+ * @brief Add or refresh a phone after pairing
+ *
+ * The phone becomes the most recent entry. When the registry is full the
+ * least recently connected phone is dropped.
+ *
+ * @param addr Phone address
+ * @param name Phone name, may be NULL to keep an existing name
+ * @return ESP_OK on success, error code if it could not be persisted
+ */
+esp_err_t bt_registry_add(const esp_bd_addr_t addr, const char *name);
+
+/**
+ * @brief Record a connection to a registered phone
+ *
+ * Moves the phone to the front and stamps it. Unknown addresses are added.
+ *
+ * @param addr Phone address
+ * @return ESP_OK on success, error code if it could not be persisted
+ */
+esp_err_t bt_registry_touch(const esp_bd_addr_t addr);
+
+/**
+ * @brief Forget one phone
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if not registered
+ */
+esp_err_t bt_registry_remove(const esp_bd_addr_t addr);
+
+/**
+ * @brief Forget all phones
+ */
+esp_err_t bt_registry_clear(void);
+
+/**
+ * @brief Number of registered phones
+ */
+int bt_registry_count(void);
+
+/**
+ * @brief Get a phone by recency
+ *
+ * @param index 0 for the most recently connected phone
+ * @param out Destination for a copy of the entry
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND past the end
+ */
+esp_err_t bt_registry_get(int index, bt_registry_entry_t *out);
+
+#endif /* __BT_DEVICE_REGISTRY_H__ */
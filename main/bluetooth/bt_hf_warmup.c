@@ -0,0 +1,219 @@
+/*
+ * HFP connection warm-up
+ * Batched COPS/CNUM/CLCC queries after the service level connection comes up
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_hf_client_api.h"
+#include "bt_hf_warmup.h"
+#include "bt_app_core.h"
+#include "bt_calls.h"
+#include "app/state/ma_bell_state.h"
+#include "config/bluetooth_config.h"
+
+static const char *TAG = "bt_hf_warmup";
+
+typedef enum {
+    WARMUP_IDLE,        // No link
+    WARMUP_CONNECTED,   // RFCOMM up, waiting for the service level connection
+    WARMUP_QUERYING,    // Queries outstanding
+    WARMUP_READY,       // All queries answered or abandoned
+} warmup_phase_t;
+
+// Queries sent on every service level connection, in this order
+static const struct {
+    const char *name;
+    esp_err_t (*send)(void);
+} warmup_queries[] = {
+    {"COPS", esp_hf_client_query_current_operator_name},
+    {"CNUM", esp_hf_client_retrieve_subscriber_info},
+    {"CLCC", esp_hf_client_query_current_calls},
+};
+
+#define WARMUP_QUERY_COUNT (sizeof(warmup_queries) / sizeof(warmup_queries[0]))
+
+// Phase is read from the stack task to pick a dispatch lane
+static volatile warmup_phase_t warmup_phase = WARMUP_IDLE;
+static int64_t warmup_connect_us;
+static uint8_t warmup_outstanding;
+static uint8_t warmup_calls;
+static bool warmup_listed;           // CLCC sent; it is last, so the final result is its own
+static bool warmup_last_ok;
+static uint32_t warmup_generation;   // Lets a late timeout recognise a finished warm-up
+static esp_timer_handle_t warmup_timer = NULL;
+
+static bt_hf_warmup_stats_t warmup_stats;
+static portMUX_TYPE warmup_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void warmup_finish(bool timed_out)
+{
+    uint32_t ready_ms = (uint32_t)((esp_timer_get_time() - warmup_connect_us) / 1000);
+
+    esp_timer_stop(warmup_timer);
+    warmup_phase = WARMUP_READY;
+    warmup_outstanding = 0;
+
+    portENTER_CRITICAL(&warmup_stats_lock);
+    warmup_stats.ready = true;
+    warmup_stats.calls_at_connect = warmup_calls;
+    warmup_stats.warmups++;
+    if (timed_out) {
+        warmup_stats.timeouts++;
+    }
+    warmup_stats.last_ready_ms = ready_ms;
+    if (ready_ms > warmup_stats.max_ready_ms) {
+        warmup_stats.max_ready_ms = ready_ms;
+    }
+    warmup_stats.total_ready_ms += ready_ms;
+    portEXIT_CRITICAL(&warmup_stats_lock);
+
+    // The listing replaces whatever the indicators suggested before it
+    if (!timed_out && warmup_listed && warmup_last_ok) {
+        bt_calls_list_end();
+    }
+
+    ESP_LOGI(TAG, "Link ready %" PRIu32 " ms after connect%s, %u call(s) in progress",
+             ready_ms, timed_out ? " (query timed out)" : "", warmup_calls);
+}
+
+// Runs on the BT app task, dispatched from the timer
+static void warmup_timeout_hdl(uint16_t event, void *param)
+{
+    uint32_t generation = *(uint32_t *)param;
+
+    if (warmup_phase == WARMUP_QUERYING && generation == warmup_generation) {
+        ESP_LOGW(TAG, "%u warm-up quer%s unanswered", warmup_outstanding,
+                 warmup_outstanding == 1 ? "y" : "ies");
+        warmup_finish(true);
+    }
+}
+
+static void warmup_timer_cb(void *arg)
+{
+    uint32_t generation = warmup_generation;
+    bt_app_work_dispatch(warmup_timeout_hdl, 0, &generation, sizeof(generation), NULL);
+}
+
+esp_err_t bt_hf_warmup_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = warmup_timer_cb,
+        .name = "hf_warmup",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &warmup_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+void bt_hf_warmup_connected(void)
+{
+    warmup_connect_us = esp_timer_get_time();
+    warmup_phase = WARMUP_CONNECTED;
+    warmup_outstanding = 0;
+    warmup_calls = 0;
+    ma_bell_state_set_bt_network_info("", "");
+
+    portENTER_CRITICAL(&warmup_stats_lock);
+    warmup_stats.ready = false;
+    portEXIT_CRITICAL(&warmup_stats_lock);
+}
+
+void bt_hf_warmup_slc_up(void)
+{
+    if (warmup_phase != WARMUP_CONNECTED) {
+        return;
+    }
+
+    warmup_generation++;
+    warmup_calls = 0;
+    warmup_outstanding = 0;
+    warmup_listed = false;
+    // Set before sending so results are claimed even if they beat the loop
+    warmup_phase = WARMUP_QUERYING;
+
+    for (size_t i = 0; i < WARMUP_QUERY_COUNT; i++) {
+        bool listing = (warmup_queries[i].send == esp_hf_client_query_current_calls);
+        if (listing) {
+            bt_calls_list_begin();
+        }
+        esp_err_t ret = warmup_queries[i].send();
+        warmup_listed = listing && ret == ESP_OK;
+        if (ret == ESP_OK) {
+            warmup_outstanding++;
+        } else {
+            ESP_LOGW(TAG, "%s query not sent: %s", warmup_queries[i].name, esp_err_to_name(ret));
+        }
+    }
+
+    if (warmup_outstanding == 0) {
+        warmup_finish(false);
+        return;
+    }
+    esp_timer_start_once(warmup_timer, (uint64_t)BT_HF_WARMUP_TIMEOUT_MS * 1000);
+}
+
+void bt_hf_warmup_disconnected(void)
+{
+    if (warmup_timer) {
+        esp_timer_stop(warmup_timer);
+    }
+    warmup_generation++;
+    warmup_phase = WARMUP_IDLE;
+    warmup_outstanding = 0;
+    ma_bell_state_set_bt_network_info("", "");
+
+    portENTER_CRITICAL(&warmup_stats_lock);
+    warmup_stats.ready = false;
+    portEXIT_CRITICAL(&warmup_stats_lock);
+}
+
+void bt_hf_warmup_subscriber(const char *number)
+{
+    if (number) {
+        ma_bell_state_set_bt_network_info(NULL, number);
+        ESP_LOGI(TAG, "Subscriber number: %s", number);
+    }
+}
+
+void bt_hf_warmup_call_listed(void)
+{
+    if (warmup_phase == WARMUP_QUERYING) {
+        warmup_calls++;
+    }
+}
+
+bool bt_hf_warmup_at_response(bool ok)
+{
+    if (warmup_phase != WARMUP_QUERYING || warmup_outstanding == 0) {
+        return false;
+    }
+
+    warmup_last_ok = ok;
+    if (!ok) {
+        portENTER_CRITICAL(&warmup_stats_lock);
+        warmup_stats.query_errors++;
+        portEXIT_CRITICAL(&warmup_stats_lock);
+    }
+    if (--warmup_outstanding == 0) {
+        warmup_finish(false);
+    }
+    return true;
+}
+
+bool bt_hf_warmup_pending(void)
+{
+    return warmup_phase == WARMUP_QUERYING;
+}
+
+void bt_hf_warmup_get_stats(bt_hf_warmup_stats_t *out)
+{
+    portENTER_CRITICAL(&warmup_stats_lock);
+    *out = warmup_stats;
+    portEXIT_CRITICAL(&warmup_stats_lock);
+}
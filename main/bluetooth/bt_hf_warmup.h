@@ -0,0 +1,91 @@
+#ifndef __BT_HF_WARMUP_H__
+#define __BT_HF_WARMUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @file bt_hf_warmup.h
+ * @brief Connection warm-up for the HFP service level connection
+ *
+ * As soon as the service level connection is up the operator name (COPS),
+ * subscriber number (CNUM) and current call list (CLCC) are requested back
+ * to back. Bluedroid queues the AT commands, so the phone answers them in one
+ * burst instead of one query per user action. Results are cached in
+ * ma_bell_state. The indicators (CIND) are read by the stack itself while the
+ * service level connection is set up.
+ *
+ * All functions except bt_hf_warmup_get_stats() and bt_hf_warmup_pending()
+ * must be called from the BT app task.
+ */
+
+/**
+ * @brief Warm-up statistics
+ */
+typedef struct {
+    bool ready;              // Current link has finished warm-up
+    uint8_t calls_at_connect;// Calls listed by CLCC during the last warm-up
+    uint32_t warmups;        // Warm-ups completed
+    uint32_t timeouts;       // Warm-ups that gave up on a query
+    uint32_t query_errors;   // Queries answered with an error
+    uint32_t last_ready_ms;  // Connect to ready, last warm-up
+    uint32_t max_ready_ms;   // Slowest warm-up
+    uint64_t total_ready_ms; // Sum, for averaging
+} bt_hf_warmup_stats_t;
+
+/**
+ * @brief Create the warm-up timeout timer
+ */
+esp_err_t bt_hf_warmup_init(void);
+
+/**
+ * @brief RFCOMM link to the audio gateway is up, start timing
+ */
+void bt_hf_warmup_connected(void);
+
+/**
+ * @brief Service level connection is up, issue the queries
+ */
+void bt_hf_warmup_slc_up(void);
+
+/**
+ * @brief Link lost, abandon any warm-up and clear the cached values
+ */
+void bt_hf_warmup_disconnected(void);
+
+/**
+ * @brief Cache a subscriber number reported by the audio gateway
+ */
+void bt_hf_warmup_subscriber(const char *number);
+
+/**
+ * @brief Count a call reported in a CLCC listing
+ */
+void bt_hf_warmup_call_listed(void);
+
+/**
+ * @brief Offer an AT command result to the warm-up
+ *
+ * Results arrive in the order the commands were sent, so while warm-up
+ * queries are outstanding the next results belong to them.
+ *
+ * @param ok True for OK, false for any error result
+ * @return True if the result answered a warm-up query and must not be
+ *         treated as the result of a call command
+ */
+bool bt_hf_warmup_at_response(bool ok);
+
+/**
+ * @brief Whether warm-up queries are outstanding
+ *
+ * Safe to call from the Bluetooth stack task.
+ */
+bool bt_hf_warmup_pending(void);
+
+/**
+ * @brief Get a copy of the warm-up statistics
+ */
+void bt_hf_warmup_get_stats(bt_hf_warmup_stats_t *out);
+
+#endif /* __BT_HF_WARMUP_H__ */
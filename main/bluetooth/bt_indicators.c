@@ -0,0 +1,145 @@
+/*
+ * HFP indicator cache
+ * Suppresses repeated indicator reports and publishes only changes
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "bt_indicators.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+
+static const char *TAG = "bt_indicators";
+
+static const char *indicator_names[BT_IND_COUNT] = {
+    [BT_IND_SERVICE]  = "service",
+    [BT_IND_SIGNAL]   = "signal",
+    [BT_IND_ROAMING]  = "roaming",
+    [BT_IND_BATTERY]  = "battery",
+    [BT_IND_OPERATOR] = "operator",
+};
+
+static bt_indicator_stats_t indicators[BT_IND_COUNT];
+static uint32_t change_seq = 0;
+static char operator_name[sizeof(((ma_bell_state_t *)0)->bluetooth.operator_name)];
+
+// Written on the BT app task, read by the web server
+static portMUX_TYPE indicators_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void bt_indicators_update(bt_indicator_t indicator, int value)
+{
+    if (indicator >= BT_IND_OPERATOR || value < 0 || value >= BT_IND_HISTOGRAM_BINS) {
+        ESP_LOGW(TAG, "Ignoring %s=%d", bt_indicators_name(indicator), value);
+        return;
+    }
+
+    bool changed;
+
+    portENTER_CRITICAL(&indicators_lock);
+    bt_indicator_stats_t *ind = &indicators[indicator];
+    ind->reports++;
+    ind->histogram[value]++;
+    changed = !ind->valid || ind->value != value;
+    if (changed) {
+        if (ind->changes == 0 || value < ind->min) {
+            ind->min = value;
+        }
+        if (ind->changes == 0 || value > ind->max) {
+            ind->max = value;
+        }
+        ind->valid = true;
+        ind->value = value;
+        ind->changes++;
+        ind->seq = ++change_seq;
+    }
+    portEXIT_CRITICAL(&indicators_lock);
+
+    if (!changed) {
+        return;
+    }
+
+    if (indicator == BT_IND_SIGNAL) {
+        ma_bell_state_set_bt_metrics(0xFF, value, 0xFF);
+    } else if (indicator == BT_IND_BATTERY) {
+        ma_bell_state_set_bt_metrics(0xFF, 0xFF, value);
+    }
+    event_publish(BT_EVENT_INDICATOR_CHANGED, NULL);
+}
+
+void bt_indicators_update_operator(const char *name)
+{
+    if (name == NULL) {
+        return;
+    }
+
+    bool changed;
+
+    portENTER_CRITICAL(&indicators_lock);
+    bt_indicator_stats_t *ind = &indicators[BT_IND_OPERATOR];
+    ind->reports++;
+    changed = !ind->valid || strncmp(operator_name, name, sizeof(operator_name) - 1) != 0;
+    if (changed) {
+        strncpy(operator_name, name, sizeof(operator_name) - 1);
+        operator_name[sizeof(operator_name) - 1] = '\0';
+        ind->valid = true;
+        ind->changes++;
+        ind->seq = ++change_seq;
+    }
+    portEXIT_CRITICAL(&indicators_lock);
+
+    if (!changed) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Operator: %s", name);
+    ma_bell_state_set_bt_network_info(name, NULL);
+    event_publish(BT_EVENT_INDICATOR_CHANGED, NULL);
+}
+
+void bt_indicators_reset(void)
+{
+    portENTER_CRITICAL(&indicators_lock);
+    for (int i = 0; i < BT_IND_COUNT; i++) {
+        indicators[i].valid = false;
+    }
+    operator_name[0] = '\0';
+    portEXIT_CRITICAL(&indicators_lock);
+}
+
+esp_err_t bt_indicators_get(bt_indicator_t indicator, bt_indicator_stats_t *out)
+{
+    if (indicator >= BT_IND_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&indicators_lock);
+    *out = indicators[indicator];
+    portEXIT_CRITICAL(&indicators_lock);
+    return ESP_OK;
+}
+
+void bt_indicators_get_operator(char *out, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    portENTER_CRITICAL(&indicators_lock);
+    strncpy(out, operator_name, len - 1);
+    portEXIT_CRITICAL(&indicators_lock);
+    out[len - 1] = '\0';
+}
+
+uint32_t bt_indicators_seq(void)
+{
+    portENTER_CRITICAL(&indicators_lock);
+    uint32_t seq = change_seq;
+    portEXIT_CRITICAL(&indicators_lock);
+    return seq;
+}
+
+const char *bt_indicators_name(bt_indicator_t indicator)
+{
+    return indicator < BT_IND_COUNT ? indicator_names[indicator] : "unknown";
+}
@@ -0,0 +1,98 @@
+#ifndef __BT_INDICATORS_H__
+#define __BT_INDICATORS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/**
+ * @file bt_indicators.h
+ * @brief Cache of the audio gateway's status indicators
+ *
+ * Phones resend indicators (signal, battery, roaming, service, operator)
+ * whether or not they changed. Each report is recorded in a per-indicator
+ * histogram, but only a changed value updates ma_bell_state, takes a new
+ * change sequence number and publishes BT_EVENT_INDICATOR_CHANGED. Consumers
+ * (web, MQTT) remember the last sequence number they saw and fetch only the
+ * indicators changed since.
+ *
+ * Updates must come from the BT app task. Readers may run on any task.
+ */
+
+/**
+ * @brief Cached indicators
+ */
+typedef enum {
+    BT_IND_SERVICE,     // CIND service (0/1)
+    BT_IND_SIGNAL,      // CIND signal (0-5)
+    BT_IND_ROAMING,     // CIND roam (0/1)
+    BT_IND_BATTERY,     // CIND battchg (0-5)
+    BT_IND_OPERATOR,    // COPS operator name, no numeric value
+    BT_IND_COUNT
+} bt_indicator_t;
+
+// CIND values range 0-5
+#define BT_IND_HISTOGRAM_BINS 6
+
+/**
+ * @brief Statistics for one indicator
+ */
+typedef struct {
+    bool valid;                 // A value has been received on this link
+    uint8_t value;              // Current value
+    uint8_t min;                // Lowest value seen since boot
+    uint8_t max;                // Highest value seen since boot
+    uint32_t reports;           // Reports received, including repeats
+    uint32_t changes;           // Reports that changed the value
+    uint32_t seq;               // Change sequence number of the last change
+    uint32_t histogram[BT_IND_HISTOGRAM_BINS];  // Reports per value
+} bt_indicator_stats_t;
+
+/**
+ * @brief Record a numeric indicator report
+ *
+ * @param indicator Indicator, not BT_IND_OPERATOR
+ * @param value Reported value
+ */
+void bt_indicators_update(bt_indicator_t indicator, int value);
+
+/**
+ * @brief Record an operator name report
+ */
+void bt_indicators_update_operator(const char *name);
+
+/**
+ * @brief Forget current values when the link drops
+ *
+ * Min, max and histograms are kept. The first value on the next link is
+ * published as a change.
+ */
+void bt_indicators_reset(void);
+
+/**
+ * @brief Get statistics for one indicator
+ *
+ * @return ESP_OK, or ESP_ERR_INVALID_ARG for a bad indicator
+ */
+esp_err_t bt_indicators_get(bt_indicator_t indicator, bt_indicator_stats_t *out);
+
+/**
+ * @brief Copy the current operator name
+ *
+ * @param out Destination, empty string if unknown
+ * @param len Size of out
+ */
+void bt_indicators_get_operator(char *out, size_t len);
+
+/**
+ * @brief Sequence number of the most recent change, 0 if none
+ */
+uint32_t bt_indicators_seq(void);
+
+/**
+ * @brief Get a short name for an indicator
+ */
+const char *bt_indicators_name(bt_indicator_t indicator);
+
+#endif /* __BT_INDICATORS_H__ */
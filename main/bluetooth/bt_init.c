@@ -12,7 +12,11 @@
 #include "bt_app_core.h"
 #include "bt_app_hf.h"
 #include "bt_connection_manager.h"
+#include "bt_hf_warmup.h"
+#include "bt_calls.h"
+#include "bt_link_quality.h"
 #include "config/bluetooth_config.h"
+#include "storage/settings.h"
 
 static const char *TAG = "BT_INIT";
 
@@ -62,14 +66,28 @@ esp_err_t bluetooth_init(void)
     bt_app_task_start_up();
 
     // Step 7: Set Bluetooth device name
-    ret = esp_bt_gap_set_device_name(BT_DEVICE_NAME);
+    settings_t cfg;
+    settings_get(&cfg);
+    ret = esp_bt_gap_set_device_name(cfg.bt.device_name);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set device name: %s", esp_err_to_name(ret));
         return ret;
     }
-    ESP_LOGI(TAG, "Set BT device name: %s", BT_DEVICE_NAME);
+    ESP_LOGI(TAG, "Set BT device name: %s", cfg.bt.device_name);
 
     // Step 8: Initialize HFP client profile
+    ret = bt_hf_warmup_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = bt_calls_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = bt_link_quality_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
     ret = esp_hf_client_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize HFP client: %s", esp_err_to_name(ret));
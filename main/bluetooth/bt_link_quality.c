@@ -0,0 +1,170 @@
+/*
+ * SCO link-quality monitor
+ * Polls packet statistics during calls and separates RF glitches from
+ * scheduling glitches using the audio bridge's underrun counters
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "bt_link_quality.h"
+#include "audio/audio_bridge.h"
+#include "config/bluetooth_config.h"
+
+static const char *TAG = "bt_link_quality";
+
+_Static_assert(AUDIO_XRUN_KINDS == 4, "bt_link_quality_t.xruns sized for four kinds");
+
+static esp_timer_handle_t poll_timer = NULL;
+static volatile uint16_t poll_handle;
+
+// Cumulative counts at one report
+typedef struct {
+    int64_t time_us;
+    uint32_t rx_total, rx_correct, rx_err, rx_none, rx_lost, tx_total, tx_discarded;
+    uint32_t xruns[AUDIO_XRUN_KINDS];
+} pkt_counts_t;
+
+// Previous report, to turn each report into an interval
+static pkt_counts_t prev;
+static bool prev_valid;
+
+static bt_link_quality_t current;
+static bt_link_quality_t last_link;
+static portMUX_TYPE quality_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void poll_timer_cb(void *arg)
+{
+    // Answered with PKT_STAT_NUMS_GET_EVT on the BT app task
+    esp_hf_client_pkt_stat_nums_get(poll_handle);
+}
+
+esp_err_t bt_link_quality_init(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = poll_timer_cb,
+        .name = "sco_quality",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &poll_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+void bt_link_quality_start(uint16_t sync_conn_handle)
+{
+    poll_handle = sync_conn_handle;
+    prev_valid = false;
+
+    portENTER_CRITICAL(&quality_lock);
+    memset(&current, 0, sizeof(current));
+    current.active = true;
+    portEXIT_CRITICAL(&quality_lock);
+
+    if (poll_timer) {
+        esp_timer_stop(poll_timer);
+        esp_timer_start_periodic(poll_timer, (uint64_t)BT_LINK_QUALITY_POLL_MS * 1000);
+    }
+}
+
+void bt_link_quality_stop(void)
+{
+    if (poll_timer) {
+        esp_timer_stop(poll_timer);
+    }
+
+    portENTER_CRITICAL(&quality_lock);
+    bool was_active = current.active;
+    current.active = false;
+    if (was_active) {
+        last_link = current;
+    }
+    portEXIT_CRITICAL(&quality_lock);
+
+    if (was_active) {
+        ESP_LOGI(TAG, "SCO closed: %" PRIu32 " ms, rx bad %u/1000 (worst %u), glitches rf %" PRIu32
+                 " sched %" PRIu32, last_link.duration_ms, last_link.rx_bad_permille,
+                 last_link.worst_rx_bad_permille, last_link.rf_glitches, last_link.sched_glitches);
+    }
+}
+
+void bt_link_quality_sample(const esp_hf_client_cb_param_t *param)
+{
+    pkt_counts_t now = {
+        .time_us = esp_timer_get_time(),
+        .rx_total = param->pkt_nums.rx_total,
+        .rx_correct = param->pkt_nums.rx_correct,
+        .rx_err = param->pkt_nums.rx_err,
+        .rx_none = param->pkt_nums.rx_none,
+        .rx_lost = param->pkt_nums.rx_lost,
+        .tx_total = param->pkt_nums.tx_total,
+        .tx_discarded = param->pkt_nums.tx_discarded,
+    };
+    audio_bridge_get_xruns(now.xruns);
+
+    // First report, or the controller restarted its counters: new baseline
+    if (!prev_valid || now.rx_total < prev.rx_total || now.tx_total < prev.tx_total) {
+        prev = now;
+        prev_valid = true;
+        return;
+    }
+
+    uint32_t d_rx_total = now.rx_total - prev.rx_total;
+    uint32_t d_rx_err = now.rx_err - prev.rx_err;
+    uint32_t d_rx_none = now.rx_none - prev.rx_none;
+    uint32_t d_rx_lost = now.rx_lost - prev.rx_lost;
+    uint32_t d_rx_bad = d_rx_err + d_rx_none + d_rx_lost;
+    uint32_t d_xruns[AUDIO_XRUN_KINDS];
+    for (int i = 0; i < AUDIO_XRUN_KINDS; i++) {
+        d_xruns[i] = now.xruns[i] - prev.xruns[i];
+    }
+    bool glitch = d_xruns[AUDIO_XRUN_DOWNLINK_UNDERRUN] || d_xruns[AUDIO_XRUN_DOWNLINK_OVERRUN];
+    uint16_t interval_bad = d_rx_total ? (uint16_t)((uint64_t)d_rx_bad * 1000 / d_rx_total) : 0;
+
+    portENTER_CRITICAL(&quality_lock);
+    current.samples++;
+    current.duration_ms += (uint32_t)((now.time_us - prev.time_us) / 1000);
+    current.rx_total += d_rx_total;
+    current.rx_good += now.rx_correct - prev.rx_correct;
+    current.rx_err += d_rx_err;
+    current.rx_none += d_rx_none;
+    current.rx_lost += d_rx_lost;
+    current.tx_total += now.tx_total - prev.tx_total;
+    current.tx_discarded += now.tx_discarded - prev.tx_discarded;
+    for (int i = 0; i < AUDIO_XRUN_KINDS; i++) {
+        current.xruns[i] += d_xruns[i];
+    }
+    if (glitch) {
+        if (d_rx_bad) {
+            current.rf_glitches++;
+        } else {
+            current.sched_glitches++;
+        }
+    }
+    if (current.rx_total) {
+        uint32_t bad = current.rx_err + current.rx_none + current.rx_lost;
+        current.rx_bad_permille = (uint16_t)((uint64_t)bad * 1000 / current.rx_total);
+    }
+    if (interval_bad > current.worst_rx_bad_permille) {
+        current.worst_rx_bad_permille = interval_bad;
+    }
+    portEXIT_CRITICAL(&quality_lock);
+
+    if (glitch) {
+        ESP_LOGW(TAG, "Downlink glitch (%s): rx bad %" PRIu32 "/%" PRIu32 ", underruns %" PRIu32
+                 ", overruns %" PRIu32, d_rx_bad ? "rf" : "scheduling", d_rx_bad, d_rx_total,
+                 d_xruns[AUDIO_XRUN_DOWNLINK_UNDERRUN], d_xruns[AUDIO_XRUN_DOWNLINK_OVERRUN]);
+    }
+
+    prev = now;
+}
+
+void bt_link_quality_get(bool last, bt_link_quality_t *out)
+{
+    portENTER_CRITICAL(&quality_lock);
+    *out = last ? last_link : current;
+    portEXIT_CRITICAL(&quality_lock);
+}
@@ -0,0 +1,76 @@
+#ifndef __BT_LINK_QUALITY_H__
+#define __BT_LINK_QUALITY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_hf_client_api.h"
+
+/**
+ * @file bt_link_quality.h
+ * @brief SCO link-quality monitor
+ *
+ * While the audio link is up the controller's packet statistics are polled
+ * every BT_LINK_QUALITY_POLL_MS. Each poll interval is checked against the
+ * audio bridge's underrun/overrun counters: a downlink glitch in an interval
+ * that also lost or corrupted packets over the air is counted as RF, one in
+ * an interval with clean reception as scheduling (the bridge task or the
+ * ring buffer fell behind).
+ *
+ * start/stop/sample are called from the BT app task; the getter from any task.
+ */
+
+/**
+ * @brief Link quality for one SCO connection (normally one call)
+ */
+typedef struct {
+    bool active;                  // Audio link currently up
+    uint32_t duration_ms;         // Time covered by the samples
+    uint32_t samples;             // Packet statistics received
+    uint32_t rx_total;            // Packets expected from the phone
+    uint32_t rx_good;             // Received intact
+    uint32_t rx_err;              // Received with errors
+    uint32_t rx_none;             // No packet in the slot
+    uint32_t rx_lost;             // Lost
+    uint32_t tx_total;            // Packets sent to the phone
+    uint32_t tx_discarded;        // Dropped before sending
+    uint32_t xruns[4];            // Bridge glitches, indexed by audio_xrun_kind_t
+    uint32_t rf_glitches;         // Intervals with downlink glitches and bad reception
+    uint32_t sched_glitches;      // Intervals with downlink glitches and clean reception
+    uint16_t rx_bad_permille;     // Bad receive slots over the whole link
+    uint16_t worst_rx_bad_permille; // Worst single interval
+} bt_link_quality_t;
+
+/**
+ * @brief Create the poll timer
+ */
+esp_err_t bt_link_quality_init(void);
+
+/**
+ * @brief Audio link up: reset the current metrics and start polling
+ *
+ * @param sync_conn_handle SCO connection handle from AUDIO_STATE_EVT
+ */
+void bt_link_quality_start(uint16_t sync_conn_handle);
+
+/**
+ * @brief Audio link down: stop polling and keep the metrics as the last call
+ */
+void bt_link_quality_stop(void);
+
+/**
+ * @brief Feed a packet statistics report
+ *
+ * Counts are cumulative for the SCO connection.
+ */
+void bt_link_quality_sample(const esp_hf_client_cb_param_t *param);
+
+/**
+ * @brief Get link-quality metrics
+ *
+ * @param last False for the current audio link, true for the previous one
+ * @param out Destination
+ */
+void bt_link_quality_get(bool last, bt_link_quality_t *out);
+
+#endif /* __BT_LINK_QUALITY_H__ */
@@ -9,7 +9,43 @@
 #define AUDIO_BUFFER_SIZE           1024
 #define AUDIO_PLAY_DURATION         5  // seconds
 
+// Tone frames: 160 samples = 20 ms at 8 kHz, same as the bridge's audio frame.
+// A tone change takes effect at the next frame boundary.
+#define AUDIO_FRAME_SAMPLES         160
+
+// I2S DMA depth. Kept to a few frames so a new tone reaches the DAC quickly
+// (the driver default of 6 x 240 samples queues 180 ms ahead).
+#define AUDIO_I2S_DMA_DESC_NUM      3
+#define AUDIO_I2S_DMA_FRAME_NUM     AUDIO_FRAME_SAMPLES
+
+// Call-progress tone level, percent of full scale. Default for the
+// settings record.
+#define AUDIO_TONE_LEVEL_PCT        20
+
+// Segments in one downlink overlay (e.g. call-waiting SAS, CAS, pause)
+#define AUDIO_OVERLAY_MAX_SEGS      4
+
+// Clips in one announcement (e.g. "the time is", hour, minute, am/pm)
+#define AUDIO_CLIPS_MAX             8
+
 // HFP Audio (if CONFIG_BT_HFP_AUDIO_DATA_PATH_HCI)
 #define AUDIO_HFP_RINGBUF_SIZE      3600
 
+// Bridge tasks, statically allocated at init and parked between calls
+#define AUDIO_BRIDGE_TASK_STACK     4096
+#define AUDIO_BRIDGE_TASK_PRIORITY  10
+
+// Upper bound on audio_bridge_stop() waiting for both tasks to finish the
+// frame in hand (one I/O timeout plus the inter-frame delay each)
+#define AUDIO_BRIDGE_DRAIN_TIMEOUT_MS  100
+
+// Request the SCO link ourselves when the user answers or starts dialing,
+// instead of waiting for the audio gateway to open it when the call connects.
+// Trades a few seconds of idle SCO during dialing for no clipped "hello".
+#define AUDIO_SCO_PREOPEN           0
+
+// A cut-through measurement still pending after this long is abandoned
+// (the call never produced downlink audio)
+#define AUDIO_CUT_THROUGH_MAX_MS    10000
+
 #endif /* __AUDIO_CONFIG_H__ */
@@ -4,21 +4,56 @@
 #include "freertos/FreeRTOS.h"
 
 // Device configuration
-#define BT_DEVICE_NAME              "MA BELL"
+#define BT_DEVICE_NAME              "MA BELL"   // Default for the settings record
 #define BT_PIN_CODE                 {'0', '0', '0', '0'}
 #define BT_PIN_CODE_LEN             4
 
-// Connection management
-#define BT_RECONNECT_INTERVAL_MS    10000  // 10 seconds
-#define BT_DISCOVERY_DURATION       10     // 10 * 1.28s = 12.8s
-#define BT_DISCOVERY_MAX_RESPONSES  0      // Unlimited
+// Connection management: page the paired phone directly, retrying with
+// jittered exponential backoff, then park until something suggests it is back
+#define BT_RECONNECT_PAGE_TIMEOUT_MS    5120   // Per page, rounded to 0.625 ms slots
+#define BT_RECONNECT_ATTEMPT_TIMEOUT_MS (BT_RECONNECT_PAGE_TIMEOUT_MS + 3000)  // Page plus SLC setup
+#define BT_RECONNECT_BACKOFF_MIN_MS     1000
+#define BT_RECONNECT_BACKOFF_MAX_MS     60000
+#define BT_RECONNECT_JITTER_PCT         25     // +/- percent applied to each backoff
+#define BT_RECONNECT_MAX_ATTEMPTS       8      // Failed rounds (every phone paged once) before parking
+
+// Paired phones remembered, most recently connected paged first
+#define BT_REGISTRY_MAX_DEVICES         4
+
+// Connection warm-up: operator, subscriber and call list queried back to
+// back once the service level connection is up. Queries still unanswered
+// after this long are abandoned and the link is reported ready anyway.
+#define BT_HF_WARMUP_TIMEOUT_MS         5000
+
+// SCO packet statistics are polled this often while the audio link is up
+#define BT_LINK_QUALITY_POLL_MS         1000
+
+// Call list: CIEV changes are applied as they arrive; an AT+CLCC listing
+// is only requested when a change cannot be attributed to one call, this
+// long after the last such change so a burst of indicators costs one query
+#define BT_CALLS_REQUERY_MS             300
 
 // Task configuration
-#define BT_APP_TASK_STACK_SIZE      2048
+// BtAppT runs each HFP event through call control and, synchronously, every
+// subscriber to the events it publishes (logging, state journal, CDR, tones).
+// The least stack it has left free is reported at /bt/dispatch; keep this at
+// the deepest call setup and teardown seen there plus the margin.
+#define BT_APP_TASK_STACK_SIZE      6144
+#define BT_APP_TASK_STACK_MARGIN    1024   // Less free than this is logged
+
 #define BT_APP_TASK_PRIORITY        (configMAX_PRIORITIES - 3)
-#define BT_APP_TASK_QUEUE_SIZE      10
+#define BT_APP_TASK_QUEUE_SIZE      10     // Urgent lane depth
+#define BT_APP_BG_QUEUE_SIZE        8      // Background lane depth
+#define BT_APP_COALESCE_SLOTS       8      // Distinct indicator events pending at once
 #define BT_APP_TASK_NAME            "BtAppT"
 
+// Fixed slabs for dispatched work parameters, one block per message that can
+// be pending in any lane plus headroom. Larger parameters fall back to the heap.
+#define BT_APP_SLAB_SMALL_SIZE      32
+#define BT_APP_SLAB_MEDIUM_SIZE     64
+#define BT_APP_SLAB_LARGE_SIZE      160    // HFP event plus a phone number/operator name
+#define BT_APP_SLAB_BLOCKS          (BT_APP_TASK_QUEUE_SIZE + BT_APP_BG_QUEUE_SIZE + BT_APP_COALESCE_SLOTS + 2)
+
 // Reconnection task configuration
 #define BT_RECONNECT_TASK_STACK_SIZE 4096
 #define BT_RECONNECT_TASK_PRIORITY   5
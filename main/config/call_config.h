@@ -0,0 +1,113 @@
+#ifndef __CALL_CONFIG_H__
+#define __CALL_CONFIG_H__
+
+// Call progress timing, loosely following North American central office practice.
+// Defaults for the settings record, which is what the firmware uses.
+#define CALL_PROGRESS_DIAL_TONE_TIMEOUT_MS   15000  // Dial tone with no digits before reorder
+#define CALL_PROGRESS_INTERDIGIT_TIMEOUT_MS  10000  // Pause between digits before reorder
+#define CALL_PROGRESS_DISCONNECT_TIMEOUT_MS  10000  // Silence after far-end hangup before reorder
+#define CALL_PROGRESS_REORDER_TIMEOUT_MS     30000  // Busy/reorder before off-hook warning
+#define CALL_PROGRESS_TIMER_RETRY_MS         5      // Timeout retried while an event holds the lock
+
+// Hook switch timing. The SLIC is polled every HOOK_POLL_MS; a level must be
+// stable for HOOK_DEBOUNCE_MS to count. Breaks up to HOOK_PULSE_BREAK_MAX_MS
+// are dial pulses (10 pps: 60 ms break / 40 ms make), breaks of
+// HOOK_FLASH_MIN_MS to HOOK_FLASH_MAX_MS during a call are flashes, and
+// longer ones are hang-ups.
+#define HOOK_POLL_MS                         10
+#define HOOK_DEBOUNCE_MS                     20
+#define HOOK_PULSE_BREAK_MAX_MS              120
+#define HOOK_INTERDIGIT_MIN_MS               250    // Make after the last pulse that ends a digit
+#define HOOK_FLASH_MIN_MS                    300
+#define HOOK_FLASH_MAX_MS                    1100
+
+// Digit collection: the number is dialed after this pause. Must be shorter
+// than CALL_PROGRESS_INTERDIGIT_TIMEOUT_MS. Default for the settings record.
+#define DIALER_COMPLETE_MS                   4000
+#define DIALER_MAX_DIGITS                    32
+
+// Recall dial tone after a flash with a second call waiting or held: the
+// next digit picks the CHLD operation (1 release, 2 hold/swap, 3 conference)
+#define CALL_RECALL_TIMEOUT_MS               5000
+
+// Ringing cadence (North American 2 s on / 4 s off). Multiples of the 20 ms
+// audio frame so ring command edges fall on frame boundaries.
+#define RING_ON_MS                           2000
+#define RING_OFF_MS                          4000
+
+// On-hook Caller ID, sent once in the silence after the first ring
+#define CALLER_ID_DELAY_MS                   500    // From the end of the first ring to the first FSK sample
+#define CALLER_ID_GUARD_MS                   200    // Burst must end this long before the second ring
+#define CALLER_ID_LEVEL                      8192   // FSK peak amplitude (full scale 32767)
+
+// Call waiting. The SAS beep is mixed over the active call; it repeats while
+// the second call is still waiting.
+#define CALL_WAITING_SAS_FREQ                440
+#define CALL_WAITING_SAS_MS                  300
+#define CALL_WAITING_SAS_LEVEL               4096   // Peak, added to the far-end voice
+#define CALL_WAITING_REPEAT_MS               10000
+
+// Off-hook (Type II) Caller ID after the first SAS: CAS, a muted pause in
+// place of the CPE acknowledgement, then FSK. Sets without Type II support
+// will hear the burst, so it is off by default.
+#define CALL_WAITING_TYPE2_CID               0
+#define CALL_WAITING_CAS_FREQ1               2130
+#define CALL_WAITING_CAS_FREQ2               2750
+#define CALL_WAITING_CAS_MS                  80
+#define CALL_WAITING_CAS_LEVEL               4096
+#define CALL_WAITING_ACK_WAIT_MS             250
+
+// Call detail records. Finished calls are batched in RAM and written to the
+// "cdr" partition when the batch fills or CDR_FLUSH_MS after the first one,
+// so a power cut loses at most one batch.
+#define CDR_PARTITION_LABEL                  "cdr"
+#define CDR_BATCH_RECORDS                    8
+#define CDR_FLUSH_MS                         30000
+#define CDR_HASH_NUMBERS                     0      // Store an FNV-1a hash instead of the number
+#define CDR_TASK_STACK_SIZE                  3072
+#define CDR_TASK_PRIORITY                    2
+
+// Local phonebook. A speed-dial code dialed on its own is replaced by its
+// number; codes are at most two digits so they never shadow 911 or 411.
+// Caller ID names match on the last PHONEBOOK_MATCH_DIGITS digits, so
+// +1 555 123 4567 finds an entry stored as 5551234567.
+#define PHONEBOOK_MAX_ENTRIES                100
+#define PHONEBOOK_CODE_MAX_LEN               2
+#define PHONEBOOK_MATCH_DIGITS               10
+#define PHONEBOOK_CSV_MAX_LEN                8192   // Largest import accepted over HTTP
+
+// Answering machine. An unanswered call is picked up after the number of
+// rings in the settings record (0 turns it off), hears the greeting and a
+// beep, and is recorded as IMA ADPCM (4000 bytes/s) into the "voicemail"
+// partition: one greeting slot, then as many message slots as fit.
+#define VOICEMAIL_PARTITION_LABEL            "voicemail"
+#define VOICEMAIL_ANSWER_RINGS               4      // Default for the settings record
+#define VOICEMAIL_GREETING_SECTORS           16     // 64 KB, about 16 s
+#define VOICEMAIL_SLOT_SECTORS               32     // 128 KB, about 32 s per message
+#define VOICEMAIL_MIN_MESSAGE_MS             1000   // Shorter recordings (hang-ups at the beep) are dropped
+#define VOICEMAIL_CALL_GUARD_MS              60000  // Hang up if the call is still up after this
+#define VOICEMAIL_BEEP_MS                    500    // 1 kHz, before recording starts
+#define VOICEMAIL_BEEP_LEVEL                 8192
+#define VOICEMAIL_BLOCK_BYTES                2048   // Each half of the ping-pong buffer, 0.5 s
+#define VOICEMAIL_TASK_STACK_SIZE            4096
+#define VOICEMAIL_TASK_PRIORITY              4      // Above the NVS and CDR writers, below the bridge
+
+// Dialed off-hook in place of a number. Rotary-friendly 11xx codes, the
+// pulse equivalent of *xx vertical service codes.
+#define VOICEMAIL_ACCESS_CODE                "1198" // Play messages: 7 deletes, 9 skips
+#define VOICEMAIL_GREETING_CODE              "1197" // Record a greeting after the beep
+
+// Recorded announcements, packed by tools/pack_announcements.py into the
+// "announce" partition and played from it in place. A failed call hears the
+// intercept clip before reorder, and a handset left off-hook too long hears
+// the permanent-signal clip; each plays ANNOUNCE_REPEATS times. A missing
+// partition or clip leaves the plain tone.
+#define ANNOUNCE_PARTITION_LABEL             "announce"
+#define ANNOUNCE_INTERCEPT                   "intercept"    // "The number you have dialed..."
+#define ANNOUNCE_PERMANENT                   "permanent"    // "If you'd like to make a call..."
+#define ANNOUNCE_REPEATS                     2
+#define ANNOUNCE_GAP_MS                      1000   // Silence between repeats
+#define ANNOUNCE_LEAD_MS                     500    // Pause after dialing before the time is read
+#define ANNOUNCE_TIME_CODE                   "1196" // Time of day, then dial tone again
+
+#endif /* __CALL_CONFIG_H__ */
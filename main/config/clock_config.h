@@ -0,0 +1,15 @@
+#ifndef __CLOCK_CONFIG_H__
+#define __CLOCK_CONFIG_H__
+
+// Wall clock, set by SNTP once WiFi is up. lwIP polls the server every
+// CONFIG_LWIP_SNTP_UPDATE_DELAY ms after the first sync.
+#define CLOCK_NTP_SERVER            "pool.ntp.org"
+
+// POSIX TZ string for local time (announcements, Caller ID date/time),
+// e.g. "EST5EDT,M3.2.0,M11.1.0". Records store UTC.
+#define CLOCK_TIMEZONE              "UTC0"
+
+// Times before this (2024-01-01 UTC) mean the clock has not been set
+#define CLOCK_MIN_VALID_TIME        1704067200
+
+#endif /* __CLOCK_CONFIG_H__ */
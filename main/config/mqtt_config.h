@@ -0,0 +1,21 @@
+#ifndef __MQTT_CONFIG_H__
+#define __MQTT_CONFIG_H__
+
+// Set to 1 to start the MQTT client at boot, once WiFi has been brought up.
+// The client connects and reconnects to the broker on its own.
+#define MQTT_ENABLED                0
+#define MQTT_BROKER_URI             "mqtt://mqtt.local"
+#define MQTT_BROKER_PORT            1883
+#define MQTT_USE_SSL                false
+#define MQTT_CLIENT_ID              "ma-bell-gateway"
+#define MQTT_USERNAME               NULL   // NULL for an anonymous broker
+#define MQTT_PASSWORD               NULL
+
+// Prefix of every topic published by the gateway
+#define MQTT_TOPIC_PREFIX           "ma-bell"
+
+// Phone status indicators are published, retained, as
+// <prefix>/bt/indicator/<name> when they change
+#define MQTT_INDICATOR_TOPIC        MQTT_TOPIC_PREFIX "/bt/indicator/"
+
+#endif /* __MQTT_CONFIG_H__ */
@@ -2,9 +2,24 @@
 #define __SYSTEM_CONFIG_H__
 
 #include "esp_log.h"
+#include "mqtt_config.h"
 
 // NVS Configuration
 #define SYSTEM_NVS_PARTITION        "nvs"
+#define STORAGE_WRITE_BEHIND_MS     2000    // Quiet period before pending writes are committed
+#define STORAGE_CACHE_ENTRIES       24      // Cached values, pending writes included
+#define STORAGE_CACHE_VALUE_MAX     96      // Larger values are only held until written
+#define STORAGE_RETRY_MS            10000   // Wait before a failed write is tried again
+#define STORAGE_MAX_NAMESPACES      6       // Handles kept open
+#define STORAGE_TASK_STACK_SIZE     3072
+#define STORAGE_TASK_PRIORITY       2
+
+// Event system. One subscriber slot per event_subscribe() call: the
+// connection manager, dialer, call control, caller ID, announcements, call
+// waiting, voicemail, call progress and CDR, plus MQTT when it is enabled.
+// Add to the count when a module subscribes; event_system.c checks it fits.
+#define EVENT_SUBSCRIBERS_KNOWN     (9 + MQTT_ENABLED)
+#define EVENT_MAX_SUBSCRIBERS       16
 
 // System initialization order (documented for reference)
 // 1. NVS
@@ -6,7 +6,7 @@
 #define WEB_SERVER_CTRL_PORT        32768
 #define WEB_SERVER_STACK_SIZE       8192
 #define WEB_SERVER_CORE_ID          0
-#define WEB_SERVER_MAX_URI_HANDLERS 8
+#define WEB_SERVER_MAX_URI_HANDLERS 16
 #define WEB_SERVER_MAX_RESP_HEADERS 8
 #define WEB_SERVER_BACKLOG_CONN     5
 
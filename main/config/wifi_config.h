@@ -5,8 +5,9 @@
 #define WIFI_CONNECT_TIMEOUT        60    // Increased to allow all retries to complete
 #define WIFI_MAXIMUM_RETRY          5     // All retries should complete within 60s timeout
 
-// WiFi credentials are stored in NVS only
-// Use provisioning tool to set credentials (see WIFI_SETUP.md)
+// WiFi credentials are stored in the settings record only
+// Use provisioning tool to set credentials (see WIFI_SETUP.md); they are
+// moved into the record at the next boot
 // No hardcoded defaults - credentials must be provisioned to NVS partition
 // #define DEFAULT_WIFI_SSID           "YourSSID"  // No longer used
 // #define DEFAULT_WIFI_PASS           "YourPassword"  // No longer used
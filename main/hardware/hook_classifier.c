@@ -0,0 +1,77 @@
+#include "hook_classifier.h"
+#include "config/call_config.h"
+
+// Longest break that may still end in something other than a hang-up
+static uint32_t hangup_threshold(const hook_classifier_t *hc)
+{
+    return hc->flash_allowed ? HOOK_FLASH_MAX_MS : HOOK_FLASH_MIN_MS;
+}
+
+void hook_classifier_init(hook_classifier_t *hc, bool on_hook, uint32_t now_ms)
+{
+    hc->raw = on_hook;
+    hc->raw_since_ms = now_ms;
+    hc->level = on_hook;
+    hc->reported_on_hook = on_hook;
+    hc->break_ms = now_ms;
+    hc->make_ms = now_ms;
+    hc->pulses = 0;
+    hc->flash_allowed = false;
+}
+
+hook_evt_t hook_classifier_sample(hook_classifier_t *hc, bool on_hook, uint32_t now_ms,
+                                  bool flash_allowed)
+{
+    hook_evt_t evt = { .kind = HOOK_EVT_NONE };
+
+    if (on_hook != hc->raw) {
+        hc->raw = on_hook;
+        hc->raw_since_ms = now_ms;
+    }
+
+    // Debounced edge, timed from when the raw level first changed
+    if (hc->raw != hc->level && now_ms - hc->raw_since_ms >= HOOK_DEBOUNCE_MS) {
+        uint32_t edge_ms = hc->raw_since_ms;
+        hc->level = hc->raw;
+
+        if (hc->level) {
+            // Break: wait to see how long it lasts
+            hc->break_ms = edge_ms;
+            hc->flash_allowed = flash_allowed;
+        } else if (hc->reported_on_hook) {
+            hc->reported_on_hook = false;
+            hc->pulses = 0;
+            evt.kind = HOOK_EVT_OFF_HOOK;
+            return evt;
+        } else {
+            uint32_t break_len = edge_ms - hc->break_ms;
+            if (break_len <= HOOK_PULSE_BREAK_MAX_MS) {
+                if (hc->pulses < 10) {
+                    hc->pulses++;
+                }
+                hc->make_ms = edge_ms;
+            } else if (break_len >= HOOK_FLASH_MIN_MS && hc->flash_allowed) {
+                hc->pulses = 0;
+                evt.kind = HOOK_EVT_FLASH;
+                evt.duration_ms = break_len;
+                return evt;
+            }
+            // Anything between a pulse and a flash is contact noise
+        }
+    }
+
+    if (hc->level && !hc->reported_on_hook &&
+        now_ms - hc->break_ms > hangup_threshold(hc)) {
+        hc->reported_on_hook = true;
+        hc->pulses = 0;
+        evt.kind = HOOK_EVT_ON_HOOK;
+    } else if (!hc->level && hc->pulses > 0 &&
+               now_ms - hc->make_ms >= HOOK_INTERDIGIT_MIN_MS) {
+        // Ten pulses dial 0
+        evt.kind = HOOK_EVT_DIGIT;
+        evt.digit = hc->pulses % 10;
+        hc->pulses = 0;
+    }
+
+    return evt;
+}
@@ -0,0 +1,68 @@
+#ifndef __HOOK_CLASSIFIER_H__
+#define __HOOK_CLASSIFIER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @file hook_classifier.h
+ * @brief Timed hook-switch classifier
+ *
+ * Turns raw switch-hook samples into off-hook, on-hook, flash and dial-pulse
+ * digit events using the HOOK_* timings in config/call_config.h. Pure code
+ * with no ESP-IDF dependencies; the caller supplies the clock.
+ *
+ * A break is only reported as on-hook once it is too long to be anything
+ * else: HOOK_FLASH_MIN_MS normally, HOOK_FLASH_MAX_MS while flashes are
+ * allowed (during a call).
+ */
+
+/**
+ * @brief Classified hook event
+ */
+typedef enum {
+    HOOK_EVT_NONE,
+    HOOK_EVT_OFF_HOOK,      // Handset lifted
+    HOOK_EVT_ON_HOOK,       // Handset replaced
+    HOOK_EVT_FLASH,         // Brief on-hook during a call
+    HOOK_EVT_DIGIT,         // Dial-pulse digit complete
+} hook_evt_kind_t;
+
+typedef struct {
+    hook_evt_kind_t kind;
+    uint8_t digit;          // HOOK_EVT_DIGIT: 0-9
+    uint32_t duration_ms;   // HOOK_EVT_FLASH: break length
+} hook_evt_t;
+
+/**
+ * @brief Classifier state
+ */
+typedef struct {
+    bool raw;               // Last raw sample (true = on-hook)
+    uint32_t raw_since_ms;  // When the raw level last changed
+    bool level;             // Debounced level
+    bool reported_on_hook;  // Hook state as last reported
+    uint32_t break_ms;      // Start of the current break
+    uint32_t make_ms;       // End of the last dial pulse
+    uint8_t pulses;         // Pulses in the digit being dialed
+    bool flash_allowed;     // Flashes allowed when the current break started
+} hook_classifier_t;
+
+/**
+ * @brief Reset the classifier to a known hook state
+ */
+void hook_classifier_init(hook_classifier_t *hc, bool on_hook, uint32_t now_ms);
+
+/**
+ * @brief Feed one raw sample
+ *
+ * @param hc Classifier state
+ * @param on_hook Raw switch-hook level
+ * @param now_ms Sample time, may wrap
+ * @param flash_allowed Whether a break could be a flash (a call is up)
+ * @return The event completed by this sample, HOOK_EVT_NONE if none
+ */
+hook_evt_t hook_classifier_sample(hook_classifier_t *hc, bool on_hook, uint32_t now_ms,
+                                  bool flash_allowed);
+
+#endif /* __HOOK_CLASSIFIER_H__ */
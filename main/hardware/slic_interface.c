@@ -1,6 +1,10 @@
 #include "slic_interface.h"
+#include "hook_classifier.h"
 #include "config/pin_assignments.h"
+#include "config/call_config.h"
 #include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "app/call/dialer.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -8,16 +12,16 @@
 
 static const char *TAG = "slic_if";
 
-// Debounce timing
-#define HOOK_DEBOUNCE_MS 50
-#define POLL_INTERVAL_MS 20
-
 // Task handle
 static TaskHandle_t slic_monitor_task_handle = NULL;
 
-// Debounce state
-static bool last_hook_state = true;  // true = on-hook (default)
-static TickType_t last_hook_change_time = 0;
+// Switch-hook classifier, owned by the monitor task after init
+static hook_classifier_t hook;
+
+static uint32_t now_ms(void)
+{
+    return pdTICKS_TO_MS(xTaskGetTickCount());
+}
 
 /**
  * @brief Task to monitor SLIC interface status
@@ -25,6 +29,8 @@ static TickType_t last_hook_change_time = 0;
  * Polls SLIC input pins for status changes:
  * - GPIO 32 (SHD pin): Off-hook detection
  * The SLIC SHD pin goes LOW when the phone is off-hook.
+ *
+ * Samples are classified into hook changes, flashes and dial-pulse digits.
  */
 static void slic_monitor_task(void *arg)
 {
@@ -32,32 +38,38 @@ static void slic_monitor_task(void *arg)
 
     while (1) {
         // Read hook state - SHD pin is active LOW (0 = off-hook, 1 = on-hook)
-        int gpio_level = gpio_get_level(PIN_OFF_HOOK_DETECT);
-        bool current_hook_state = (gpio_level == 1);  // true = on-hook
-
-        // Check for state change with debouncing
-        if (current_hook_state != last_hook_state) {
-            TickType_t now = xTaskGetTickCount();
-            TickType_t elapsed_ms = pdTICKS_TO_MS(now - last_hook_change_time);
-
-            if (elapsed_ms > HOOK_DEBOUNCE_MS) {
-                // State change confirmed after debounce period
-                last_hook_state = current_hook_state;
-                last_hook_change_time = now;
-
-                if (current_hook_state) {
-                    // On-hook (handset replaced)
-                    ESP_LOGI(TAG, "Phone on-hook detected");
-                    ma_bell_state_update_phone_bits(0, PHONE_STATE_OFF_HOOK);
-                } else {
-                    // Off-hook (handset lifted)
-                    ESP_LOGI(TAG, "Phone off-hook detected");
-                    ma_bell_state_update_phone_bits(PHONE_STATE_OFF_HOOK, 0);
-                }
-            }
+        bool on_hook = (gpio_get_level(PIN_OFF_HOOK_DETECT) == 1);
+        bool in_call = ma_bell_state_bluetooth_bits_set(BT_STATE_IN_CALL);
+
+        hook_evt_t evt = hook_classifier_sample(&hook, on_hook, now_ms(), in_call);
+        switch (evt.kind) {
+            case HOOK_EVT_OFF_HOOK:
+                ESP_LOGI(TAG, "Phone off-hook detected");
+                ma_bell_state_update_phone_bits(PHONE_STATE_OFF_HOOK, 0, STATE_CAUSE_HOOK);
+                event_publish(PHONE_EVENT_OFF_HOOK, NULL);
+                break;
+
+            case HOOK_EVT_ON_HOOK:
+                ESP_LOGI(TAG, "Phone on-hook detected");
+                ma_bell_state_update_phone_bits(0, PHONE_STATE_OFF_HOOK, STATE_CAUSE_HOOK);
+                event_publish(PHONE_EVENT_ON_HOOK, NULL);
+                break;
+
+            case HOOK_EVT_FLASH:
+                ESP_LOGI(TAG, "Hook flash detected (%lu ms)", (unsigned long)evt.duration_ms);
+                event_publish(PHONE_EVENT_HOOK_FLASH, NULL);
+                break;
+
+            case HOOK_EVT_DIGIT:
+                ESP_LOGI(TAG, "Pulse digit %u", evt.digit);
+                dialer_digit('0' + evt.digit);
+                break;
+
+            default:
+                break;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(POLL_INTERVAL_MS));
+        vTaskDelay(pdMS_TO_TICKS(HOOK_POLL_MS));
     }
 }
 
@@ -83,12 +95,30 @@ esp_err_t slic_interface_init(void)
 
     ESP_LOGI(TAG, "GPIO %d configured for off-hook detection", PIN_OFF_HOOK_DETECT);
 
+    // Ring command output, driven by the tone task's ring cadence
+    gpio_config_t ring_conf = {
+        .pin_bit_mask = (1ULL << PIN_RING_COMMAND),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+
+    gpio_set_level(PIN_RING_COMMAND, 0);
+    ret = gpio_config(&ring_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure ring command GPIO: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
     // Read initial state
-    int initial_level = gpio_get_level(PIN_OFF_HOOK_DETECT);
-    last_hook_state = (initial_level == 1);
-    last_hook_change_time = xTaskGetTickCount();
+    bool initial_on_hook = (gpio_get_level(PIN_OFF_HOOK_DETECT) == 1);
+    hook_classifier_init(&hook, initial_on_hook, now_ms());
 
-    ESP_LOGI(TAG, "Initial hook state: %s", last_hook_state ? "on-hook" : "off-hook");
+    ESP_LOGI(TAG, "Initial hook state: %s", initial_on_hook ? "on-hook" : "off-hook");
+    if (!initial_on_hook) {
+        ma_bell_state_update_phone_bits(PHONE_STATE_OFF_HOOK, 0, STATE_CAUSE_HOOK);
+    }
 
     // Create monitoring task
     BaseType_t task_ret = xTaskCreate(
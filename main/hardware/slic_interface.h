@@ -9,9 +9,11 @@
  * Configures GPIO pins for interfacing with HC-5504B SLIC chip:
  * - GPIO 32 (SHD): Off-hook detection input
  * - GPIO 33 (RD): Ring detection input (future)
- * - GPIO 13 (RC): Ring command output (future)
+ * - GPIO 13 (RC): Ring command output
  *
- * Starts monitoring task for SLIC status pins with debouncing.
+ * Starts monitoring task for SLIC status pins. Hook samples are classified
+ * into off-hook, on-hook, hook flash (PHONE_EVENT_HOOK_FLASH) and dial-pulse
+ * digits (passed to the dialer); see hook_classifier.h.
  *
  * @return ESP_OK on success, error code on failure
  */
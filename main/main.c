@@ -12,12 +12,25 @@
 
 // Subsystem initialization
 #include "storage/storage.h"
+#include "storage/settings.h"
 #include "app/state/ma_bell_state.h"
 #include "hardware/hardware_init.h"
 #include "audio/audio_output.h"
 #include "audio/audio_bridge.h"
+#include "app/call/call_progress.h"
+#include "app/call/call_control.h"
+#include "app/call/caller_id.h"
+#include "app/call/call_waiting.h"
+#include "app/call/dialer.h"
+#include "app/call/cdr.h"
+#include "app/call/phonebook.h"
+#include "app/call/voicemail.h"
+#include "app/call/announce.h"
 #include "bluetooth/bt_init.h"
 #include "network/wifi/wifi_init.h"
+#include "network/mqtt/mqtt.h"
+#include "network/clock/clock.h"
+#include "config/mqtt_config.h"
 #include "app/web/web_interface.h"
 #include "app/events/event_system.h"
 
@@ -43,6 +56,16 @@ void app_main(void)
     ESP_ERROR_CHECK(ma_bell_state_init());
     ESP_ERROR_CHECK(storage_init());
 
+    // Configuration record, read once; nothing reads configuration from NVS after this
+    ESP_ERROR_CHECK(settings_init());
+
+    // Load the local phonebook (speed dial, Caller ID names)
+    ESP_LOGI(TAG, "Loading phonebook...");
+    ESP_ERROR_CHECK(phonebook_init());
+
+    // Digit collection, fed by the SLIC monitor
+    ESP_ERROR_CHECK(dialer_init());
+
     // Initialize hardware peripherals
     ESP_LOGI(TAG, "Initializing hardware...");
     ESP_ERROR_CHECK(hardware_init());
@@ -55,6 +78,34 @@ void app_main(void)
     ESP_LOGI(TAG, "Initializing audio bridge...");
     ESP_ERROR_CHECK(audio_bridge_init());
 
+    // Map recorded announcements before call progress can ask for one
+    ESP_LOGI(TAG, "Initializing announcements...");
+    ESP_ERROR_CHECK(announce_init());
+
+    // Initialize call progress tones (dial tone, ringback, busy, ...)
+    ESP_LOGI(TAG, "Initializing call progress...");
+    ESP_ERROR_CHECK(call_progress_init());
+
+    // Initialize call control (call lifecycle state machine)
+    ESP_LOGI(TAG, "Initializing call control...");
+    ESP_ERROR_CHECK(call_control_init());
+
+    // Initialize Caller ID (ring cadence and on-hook FSK)
+    ESP_LOGI(TAG, "Initializing Caller ID...");
+    ESP_ERROR_CHECK(caller_id_init());
+
+    // Initialize call waiting (SAS overlay and Type II Caller ID)
+    ESP_LOGI(TAG, "Initializing call waiting...");
+    ESP_ERROR_CHECK(call_waiting_init());
+
+    // Initialize call detail records (flash log of finished calls)
+    ESP_LOGI(TAG, "Initializing call records...");
+    ESP_ERROR_CHECK(cdr_init());
+
+    // Initialize the answering machine (greeting, messages, message waiting)
+    ESP_LOGI(TAG, "Initializing voicemail...");
+    ESP_ERROR_CHECK(voicemail_init());
+
     // Initialize communication subsystems
     // Note: WiFi initialized BEFORE Bluetooth to avoid coexistence issues during connection
     ESP_LOGI(TAG, "Initializing WiFi...");
@@ -62,14 +113,38 @@ void app_main(void)
     if (wifi_ret != ESP_OK) {
         ESP_LOGE(TAG, "WiFi initialization failed: %s", esp_err_to_name(wifi_ret));
         ESP_LOGE(TAG, "Device will continue without WiFi. See WIFI_SETUP.md for provisioning.");
+    } else {
+        // Wall clock for call records, voicemail, Caller ID and the time announcement
+        ESP_LOGI(TAG, "Starting SNTP...");
+        ESP_ERROR_CHECK(clock_init());
+    }
+
+#if MQTT_ENABLED
+    // Indicator changes go to the broker; a failure leaves the phone side working
+    ESP_LOGI(TAG, "Initializing MQTT...");
+    const mqtt_config_t mqtt_cfg = {
+        .broker_uri = MQTT_BROKER_URI,
+        .client_id = MQTT_CLIENT_ID,
+        .username = MQTT_USERNAME,
+        .password = MQTT_PASSWORD,
+        .port = MQTT_BROKER_PORT,
+        .use_ssl = MQTT_USE_SSL,
+    };
+    esp_err_t mqtt_ret = mqtt_init(&mqtt_cfg);
+    if (mqtt_ret == ESP_OK) {
+        mqtt_ret = mqtt_start();
+    }
+    if (mqtt_ret != ESP_OK) {
+        ESP_LOGE(TAG, "MQTT initialization failed: %s", esp_err_to_name(mqtt_ret));
     }
+#endif
 
     // WiFi init is complete (success or timeout), now safe to start Bluetooth
     ESP_LOGI(TAG, "Initializing Bluetooth...");
     ESP_ERROR_CHECK(bluetooth_init());
 
     // Signal Bluetooth initialization complete
-    ma_bell_state_update_network_bits(NET_STATE_BT_INIT_COMPLETE, 0);
+    ma_bell_state_update_network_bits(NET_STATE_BT_INIT_COMPLETE, 0, STATE_CAUSE_INIT);
     ESP_LOGI(TAG, "Bluetooth initialization complete");
 
     // Initialize application services
@@ -77,7 +152,7 @@ void app_main(void)
     ESP_ERROR_CHECK(web_interface_init());
 
     // Signal web server initialization complete
-    ma_bell_state_update_network_bits(NET_STATE_WEB_INIT_COMPLETE, 0);
+    ma_bell_state_update_network_bits(NET_STATE_WEB_INIT_COMPLETE, 0, STATE_CAUSE_INIT);
     ESP_LOGI(TAG, "Web interface initialization complete");
 
     ESP_LOGI(TAG, "===========================================");
@@ -0,0 +1,65 @@
+#include "clock.h"
+#include "config/clock_config.h"
+#include "esp_sntp.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <sys/time.h>
+
+static const char *TAG = "clock";
+
+static bool started = false;
+static volatile time_t last_sync = 0;
+
+// Runs in the lwIP thread after the clock has been stepped
+static void time_synced(struct timeval *tv)
+{
+    struct tm local;
+
+    last_sync = tv->tv_sec;
+    if (localtime_r(&tv->tv_sec, &local) != NULL) {
+        ESP_LOGI(TAG, "Clock set by SNTP: %04d-%02d-%02d %02d:%02d:%02d",
+                 local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                 local.tm_hour, local.tm_min, local.tm_sec);
+    }
+}
+
+esp_err_t clock_init(void)
+{
+    if (started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    setenv("TZ", CLOCK_TIMEZONE, 1);
+    tzset();
+
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, CLOCK_NTP_SERVER);
+    sntp_set_time_sync_notification_cb(time_synced);
+    esp_sntp_init();
+    started = true;
+
+    ESP_LOGI(TAG, "SNTP started (server %s, TZ %s)", CLOCK_NTP_SERVER, CLOCK_TIMEZONE);
+    return ESP_OK;
+}
+
+bool clock_is_set(void)
+{
+    return time(NULL) >= (time_t)CLOCK_MIN_VALID_TIME;
+}
+
+time_t clock_now(void)
+{
+    time_t now = time(NULL);
+    return (now >= (time_t)CLOCK_MIN_VALID_TIME) ? now : 0;
+}
+
+bool clock_localtime(struct tm *out)
+{
+    time_t now = clock_now();
+    return now != 0 && localtime_r(&now, out) != NULL;
+}
+
+time_t clock_last_sync(void)
+{
+    return last_sync;
+}
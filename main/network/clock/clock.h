@@ -0,0 +1,57 @@
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+/**
+ * @file clock.h
+ * @brief Wall clock time, set over SNTP
+ *
+ * Nothing else sets the clock, so until the first SNTP reply (and after a
+ * power cycle) time() counts from the epoch. Callers check clock_is_set()
+ * or use clock_now()/clock_localtime(), which report an unset clock, rather
+ * than judging time() themselves.
+ */
+
+/**
+ * @brief Apply the time zone and start the SNTP client
+ *
+ * Call once WiFi is up. The client keeps polling CLOCK_NTP_SERVER on its
+ * own, across WiFi reconnects.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already started
+ */
+esp_err_t clock_init(void);
+
+/**
+ * @brief Check whether the clock holds a real date
+ *
+ * @return true once the clock is at or after CLOCK_MIN_VALID_TIME
+ */
+bool clock_is_set(void);
+
+/**
+ * @brief Current time
+ *
+ * @return Seconds since the epoch, 0 if the clock is not set
+ */
+time_t clock_now(void);
+
+/**
+ * @brief Current local time in CLOCK_TIMEZONE
+ *
+ * @param out Broken-down local time
+ * @return true if the clock is set and out was filled in
+ */
+bool clock_localtime(struct tm *out);
+
+/**
+ * @brief Time of the last SNTP sync
+ *
+ * @return Seconds since the epoch, 0 if no sync has happened since boot
+ */
+time_t clock_last_sync(void);
+
+#endif /* __CLOCK_H__ */
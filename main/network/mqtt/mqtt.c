@@ -1,6 +1,10 @@
 #include "mqtt.h"
 #include "esp_log.h"
 #include "mqtt_client.h"
+#include "app/events/event_system.h"
+#include "bluetooth/bt_indicators.h"
+#include "config/mqtt_config.h"
+#include <stdio.h>
 #include <string.h>
 
 static const char *TAG = "mqtt";
@@ -36,6 +40,41 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+// Change sequence number of the last indicator sent to the broker
+static uint32_t mqtt_indicator_seq = 0;
+
+// Indicator changes, runs on the BT app task. Enqueue rather than publish
+// so it never waits on the broker.
+static void mqtt_indicator_handler(event_type_t event, void *user_data)
+{
+    char topic[64];
+    char payload[24];
+
+    if (!mqtt_client) {
+        return;
+    }
+
+    uint32_t seq = mqtt_indicator_seq;
+    for (int i = 0; i < BT_IND_COUNT; i++) {
+        bt_indicator_stats_t ind;
+        bt_indicators_get(i, &ind);
+        if (!ind.valid || ind.seq <= mqtt_indicator_seq) {
+            continue;
+        }
+        snprintf(topic, sizeof(topic), MQTT_INDICATOR_TOPIC "%s", bt_indicators_name(i));
+        if (i == BT_IND_OPERATOR) {
+            bt_indicators_get_operator(payload, sizeof(payload));
+        } else {
+            snprintf(payload, sizeof(payload), "%u", ind.value);
+        }
+        esp_mqtt_client_enqueue(mqtt_client, topic, payload, strlen(payload), 0, 1, true);
+        if (ind.seq > seq) {
+            seq = ind.seq;
+        }
+    }
+    mqtt_indicator_seq = seq;
+}
+
 esp_err_t mqtt_init(const mqtt_config_t *config)
 {
     if (!config) {
@@ -68,7 +107,13 @@ esp_err_t mqtt_init(const mqtt_config_t *config)
     }
 
     esp_mqtt_client_register_event(mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    
+
+    // Only changed indicators reach the broker, retained for late subscribers
+    esp_err_t ret = event_subscribe(BT_EVENT_INDICATOR_CHANGED, mqtt_indicator_handler, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Indicator publishing unavailable");
+    }
+
     return ESP_OK;
 }
 
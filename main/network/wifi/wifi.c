@@ -5,6 +5,7 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "wifi.h"
+#include "storage/settings.h"
 #include "app/events/event_system.h"
 #include "app/state/ma_bell_state.h"
 
@@ -26,7 +27,7 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         ESP_LOGW(TAG, "Disconnect from AP, reason: %d", disconnected->reason);
 
         // Clear WiFi connection state
-        ma_bell_state_update_network_bits(0, NET_STATE_WIFI_CONNECTED);
+        ma_bell_state_update_network_bits(0, NET_STATE_WIFI_CONNECTED, STATE_CAUSE_WIFI);
         ma_bell_state_set_ip_address("0.0.0.0");
         ma_bell_state_set_wifi_info(0, 0);
 
@@ -50,7 +51,7 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         char ip_str[16];
         snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&event->ip_info.ip));
         ma_bell_state_set_ip_address(ip_str);
-        ma_bell_state_update_network_bits(NET_STATE_WIFI_CONNECTED, 0);
+        ma_bell_state_update_network_bits(NET_STATE_WIFI_CONNECTED, 0, STATE_CAUSE_WIFI);
 
         // Get and update WiFi info (RSSI, channel)
         wifi_ap_record_t ap_info;
@@ -96,12 +97,12 @@ esp_err_t wifi_init_sta(EventGroupHandle_t wifi_event_group)
 
     esp_err_t ret = wifi_get_credentials(ssid, sizeof(ssid), password, sizeof(password));
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "No WiFi credentials found in NVS storage!");
+        ESP_LOGE(TAG, "No WiFi credentials in the settings record!");
         ESP_LOGE(TAG, "Please provision WiFi credentials (see WIFI_SETUP.md)");
         return ESP_ERR_NVS_NOT_FOUND;
     }
 
-    ESP_LOGI(TAG, "Found WiFi credentials in NVS for SSID: %s", ssid);
+    ESP_LOGI(TAG, "Found WiFi credentials for SSID: %s", ssid);
 
     // Set WiFi config
     wifi_config_t wifi_config = {
@@ -135,17 +136,11 @@ esp_err_t wifi_set_credentials(const char* ssid, const char* password)
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_err_t ret = storage_set_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_SSID, ssid);
-    if (ret != ESP_OK) {
-        return ret;
-    }
-
-    ret = storage_set_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_PASS, password);
-    if (ret != ESP_OK) {
-        return ret;
-    }
-
-    return storage_commit(STORAGE_NAMESPACE_WIFI);
+    settings_t cfg;
+    settings_get(&cfg);
+    strlcpy(cfg.wifi.ssid, ssid, sizeof(cfg.wifi.ssid));
+    strlcpy(cfg.wifi.password, password, sizeof(cfg.wifi.password));
+    return settings_set(&cfg);
 }
 
 esp_err_t wifi_get_credentials(char* ssid, size_t ssid_len, char* password, size_t pass_len)
@@ -154,12 +149,15 @@ esp_err_t wifi_get_credentials(char* ssid, size_t ssid_len, char* password, size
         return ESP_ERR_INVALID_ARG;
     }
 
-    esp_err_t ret = storage_get_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_SSID, ssid, ssid_len);
-    if (ret != ESP_OK) {
-        return ret;
+    // From the settings record in RAM; NVS is not touched
+    settings_t cfg;
+    settings_get(&cfg);
+    if (cfg.wifi.ssid[0] == '\0') {
+        return ESP_ERR_NVS_NOT_FOUND;
     }
-
-    return storage_get_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_PASS, password, pass_len);
+    strlcpy(ssid, cfg.wifi.ssid, ssid_len);
+    strlcpy(password, cfg.wifi.password, pass_len);
+    return ESP_OK;
 }
 
 esp_err_t wifi_connect(void)
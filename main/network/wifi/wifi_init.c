@@ -47,7 +47,7 @@ esp_err_t wifi_init_and_connect(void)
     );
 
     // Set initialization complete state regardless of connection outcome
-    ma_bell_state_update_network_bits(NET_STATE_WIFI_INIT_COMPLETE, 0);
+    ma_bell_state_update_network_bits(NET_STATE_WIFI_INIT_COMPLETE, 0, STATE_CAUSE_INIT);
     ESP_LOGI(TAG, "WiFi initialization complete, signaling dependent subsystems");
 
     if (bits & WIFI_CONNECTED_BIT) {
@@ -0,0 +1,130 @@
+#include "cdr_log.h"
+#include "crc32.h"
+#include <string.h>
+
+#define RECORDS_PER_SECTOR (CDR_SECTOR_SIZE / CDR_RECORD_SIZE)
+
+static bool record_free(const cdr_record_t *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    for (size_t i = 0; i < sizeof(*rec); i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool cdr_record_valid(const cdr_record_t *rec)
+{
+    return rec->magic == CDR_RECORD_MAGIC &&
+           rec->crc == crc32_update(0, rec, offsetof(cdr_record_t, crc));
+}
+
+int cdr_log_mount(cdr_log_t *log, const cdr_flash_t *flash)
+{
+    if (flash->size < 2 * CDR_SECTOR_SIZE || flash->size % CDR_SECTOR_SIZE != 0) {
+        return -1;
+    }
+    log->flash = *flash;
+
+    bool found = false;
+    uint32_t newest_seq = 0;
+    uint32_t newest_off = 0;
+    cdr_record_t rec;
+
+    for (uint32_t off = 0; off < flash->size; off += CDR_RECORD_SIZE) {
+        if (flash->read(flash->ctx, off, &rec, sizeof(rec)) != 0) {
+            return -1;
+        }
+        if (cdr_record_valid(&rec) && (!found || rec.seq > newest_seq)) {
+            found = true;
+            newest_seq = rec.seq;
+            newest_off = off;
+        }
+    }
+
+    log->head = found ? (newest_off + CDR_RECORD_SIZE) % flash->size : 0;
+    log->next_seq = found ? newest_seq + 1 : 1;
+
+    // Step over anything torn after the newest record; a new sector is erased anyway
+    while (log->head % CDR_SECTOR_SIZE != 0) {
+        if (flash->read(flash->ctx, log->head, &rec, sizeof(rec)) != 0) {
+            return -1;
+        }
+        if (record_free(&rec)) {
+            break;
+        }
+        log->head = (log->head + CDR_RECORD_SIZE) % flash->size;
+    }
+
+    return 0;
+}
+
+int cdr_log_append(cdr_log_t *log, cdr_record_t *recs, size_t count)
+{
+    const cdr_flash_t *flash = &log->flash;
+    size_t done = 0;
+
+    while (done < count) {
+        if (log->head % CDR_SECTOR_SIZE == 0 &&
+            flash->erase(flash->ctx, log->head, CDR_SECTOR_SIZE) != 0) {
+            return -1;
+        }
+
+        size_t room = (CDR_SECTOR_SIZE - log->head % CDR_SECTOR_SIZE) / CDR_RECORD_SIZE;
+        size_t n = (count - done < room) ? count - done : room;
+        for (size_t i = done; i < done + n; i++) {
+            recs[i].magic = CDR_RECORD_MAGIC;
+            recs[i].seq = log->next_seq++;
+            recs[i].crc = crc32_update(0, &recs[i], offsetof(cdr_record_t, crc));
+        }
+
+        int ret = flash->write(flash->ctx, log->head, &recs[done], n * CDR_RECORD_SIZE);
+        // The slots may be half programmed either way, never write them again
+        log->head = (log->head + n * CDR_RECORD_SIZE) % flash->size;
+        if (ret != 0) {
+            return -1;
+        }
+        done += n;
+    }
+
+    return 0;
+}
+
+void cdr_log_iter_begin(const cdr_log_t *log, cdr_log_iter_t *it, uint32_t after_seq)
+{
+    uint32_t size = log->flash.size;
+    uint32_t in_sector = log->head % CDR_SECTOR_SIZE;
+
+    // At a sector boundary the head sector still holds the oldest pass
+    it->pos = (in_sector == 0) ? log->head : (log->head - in_sector + CDR_SECTOR_SIZE) % size;
+    it->left = (log->head + size - it->pos) % size;
+    if (it->left == 0) {
+        it->left = size;
+    }
+    it->last_seq = after_seq;
+}
+
+bool cdr_log_iter_next(const cdr_log_t *log, cdr_log_iter_t *it, cdr_record_t *out)
+{
+    const cdr_flash_t *flash = &log->flash;
+
+    while (it->left >= CDR_RECORD_SIZE) {
+        int ret = flash->read(flash->ctx, it->pos, out, sizeof(*out));
+        it->pos = (it->pos + CDR_RECORD_SIZE) % flash->size;
+        it->left -= CDR_RECORD_SIZE;
+
+        if (ret == 0 && cdr_record_valid(out) && out->seq > it->last_seq) {
+            it->last_seq = out->seq;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t cdr_log_capacity(const cdr_log_t *log)
+{
+    // The sector being filled has already given up its previous pass
+    return (log->flash.size / CDR_SECTOR_SIZE - 1) * RECORDS_PER_SECTOR;
+}
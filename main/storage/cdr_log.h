@@ -0,0 +1,147 @@
+#ifndef __CDR_LOG_H__
+#define __CDR_LOG_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file cdr_log.h
+ * @brief Append-only circular log of call detail records
+ *
+ * Pure integer code with no ESP-IDF dependencies; flash access goes through
+ * the callbacks in cdr_flash_t, so the log can be exercised off-target
+ * against a RAM image.
+ *
+ * Records are a fixed 64 bytes and are written in order through the
+ * partition, one sector after another. A sector is erased just before its
+ * first record is written, so every sector is erased once per pass and the
+ * oldest sector is the one given up. Each record carries a sequence number
+ * and a CRC-32. Mounting scans for the highest valid sequence number and
+ * resumes after it; a record torn by a power cut fails its CRC and is
+ * skipped, and a torn erase is simply redone.
+ */
+
+#define CDR_SECTOR_SIZE     4096
+#define CDR_RECORD_SIZE     64
+#define CDR_RECORD_MAGIC    0xCD52
+#define CDR_NUMBER_LEN      36      // Number field, NUL padded
+
+/**
+ * @brief Call direction
+ */
+typedef enum {
+    CDR_DIR_INCOMING,
+    CDR_DIR_OUTGOING,
+} cdr_direction_t;
+
+/**
+ * @brief How the call ended
+ */
+typedef enum {
+    CDR_OUTCOME_ANSWERED,   // Connected, then hung up by either side
+    CDR_OUTCOME_MISSED,     // Incoming, caller gave up or was rejected
+    CDR_OUTCOME_ABANDONED,  // Outgoing, given up before it was answered
+    CDR_OUTCOME_BUSY,       // Outgoing, far end busy
+    CDR_OUTCOME_FAILED,     // Outgoing, refused by the phone or network
+    CDR_OUTCOME_LINK_LOST,  // Bluetooth link dropped during the call
+    CDR_OUTCOME_COUNT
+} cdr_outcome_t;
+
+/**
+ * @brief One call, as stored in flash (little endian)
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // CDR_RECORD_MAGIC
+    uint8_t direction;          // cdr_direction_t
+    uint8_t outcome;            // cdr_outcome_t
+    uint32_t seq;               // Assigned by cdr_log_append()
+    uint32_t start;             // Unix time of the first ring or dial, 0 if the clock was unset
+    uint32_t answer_ms;         // Start to answer, 0 if never answered
+    uint32_t duration_ms;       // Start to end
+    uint16_t post_dial_ms;      // Last digit to far-end alerting, 0 if not seen
+    uint16_t underruns;         // Audio underruns during the call, both directions
+    char number[CDR_NUMBER_LEN];
+    uint32_t crc;               // CRC-32 of everything above
+} cdr_record_t;
+
+_Static_assert(sizeof(cdr_record_t) == CDR_RECORD_SIZE, "CDR record must stay 64 bytes");
+
+/**
+ * @brief Flash access for the log; offsets are relative to the log start
+ *
+ * Each callback returns 0 on success.
+ */
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+    int (*erase)(void *ctx, uint32_t offset, size_t len);   // Whole sectors
+    void *ctx;
+    uint32_t size;              // Multiple of CDR_SECTOR_SIZE, at least two sectors
+} cdr_flash_t;
+
+/**
+ * @brief Mounted log
+ */
+typedef struct {
+    cdr_flash_t flash;
+    uint32_t head;              // Offset the next record goes to
+    uint32_t next_seq;
+} cdr_log_t;
+
+/**
+ * @brief Read position, oldest record first
+ */
+typedef struct {
+    uint32_t pos;
+    uint32_t left;              // Bytes still to visit before reaching the head
+    uint32_t last_seq;          // Only records after this are returned
+} cdr_log_iter_t;
+
+/**
+ * @brief Scan the flash and find where to resume
+ *
+ * @return 0 on success, -1 on a bad geometry or read error
+ */
+int cdr_log_mount(cdr_log_t *log, const cdr_flash_t *flash);
+
+/**
+ * @brief Append records, assigning their sequence numbers and CRCs
+ *
+ * Records that fit in the current sector are written with one flash write.
+ *
+ * @param recs Records to write; seq and crc are filled in
+ * @param count Number of records
+ * @return 0 on success, -1 if a flash operation failed (the records before
+ *         it are kept)
+ */
+int cdr_log_append(cdr_log_t *log, cdr_record_t *recs, size_t count);
+
+/**
+ * @brief Start reading at the oldest record
+ *
+ * @param after_seq Skip records up to and including this sequence number
+ */
+void cdr_log_iter_begin(const cdr_log_t *log, cdr_log_iter_t *it, uint32_t after_seq);
+
+/**
+ * @brief Get the next valid record
+ *
+ * Safe to interleave with appends: a record overwritten since the iterator
+ * started is skipped rather than returned out of order.
+ *
+ * @return True if a record was returned, false at the end of the log
+ */
+bool cdr_log_iter_next(const cdr_log_t *log, cdr_log_iter_t *it, cdr_record_t *out);
+
+/**
+ * @brief Records kept before the oldest are overwritten
+ */
+uint32_t cdr_log_capacity(const cdr_log_t *log);
+
+/**
+ * @brief Check magic and CRC of a record read back from flash
+ */
+bool cdr_record_valid(const cdr_record_t *rec);
+
+#endif /* __CDR_LOG_H__ */
@@ -0,0 +1,28 @@
+#ifndef __CRC32_H__
+#define __CRC32_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3) for the flash formats
+ *
+ * The call record log, voicemail headers and announcement image all use
+ * this CRC, the same one as zlib.crc32 in the host tools. No ESP-IDF
+ * dependencies, so it builds into the host tests with those modules.
+ */
+
+/**
+ * @brief Add bytes to a running CRC-32
+ *
+ * Bitwise; the data it covers is short or checked rarely.
+ *
+ * @param crc 0 to start, or the result of the previous call to continue
+ * @param data Bytes to add
+ * @param len Number of bytes
+ * @return CRC-32 of everything added so far
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif /* __CRC32_H__ */
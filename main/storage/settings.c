@@ -0,0 +1,248 @@
+#include "settings.h"
+#include "storage.h"
+#include "config/audio_config.h"
+#include "config/bluetooth_config.h"
+#include "config/call_config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+
+static const char *TAG = "settings";
+
+#define SETTINGS_MAGIC      0x4643424Du     // "MBCF"
+#define SETTINGS_VERSION    1
+
+// Largest body accepted, leaving room for records from newer firmware
+#define SETTINGS_BODY_MAX   512
+
+_Static_assert(sizeof(settings_t) <= SETTINGS_BODY_MAX, "Record outgrew SETTINGS_BODY_MAX");
+
+// Stored form: this header, then length bytes of settings_t
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t generation;
+    uint32_t crc;           // CRC-32 of the fields above and the body
+} settings_header_t;
+
+static const char *const record_keys[2] = { STORAGE_KEY_CFG_A, STORAGE_KEY_CFG_B };
+
+static const settings_t defaults = {
+    .bt = {
+        .device_name = BT_DEVICE_NAME,
+    },
+    .audio = {
+        .tone_level_pct = AUDIO_TONE_LEVEL_PCT,
+    },
+    .dial = {
+        .interdigit_timeout_ms = CALL_PROGRESS_INTERDIGIT_TIMEOUT_MS,
+        .complete_ms = DIALER_COMPLETE_MS,
+    },
+    .tones = {
+        .dial_tone_timeout_ms = CALL_PROGRESS_DIAL_TONE_TIMEOUT_MS,
+        .disconnect_timeout_ms = CALL_PROGRESS_DISCONNECT_TIMEOUT_MS,
+        .reorder_timeout_ms = CALL_PROGRESS_REORDER_TIMEOUT_MS,
+    },
+    .voicemail = {
+        .answer_rings = VOICEMAIL_ANSWER_RINGS,
+    },
+};
+
+// Readers copy under the spinlock; writers serialize on the mutex
+static settings_t active;
+static uint32_t active_generation = 0;
+static portMUX_TYPE settings_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t settings_mutex = NULL;
+
+static uint32_t record_crc(const settings_header_t *header, const void *body)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(settings_header_t, crc));
+    return esp_rom_crc32_le(crc, body, header->length);
+}
+
+// Bring a record from older firmware up to SETTINGS_VERSION. Version 0 is
+// the loose NVS keys that came before the record; see import_legacy().
+static void migrate(uint16_t from, settings_t *s)
+{
+    if (from > SETTINGS_VERSION) {
+        ESP_LOGW(TAG, "Record is version %u, newer than this firmware; unknown fields ignored", from);
+    }
+}
+
+// Read one copy into out; false if it is absent or fails its checks
+static bool read_record(const char *key, uint8_t *buf, settings_t *out, uint32_t *generation)
+{
+    size_t len = sizeof(settings_header_t) + SETTINGS_BODY_MAX;
+    esp_err_t ret = storage_get_blob(STORAGE_NAMESPACE_CFG, key, buf, &len);
+    if (ret != ESP_OK) {
+        if (ret != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Record '%s' unreadable: %s", key, esp_err_to_name(ret));
+        }
+        return false;
+    }
+
+    settings_header_t header;
+    if (len < sizeof(header)) {
+        ESP_LOGW(TAG, "Record '%s' truncated", key);
+        return false;
+    }
+    memcpy(&header, buf, sizeof(header));
+    const uint8_t *body = buf + sizeof(header);
+    if (header.magic != SETTINGS_MAGIC || len != sizeof(header) + header.length ||
+        header.crc != record_crc(&header, body)) {
+        ESP_LOGW(TAG, "Record '%s' corrupt", key);
+        return false;
+    }
+
+    *out = defaults;
+    memcpy(out, body, header.length < sizeof(*out) ? header.length : sizeof(*out));
+    migrate(header.version, out);
+    *generation = header.generation;
+    return true;
+}
+
+// Overwrite the older copy; called with settings_mutex held
+static esp_err_t write_record(const settings_t *s)
+{
+    uint8_t buf[sizeof(settings_header_t) + sizeof(settings_t)];
+    settings_header_t header = {
+        .magic = SETTINGS_MAGIC,
+        .version = SETTINGS_VERSION,
+        .length = sizeof(settings_t),
+        .generation = active_generation + 1,
+    };
+    header.crc = record_crc(&header, s);
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), s, sizeof(*s));
+
+    const char *key = record_keys[header.generation & 1];
+    esp_err_t ret = storage_set_blob(STORAGE_NAMESPACE_CFG, key, buf, sizeof(buf));
+    if (ret == ESP_OK) {
+        ret = storage_commit(STORAGE_NAMESPACE_CFG);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write record: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    portENTER_CRITICAL(&settings_lock);
+    active = *s;
+    active_generation = header.generation;
+    portEXIT_CRITICAL(&settings_lock);
+    ESP_LOGD(TAG, "Wrote generation %" PRIu32 " to '%s'", header.generation, key);
+    return ESP_OK;
+}
+
+// Move credentials from the separate Wi-Fi keys into s; true if there were any
+static bool import_legacy(settings_t *s)
+{
+    char ssid[sizeof(s->wifi.ssid)];
+    char password[sizeof(s->wifi.password)];
+
+    if (storage_get_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_SSID, ssid, sizeof(ssid)) != ESP_OK) {
+        return false;
+    }
+    if (storage_get_str(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_PASS, password, sizeof(password)) != ESP_OK) {
+        password[0] = '\0';
+    }
+    memcpy(s->wifi.ssid, ssid, sizeof(ssid));
+    memcpy(s->wifi.password, password, sizeof(password));
+    return true;
+}
+
+static void drop_legacy(void)
+{
+    storage_delete(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_SSID);
+    storage_delete(STORAGE_NAMESPACE_WIFI, STORAGE_KEY_WIFI_PASS);
+    storage_commit(STORAGE_NAMESPACE_WIFI);
+}
+
+esp_err_t settings_init(void)
+{
+    settings_mutex = xSemaphoreCreateMutex();
+    uint8_t *buf = malloc(sizeof(settings_header_t) + SETTINGS_BODY_MAX);
+    if (settings_mutex == NULL || buf == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate settings");
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The newer of the two valid copies wins
+    settings_t loaded = defaults;
+    bool found = false;
+    for (int i = 0; i < 2; i++) {
+        settings_t candidate;
+        uint32_t generation;
+        if (read_record(record_keys[i], buf, &candidate, &generation) &&
+            (!found || (int32_t)(generation - active_generation) > 0)) {
+            loaded = candidate;
+            active_generation = generation;
+            found = true;
+        }
+    }
+    free(buf);
+    active = loaded;
+
+    bool imported = import_legacy(&loaded);
+    if (found && !imported) {
+        ESP_LOGI(TAG, "Loaded generation %" PRIu32, active_generation);
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    esp_err_t ret = write_record(&loaded);
+    xSemaphoreGive(settings_mutex);
+    if (ret == ESP_OK && imported) {
+        ESP_LOGI(TAG, "Moved provisioned Wi-Fi credentials into the settings record");
+        drop_legacy();
+    } else if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "No settings record, created one with defaults");
+    }
+    // Running on what was loaded is still better than not starting
+    active = loaded;
+    return ESP_OK;
+}
+
+void settings_get(settings_t *out)
+{
+    portENTER_CRITICAL(&settings_lock);
+    *out = active;
+    portEXIT_CRITICAL(&settings_lock);
+}
+
+void settings_get_ssid(char *out, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&settings_lock);
+    strncpy(out, active.wifi.ssid, size - 1);
+    portEXIT_CRITICAL(&settings_lock);
+    out[size - 1] = '\0';
+}
+
+esp_err_t settings_set(const settings_t *in)
+{
+    if (in->audio.tone_level_pct > 100 ||
+        memchr(in->wifi.ssid, '\0', sizeof(in->wifi.ssid)) == NULL ||
+        memchr(in->wifi.password, '\0', sizeof(in->wifi.password)) == NULL ||
+        memchr(in->bt.device_name, '\0', sizeof(in->bt.device_name)) == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    settings_t current;
+    settings_get(&current);
+    esp_err_t ret = ESP_OK;
+    if (memcmp(&current, in, sizeof(current)) != 0) {
+        ret = write_record(in);
+    }
+    xSemaphoreGive(settings_mutex);
+    return ret;
+}
@@ -0,0 +1,99 @@
+#ifndef __SETTINGS_H__
+#define __SETTINGS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "config/wifi_config.h"
+
+/**
+ * @file settings.h
+ * @brief Configuration record
+ *
+ * All user configuration lives in one versioned, CRC-protected record that
+ * is read from NVS once by settings_init() and served from RAM afterwards;
+ * no runtime path reads NVS for configuration. Two copies are kept under
+ * alternating keys with a generation counter, and an update always
+ * overwrites the older one, so a write cut short by a reset leaves the
+ * previous record to boot from.
+ *
+ * Fields are only ever appended to the end of settings_t. A record from
+ * older firmware keeps its fields and takes defaults for the rest; any
+ * other layout change needs SETTINGS_VERSION bumped and a step in
+ * migrate().
+ */
+
+#define SETTINGS_BT_NAME_LEN    31
+
+/**
+ * @brief Configuration, as held in RAM and on flash
+ */
+typedef struct {
+    struct {
+        char ssid[MAX_SSID_LEN + 1];                // "" when not provisioned
+        char password[MAX_PASS_LEN + 1];
+    } wifi;
+    struct {
+        char device_name[SETTINGS_BT_NAME_LEN + 1]; // Name shown to phones
+    } bt;
+    struct {
+        uint8_t tone_level_pct;                     // Call-progress tones, percent of full scale
+    } audio;
+    struct {
+        uint32_t interdigit_timeout_ms;             // Pause between digits before reorder
+        uint32_t complete_ms;                       // Pause after which the number is dialed
+    } dial;
+    struct {
+        uint32_t dial_tone_timeout_ms;              // Dial tone with no digits before reorder
+        uint32_t disconnect_timeout_ms;             // Silence after far-end hangup before reorder
+        uint32_t reorder_timeout_ms;                // Busy/reorder before off-hook warning
+    } tones;
+    struct {
+        uint8_t answer_rings;                       // Rings before the answering machine picks up, 0 = off
+    } voicemail;
+} settings_t;
+
+/**
+ * @brief Load the configuration record
+ *
+ * Must be called after storage_init() and before anything reads the
+ * settings. Wi-Fi credentials written as separate keys (by the
+ * provisioning tool or older firmware) are moved into the record.
+ * Without a valid record the defaults from config/ are used.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the read buffer cannot be allocated
+ */
+esp_err_t settings_init(void);
+
+/**
+ * @brief Copy the current configuration
+ *
+ * Never touches NVS; safe from any task.
+ */
+void settings_get(settings_t *out);
+
+/**
+ * @brief Copy only the WiFi SSID
+ *
+ * For callers that report the network, so that the rest of the record
+ * (the WiFi password included) is not copied onto their stack.
+ *
+ * @param out Destination, "" when not provisioned
+ * @param size Size of out; the SSID is cut short if it does not fit
+ */
+void settings_get_ssid(char *out, size_t size);
+
+/**
+ * @brief Replace the configuration
+ *
+ * The record is committed to NVS before the copy in RAM changes, so
+ * settings_get() never returns values that would not survive a reset.
+ * Blocks the caller for the flash write.
+ *
+ * @param in New configuration, usually a modified copy from settings_get()
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an out-of-range value,
+ *         or the NVS error if the record could not be written
+ */
+esp_err_t settings_set(const settings_t *in);
+
+#endif /* __SETTINGS_H__ */
@@ -1,241 +1,606 @@
 #include "storage.h"
+#include "config/system_config.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_system.h"
 #include "esp_log.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "storage";
 
-esp_err_t storage_init(void)
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_U8,
+    SLOT_U32,
+    SLOT_STR,           // data holds the string and its NUL
+    SLOT_BLOB,
+    SLOT_ERASED,        // Known absent; pending erase if dirty
+} slot_type_t;
+
+typedef struct {
+    char name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t handle;
+} ns_entry_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t ns;
+    bool dirty;
+    uint16_t failures;  // Failed attempts to write the pending value
+    esp_err_t last_error;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    uint32_t num;
+    void *data;
+    size_t len;
+    uint32_t last_use;
+} cache_slot_t;
+
+// Handles are opened on first use and never closed
+static ns_entry_t namespaces[STORAGE_MAX_NAMESPACES];
+static uint8_t ns_count = 0;
+
+static cache_slot_t cache[STORAGE_CACHE_ENTRIES];
+static uint32_t use_clock = 0;
+
+static storage_stats_t stats;
+static SemaphoreHandle_t storage_mutex = NULL;
+static esp_timer_handle_t flush_timer = NULL;
+static TaskHandle_t flush_task_handle = NULL;
+
+_Static_assert(STORAGE_NAME_MAX == NVS_KEY_NAME_MAX_SIZE, "STORAGE_NAME_MAX must match NVS");
+
+static esp_err_t ns_open_locked(const char *namespace, uint8_t *idx)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_LOGI(TAG, "NVS partition was truncated and needs to be erased");
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+    for (uint8_t i = 0; i < ns_count; i++) {
+        if (strcmp(namespaces[i].name, namespace) == 0) {
+            *idx = i;
+            return ESP_OK;
+        }
+    }
+    if (ns_count >= STORAGE_MAX_NAMESPACES || strlen(namespace) >= NVS_KEY_NAME_MAX_SIZE) {
+        ESP_LOGE(TAG, "Cannot open namespace '%s'", namespace);
+        return ESP_ERR_NO_MEM;
     }
-    ESP_ERROR_CHECK(ret);
-    ESP_LOGI(TAG, "NVS initialized successfully");
 
+    // Read-write even for reads: it is the same handle for the writes later
+    ns_entry_t *ns = &namespaces[ns_count];
+    stats.nvs_opens++;
+    esp_err_t ret = nvs_open(namespace, NVS_READWRITE, &ns->handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
+        return ret;
+    }
+    strcpy(ns->name, namespace);
+    *idx = ns_count++;
     return ESP_OK;
 }
 
-esp_err_t storage_set_str(const char* namespace, const char* key, const char* value)
+static cache_slot_t *find_locked(uint8_t ns, const char *key)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
-
-    ret = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES; i++) {
+        if (cache[i].type != SLOT_FREE && cache[i].ns == ns && strcmp(cache[i].key, key) == 0) {
+            cache[i].last_use = ++use_clock;
+            return &cache[i];
+        }
     }
+    return NULL;
+}
 
-    ret = nvs_set_str(nvs_handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error setting NVS value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+static void release_slot(cache_slot_t *slot)
+{
+    free(slot->data);
+    memset(slot, 0, sizeof(*slot));
+}
+
+// A free slot, else the least recently used clean one; NULL if all are dirty
+static cache_slot_t *claim_locked(uint8_t ns, const char *key)
+{
+    cache_slot_t *victim = NULL;
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES; i++) {
+        if (cache[i].type == SLOT_FREE) {
+            victim = &cache[i];
+            break;
+        }
+        if (!cache[i].dirty && (victim == NULL || cache[i].last_use < victim->last_use)) {
+            victim = &cache[i];
+        }
     }
+    if (victim == NULL) {
+        return NULL;
+    }
+    release_slot(victim);
+    victim->ns = ns;
+    strcpy(victim->key, key);
+    victim->last_use = ++use_clock;
+    return victim;
+}
 
-    ret = nvs_commit(nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+// Fill a slot with a value; false if the copy cannot be allocated
+static bool fill_slot(cache_slot_t *slot, slot_type_t type, uint32_t num, const void *data, size_t len)
+{
+    void *copy = NULL;
+    if (type == SLOT_STR || type == SLOT_BLOB) {
+        copy = malloc(len ? len : 1);
+        if (copy == NULL) {
+            return false;
+        }
+        memcpy(copy, data, len);
     }
+    free(slot->data);
+    slot->type = type;
+    slot->num = num;
+    slot->data = copy;
+    slot->len = len;
+    return true;
+}
 
-    ESP_LOGI(TAG, "Successfully stored value for key '%s' in namespace '%s'", key, namespace);
-    nvs_close(nvs_handle);
-    return ESP_OK;
+static bool same_value(const cache_slot_t *slot, slot_type_t type, uint32_t num, const void *data, size_t len)
+{
+    if (slot->type != type) {
+        return false;
+    }
+    switch (type) {
+    case SLOT_U8:
+    case SLOT_U32:
+        return slot->num == num;
+    case SLOT_STR:
+    case SLOT_BLOB:
+        return slot->len == len && memcmp(slot->data, data, len) == 0;
+    default:
+        return true;
+    }
 }
 
-esp_err_t storage_get_str(const char* namespace, const char* key, char* value, size_t max_len)
+static esp_err_t nvs_write(nvs_handle_t handle, const char *key, slot_type_t type,
+                           uint32_t num, const void *data, size_t len)
 {
-    nvs_handle_t nvs_handle;
     esp_err_t ret;
+    switch (type) {
+    case SLOT_U8:
+        stats.nvs_writes++;
+        return nvs_set_u8(handle, key, (uint8_t)num);
+    case SLOT_U32:
+        stats.nvs_writes++;
+        return nvs_set_u32(handle, key, num);
+    case SLOT_STR:
+        stats.nvs_writes++;
+        return nvs_set_str(handle, key, data);
+    case SLOT_BLOB:
+        stats.nvs_writes++;
+        return nvs_set_blob(handle, key, data, len);
+    case SLOT_ERASED:
+        stats.nvs_erases++;
+        ret = nvs_erase_key(handle, key);
+        return ret == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : ret;
+    default:
+        return ESP_OK;
+    }
+}
 
-    ret = nvs_open(namespace, NVS_READONLY, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
+// Note a write that did not reach flash; the value stays cached and dirty
+static void write_failed(cache_slot_t *slot, esp_err_t ret)
+{
+    stats.flush_errors++;
+    slot->last_error = ret;
+    if (slot->failures++ == 0) {
+        ESP_LOGE(TAG, "Error writing key '%s' in namespace '%s': %s, will retry",
+                 slot->key, namespaces[slot->ns].name, esp_err_to_name(ret));
     }
+}
 
-    size_t required_size = 0;
-    ret = nvs_get_str(nvs_handle, key, NULL, &required_size);
-    if (ret != ESP_OK) {
-        ESP_LOGD(TAG, "Key '%s' not found in namespace '%s': %s", key, namespace, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+// Write dirty slots of one namespace (or all, ns < 0) and commit each namespace touched.
+// A slot is only clean once its namespace has committed; anything else is retried.
+static esp_err_t flush_locked(int ns)
+{
+    bool touched[STORAGE_MAX_NAMESPACES] = { false };
+    esp_err_t committed[STORAGE_MAX_NAMESPACES] = { ESP_OK };
+    bool written[STORAGE_CACHE_ENTRIES] = { false };
+    esp_err_t result = ESP_OK;
+
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES; i++) {
+        cache_slot_t *slot = &cache[i];
+        if (!slot->dirty || (ns >= 0 && slot->ns != ns)) {
+            continue;
+        }
+        esp_err_t ret = nvs_write(namespaces[slot->ns].handle, slot->key, slot->type,
+                                  slot->num, slot->data, slot->len);
+        if (ret != ESP_OK) {
+            write_failed(slot, ret);
+            result = ret;
+            continue;
+        }
+        written[i] = true;
+        touched[slot->ns] = true;
     }
 
-    if (required_size > max_len) {
-        ESP_LOGE(TAG, "Value too long for buffer (required: %d, available: %d)", required_size, max_len);
-        nvs_close(nvs_handle);
-        return ESP_ERR_NVS_INVALID_LENGTH;
+    for (int i = 0; i < ns_count; i++) {
+        if (!touched[i]) {
+            continue;
+        }
+        stats.nvs_commits++;
+        committed[i] = nvs_commit(namespaces[i].handle);
+        if (committed[i] != ESP_OK) {
+            ESP_LOGE(TAG, "Error committing NVS for namespace '%s': %s", namespaces[i].name,
+                     esp_err_to_name(committed[i]));
+            result = committed[i];
+        }
     }
 
-    ret = nvs_get_str(nvs_handle, key, value, &max_len);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error getting NVS value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+    bool retry = false;
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES; i++) {
+        cache_slot_t *slot = &cache[i];
+        if (written[i] && committed[slot->ns] != ESP_OK) {
+            write_failed(slot, committed[slot->ns]);
+        } else if (written[i]) {
+            if (slot->failures) {
+                ESP_LOGI(TAG, "Key '%s' in namespace '%s' written after %u failed attempts",
+                         slot->key, namespaces[slot->ns].name, slot->failures);
+            }
+            slot->dirty = false;
+            slot->failures = 0;
+            slot->last_error = ESP_OK;
+            // Large values were only held until they reached flash
+            if (slot->len > STORAGE_CACHE_VALUE_MAX) {
+                release_slot(slot);
+            }
+        }
+        retry |= slot->dirty;
     }
 
-    ESP_LOGI(TAG, "Successfully retrieved value for key '%s' from namespace '%s'", key, namespace);
-    nvs_close(nvs_handle);
-    return ESP_OK;
+    if (retry) {
+        esp_timer_stop(flush_timer);
+        esp_timer_start_once(flush_timer, (uint64_t)STORAGE_RETRY_MS * 1000);
+    }
+    stats.flushes++;
+    return result;
 }
 
-esp_err_t storage_set_u8(const char* namespace, const char* key, uint8_t value)
+static esp_err_t put(const char *namespace, const char *key, slot_type_t type,
+                     uint32_t num, const void *data, size_t len)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
+    if (storage_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    ret = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
+    xSemaphoreTake(storage_mutex, portMAX_DELAY);
+    uint8_t ns;
+    esp_err_t ret = ns_open_locked(namespace, &ns);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
+        xSemaphoreGive(storage_mutex);
         return ret;
     }
 
-    ret = nvs_set_u8(nvs_handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error setting uint8 value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+    cache_slot_t *slot = find_locked(ns, key);
+    if (slot && same_value(slot, type, num, data, len)) {
+        stats.unchanged++;
+        xSemaphoreGive(storage_mutex);
+        return ESP_OK;
+    }
+    if (slot && slot->dirty) {
+        stats.coalesced++;
+    }
+    if (slot == NULL) {
+        slot = claim_locked(ns, key);
+    }
+    if (slot == NULL) {
+        // Every slot is waiting to be written: write them now to make room
+        flush_locked(-1);
+        slot = claim_locked(ns, key);
     }
 
-    ret = nvs_commit(nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
+    if (slot == NULL || !fill_slot(slot, type, num, data, len)) {
+        // No memory to hold the value: write it through
+        ret = nvs_write(namespaces[ns].handle, key, type, num, data, len);
+        if (ret == ESP_OK) {
+            stats.nvs_commits++;
+            ret = nvs_commit(namespaces[ns].handle);
+        }
+        if (ret != ESP_OK) {
+            // The caller sees the error; a value still pending for the key is kept
+            ESP_LOGE(TAG, "Error storing key '%s' in namespace '%s': %s", key, namespace, esp_err_to_name(ret));
+        } else if (slot) {
+            release_slot(slot);
+        }
+        xSemaphoreGive(storage_mutex);
         return ret;
     }
+    slot->dirty = true;
+    xSemaphoreGive(storage_mutex);
 
-    nvs_close(nvs_handle);
+    ESP_LOGD(TAG, "Queued key '%s' in namespace '%s'", key, namespace);
+    esp_timer_stop(flush_timer);
+    esp_timer_start_once(flush_timer, (uint64_t)STORAGE_WRITE_BEHIND_MS * 1000);
     return ESP_OK;
 }
 
-esp_err_t storage_get_u8(const char* namespace, const char* key, uint8_t* value)
+// Read a value missing from the cache and keep it if it is small
+static esp_err_t load_locked(uint8_t ns, const char *key, slot_type_t type, cache_slot_t **out)
 {
-    nvs_handle_t nvs_handle;
+    nvs_handle_t handle = namespaces[ns].handle;
+    uint8_t u8 = 0;
+    uint32_t num = 0;
+    size_t len = 0;
     esp_err_t ret;
 
-    ret = nvs_open(namespace, NVS_READONLY, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
+    *out = NULL;
+    stats.nvs_reads++;
+    switch (type) {
+    case SLOT_U8:
+        ret = nvs_get_u8(handle, key, &u8);
+        num = u8;
+        break;
+    case SLOT_U32:
+        ret = nvs_get_u32(handle, key, &num);
+        break;
+    case SLOT_STR:
+        ret = nvs_get_str(handle, key, NULL, &len);
+        break;
+    default:
+        ret = nvs_get_blob(handle, key, NULL, &len);
+        break;
     }
 
-    ret = nvs_get_u8(nvs_handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error getting uint8 value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        // Remember the absence too; every write goes through this cache
+        cache_slot_t *slot = claim_locked(ns, key);
+        if (slot) {
+            slot->type = SLOT_ERASED;
+        }
+        return ret;
+    }
+    if (ret != ESP_OK || len > STORAGE_CACHE_VALUE_MAX) {
         return ret;
     }
 
-    nvs_close(nvs_handle);
+    void *data = NULL;
+    if (type == SLOT_STR || type == SLOT_BLOB) {
+        data = malloc(len ? len : 1);
+        if (data == NULL) {
+            return ESP_OK;      // Caller reads it directly
+        }
+        stats.nvs_reads++;
+        ret = (type == SLOT_STR) ? nvs_get_str(handle, key, data, &len)
+                                 : nvs_get_blob(handle, key, data, &len);
+        if (ret != ESP_OK) {
+            free(data);
+            return ret;
+        }
+    }
+
+    cache_slot_t *slot = claim_locked(ns, key);
+    if (slot == NULL) {
+        free(data);
+        return ESP_OK;
+    }
+    slot->type = type;
+    slot->num = num;
+    slot->data = data;
+    slot->len = len;
+    *out = slot;
     return ESP_OK;
 }
 
-esp_err_t storage_set_u32(const char* namespace, const char* key, uint32_t value)
+// Copy a value out of the cache, or straight from NVS if it is not cacheable
+static esp_err_t get(const char *namespace, const char *key, slot_type_t type,
+                     uint32_t *num, void *value, size_t *len)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
+    if (storage_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    ret = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
+    xSemaphoreTake(storage_mutex, portMAX_DELAY);
+    uint8_t ns;
+    esp_err_t ret = ns_open_locked(namespace, &ns);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
+        xSemaphoreGive(storage_mutex);
         return ret;
     }
 
-    ret = nvs_set_u32(nvs_handle, key, value);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error setting uint32 value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+    cache_slot_t *slot = find_locked(ns, key);
+    if (slot) {
+        stats.cache_hits++;
+    } else {
+        ret = load_locked(ns, key, type, &slot);
     }
 
-    ret = nvs_commit(nvs_handle);
+    if (slot) {
+        if (slot->type != type) {
+            ret = ESP_ERR_NVS_NOT_FOUND;
+        } else if (type == SLOT_U8 || type == SLOT_U32) {
+            *num = slot->num;
+        } else if (type == SLOT_BLOB && value == NULL) {
+            *len = slot->len;
+        } else if (slot->len > *len) {
+            ret = ESP_ERR_NVS_INVALID_LENGTH;
+        } else {
+            memcpy(value, slot->data, slot->len);
+            *len = slot->len;
+        }
+    } else if (ret == ESP_OK) {
+        stats.nvs_reads++;
+        ret = (type == SLOT_STR) ? nvs_get_str(namespaces[ns].handle, key, value, len)
+                                 : nvs_get_blob(namespaces[ns].handle, key, value, len);
+    }
+    xSemaphoreGive(storage_mutex);
+
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+        ESP_LOGD(TAG, "Key '%s' not read from namespace '%s': %s", key, namespace, esp_err_to_name(ret));
     }
+    return ret;
+}
 
-    nvs_close(nvs_handle);
-    return ESP_OK;
+static void flush_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        storage_flush();
+    }
 }
 
-esp_err_t storage_get_u32(const char* namespace, const char* key, uint32_t* value)
+// Flash writes stay off the esp_timer task, which runs the tone cadences
+static void flush_timer_cb(void *arg)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
+    xTaskNotifyGive(flush_task_handle);
+}
 
-    ret = nvs_open(namespace, NVS_READONLY, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
+esp_err_t storage_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGI(TAG, "NVS partition was truncated and needs to be erased");
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
     }
+    ESP_ERROR_CHECK(ret);
 
-    ret = nvs_get_u32(nvs_handle, key, value);
+    storage_mutex = xSemaphoreCreateMutex();
+    if (storage_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = flush_timer_cb,
+        .name = "storage_flush",
+    };
+    ret = esp_timer_create(&timer_args, &flush_timer);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error getting uint32 value for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
+        ESP_LOGE(TAG, "Failed to create timer: %s", esp_err_to_name(ret));
         return ret;
     }
 
-    nvs_close(nvs_handle);
+    if (xTaskCreate(flush_task, "storage", STORAGE_TASK_STACK_SIZE, NULL, STORAGE_TASK_PRIORITY,
+                    &flush_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return ESP_FAIL;
+    }
+
+    // Pending writes reach flash before a software restart
+    esp_register_shutdown_handler(storage_flush);
+
+    ESP_LOGI(TAG, "NVS initialized successfully");
     return ESP_OK;
 }
 
-esp_err_t storage_delete(const char* namespace, const char* key)
+esp_err_t storage_set_str(const char* namespace, const char* key, const char* value)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
+    return put(namespace, key, SLOT_STR, 0, value, strlen(value) + 1);
+}
 
-    ret = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
-    }
+esp_err_t storage_get_str(const char* namespace, const char* key, char* value, size_t max_len)
+{
+    return get(namespace, key, SLOT_STR, NULL, value, &max_len);
+}
 
-    ret = nvs_erase_key(nvs_handle, key);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error deleting key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
-    }
+esp_err_t storage_set_u8(const char* namespace, const char* key, uint8_t value)
+{
+    return put(namespace, key, SLOT_U8, value, NULL, 0);
+}
 
-    ret = nvs_commit(nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS after delete for key '%s': %s", key, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+esp_err_t storage_get_u8(const char* namespace, const char* key, uint8_t* value)
+{
+    uint32_t num;
+    esp_err_t ret = get(namespace, key, SLOT_U8, &num, NULL, NULL);
+    if (ret == ESP_OK) {
+        *value = (uint8_t)num;
     }
+    return ret;
+}
 
-    nvs_close(nvs_handle);
-    return ESP_OK;
+esp_err_t storage_set_u32(const char* namespace, const char* key, uint32_t value)
+{
+    return put(namespace, key, SLOT_U32, value, NULL, 0);
+}
+
+esp_err_t storage_get_u32(const char* namespace, const char* key, uint32_t* value)
+{
+    return get(namespace, key, SLOT_U32, value, NULL, NULL);
+}
+
+esp_err_t storage_set_blob(const char* namespace, const char* key, const void* value, size_t len)
+{
+    return put(namespace, key, SLOT_BLOB, 0, value, len);
+}
+
+esp_err_t storage_get_blob(const char* namespace, const char* key, void* value, size_t* len)
+{
+    return get(namespace, key, SLOT_BLOB, NULL, value, len);
+}
+
+esp_err_t storage_delete(const char* namespace, const char* key)
+{
+    return put(namespace, key, SLOT_ERASED, 0, NULL, 0);
 }
 
 esp_err_t storage_commit(const char* namespace)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t ret;
+    if (storage_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    ret = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS handle for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        return ret;
+    xSemaphoreTake(storage_mutex, portMAX_DELAY);
+    uint8_t ns;
+    esp_err_t ret = ns_open_locked(namespace, &ns);
+    if (ret == ESP_OK) {
+        ret = flush_locked(ns);
     }
+    xSemaphoreGive(storage_mutex);
+    return ret;
+}
 
-    ret = nvs_commit(nvs_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS for namespace '%s': %s", namespace, esp_err_to_name(ret));
-        nvs_close(nvs_handle);
-        return ret;
+void storage_flush(void)
+{
+    if (storage_mutex == NULL) {
+        return;
     }
 
-    nvs_close(nvs_handle);
-    return ESP_OK;
-} 
\ No newline at end of file
+    xSemaphoreTake(storage_mutex, portMAX_DELAY);
+    bool pending = false;
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES && !pending; i++) {
+        pending = cache[i].dirty;
+    }
+    if (pending) {
+        flush_locked(-1);
+    }
+    xSemaphoreGive(storage_mutex);
+}
+
+void storage_get_stats(storage_stats_t *out)
+{
+    if (storage_mutex == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+
+    xSemaphoreTake(storage_mutex, portMAX_DELAY);
+    *out = stats;
+    out->pending = 0;
+    out->failing = 0;
+    for (int i = 0; i < STORAGE_CACHE_ENTRIES; i++) {
+        const cache_slot_t *slot = &cache[i];
+        out->pending += slot->dirty;
+        if (!slot->dirty || slot->failures == 0) {
+            continue;
+        }
+        if (out->failing < STORAGE_STATS_FAILED_KEYS) {
+            storage_failed_key_t *failed = &out->failed[out->failing];
+            strcpy(failed->namespace, namespaces[slot->ns].name);
+            strcpy(failed->key, slot->key);
+            failed->attempts = slot->failures;
+            failed->last_error = slot->last_error;
+        }
+        out->failing++;
+    }
+    xSemaphoreGive(storage_mutex);
+}
@@ -4,24 +4,86 @@
 #include <esp_err.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Values are cached in RAM and writes are held back: a set or delete marks
+ * the cached value dirty and (re)starts a STORAGE_WRITE_BEHIND_MS quiet
+ * period, after which every dirty value is written and each namespace
+ * touched is committed once. Reads are served from the cache, pending
+ * writes included. Call storage_commit() where a value must be on flash
+ * before going on; a software restart flushes as well, a power loss drops
+ * what is still pending.
+ *
+ * A value whose write or commit fails stays cached and dirty, so reads
+ * still return it, and the write is tried again STORAGE_RETRY_MS later.
+ * storage_get_stats() lists the keys that are failing.
+ */
 
 // Namespace for different types of data
 #define STORAGE_NAMESPACE_WIFI "wifi"
 #define STORAGE_NAMESPACE_BT   "bt"
 #define STORAGE_NAMESPACE_SYS  "sys"
+#define STORAGE_NAMESPACE_PBOOK "pbook"
+#define STORAGE_NAMESPACE_CFG  "cfg"
 
-// Keys for WiFi configuration
+// Keys for WiFi configuration, as written by tools/provision_wifi.py.
+// Moved into the settings record at boot and then deleted.
 #define STORAGE_KEY_WIFI_SSID "ssid"
 #define STORAGE_KEY_WIFI_PASS "pass"
 
+// Keys for the settings record, two copies written alternately
+#define STORAGE_KEY_CFG_A          "rec_a"
+#define STORAGE_KEY_CFG_B          "rec_b"
+
 // Keys for Bluetooth configuration
 #define STORAGE_KEY_BT_DEVICE_NAME "dev_name"
-#define STORAGE_KEY_BT_PAIRED_DEV  "paired_dev"
+#define STORAGE_KEY_BT_PAIRED_DEV  "paired_dev"   // Legacy single device, migrated into the registry
+#define STORAGE_KEY_BT_PAIRED_NAME "paired_name"  // Legacy single device name
+#define STORAGE_KEY_BT_REGISTRY    "registry"     // Paired device registry blob
 
 // Keys for System configuration
 #define STORAGE_KEY_SYS_VOLUME     "volume"
 #define STORAGE_KEY_SYS_RING_VOL   "ring_vol"
 
+// Keys for the phonebook
+#define STORAGE_KEY_PBOOK_ENTRIES  "entries"      // Header and entry array blob
+
+// Longest namespace or key name, NUL included (NVS_KEY_NAME_MAX_SIZE)
+#define STORAGE_NAME_MAX           16
+
+// Failing keys reported by storage_get_stats()
+#define STORAGE_STATS_FAILED_KEYS  4
+
+/**
+ * @brief A pending value whose writes keep failing
+ */
+typedef struct {
+    char namespace[STORAGE_NAME_MAX];
+    char key[STORAGE_NAME_MAX];
+    uint32_t attempts;       // Failed writes or commits since the value was set
+    esp_err_t last_error;
+} storage_failed_key_t;
+
+/**
+ * @brief NVS operation counters
+ */
+typedef struct {
+    uint32_t nvs_opens;      // Namespace handles opened
+    uint32_t nvs_reads;      // nvs_get_* calls
+    uint32_t nvs_writes;     // nvs_set_* calls
+    uint32_t nvs_erases;     // nvs_erase_key calls
+    uint32_t nvs_commits;    // nvs_commit calls
+    uint32_t cache_hits;     // Reads served without NVS
+    uint32_t coalesced;      // Writes that replaced a value not yet written
+    uint32_t unchanged;      // Writes dropped because the value was the same
+    uint32_t flushes;        // Write-behind batches
+    uint32_t flush_errors;   // Writes or commits that failed in a batch
+    uint32_t pending;        // Values waiting to be written
+    uint32_t failing;        // Pending values whose last write failed
+    storage_failed_key_t failed[STORAGE_STATS_FAILED_KEYS];  // The first of them
+} storage_stats_t;
+
 /**
  * @brief Initialize the storage system
  * 
@@ -92,6 +154,29 @@ esp_err_t storage_set_u32(const char* namespace, const char* key, uint32_t value
  */
 esp_err_t storage_get_u32(const char* namespace, const char* key, uint32_t* value);
 
+/**
+ * @brief Store a binary blob in NVS
+ *
+ * @param namespace NVS namespace
+ * @param key Key for the value
+ * @param value Data to store
+ * @param len Length of the data in bytes
+ * @return ESP_OK on success, error code on failure
+ */
+esp_err_t storage_set_blob(const char* namespace, const char* key, const void* value, size_t len);
+
+/**
+ * @brief Get a binary blob from NVS
+ *
+ * @param namespace NVS namespace
+ * @param key Key for the value
+ * @param value Buffer to store the data
+ * @param len In: size of the buffer. Out: length of the stored blob
+ * @return ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if absent,
+ *         ESP_ERR_NVS_INVALID_LENGTH if the buffer is too small
+ */
+esp_err_t storage_get_blob(const char* namespace, const char* key, void* value, size_t* len);
+
 /**
  * @brief Delete a value from NVS
  * 
@@ -102,11 +187,23 @@ esp_err_t storage_get_u32(const char* namespace, const char* key, uint32_t* valu
 esp_err_t storage_delete(const char* namespace, const char* key);
 
 /**
- * @brief Commit changes to NVS
+ * @brief Write pending changes of a namespace to NVS now
+ * 
+ * Blocks the caller for the flash write.
  * 
  * @param namespace NVS namespace
- * @return ESP_OK on success, ESP_FAIL on failure
+ * @return ESP_OK on success, the first write or commit error otherwise
  */
 esp_err_t storage_commit(const char* namespace);
 
+/**
+ * @brief Write all pending changes to NVS now
+ */
+void storage_flush(void);
+
+/**
+ * @brief Get a copy of the NVS operation counters
+ */
+void storage_get_stats(storage_stats_t *out);
+
 #endif /* __STORAGE_H__ */ 
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "vm_store.h"
+#include "crc32.h"
+#include <string.h>
+
+static uint32_t header_crc(const vm_header_t *hdr)
+{
+    const uint8_t *p = (const uint8_t *)hdr;
+    return crc32_update(0, p + offsetof(vm_header_t, magic),
+                        offsetof(vm_header_t, crc) - offsetof(vm_header_t, magic));
+}
+
+static uint32_t slot_base(const vm_store_t *store, uint8_t slot)
+{
+    return (slot == VM_GREETING) ? 0 : store->greeting_size + (uint32_t)(slot - 1) * store->slot_size;
+}
+
+static uint32_t slot_capacity(const vm_store_t *store, uint8_t slot)
+{
+    return ((slot == VM_GREETING) ? store->greeting_size : store->slot_size) - VM_HEADER_SIZE;
+}
+
+bool vm_header_valid(const vm_store_t *store, uint8_t slot, const vm_header_t *hdr)
+{
+    return hdr->magic == VM_HEADER_MAGIC &&
+           hdr->length <= slot_capacity(store, slot) &&
+           hdr->crc == header_crc(hdr);
+}
+
+int vm_store_mount(vm_store_t *store, const vm_flash_t *flash,
+                   uint32_t greeting_size, uint32_t slot_size)
+{
+    if (greeting_size < VM_SECTOR_SIZE || greeting_size % VM_SECTOR_SIZE != 0 ||
+        slot_size < VM_SECTOR_SIZE || slot_size % VM_SECTOR_SIZE != 0 ||
+        flash->size < greeting_size + slot_size) {
+        return -1;
+    }
+
+    memset(store, 0, sizeof(*store));
+    store->flash = *flash;
+    store->greeting_size = greeting_size;
+    store->slot_size = slot_size;
+    uint32_t fit = (flash->size - greeting_size) / slot_size;
+    store->slot_count = (fit > VM_MAX_SLOTS) ? VM_MAX_SLOTS : (uint8_t)fit;
+    store->next_seq = 1;
+
+    for (uint8_t slot = 0; slot <= store->slot_count; slot++) {
+        vm_header_t hdr;
+        if (flash->read(flash->ctx, slot_base(store, slot), &hdr, sizeof(hdr)) != 0) {
+            return -1;
+        }
+        if (!vm_header_valid(store, slot, &hdr)) {
+            continue;
+        }
+        store->slots[slot] = hdr;
+        if (slot != VM_GREETING && hdr.seq >= store->next_seq) {
+            store->next_seq = hdr.seq + 1;
+        }
+    }
+
+    return 0;
+}
+
+bool vm_store_live(const vm_store_t *store, uint8_t slot)
+{
+    return slot <= store->slot_count &&
+           store->slots[slot].magic == VM_HEADER_MAGIC &&
+           (store->slots[slot].flags & VM_FLAG_LIVE);
+}
+
+uint8_t vm_store_pick(const vm_store_t *store)
+{
+    uint8_t oldest = 1;
+
+    for (uint8_t slot = 1; slot <= store->slot_count; slot++) {
+        if (!vm_store_live(store, slot)) {
+            return slot;
+        }
+        if (store->slots[slot].seq < store->slots[oldest].seq) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+int vm_store_make_room(vm_store_t *store)
+{
+    if (store->slot_count < 2) {
+        return 0;
+    }
+
+    uint8_t oldest = vm_store_pick(store);
+    if (!vm_store_live(store, oldest)) {
+        return 0;
+    }
+    if (vm_store_clear_flags(store, oldest, VM_FLAG_LIVE) != 0) {
+        return -1;
+    }
+    return oldest;
+}
+
+void vm_store_begin(const vm_store_t *store, uint8_t slot, vm_writer_t *w)
+{
+    w->slot = slot;
+    w->length = 0;
+    w->capacity = slot_capacity(store, slot);
+    w->erased = 0;
+}
+
+int vm_store_write(vm_store_t *store, vm_writer_t *w, const void *data, size_t len)
+{
+    const vm_flash_t *flash = &store->flash;
+    uint32_t base = slot_base(store, w->slot);
+
+    if (len > w->capacity - w->length) {
+        len = w->capacity - w->length;
+    }
+
+    // Erase ahead of the audio; the header goes in the first sector
+    uint32_t end = VM_HEADER_SIZE + w->length + (uint32_t)len;
+    while (w->erased < end) {
+        if (flash->erase(flash->ctx, base + w->erased, VM_SECTOR_SIZE) != 0) {
+            return -1;
+        }
+        if (w->erased == 0) {
+            memset(&store->slots[w->slot], 0, sizeof(vm_header_t));
+        }
+        w->erased += VM_SECTOR_SIZE;
+    }
+
+    if (len > 0 &&
+        flash->write(flash->ctx, base + VM_HEADER_SIZE + w->length, data, len) != 0) {
+        return -1;
+    }
+    w->length += (uint32_t)len;
+    return (int)len;
+}
+
+int vm_store_finish(vm_store_t *store, const vm_writer_t *w, uint32_t start, const char *number)
+{
+    if (w->length == 0) {
+        return 0;
+    }
+
+    vm_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.flags = 0xFF;
+    hdr.reserved = 0xFF;
+    hdr.magic = VM_HEADER_MAGIC;
+    hdr.seq = (w->slot == VM_GREETING) ? 0 : store->next_seq;
+    hdr.start = start;
+    hdr.length = w->length;
+    if (number != NULL) {
+        strncpy(hdr.number, number, sizeof(hdr.number) - 1);
+    }
+    hdr.crc = header_crc(&hdr);
+
+    const vm_flash_t *flash = &store->flash;
+    if (flash->write(flash->ctx, slot_base(store, w->slot), &hdr, sizeof(hdr)) != 0) {
+        return -1;
+    }
+    store->slots[w->slot] = hdr;
+    if (w->slot != VM_GREETING) {
+        store->next_seq++;
+    }
+    return 0;
+}
+
+int vm_store_read(const vm_store_t *store, uint8_t slot, uint32_t offset, void *dst, size_t len)
+{
+    if (!vm_store_live(store, slot) || offset >= store->slots[slot].length) {
+        return 0;
+    }
+    if (len > store->slots[slot].length - offset) {
+        len = store->slots[slot].length - offset;
+    }
+
+    const vm_flash_t *flash = &store->flash;
+    if (flash->read(flash->ctx, slot_base(store, slot) + VM_HEADER_SIZE + offset, dst, len) != 0) {
+        return -1;
+    }
+    return (int)len;
+}
+
+int vm_store_clear_flags(vm_store_t *store, uint8_t slot, uint8_t clear)
+{
+    if (!vm_store_live(store, slot)) {
+        return -1;
+    }
+
+    uint8_t flags = store->slots[slot].flags & ~clear;
+    if (flags == store->slots[slot].flags) {
+        return 0;
+    }
+
+    const vm_flash_t *flash = &store->flash;
+    if (flash->write(flash->ctx, slot_base(store, slot), &flags, 1) != 0) {
+        return -1;
+    }
+    store->slots[slot].flags = flags;
+    return 0;
+}
+
+size_t vm_store_list(const vm_store_t *store, uint8_t *out, size_t max)
+{
+    uint8_t sorted[VM_MAX_SLOTS];
+    size_t count = 0;
+
+    // Insertion sort by sequence number; there are only a handful
+    for (uint8_t slot = 1; slot <= store->slot_count; slot++) {
+        if (!vm_store_live(store, slot)) {
+            continue;
+        }
+        size_t i = count++;
+        while (i > 0 && store->slots[sorted[i - 1]].seq > store->slots[slot].seq) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+        sorted[i] = slot;
+    }
+
+    if (count > max) {
+        count = max;
+    }
+    memcpy(out, sorted, count);
+    return count;
+}
+
+size_t vm_store_count(const vm_store_t *store, uint8_t flags)
+{
+    size_t count = 0;
+
+    for (uint8_t slot = 1; slot <= store->slot_count; slot++) {
+        if (vm_store_live(store, slot) && (store->slots[slot].flags & flags) == flags) {
+            count++;
+        }
+    }
+    return count;
+}
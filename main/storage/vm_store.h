@@ -0,0 +1,191 @@
+#ifndef __VM_STORE_H__
+#define __VM_STORE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @file vm_store.h
+ * @brief Fixed slots of recorded audio for the answering machine
+ *
+ * Pure integer code with no ESP-IDF dependencies; flash access goes through
+ * the callbacks in vm_flash_t, so the store can be exercised off-target
+ * against a RAM image.
+ *
+ * The area is cut into a greeting slot followed by equal message slots.
+ * Each slot starts with a 64-byte header and the audio follows it. A
+ * recording erases its slot's sectors only as the audio reaches them, and
+ * the header is written last, so a recording cut short by a power loss
+ * leaves an empty slot and an abandoned one leaves the old message intact.
+ * Headers carry a sequence number. A new message takes an empty slot, and
+ * vm_store_make_room() keeps one slot empty by retiring the oldest message
+ * once the others are full. The first write of a recording therefore never
+ * lands on a message that is still live, so a caller who hangs up too soon
+ * costs nothing.
+ *
+ * The flags byte sits outside the CRC. Its bits start out set and are
+ * cleared by programming in place, so marking a message heard or deleted
+ * never needs an erase.
+ */
+
+#define VM_SECTOR_SIZE      4096
+#define VM_HEADER_SIZE      64
+#define VM_HEADER_MAGIC     0x564D
+#define VM_NUMBER_LEN       44      // Number field, NUL padded
+#define VM_MAX_SLOTS        16      // Message slots, the greeting not counted
+#define VM_GREETING         0       // Slot number of the greeting
+
+#define VM_FLAG_NEW         0x01    // Cleared once the message has been played
+#define VM_FLAG_LIVE        0x02    // Cleared when the message is deleted
+
+/**
+ * @brief Slot header, as stored in flash (little endian)
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t flags;              // VM_FLAG_*, not covered by the CRC
+    uint8_t reserved;
+    uint16_t magic;             // VM_HEADER_MAGIC
+    uint32_t seq;               // Recording order, 0 for the greeting
+    uint32_t start;             // Unix time the call was answered, 0 if the clock was unset
+    uint32_t length;            // Bytes of audio after the header
+    char number[VM_NUMBER_LEN]; // Caller, empty if unknown or withheld
+    uint32_t crc;               // CRC-32 from magic up to here
+} vm_header_t;
+
+_Static_assert(sizeof(vm_header_t) == VM_HEADER_SIZE, "Slot header must stay 64 bytes");
+
+/**
+ * @brief Flash access for the store; offsets are relative to its start
+ *
+ * Each callback returns 0 on success.
+ */
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *dst, size_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *src, size_t len);
+    int (*erase)(void *ctx, uint32_t offset, size_t len);   // Whole sectors
+    void *ctx;
+    uint32_t size;
+} vm_flash_t;
+
+/**
+ * @brief Mounted store
+ */
+typedef struct {
+    vm_flash_t flash;
+    uint32_t greeting_size;     // Bytes for slot 0, header included
+    uint32_t slot_size;         // Bytes per message slot, header included
+    uint8_t slot_count;         // Message slots, numbered from 1
+    uint32_t next_seq;
+    vm_header_t slots[VM_MAX_SLOTS + 1];    // Headers as on flash, zeroed when empty
+} vm_store_t;
+
+/**
+ * @brief Recording in progress
+ */
+typedef struct {
+    uint8_t slot;
+    uint32_t length;            // Audio bytes written so far
+    uint32_t capacity;          // Audio bytes the slot holds
+    uint32_t erased;            // Slot bytes erased so far
+} vm_writer_t;
+
+/**
+ * @brief Read every slot header
+ *
+ * @param greeting_size Bytes for the greeting, a multiple of VM_SECTOR_SIZE
+ * @param slot_size Bytes per message, a multiple of VM_SECTOR_SIZE; as many
+ *        as fit after the greeting are used, up to VM_MAX_SLOTS
+ * @return 0 on success, -1 on a bad geometry or read error
+ */
+int vm_store_mount(vm_store_t *store, const vm_flash_t *flash,
+                   uint32_t greeting_size, uint32_t slot_size);
+
+/**
+ * @brief Pick the slot for a new message: an empty one, else the oldest
+ *
+ * The oldest is only returned if vm_store_make_room() could not retire a
+ * message, or the store has a single message slot.
+ */
+uint8_t vm_store_pick(const vm_store_t *store);
+
+/**
+ * @brief Keep one message slot empty for the next recording
+ *
+ * If every message slot is live, the oldest message is deleted by clearing
+ * its VM_FLAG_LIVE bit. Does nothing with a single message slot.
+ *
+ * @return Slot retired, 0 if a slot was already empty, -1 on a write error
+ */
+int vm_store_make_room(vm_store_t *store);
+
+/**
+ * @brief Start recording into a slot
+ *
+ * Nothing is erased until the first write.
+ */
+void vm_store_begin(const vm_store_t *store, uint8_t slot, vm_writer_t *w);
+
+/**
+ * @brief Append audio, erasing sectors as they are reached
+ *
+ * The slot's previous contents are gone from the first write on.
+ *
+ * @return Bytes written, less than len once the slot is full, or -1 if a
+ *         flash operation failed
+ */
+int vm_store_write(vm_store_t *store, vm_writer_t *w, const void *data, size_t len);
+
+/**
+ * @brief Write the header, making the recording visible
+ *
+ * A recording with no audio is dropped.
+ *
+ * @param start Unix time for the header, 0 if unknown
+ * @param number Caller, NULL or "" if unknown
+ * @return 0 on success, -1 if the header could not be written
+ */
+int vm_store_finish(vm_store_t *store, const vm_writer_t *w, uint32_t start, const char *number);
+
+/**
+ * @brief Read audio from a slot
+ *
+ * @return Bytes read, 0 past the end, -1 on a read error
+ */
+int vm_store_read(const vm_store_t *store, uint8_t slot, uint32_t offset, void *dst, size_t len);
+
+/**
+ * @brief Clear flag bits in a slot header in place
+ *
+ * @param clear VM_FLAG_* bits to clear
+ * @return 0 on success, -1 on a bad slot or write error
+ */
+int vm_store_clear_flags(vm_store_t *store, uint8_t slot, uint8_t clear);
+
+/**
+ * @brief Whether a slot holds a recording that has not been deleted
+ */
+bool vm_store_live(const vm_store_t *store, uint8_t slot);
+
+/**
+ * @brief List live messages, oldest first
+ *
+ * @param out Slot numbers
+ * @param max Room in out
+ * @return Number of slots listed
+ */
+size_t vm_store_list(const vm_store_t *store, uint8_t *out, size_t max);
+
+/**
+ * @brief Count live messages with all the given flag bits still set
+ *
+ * @param flags VM_FLAG_NEW for unheard messages, 0 for all
+ */
+size_t vm_store_count(const vm_store_t *store, uint8_t flags);
+
+/**
+ * @brief Check magic, CRC and length of a header read back from flash
+ */
+bool vm_header_valid(const vm_store_t *store, uint8_t slot, const vm_header_t *hdr);
+
+#endif /* __VM_STORE_H__ */
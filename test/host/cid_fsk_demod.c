@@ -0,0 +1,112 @@
+#include "cid_fsk_demod.h"
+#include "audio/caller_id_fsk.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define BAUD                1200
+#define MARK_HZ             1200
+#define SPACE_HZ            2200
+#define SAMPLES_PER_BIT     ((double)CID_SAMPLE_RATE / BAUD)
+#define HALF_WINDOW         3       // Correlate over 7 samples, about one bit
+#define MIN_MARK_BITS       20      // Mark run that ends the channel seizure
+
+// Energy of one tone over the window centred on sample n
+static double tone_energy(const int16_t *pcm, size_t samples, size_t n, double hz)
+{
+    double i_sum = 0;
+    double q_sum = 0;
+
+    for (long k = (long)n - HALF_WINDOW; k <= (long)n + HALF_WINDOW; k++) {
+        if (k < 0 || k >= (long)samples) {
+            continue;
+        }
+        double angle = 2 * M_PI * hz * k / CID_SAMPLE_RATE;
+        i_sum += pcm[k] * cos(angle);
+        q_sum += pcm[k] * sin(angle);
+    }
+    return i_sum * i_sum + q_sum * q_sum;
+}
+
+// 1 for mark, 0 for space, per sample
+static uint8_t *slice(const int16_t *pcm, size_t samples)
+{
+    uint8_t *bits = malloc(samples);
+
+    for (size_t n = 0; bits != NULL && n < samples; n++) {
+        bits[n] = tone_energy(pcm, samples, n, MARK_HZ) >= tone_energy(pcm, samples, n, SPACE_HZ);
+    }
+    return bits;
+}
+
+// Level at the middle of bit k after a start edge at sample edge
+static int bit_at(const uint8_t *bits, size_t samples, size_t edge, int k)
+{
+    size_t n = edge + (size_t)((k + 0.5) * SAMPLES_PER_BIT);
+    return (n < samples) ? bits[n] : -1;
+}
+
+size_t cid_fsk_demodulate(const int16_t *pcm, size_t samples, uint8_t *msg, size_t size,
+                          cid_demod_result_t *result)
+{
+    uint8_t *bits = slice(pcm, samples);
+    cid_demod_result_t found = { 0 };
+    size_t len = 0;
+    size_t want = 2;    // Type and length, until the length is known
+    size_t n = 0;
+
+    if (bits == NULL) {
+        return 0;
+    }
+
+    // Channel seizure alternates every bit; the message follows a run of mark
+    size_t run_start = 0;
+    bool in_run = false;
+    for (; n < samples; n++) {
+        if (bits[n] && !in_run) {
+            run_start = n;
+            in_run = true;
+        } else if (!bits[n] && in_run) {
+            in_run = false;
+            if (n - run_start >= MIN_MARK_BITS * SAMPLES_PER_BIT) {
+                found.mark_bits = (uint32_t)((n - run_start) / SAMPLES_PER_BIT + 0.5);
+                break;
+            }
+        }
+    }
+
+    // n is now the start edge of the first byte
+    while (n < samples && len < want && len < size) {
+        uint8_t byte = 0;
+
+        if (bit_at(bits, samples, n, 0) != 0) {
+            break;      // Not a start bit after all
+        }
+        for (int k = 1; k <= 8; k++) {
+            int bit = bit_at(bits, samples, n, k);
+            if (bit < 0) {
+                break;
+            }
+            byte |= (uint8_t)(bit << (k - 1));
+        }
+        if (bit_at(bits, samples, n, 9) != 1) {
+            found.framing_errors++;
+        }
+        msg[len++] = byte;
+        if (len == 2) {
+            want = 2 + (size_t)msg[1] + 1;
+        }
+
+        // Next start edge: the first space after the middle of the stop bit
+        n += (size_t)(9.5 * SAMPLES_PER_BIT);
+        while (n < samples && bits[n]) {
+            n++;
+        }
+    }
+
+    free(bits);
+    if (result != NULL) {
+        *result = found;
+    }
+    return (len == want) ? len : 0;
+}
@@ -0,0 +1,41 @@
+#ifndef __CID_FSK_DEMOD_H__
+#define __CID_FSK_DEMOD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file cid_fsk_demod.h
+ * @brief Bell 202 FSK receiver for checking the Caller ID modulator
+ *
+ * Works the way a Caller ID display does: each sample is classed as mark or
+ * space by correlating one bit time of signal against both tones, the
+ * channel seizure is skipped by waiting for a run of mark, and bytes are
+ * then read asynchronously, each timed from the edge of its start bit.
+ */
+
+/**
+ * @brief What the receiver found
+ */
+typedef struct {
+    uint32_t mark_bits;     // Length of the mark run before the first byte, in bits
+    size_t framing_errors;  // Bytes with a missing stop bit
+} cid_demod_result_t;
+
+/**
+ * @brief Demodulate a burst
+ *
+ * Reads the message type, the length byte and as many bytes again as the
+ * length gives, plus the checksum.
+ *
+ * @param pcm 16-bit PCM at CID_SAMPLE_RATE
+ * @param samples Number of samples
+ * @param msg Destination for the message bytes
+ * @param size Size of msg
+ * @param result Receiver details, may be NULL
+ * @return Message length including the checksum, 0 if no message was found
+ */
+size_t cid_fsk_demodulate(const int16_t *pcm, size_t samples, uint8_t *msg, size_t size,
+                          cid_demod_result_t *result);
+
+#endif /* __CID_FSK_DEMOD_H__ */
@@ -0,0 +1,10 @@
+// Host stand-in for the ESP-IDF header of the same name
+#ifndef __HOST_ESP_GAP_BT_API_H__
+#define __HOST_ESP_GAP_BT_API_H__
+
+#include <stdint.h>
+
+#define ESP_BD_ADDR_LEN 6
+typedef uint8_t esp_bd_addr_t[ESP_BD_ADDR_LEN];
+
+#endif /* __HOST_ESP_GAP_BT_API_H__ */
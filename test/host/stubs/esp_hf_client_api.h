@@ -0,0 +1,27 @@
+// Host stand-in for the ESP-IDF header of the same name. Only the commands
+// call control sends are declared; tests define them to record each call.
+#ifndef __HOST_ESP_HF_CLIENT_API_H__
+#define __HOST_ESP_HF_CLIENT_API_H__
+
+#include "esp_err.h"
+#include "esp_gap_bt_api.h"
+
+typedef enum {
+    ESP_HF_CHLD_TYPE_REL = 0,
+    ESP_HF_CHLD_TYPE_REL_ACC,
+    ESP_HF_CHLD_TYPE_HOLD_ACC,
+    ESP_HF_CHLD_TYPE_MERGE,
+    ESP_HF_CHLD_TYPE_MERGE_ACC,
+    ESP_HF_CHLD_TYPE_PRIV_X,
+    ESP_HF_CHLD_TYPE_REL_X,
+} esp_hf_chld_type_t;
+
+typedef int esp_hf_client_cb_event_t;
+typedef union { int unused; } esp_hf_client_cb_param_t;
+
+esp_err_t esp_hf_client_answer_call(void);
+esp_err_t esp_hf_client_reject_call(void);
+esp_err_t esp_hf_client_dial(const char *number);
+esp_err_t esp_hf_client_send_chld_cmd(esp_hf_chld_type_t chld, int idx);
+
+#endif /* __HOST_ESP_HF_CLIENT_API_H__ */
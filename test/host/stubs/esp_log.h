@@ -0,0 +1,17 @@
+// Host stand-in for the ESP-IDF header of the same name: errors and warnings
+// go to stderr, the rest is compiled (so formats are still checked) but dropped
+#ifndef __HOST_ESP_LOG_H__
+#define __HOST_ESP_LOG_H__
+
+#include <stdio.h>
+
+#define HOST_LOG(show, tag, fmt, ...) \
+    do { if (show) fprintf(stderr, "%s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG(1, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG(1, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG(0, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG(0, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG(0, tag, fmt, ##__VA_ARGS__)
+
+#endif /* __HOST_ESP_LOG_H__ */
@@ -0,0 +1,10 @@
+// Host stand-in for the FreeRTOS header of the same name
+#ifndef __HOST_FREERTOS_EVENT_GROUPS_H__
+#define __HOST_FREERTOS_EVENT_GROUPS_H__
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+#endif /* __HOST_FREERTOS_EVENT_GROUPS_H__ */
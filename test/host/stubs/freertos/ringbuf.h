@@ -0,0 +1,9 @@
+// Host stand-in for the ESP-IDF header of the same name
+#ifndef __HOST_FREERTOS_RINGBUF_H__
+#define __HOST_FREERTOS_RINGBUF_H__
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *RingbufHandle_t;
+
+#endif /* __HOST_FREERTOS_RINGBUF_H__ */
@@ -0,0 +1,9 @@
+// Host stand-in for the FreeRTOS header of the same name
+#ifndef __HOST_FREERTOS_TASK_H__
+#define __HOST_FREERTOS_TASK_H__
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+
+#endif /* __HOST_FREERTOS_TASK_H__ */
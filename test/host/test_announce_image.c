@@ -0,0 +1,307 @@
+// Keeps tools/pack_announcements.py and the firmware's image reader in step.
+//
+//     test_announce_image inputs <dir>
+//         writes the test recordings as 8 kHz 16-bit mono WAVs
+//     test_announce_image check <image> <extract dir>
+//         checks an image packed from them with --no-trim --no-normalize,
+//         and the clips "verify --extract" decoded from it
+//
+// CTest runs the packer between the two. With trimming and normalizing off
+// the packer encodes the recordings as they are, so ima_adpcm.c must produce
+// the same bytes from them, and must decode those bytes to the same samples
+// the packer does. The directory is read only through announce_image.c.
+
+#include "audio/announce_image.h"
+#include "audio/ima_adpcm.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_RATE     8000
+
+typedef struct {
+    const char *name;
+    size_t samples;
+    double hz;
+} recording_t;
+
+// Odd lengths are padded by the packer; the 15-character name fills the field
+static const recording_t recordings[] = {
+    { "intercept", 4001, 950 },
+    { "pm", 800, 1400 },
+    { "n_15", 12000, 440 },
+    { "abcdefghijklmno", 64, 2000 },
+};
+
+#define RECORDINGS  (sizeof(recordings) / sizeof(recordings[0]))
+
+static int failures;
+
+#define CHECK(cond, ...) do {                               \
+    if (!(cond)) {                                          \
+        printf("  FAIL %s:%d: ", __FILE__, __LINE__);       \
+        printf(__VA_ARGS__);                                \
+        printf("\n");                                       \
+        failures++;                                         \
+    }                                                       \
+} while (0)
+
+// A tone with a slow swell and a little noise, so every step size is used
+static int16_t *synthesize(const recording_t *rec)
+{
+    int16_t *pcm = malloc(rec->samples * sizeof(*pcm));
+    uint32_t noise = 12345;
+
+    for (size_t i = 0; i < rec->samples; i++) {
+        noise = noise * 1103515245 + 12345;
+        double swell = 0.1 + 0.8 * sin(M_PI * i / rec->samples);
+        double v = 30000 * swell * sin(2 * M_PI * rec->hz * i / SAMPLE_RATE);
+        pcm[i] = (int16_t)(v + (int)((noise >> 16) % 512) - 256);
+    }
+    return pcm;
+}
+
+static void put_u16(FILE *f, uint16_t v)
+{
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void put_u32(FILE *f, uint32_t v)
+{
+    put_u16(f, v & 0xFFFF);
+    put_u16(f, v >> 16);
+}
+
+static int write_wav(const char *path, const int16_t *pcm, size_t samples)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    uint32_t bytes = (uint32_t)(samples * 2);
+    fwrite("RIFF", 1, 4, f);
+    put_u32(f, 36 + bytes);
+    fwrite("WAVEfmt ", 1, 8, f);
+    put_u32(f, 16);
+    put_u16(f, 1);                  // PCM
+    put_u16(f, 1);                  // Mono
+    put_u32(f, SAMPLE_RATE);
+    put_u32(f, SAMPLE_RATE * 2);
+    put_u16(f, 2);
+    put_u16(f, 16);
+    fwrite("data", 1, 4, f);
+    put_u32(f, bytes);
+    for (size_t i = 0; i < samples; i++) {
+        put_u16(f, (uint16_t)pcm[i]);
+    }
+    return fclose(f);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // Word aligned, as the mapped partition is
+    uint8_t *buf = aligned_alloc(4, (*len + 3) & ~(size_t)3);
+    if (buf != NULL && fread(buf, 1, *len, f) != *len) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+// Samples of a 16-bit PCM WAV; the data chunk is found by walking the chunks
+static int16_t *read_wav(const char *path, size_t *samples)
+{
+    size_t len;
+    uint8_t *file = read_file(path, &len);
+    int16_t *pcm = NULL;
+
+    for (size_t pos = 12; file != NULL && pos + 8 <= len; ) {
+        uint32_t size = file[pos + 4] | file[pos + 5] << 8 | file[pos + 6] << 16 |
+                        (uint32_t)file[pos + 7] << 24;
+        if (memcmp(file + pos, "data", 4) == 0 && pos + 8 + size <= len) {
+            *samples = size / 2;
+            pcm = malloc(size + 2);
+            for (size_t i = 0; i < *samples; i++) {
+                pcm[i] = (int16_t)(file[pos + 8 + 2 * i] | file[pos + 9 + 2 * i] << 8);
+            }
+            break;
+        }
+        pos += 8 + size + (size & 1);
+    }
+    free(file);
+    return pcm;
+}
+
+static int write_inputs(const char *dir)
+{
+    for (size_t r = 0; r < RECORDINGS; r++) {
+        char path[512];
+        int16_t *pcm = synthesize(&recordings[r]);
+        snprintf(path, sizeof(path), "%s/%s.wav", dir, recordings[r].name);
+        int ret = write_wav(path, pcm, recordings[r].samples);
+        free(pcm);
+        if (ret != 0) {
+            printf("cannot write %s\n", path);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void check_clip(const announce_image_t *img, const recording_t *rec, const char *extract)
+{
+    const announce_image_entry_t *entry = announce_image_find(img, rec->name);
+
+    printf("%s\n", rec->name);
+    CHECK(entry != NULL, "not found");
+    if (entry == NULL) {
+        return;
+    }
+    const uint8_t *data = announce_image_data(img, entry);
+    CHECK(entry->format == ANNOUNCE_FORMAT_IMA_ADPCM, "format %u", entry->format);
+    CHECK(entry->offset % 4 == 0, "clip at %u is not word aligned", (unsigned)entry->offset);
+    CHECK(data == img->base + entry->offset, "data is not read in place");
+    CHECK(announce_image_check_clip(img, entry), "clip CRC");
+
+    // The packer pads an odd recording with a silent sample
+    size_t even = (rec->samples + 1) & ~(size_t)1;
+    int16_t *pcm = calloc(even, sizeof(*pcm));
+    int16_t *input = synthesize(rec);
+    memcpy(pcm, input, rec->samples * sizeof(*pcm));
+    free(input);
+
+    uint8_t *adpcm = malloc(even / 2);
+    ima_adpcm_state_t st;
+    ima_adpcm_init(&st);
+    size_t bytes = ima_adpcm_encode(&st, pcm, even, adpcm);
+    CHECK(entry->length == bytes, "clip is %u bytes, %zu samples encode to %zu",
+          (unsigned)entry->length, rec->samples, bytes);
+    if (entry->length == bytes) {
+        size_t first = 0;
+        while (first < bytes && adpcm[first] == data[first]) {
+            first++;
+        }
+        CHECK(first == bytes, "packer and ima_adpcm.c encode byte %zu differently", first);
+    }
+
+    char path[512];
+    size_t ref_samples = 0;
+    snprintf(path, sizeof(path), "%s/%s.wav", extract, rec->name);
+    int16_t *ref = read_wav(path, &ref_samples);
+    CHECK(ref != NULL, "no %s", path);
+    if (ref != NULL) {
+        int16_t *decoded = malloc(entry->length * 2 * sizeof(*decoded));
+        ima_adpcm_init(&st);
+        size_t n = ima_adpcm_decode(&st, data, entry->length, decoded);
+        CHECK(n == ref_samples, "decoded %zu samples, packer %zu", n, ref_samples);
+        if (n == ref_samples) {
+            size_t first = 0;
+            while (first < n && decoded[first] == ref[first]) {
+                first++;
+            }
+            CHECK(first == n, "packer and ima_adpcm.c decode sample %zu differently", first);
+        }
+        free(decoded);
+        free(ref);
+    }
+    free(adpcm);
+    free(pcm);
+}
+
+// The reader must refuse what the packer's verify refuses
+static void check_damage(const uint8_t *image, size_t len)
+{
+    announce_image_t img;
+    uint8_t *copy = aligned_alloc(4, (len + 3) & ~(size_t)3);
+
+    printf("damage\n");
+    memcpy(copy, image, len);
+    copy[sizeof(announce_image_header_t) + ANNOUNCE_NAME_LEN] ^= 0x04;   // First entry's offset
+    CHECK(announce_image_open(&img, copy, (uint32_t)len) != 0, "bad directory opened");
+
+    memcpy(copy, image, len);
+    copy[4] = ANNOUNCE_IMAGE_VERSION + 1;
+    CHECK(announce_image_open(&img, copy, (uint32_t)len) != 0, "unknown version opened");
+
+    memcpy(copy, image, len);
+    copy[0] ^= 0xFF;
+    CHECK(announce_image_open(&img, copy, (uint32_t)len) != 0, "bad magic opened");
+
+    CHECK(announce_image_open(&img, image, (uint32_t)len - 1) != 0, "truncated image opened");
+
+    // A damaged clip leaves the image usable, only that clip fails its CRC
+    memcpy(copy, image, len);
+    CHECK(announce_image_open(&img, copy, (uint32_t)len) == 0, "copy does not open");
+    const announce_image_entry_t *entry = announce_image_find(&img, recordings[0].name);
+    const announce_image_entry_t *other = announce_image_find(&img, recordings[1].name);
+    copy[entry->offset + entry->length / 2] ^= 0x10;
+    CHECK(!announce_image_check_clip(&img, entry), "damaged clip passed its CRC");
+    CHECK(announce_image_check_clip(&img, other), "undamaged clip failed its CRC");
+    free(copy);
+}
+
+static int check_image(const char *path, const char *extract)
+{
+    size_t len;
+    uint8_t *image = read_file(path, &len);
+    announce_image_t img;
+
+    if (image == NULL) {
+        printf("cannot read %s\n", path);
+        return 1;
+    }
+    CHECK(announce_image_open(&img, image, (uint32_t)len) == 0, "image does not open");
+    if (failures) {
+        free(image);
+        return 1;
+    }
+    CHECK(img.count == RECORDINGS, "%u clips, %zu recordings", img.count, RECORDINGS);
+    CHECK(img.size == len, "image is %u bytes, file %zu", (unsigned)img.size, len);
+
+    // A partition larger than the image is fine
+    announce_image_t roomy;
+    uint8_t *padded = aligned_alloc(4, len + 4096);
+    memcpy(padded, image, len);
+    memset(padded + len, 0xFF, 4096);
+    CHECK(announce_image_open(&roomy, padded, (uint32_t)len + 4096) == 0, "padded image");
+    free(padded);
+
+    for (size_t r = 0; r < RECORDINGS; r++) {
+        check_clip(&img, &recordings[r], extract);
+    }
+    CHECK(announce_image_find(&img, "nope") == NULL, "found a clip that was never packed");
+    CHECK(announce_image_find(&img, "n_1") == NULL, "\"n_1\" matched \"n_15\"");
+    CHECK(announce_image_find(&img, "abcdefghijklmnop") == NULL, "name longer than the field");
+
+    check_damage(image, len);
+    free(image);
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 3 && strcmp(argv[1], "inputs") == 0) {
+        return write_inputs(argv[2]);
+    }
+    if (argc == 4 && strcmp(argv[1], "check") == 0) {
+        return check_image(argv[2], argv[3]);
+    }
+    printf("usage: %s inputs <dir> | check <image> <extract dir>\n", argv[0]);
+    return 2;
+}
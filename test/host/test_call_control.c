@@ -0,0 +1,434 @@
+// Replays HFP and handset event traces through the call-control table.
+//
+// call_control.c is built unchanged against the host stubs; everything it
+// calls is faked here and records what it did. Each trace line is
+//
+//     <event> <state> [<effect> ...]
+//
+// where <event> is a call_control_event_name(), <state> the state expected
+// afterwards and the effects are, in order, what the transition must do:
+//
+//     +bit / -bit      state bit set or cleared (off_hook, ringing, waiting,
+//                      in_call, audio)
+//     hf:answer        ATA
+//     hf:chup          AT+CHUP
+//     hf:dial=<n>      ATD<n>
+//     hf:chld=<n>      AT+CHLD=<n>
+//     sco:open         SCO link requested
+//     sco:release      SCO link released
+//     cut:cold/warm    cut-through clock started
+//     timer:<name>     timer armed
+//     voicemail        handset code taken by voicemail
+//     announce         handset code taken by announcements
+//     publish:<event>  event published once the lock is dropped
+//
+// No effects means none are allowed. Lines starting with '@' set up the fakes
+// for the lines that follow:
+//
+//     @number <digits>       digits the dialer holds (the last one is also
+//                            the last digit dialed)
+//     @speed <code> <number> a phonebook speed-dial entry
+//     @audio up|down         SCO link already up when the line is replayed
+//
+// off_hook and on_hook also move the hook bit first, as the SLIC does before
+// it publishes them.
+
+#include "app/call/call_control.h"
+#include "app/state/ma_bell_state.h"
+#include "app/events/event_system.h"
+#include "audio/audio_bridge.h"
+#include "bluetooth/bt_app_hf.h"
+#include "app/call/dialer.h"
+#include "app/call/phonebook.h"
+#include "app/call/voicemail.h"
+#include "app/call/announce.h"
+#include "config/call_config.h"
+#include "esp_hf_client_api.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_LINE 512
+
+static char effects[MAX_LINE];
+
+static void effect(const char *fmt, ...)
+{
+    size_t len = strlen(effects);
+    va_list ap;
+
+    if (len > 0 && len < sizeof(effects) - 1) {
+        effects[len++] = ' ';
+        effects[len] = '\0';
+    }
+    va_start(ap, fmt);
+    vsnprintf(effects + len, sizeof(effects) - len, fmt, ap);
+    va_end(ap);
+}
+
+// ---- ma_bell_state ----
+
+static uint8_t phone_bits;
+static uint8_t bt_bits;
+
+static const struct {
+    uint8_t *bits;
+    uint8_t mask;
+    const char *name;
+} bit_names[] = {
+    { &phone_bits, PHONE_STATE_OFF_HOOK,     "off_hook" },
+    { &phone_bits, PHONE_STATE_RINGING,      "ringing" },
+    { &phone_bits, PHONE_STATE_CALL_WAITING, "waiting" },
+    { &bt_bits,    BT_STATE_IN_CALL,         "in_call" },
+    { &bt_bits,    BT_STATE_AUDIO_CONNECTED, "audio" },
+};
+
+static void update_bits(uint8_t *bits, uint8_t set, uint8_t clear)
+{
+    uint8_t next = (*bits & ~clear) | set;
+
+    for (size_t i = 0; i < sizeof(bit_names) / sizeof(bit_names[0]); i++) {
+        if (bit_names[i].bits != bits || ((*bits ^ next) & bit_names[i].mask) == 0) {
+            continue;
+        }
+        effect("%c%s", (next & bit_names[i].mask) ? '+' : '-', bit_names[i].name);
+    }
+    *bits = next;
+}
+
+void ma_bell_state_update_phone_bits(uint8_t set_bits, uint8_t clear_bits, ma_bell_state_cause_t cause)
+{
+    update_bits(&phone_bits, set_bits, clear_bits);
+}
+
+void ma_bell_state_update_call_bits(uint8_t phone_set, uint8_t phone_clear,
+                                   uint8_t bt_set, uint8_t bt_clear,
+                                   ma_bell_state_cause_t cause)
+{
+    update_bits(&phone_bits, phone_set, phone_clear);
+    update_bits(&bt_bits, bt_set, bt_clear);
+}
+
+int ma_bell_state_phone_bits_set(uint8_t bits)
+{
+    return (phone_bits & bits) == bits;
+}
+
+bool ma_bell_state_has_held_call(void)
+{
+    return false;
+}
+
+int ma_bell_state_bluetooth_bits_set(uint8_t bits)
+{
+    return (bt_bits & bits) == bits;
+}
+
+// ---- event_system ----
+
+static const char *published_names[32] = {
+    [0] = "off_hook", [1] = "on_hook", [2] = "ringing_start", [3] = "ringing_stop",
+    [4] = "digit", [9] = "call_started", [10] = "call_ended", [16] = "call_dialing",
+    [17] = "call_alerting", [18] = "call_busy", [19] = "call_failed",
+    [22] = "waiting_start", [23] = "waiting_stop", [24] = "recall_start",
+    [25] = "recall_end", [26] = "voicemail_start", [27] = "voicemail_end",
+    [28] = "announce_start", [29] = "announce_end",
+};
+
+esp_err_t event_publish(event_type_t event, void *event_data)
+{
+    for (int bit = 0; bit < 32; bit++) {
+        if ((uint32_t)event & (1u << bit)) {
+            if (published_names[bit] != NULL) {
+                effect("publish:%s", published_names[bit]);
+            } else {
+                effect("publish:bit%d", bit);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t event_subscribe(event_type_t events, event_callback_t callback, void *user_data)
+{
+    return ESP_OK;
+}
+
+// ---- audio and Bluetooth ----
+
+void audio_bridge_mark_cut_through(audio_cut_through_kind_t kind)
+{
+    effect("cut:%s", kind == AUDIO_CUT_THROUGH_WARM ? "warm" : "cold");
+}
+
+esp_err_t bt_app_hf_open_audio(void)
+{
+    effect("sco:open");
+    return ESP_OK;
+}
+
+bool bt_app_hf_audio_preopened(void)
+{
+    return false;
+}
+
+void bt_app_hf_release_audio(void)
+{
+    effect("sco:release");
+}
+
+
+esp_err_t esp_hf_client_answer_call(void)
+{
+    effect("hf:answer");
+    return ESP_OK;
+}
+
+esp_err_t esp_hf_client_reject_call(void)
+{
+    effect("hf:chup");
+    return ESP_OK;
+}
+
+esp_err_t esp_hf_client_dial(const char *number)
+{
+    effect("hf:dial=%s", number);
+    return ESP_OK;
+}
+
+esp_err_t esp_hf_client_send_chld_cmd(esp_hf_chld_type_t chld, int idx)
+{
+    static const char *codes[] = {
+        [ESP_HF_CHLD_TYPE_REL] = "0", [ESP_HF_CHLD_TYPE_REL_ACC] = "1",
+        [ESP_HF_CHLD_TYPE_HOLD_ACC] = "2", [ESP_HF_CHLD_TYPE_MERGE] = "3",
+    };
+    effect("hf:chld=%s", (chld < 4) ? codes[chld] : "?");
+    return ESP_OK;
+}
+
+// ---- dialer, phonebook and handset codes ----
+
+static char dialed[DIALER_MAX_DIGITS + 1];
+static char speed_code[PHONEBOOK_CODE_MAX_LEN + 1];
+static char speed_number[PHONEBOOK_NUMBER_LEN + 1];
+
+size_t dialer_get_number(char *out, size_t size)
+{
+    snprintf(out, size, "%s", dialed);
+    return strlen(out);
+}
+
+char dialer_last_digit(void)
+{
+    size_t len = strlen(dialed);
+    return (len > 0) ? dialed[len - 1] : '\0';
+}
+
+void dialer_reset(void)
+{
+    dialed[0] = '\0';
+}
+
+bool phonebook_speed_dial(const char *code, char *number, size_t size)
+{
+    if (speed_code[0] == '\0' || strcmp(code, speed_code) != 0) {
+        return false;
+    }
+    snprintf(number, size, "%s", speed_number);
+    return true;
+}
+
+bool voicemail_handset_code(const char *digits)
+{
+    if (strcmp(digits, VOICEMAIL_ACCESS_CODE) != 0 && strcmp(digits, VOICEMAIL_GREETING_CODE) != 0) {
+        return false;
+    }
+    effect("voicemail");
+    return true;
+}
+
+bool announce_handset_code(const char *digits)
+{
+    if (strcmp(digits, ANNOUNCE_TIME_CODE) != 0) {
+        return false;
+    }
+    effect("announce");
+    return true;
+}
+
+// ---- esp_timer ----
+
+struct esp_timer {
+    const char *name;
+};
+
+static struct esp_timer timers[4];
+static size_t timer_count;
+static int64_t now_us;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (timer_count == sizeof(timers) / sizeof(timers[0])) {
+        return ESP_ERR_NO_MEM;
+    }
+    timers[timer_count].name = args->name;
+    *out = &timers[timer_count++];
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    effect("timer:%s", timer->name);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    // Moves on with every read, so each timed transition takes some time
+    return now_us += 3;
+}
+
+// ---- replay ----
+
+static int find_event(const char *name)
+{
+    for (int ev = 0; ev < CC_EVENT_COUNT; ev++) {
+        if (strcmp(call_control_event_name((cc_event_t)ev), name) == 0) {
+            return ev;
+        }
+    }
+    return -1;
+}
+
+// Joins the remaining strtok() tokens with single spaces
+static void join_rest(char *out, size_t size)
+{
+    out[0] = '\0';
+    for (char *tok = strtok(NULL, " \t\r\n"); tok != NULL; tok = strtok(NULL, " \t\r\n")) {
+        size_t len = strlen(out);
+        snprintf(out + len, size - len, "%s%s", len > 0 ? " " : "", tok);
+    }
+}
+
+static int replay(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[MAX_LINE];
+    char expected[MAX_LINE];
+    int line_no = 0;
+    int failures = 0;
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+
+    phone_bits = 0;
+    bt_bits = 0;
+    dialed[0] = '\0';
+    speed_code[0] = '\0';
+    timer_count = 0;
+    if (call_control_init() != ESP_OK) {
+        fprintf(stderr, "%s: call_control_init failed\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        line_no++;
+        char *tok = strtok(line, " \t\r\n");
+        if (tok == NULL || tok[0] == '#') {
+            continue;
+        }
+
+        if (strcmp(tok, "@number") == 0) {
+            tok = strtok(NULL, " \t\r\n");
+            snprintf(dialed, sizeof(dialed), "%s", tok ? tok : "");
+            continue;
+        }
+        if (strcmp(tok, "@speed") == 0) {
+            char *code = strtok(NULL, " \t\r\n");
+            char *number = strtok(NULL, " \t\r\n");
+            snprintf(speed_code, sizeof(speed_code), "%s", code ? code : "");
+            snprintf(speed_number, sizeof(speed_number), "%s", number ? number : "");
+            continue;
+        }
+        if (strcmp(tok, "@audio") == 0) {
+            tok = strtok(NULL, " \t\r\n");
+            bool up = (tok != NULL && strcmp(tok, "up") == 0);
+            bt_bits = up ? (bt_bits | BT_STATE_AUDIO_CONNECTED) : (bt_bits & ~BT_STATE_AUDIO_CONNECTED);
+            continue;
+        }
+
+        int ev = find_event(tok);
+        char *state = strtok(NULL, " \t\r\n");
+        if (ev < 0 || state == NULL) {
+            fprintf(stderr, "%s:%d: bad line\n", path, line_no);
+            failures++;
+            break;
+        }
+        join_rest(expected, sizeof(expected));
+
+        if (ev == CC_EVENT_OFF_HOOK) {
+            phone_bits |= PHONE_STATE_OFF_HOOK;
+        } else if (ev == CC_EVENT_ON_HOOK) {
+            phone_bits &= ~PHONE_STATE_OFF_HOOK;
+        }
+
+        cc_state_t from = call_control_get_state();
+        effects[0] = '\0';
+        call_control_dispatch((cc_event_t)ev);
+        const char *got = call_control_state_name(call_control_get_state());
+
+        if (strcmp(got, state) != 0 || strcmp(effects, expected) != 0) {
+            fprintf(stderr, "%s:%d: %s in %s\n"
+                    "  expected: %s [%s]\n"
+                    "  got:      %s [%s]\n",
+                    path, line_no, tok, call_control_state_name(from),
+                    state, expected, got, effects);
+            failures++;
+        }
+    }
+    fclose(f);
+
+    // Every transition taken was timed
+    for (int st = 0; st < CC_STATE_COUNT; st++) {
+        for (int ev = 0; ev < CC_EVENT_COUNT; ev++) {
+            cc_transition_stats_t stats;
+            call_control_get_stats((cc_state_t)st, (cc_event_t)ev, &stats);
+            if (stats.count > 0 && stats.max_us == 0) {
+                fprintf(stderr, "%s: %s/%s counted but not timed\n", path,
+                        call_control_state_name((cc_state_t)st),
+                        call_control_event_name((cc_event_t)ev));
+                failures++;
+            }
+        }
+    }
+    printf("%s: %d line(s), %d failure(s)\n", path, line_no, failures);
+    return failures != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int status = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace> ...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 1; i < argc; i++) {
+        status |= replay(argv[i]);
+    }
+    return status;
+}
@@ -0,0 +1,351 @@
+// Exercises the call detail log against a RAM image of its partition.
+//
+// The image behaves like NOR flash: erase sets whole sectors to 0xFF and a
+// write can only clear bits. A power cut is modelled by letting a write
+// program only its first bytes and then remounting from the image with a
+// fresh cdr_log_t, as the firmware does after a reset.
+
+#include "storage/cdr_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTORS             3
+#define IMAGE_SIZE          (SECTORS * CDR_SECTOR_SIZE)
+#define RECORDS_PER_SECTOR  (CDR_SECTOR_SIZE / CDR_RECORD_SIZE)
+#define NO_CUT              -1
+
+typedef struct {
+    uint8_t mem[IMAGE_SIZE];
+    int cut_after;          // Bytes the next write programs before the power goes, or NO_CUT
+    int erases;
+} ram_flash_t;
+
+static int failures;
+
+#define CHECK(cond, ...) do {                               \
+    if (!(cond)) {                                          \
+        printf("  FAIL %s:%d: ", __FILE__, __LINE__);       \
+        printf(__VA_ARGS__);                                \
+        printf("\n");                                       \
+        failures++;                                         \
+    }                                                       \
+} while (0)
+
+static int ram_read(void *ctx, uint32_t offset, void *dst, size_t len)
+{
+    ram_flash_t *ram = ctx;
+
+    if (offset + len > IMAGE_SIZE) {
+        return -1;
+    }
+    memcpy(dst, ram->mem + offset, len);
+    return 0;
+}
+
+static int ram_write(void *ctx, uint32_t offset, const void *src, size_t len)
+{
+    ram_flash_t *ram = ctx;
+    const uint8_t *p = src;
+    size_t n = len;
+
+    if (offset + len > IMAGE_SIZE || (offset % CDR_SECTOR_SIZE) + len > CDR_SECTOR_SIZE) {
+        printf("  FAIL write of %zu at 0x%x crosses a sector\n", len, (unsigned)offset);
+        failures++;
+        return -1;
+    }
+    if (ram->cut_after != NO_CUT && (size_t)ram->cut_after < len) {
+        n = (size_t)ram->cut_after;
+    }
+    for (size_t i = 0; i < n; i++) {
+        ram->mem[offset + i] &= p[i];
+    }
+    if (n < len) {
+        ram->cut_after = NO_CUT;
+        return -1;
+    }
+    return 0;
+}
+
+static int ram_erase(void *ctx, uint32_t offset, size_t len)
+{
+    ram_flash_t *ram = ctx;
+
+    if (offset % CDR_SECTOR_SIZE != 0 || len % CDR_SECTOR_SIZE != 0 || offset + len > IMAGE_SIZE) {
+        return -1;
+    }
+    memset(ram->mem + offset, 0xFF, len);
+    ram->erases++;
+    return 0;
+}
+
+static ram_flash_t *ram_new(void)
+{
+    ram_flash_t *ram = malloc(sizeof(*ram));
+
+    memset(ram->mem, 0xFF, sizeof(ram->mem));
+    ram->cut_after = NO_CUT;
+    ram->erases = 0;
+    return ram;
+}
+
+static cdr_flash_t flash_of(ram_flash_t *ram)
+{
+    return (cdr_flash_t) {
+        .read = ram_read,
+        .write = ram_write,
+        .erase = ram_erase,
+        .ctx = ram,
+        .size = IMAGE_SIZE,
+    };
+}
+
+// Reset: forget everything in RAM and scan the image again
+static void remount(cdr_log_t *log, ram_flash_t *ram)
+{
+    cdr_flash_t flash = flash_of(ram);
+    CHECK(cdr_log_mount(log, &flash) == 0, "mount failed");
+}
+
+// Append count records whose number field names the sequence they should get.
+// Every call writes different bytes, so a record programmed over a torn one
+// fails its CRC.
+static int append(cdr_log_t *log, size_t count)
+{
+    static uint16_t calls;
+    cdr_record_t recs[RECORDS_PER_SECTOR * 2];
+    int ret = 0;
+
+    calls++;
+    while (count > 0 && ret == 0) {
+        size_t n = count < sizeof(recs) / sizeof(recs[0]) ? count : sizeof(recs) / sizeof(recs[0]);
+        memset(recs, 0, sizeof(recs));
+        for (size_t i = 0; i < n; i++) {
+            recs[i].direction = CDR_DIR_INCOMING;
+            recs[i].outcome = CDR_OUTCOME_ANSWERED;
+            recs[i].duration_ms = 1000;
+            recs[i].underruns = calls;
+            snprintf(recs[i].number, CDR_NUMBER_LEN, "%u", (unsigned)(log->next_seq + i));
+        }
+        ret = cdr_log_append(log, recs, n);
+        count -= n;
+    }
+    return ret;
+}
+
+// Walk the log from after_seq and check it is one unbroken run ending at the head
+static uint32_t check_run(const cdr_log_t *log, uint32_t after_seq, uint32_t *first)
+{
+    cdr_log_iter_t it;
+    cdr_record_t rec;
+    uint32_t count = 0;
+    uint32_t prev = 0;
+
+    cdr_log_iter_begin(log, &it, after_seq);
+    while (cdr_log_iter_next(log, &it, &rec)) {
+        char expect[CDR_NUMBER_LEN];
+        snprintf(expect, sizeof(expect), "%u", (unsigned)rec.seq);
+        CHECK(strcmp(rec.number, expect) == 0, "record %u holds \"%.*s\"",
+              (unsigned)rec.seq, CDR_NUMBER_LEN, rec.number);
+        CHECK(rec.seq > after_seq, "record %u returned after %u", (unsigned)rec.seq,
+              (unsigned)after_seq);
+        if (count == 0 && first != NULL) {
+            *first = rec.seq;
+        }
+        CHECK(count == 0 || rec.seq == prev + 1, "record %u follows %u", (unsigned)rec.seq,
+              (unsigned)prev);
+        prev = rec.seq;
+        count++;
+    }
+    CHECK(count == 0 || prev == log->next_seq - 1, "run ends at %u, next is %u", (unsigned)prev,
+          (unsigned)log->next_seq);
+    return count;
+}
+
+static void test_wraps(void)
+{
+    ram_flash_t *ram = ram_new();
+    cdr_log_t log;
+    uint32_t written = 0;
+
+    printf("wraps\n");
+    remount(&log, ram);
+    CHECK(log.next_seq == 1 && log.head == 0, "blank image mounts at %u/0x%x",
+          (unsigned)log.next_seq, (unsigned)log.head);
+    CHECK(cdr_log_capacity(&log) == (SECTORS - 1) * RECORDS_PER_SECTOR, "capacity %u",
+          (unsigned)cdr_log_capacity(&log));
+
+    // Odd batch sizes so the head lands everywhere, including on sector boundaries
+    static const size_t batches[] = { 1, 7, 63, 64, 65, 1, 128, 3, 200, 17, 64, 31 };
+    for (int pass = 0; pass < 4; pass++) {
+        for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+            CHECK(append(&log, batches[b]) == 0, "append failed");
+            written += batches[b];
+
+            cdr_log_t again;
+            remount(&again, ram);
+            CHECK(again.head == log.head && again.next_seq == log.next_seq,
+                  "remount at 0x%x/%u, live log at 0x%x/%u", (unsigned)again.head,
+                  (unsigned)again.next_seq, (unsigned)log.head, (unsigned)log.next_seq);
+
+            uint32_t first = 0;
+            uint32_t count = check_run(&again, 0, &first);
+            uint32_t want = written < cdr_log_capacity(&log) ? written : cdr_log_capacity(&log);
+            CHECK(count >= want && count <= SECTORS * RECORDS_PER_SECTOR,
+                  "%u records kept after %u written", (unsigned)count, (unsigned)written);
+        }
+    }
+    CHECK(written > 5 * IMAGE_SIZE / CDR_RECORD_SIZE, "only %u records written",
+          (unsigned)written);
+    CHECK(ram->erases == (int)((written + RECORDS_PER_SECTOR - 1) / RECORDS_PER_SECTOR),
+          "%d erases for %u records", ram->erases, (unsigned)written);
+    free(ram);
+}
+
+static void test_torn_record(void)
+{
+    ram_flash_t *ram = ram_new();
+    cdr_log_t log;
+
+    printf("torn_record\n");
+    remount(&log, ram);
+
+    // Two full passes, then stop mid-sector
+    append(&log, 2 * SECTORS * RECORDS_PER_SECTOR + 20);
+    uint32_t good = log.next_seq - 1;
+    uint32_t torn_at = log.head;
+    CHECK(torn_at % CDR_SECTOR_SIZE != 0, "head 0x%x is not mid-sector", (unsigned)torn_at);
+
+    // Power goes halfway through the next record
+    ram->cut_after = CDR_RECORD_SIZE / 2;
+    CHECK(append(&log, 1) != 0, "torn write reported success");
+
+    remount(&log, ram);
+    CHECK(log.next_seq == good + 1, "resumes at %u after %u", (unsigned)log.next_seq,
+          (unsigned)good);
+    CHECK(log.head == torn_at + CDR_RECORD_SIZE, "head 0x%x, torn slot 0x%x",
+          (unsigned)log.head, (unsigned)torn_at);
+    check_run(&log, 0, NULL);
+
+    // The torn slot is stepped over, never programmed again
+    CHECK(append(&log, 5) == 0, "append after the tear failed");
+    uint32_t first = 0;
+    uint32_t count = check_run(&log, good - 10, &first);
+    CHECK(count == 15 && first == good - 9, "%u records from %u", (unsigned)count,
+          (unsigned)first);
+
+    // A tear in the last slot of a sector leaves the head at the next sector
+    append(&log, RECORDS_PER_SECTOR - (log.head % CDR_SECTOR_SIZE) / CDR_RECORD_SIZE - 1);
+    good = log.next_seq - 1;
+    ram->cut_after = 10;
+    append(&log, 1);
+    remount(&log, ram);
+    CHECK(log.next_seq == good + 1 && log.head % CDR_SECTOR_SIZE == 0,
+          "resumes at %u/0x%x", (unsigned)log.next_seq, (unsigned)log.head);
+    CHECK(append(&log, 3) == 0, "append into the next sector failed");
+    check_run(&log, 0, NULL);
+    free(ram);
+}
+
+static void test_erase_then_crash(void)
+{
+    ram_flash_t *ram = ram_new();
+    cdr_log_t log;
+
+    printf("erase_then_crash\n");
+    remount(&log, ram);
+
+    // End exactly on a sector boundary after wrapping, so the next sector holds the oldest pass
+    append(&log, 2 * SECTORS * RECORDS_PER_SECTOR + RECORDS_PER_SECTOR);
+    uint32_t good = log.next_seq - 1;
+    uint32_t boundary = log.head;
+    CHECK(boundary % CDR_SECTOR_SIZE == 0, "head 0x%x not on a boundary", (unsigned)boundary);
+    CHECK(check_run(&log, 0, NULL) == SECTORS * RECORDS_PER_SECTOR, "full image not readable");
+
+    // The sector is erased, then power goes before a byte of the record lands
+    int erases = ram->erases;
+    ram->cut_after = 0;
+    CHECK(append(&log, 1) != 0, "failed write reported success");
+    CHECK(ram->erases == erases + 1, "sector not erased");
+
+    remount(&log, ram);
+    CHECK(log.head == boundary && log.next_seq == good + 1, "resumes at 0x%x/%u",
+          (unsigned)log.head, (unsigned)log.next_seq);
+    uint32_t first = 0;
+    uint32_t count = check_run(&log, 0, &first);
+    CHECK(count == cdr_log_capacity(&log) && first == good - count + 1,
+          "%u records from %u after losing the oldest sector", (unsigned)count, (unsigned)first);
+
+    // The half-done erase is redone and the log carries on
+    CHECK(append(&log, 2) == 0, "append after the crash failed");
+    CHECK(ram->erases == erases + 2, "sector not erased again");
+    count = check_run(&log, 0, &first);
+    CHECK(count == cdr_log_capacity(&log) + 2, "%u records", (unsigned)count);
+    free(ram);
+}
+
+static void test_resume(void)
+{
+    ram_flash_t *ram = ram_new();
+    cdr_log_t log;
+    cdr_log_iter_t it;
+    cdr_record_t rec;
+
+    printf("resume\n");
+    remount(&log, ram);
+    append(&log, SECTORS * RECORDS_PER_SECTOR * 3 + 40);
+    uint32_t newest = log.next_seq - 1;
+
+    // From the middle: exactly the records after it
+    uint32_t first = 0;
+    uint32_t count = check_run(&log, newest - 50, &first);
+    CHECK(count == 50 && first == newest - 49, "%u records from %u", (unsigned)count,
+          (unsigned)first);
+
+    // From before the oldest kept: everything that is left
+    uint32_t all = check_run(&log, 0, &first);
+    count = check_run(&log, 5, NULL);
+    CHECK(count == all, "%u records after an overwritten seq, %u kept", (unsigned)count,
+          (unsigned)all);
+
+    // From the newest: nothing until something new is appended
+    CHECK(check_run(&log, newest, NULL) == 0, "records returned after the newest");
+    append(&log, 3);
+    count = check_run(&log, newest, &first);
+    CHECK(count == 3 && first == newest + 1, "%u new records from %u", (unsigned)count,
+          (unsigned)first);
+
+    // After a reset, the same position picks up where the reader stopped
+    remount(&log, ram);
+    count = check_run(&log, newest + 1, &first);
+    CHECK(count == 2 && first == newest + 2, "%u records from %u after remount",
+          (unsigned)count, (unsigned)first);
+
+    // Appends that lap a running iterator never make it go backwards
+    cdr_log_iter_begin(&log, &it, 0);
+    uint32_t prev = 0;
+    for (int i = 0; i < 30 && cdr_log_iter_next(&log, &it, &rec); i++) {
+        prev = rec.seq;
+    }
+    append(&log, SECTORS * RECORDS_PER_SECTOR);
+    while (cdr_log_iter_next(&log, &it, &rec)) {
+        CHECK(rec.seq > prev, "record %u after %u", (unsigned)rec.seq, (unsigned)prev);
+        prev = rec.seq;
+    }
+    free(ram);
+}
+
+int main(void)
+{
+    test_wraps();
+    test_torn_record();
+    test_erase_then_crash();
+    test_resume();
+
+    if (failures) {
+        printf("%d failure(s)\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
@@ -0,0 +1,436 @@
+#!/usr/bin/env python3
+"""
+Announcement Packer for Ma Bell Gateway
+
+Packs WAV recordings into the image the firmware plays from its "announce"
+partition, checks an image, and writes one to a device.
+
+Each WAV becomes one clip named after the file (intercept.wav -> "intercept").
+Clips are converted to 8 kHz mono, trimmed of leading and trailing silence,
+normalized and encoded as 4-bit IMA ADPCM exactly as main/audio/ima_adpcm.c
+decodes it. The layout is described in main/audio/announce_image.h.
+
+    ./pack_announcements.py pack -o announce.bin ../announcements
+    ./pack_announcements.py verify announce.bin --extract /tmp/clips
+    ./pack_announcements.py flash announce.bin
+"""
+
+import sys
+import os
+import re
+import struct
+import subprocess
+import argparse
+import wave
+import zlib
+import math
+
+IMAGE_MAGIC = 0x434E4E41        # "ANNC"
+IMAGE_VERSION = 1
+HEADER = struct.Struct('<IHHII')        # magic, version, count, size, crc
+ENTRY = struct.Struct('<16sIIHHI')      # name, offset, length, format, reserved, crc
+FORMAT_IMA_ADPCM = 1
+NAME_LEN = 16
+SAMPLE_RATE = 8000
+PARTITION_NAME = 'announce'
+PARTITION_SIZE = 0x100000
+
+# Clips the firmware asks for by name (main/config/call_config.h, announce.c)
+CALL_PROGRESS_CLIPS = ['intercept', 'permanent']
+TIME_CLIPS = (['time', 'oh', 'oclock', 'am', 'pm'] +
+              ['n_%d' % n for n in list(range(1, 20)) + [20, 30, 40, 50]])
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+class Adpcm:
+    """IMA ADPCM state, stepped the same way as ima_adpcm.c"""
+
+    def __init__(self):
+        self.predictor = 0
+        self.index = 0
+
+    def update(self, code):
+        step = STEP_TABLE[self.index]
+        diff = step >> 3
+        if code & 4:
+            diff += step
+        if code & 2:
+            diff += step >> 1
+        if code & 1:
+            diff += step >> 2
+        pred = self.predictor - diff if code & 8 else self.predictor + diff
+        self.predictor = max(-32768, min(32767, pred))
+        self.index = max(0, min(88, self.index + INDEX_TABLE[code & 7]))
+
+    def encode_sample(self, sample):
+        step = STEP_TABLE[self.index]
+        diff = sample - self.predictor
+        code = 0
+        if diff < 0:
+            code = 8
+            diff = -diff
+        if diff >= step:
+            code |= 4
+            diff -= step
+        step >>= 1
+        if diff >= step:
+            code |= 2
+            diff -= step
+        step >>= 1
+        if diff >= step:
+            code |= 1
+        self.update(code)
+        return code
+
+
+def adpcm_encode(samples):
+    """Encode 16-bit samples, two per byte, low nibble first"""
+    if len(samples) % 2:
+        samples = samples + [0]
+    codec = Adpcm()
+    out = bytearray()
+    for i in range(0, len(samples), 2):
+        lo = codec.encode_sample(samples[i])
+        hi = codec.encode_sample(samples[i + 1])
+        out.append(lo | (hi << 4))
+    return bytes(out)
+
+
+def adpcm_decode(data):
+    codec = Adpcm()
+    samples = []
+    for byte in data:
+        codec.update(byte & 0x0F)
+        samples.append(codec.predictor)
+        codec.update(byte >> 4)
+        samples.append(codec.predictor)
+    return samples
+
+
+def read_wav(path):
+    """Read a PCM WAV as a list of mono 16-bit samples at its own rate"""
+    with wave.open(path, 'rb') as w:
+        channels = w.getnchannels()
+        width = w.getsampwidth()
+        rate = w.getframerate()
+        raw = w.readframes(w.getnframes())
+
+    if width == 1:
+        values = [(b - 128) << 8 for b in raw]
+    elif width == 2:
+        values = list(struct.unpack('<%dh' % (len(raw) // 2), raw))
+    else:
+        raise ValueError('%s: %d-bit samples, only 8 and 16 are supported' % (path, width * 8))
+
+    if channels > 1:
+        values = [sum(values[i:i + channels]) // channels
+                  for i in range(0, len(values), channels)]
+    return values, rate
+
+
+def resample(samples, rate):
+    """Resample to 8 kHz, averaging over each output period when downsampling"""
+    if rate == SAMPLE_RATE or not samples:
+        return samples
+    ratio = rate / SAMPLE_RATE
+    count = int(len(samples) / ratio)
+    out = []
+    for i in range(count):
+        start = i * ratio
+        if ratio > 1:
+            # Box filter over the input samples this output sample covers
+            lo = int(start)
+            hi = max(lo + 1, min(len(samples), int(start + ratio)))
+            out.append(sum(samples[lo:hi]) // (hi - lo))
+        else:
+            lo = int(start)
+            frac = start - lo
+            nxt = samples[min(lo + 1, len(samples) - 1)]
+            out.append(int(samples[lo] * (1 - frac) + nxt * frac))
+    return out
+
+
+def trim(samples, threshold_db, pad_ms=20):
+    """Drop leading and trailing samples below the threshold, keeping a short pad"""
+    limit = 32767 * 10 ** (threshold_db / 20)
+    loud = [i for i, s in enumerate(samples) if abs(s) > limit]
+    if not loud:
+        return []
+    pad = SAMPLE_RATE * pad_ms // 1000
+    return samples[max(0, loud[0] - pad):loud[-1] + 1 + pad]
+
+
+def normalize(samples, peak_db):
+    peak = max((abs(s) for s in samples), default=0)
+    if peak == 0:
+        return samples
+    gain = 32767 * 10 ** (peak_db / 20) / peak
+    return [max(-32768, min(32767, int(round(s * gain)))) for s in samples]
+
+
+def snr_db(reference, decoded):
+    signal = sum(s * s for s in reference)
+    noise = sum((a - b) ** 2 for a, b in zip(reference, decoded))
+    if noise == 0:
+        return float('inf')
+    if signal == 0:
+        return 0.0
+    return 10 * math.log10(signal / noise)
+
+
+def clip_name(path):
+    name = os.path.splitext(os.path.basename(path))[0].lower()
+    if not re.fullmatch(r'[a-z0-9_]{1,%d}' % (NAME_LEN - 1), name):
+        raise ValueError('%s: clip names are 1-%d of a-z, 0-9 and _' % (path, NAME_LEN - 1))
+    return name
+
+
+def collect(inputs):
+    paths = []
+    for item in inputs:
+        if os.path.isdir(item):
+            paths += sorted(os.path.join(item, f) for f in os.listdir(item)
+                            if f.lower().endswith('.wav'))
+        else:
+            paths.append(item)
+    return paths
+
+
+def build_image(clips):
+    """clips: list of (name, adpcm bytes); returns the image"""
+    dir_end = HEADER.size + len(clips) * ENTRY.size
+    offset = (dir_end + 3) & ~3
+    entries = bytearray()
+    data = bytearray(offset - dir_end)
+
+    for name, adpcm in clips:
+        entries += ENTRY.pack(name.encode('ascii'), offset, len(adpcm), FORMAT_IMA_ADPCM, 0,
+                              zlib.crc32(adpcm))
+        data += adpcm
+        pad = -len(adpcm) & 3
+        data += bytes(pad)
+        offset += len(adpcm) + pad
+
+    size = dir_end + len(data)
+    head = struct.pack('<IHHI', IMAGE_MAGIC, IMAGE_VERSION, len(clips), size)
+    crc = zlib.crc32(bytes(entries), zlib.crc32(head))
+    return head + struct.pack('<I', crc) + bytes(entries) + bytes(data)
+
+
+def parse_image(image):
+    """Check an image as announce_image.c does, then every clip CRC.
+
+    Returns a list of (name, adpcm bytes); raises ValueError on any fault."""
+    if len(image) < HEADER.size:
+        raise ValueError('shorter than a header')
+    magic, version, count, size, crc = HEADER.unpack_from(image)
+    if magic != IMAGE_MAGIC:
+        raise ValueError('bad magic 0x%08X' % magic)
+    if version != IMAGE_VERSION:
+        raise ValueError('version %d, expected %d' % (version, IMAGE_VERSION))
+    if size > len(image):
+        raise ValueError('header says %d bytes, file has %d' % (size, len(image)))
+    dir_end = HEADER.size + count * ENTRY.size
+    if dir_end > size:
+        raise ValueError('directory runs past the image')
+    if zlib.crc32(image[HEADER.size:dir_end], zlib.crc32(image[:12])) != crc:
+        raise ValueError('header CRC mismatch')
+
+    clips = []
+    names = set()
+    for i in range(count):
+        raw, offset, length, fmt, _, clip_crc = ENTRY.unpack_from(image, HEADER.size + i * ENTRY.size)
+        name = raw.rstrip(b'\0').decode('ascii', 'replace')
+        if offset < dir_end or offset > size or length > size - offset:
+            raise ValueError('%s: clip lies outside the image' % name)
+        if fmt != FORMAT_IMA_ADPCM:
+            raise ValueError('%s: unknown format %d' % (name, fmt))
+        if name in names:
+            raise ValueError('%s: duplicate name, the firmware only finds the first' % name)
+        adpcm = image[offset:offset + length]
+        if zlib.crc32(adpcm) != clip_crc:
+            raise ValueError('%s: clip CRC mismatch' % name)
+        names.add(name)
+        clips.append((name, adpcm))
+    return clips
+
+
+def report_missing(names):
+    missing = [n for n in CALL_PROGRESS_CLIPS if n not in names]
+    for name in missing:
+        print('  note: no "%s" clip, the plain tone plays instead' % name)
+    missing_time = [n for n in TIME_CLIPS if n not in names]
+    if len(missing_time) < len(TIME_CLIPS) and missing_time:
+        print('  note: time of day will skip: %s' % ', '.join(missing_time))
+
+
+def cmd_pack(args):
+    paths = collect(args.inputs)
+    if not paths:
+        print('Error: no WAV files given')
+        return 1
+
+    clips = []
+    names = set()
+    for path in paths:
+        try:
+            name = clip_name(path)
+            samples, rate = read_wav(path)
+        except (ValueError, wave.Error, OSError) as e:
+            print('Error: %s' % e)
+            return 1
+        if name in names:
+            print('Error: two clips named "%s"' % name)
+            return 1
+        names.add(name)
+
+        pcm = resample(samples, rate)
+        if not args.no_trim:
+            pcm = trim(pcm, args.trim_db)
+        if not pcm:
+            print('Error: %s is silent' % path)
+            return 1
+        if not args.no_normalize:
+            pcm = normalize(pcm, args.peak_db)
+
+        adpcm = adpcm_encode(pcm)
+        snr = snr_db(pcm, adpcm_decode(adpcm))
+        print('  %-15s %6.2f s  %6d bytes  SNR %5.1f dB' %
+              (name, len(adpcm) * 2 / SAMPLE_RATE, len(adpcm), snr))
+        clips.append((name, adpcm))
+
+    image = build_image(clips)
+    if len(image) > args.partition_size:
+        print('Error: image is %d bytes, the partition holds %d' % (len(image), args.partition_size))
+        return 1
+
+    # Check the result the way the firmware will before writing it
+    parse_image(image)
+    with open(args.output, 'wb') as f:
+        f.write(image)
+
+    print('✓ %d clips, %d bytes (%.0f%% of the partition) -> %s' %
+          (len(clips), len(image), 100.0 * len(image) / args.partition_size, args.output))
+    report_missing(names)
+    return 0
+
+
+def cmd_verify(args):
+    with open(args.image, 'rb') as f:
+        image = f.read()
+    try:
+        clips = parse_image(image)
+    except ValueError as e:
+        print('Error: %s: %s' % (args.image, e))
+        return 1
+
+    if len(image) > args.partition_size:
+        print('Error: image is %d bytes, the partition holds %d' % (len(image), args.partition_size))
+        return 1
+
+    for name, adpcm in clips:
+        pcm = adpcm_decode(adpcm)
+        peak = max((abs(s) for s in pcm), default=0)
+        print('  %-15s %6.2f s  peak %5d' % (name, len(pcm) / SAMPLE_RATE, peak))
+        if args.extract:
+            os.makedirs(args.extract, exist_ok=True)
+            with wave.open(os.path.join(args.extract, name + '.wav'), 'wb') as w:
+                w.setnchannels(1)
+                w.setsampwidth(2)
+                w.setframerate(SAMPLE_RATE)
+                w.writeframes(struct.pack('<%dh' % len(pcm), *pcm))
+
+    print('✓ %s: %d clips, header and clip CRCs good' % (args.image, len(clips)))
+    report_missing({name for name, _ in clips})
+    return 0
+
+
+def cmd_flash(args):
+    idf_path = os.environ.get('IDF_PATH')
+    if not idf_path:
+        print("Error: IDF_PATH environment variable not set")
+        print("Please run: export IDF_PATH=/path/to/esp-idf")
+        return 1
+
+    with open(args.image, 'rb') as f:
+        try:
+            parse_image(f.read())
+        except ValueError as e:
+            print('Error: %s: %s' % (args.image, e))
+            return 1
+
+    port = args.port
+    if port is None:
+        from provision_wifi import find_esp32_port
+        print("Auto-detecting ESP32 serial port...")
+        port = find_esp32_port()
+        if port is None:
+            print("Error: Could not find ESP32 device")
+            print("Please specify port manually with -p /dev/ttyUSB0")
+            return 1
+        print(f"✓ Found ESP32 on port: {port}")
+
+    parttool = os.path.join(idf_path, 'components', 'partition_table', 'parttool.py')
+    print(f"\nWriting {args.image} to the \"{PARTITION_NAME}\" partition on {port}...")
+    result = subprocess.run([
+        sys.executable, parttool, '--port', port,
+        'write_partition', '--partition-name', PARTITION_NAME, '--input', args.image
+    ], capture_output=True, text=True)
+
+    if result.returncode != 0:
+        print(f"Error flashing device: {result.stderr}")
+        return 1
+
+    print("✓ Announcements flashed; they are picked up on the next boot")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Pack, check and flash recorded announcements'
+    )
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('pack', help='Build an image from WAV files')
+    p.add_argument('inputs', nargs='+', help='WAV files, or directories of them')
+    p.add_argument('-o', '--output', default='announce.bin', help='Image to write')
+    p.add_argument('--peak-db', type=float, default=-3.0,
+                   help='Normalize each clip to this peak, dBFS (default -3)')
+    p.add_argument('--no-normalize', action='store_true', help='Keep recorded levels')
+    p.add_argument('--trim-db', type=float, default=-45.0,
+                   help='Trim leading and trailing audio below this, dBFS (default -45)')
+    p.add_argument('--no-trim', action='store_true', help='Keep leading and trailing silence')
+    p.add_argument('--partition-size', type=lambda s: int(s, 0), default=PARTITION_SIZE,
+                   help='Bytes in the announce partition (default 0x100000)')
+    p.set_defaults(func=cmd_pack)
+
+    v = sub.add_parser('verify', help='Check an image as the firmware would')
+    v.add_argument('image')
+    v.add_argument('--extract', metavar='DIR', help='Write each clip, decoded, as a WAV')
+    v.add_argument('--partition-size', type=lambda s: int(s, 0), default=PARTITION_SIZE)
+    v.set_defaults(func=cmd_verify)
+
+    f = sub.add_parser('flash', help='Write an image to the announce partition')
+    f.add_argument('image')
+    f.add_argument('-p', '--port', default=None,
+                   help='Serial port (auto-detect if not specified)')
+    f.set_defaults(func=cmd_flash)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())